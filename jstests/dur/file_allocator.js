@@ -0,0 +1,125 @@
+/* file_allocator.js
+   serverStatus reports the file allocator's work and the time callers waited on it, the data
+   file after the one a database has just added is allocated ahead of need, and a journal file
+   that rotates out is recycled as journal/prealloc.<n> unless --nopreallocj was given.
+*/
+
+testname = "file_allocator";
+load("jstests/_tst.js");
+
+var port = 30001;
+
+function fileNames(dir) {
+    return listFiles(dir).map(function(f) { return f.baseName; });
+}
+
+function has(dir, name) {
+    return fileNames(dir).indexOf(name) >= 0;
+}
+
+function fileAllocatorStats(conn) {
+    var fa = conn.getDB("admin").serverStatus().fileAllocator;
+    printjson(fa);
+    assert(fa, "no fileAllocator section in serverStatus");
+    ["pending", "allocations", "reservedWithoutWriting", "allocationMillis"].forEach(function(f) {
+        assert(typeof fa[f] == "number", "fileAllocator." + f);
+    });
+    assert(fa.waits, "no fileAllocator.waits");
+    ["count", "totalMicros", "maxMicros"].forEach(function(f) {
+        assert(typeof fa.waits[f] == "number", "fileAllocator.waits." + f);
+    });
+    assert.lte(fa.reservedWithoutWriting, fa.allocations);
+    assert.lte(fa.waits.maxMicros, fa.waits.totalMicros);
+    return fa;
+}
+
+function checkDataFiles(conn, path) {
+    tst.log("data files are allocated one ahead");
+    var before = fileAllocatorStats(conn);
+
+    // A new database's files are needed at once, so the first insert waits for them.  The .0 is
+    // 16MB with --smallfiles, so this adds the .1 as well.
+    var d = conn.getDB("alloc");
+    var pad = new Array(20 * 1024).join("x");
+    for (var i = 0; i < 1000; i++) {
+        d.foo.insert({ _id: i, pad: pad });
+    }
+    assert.eq(null, d.getLastError());
+    assert(has(path, "alloc.1"), "alloc.1 wasn't added");
+
+    assert.soon(function() { return has(path, "alloc.2"); }, "alloc.2 wasn't allocated ahead");
+    assert.soon(function() { return fileAllocatorStats(conn).pending == 0; });
+
+    var after = fileAllocatorStats(conn);
+    // alloc.ns, alloc.0, alloc.1 and alloc.2
+    assert.gte(after.allocations - before.allocations, 4);
+    assert.gt(after.waits.count, before.waits.count, "nothing waited for the new database's files");
+    assert.gt(after.waits.totalMicros, before.waits.totalMicros);
+    assert.gte(after.waits.maxMicros, before.waits.maxMicros);
+}
+
+// Rewrites a 1MB document until j._0 is retired.  The journal is compressed, so the document
+// repeats a random run longer than snappy's 64KB blocks, leaving it nothing to match.
+function rotateJournal(conn, retiredPattern) {
+    var chars = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789+/";
+    var run = "";
+    for (var i = 0; i < 70000; i++) {
+        run += chars[Math.floor(Math.random() * chars.length)];
+    }
+    var big = new Array(16).join(run);
+
+    var d = conn.getDB("rotate");
+    d.foo.insert({ _id: 0, pad: 1000000 + big });
+    // 128MB journal files with --smallfiles
+    for (var i = 0; i < 1000; i++) {
+        d.foo.update({ _id: 0 }, { $set: { pad: (1000000 + i) + big } });
+        if (i % 10 == 0) {
+            assert.eq(null, d.runCommand({ getlasterror: 1, j: true }).err);
+            var m = rawMongoProgramOutput().match(retiredPattern);
+            if (m) {
+                return m;
+            }
+        }
+    }
+    assert(false, "j._0 was never retired");
+}
+
+function run(preallocj) {
+    var path = MongoRunner.dataDir + "/" + testname + (preallocj ? "" : "_nopreallocj");
+    var journal = path + "/journal";
+    var args = ["--port", port, "--dbpath", path, "--journal", "--smallfiles", "--syncdelay", 1];
+    if (!preallocj) {
+        args.push("--nopreallocj");
+    }
+
+    tst.log("start mongod " + (preallocj ? "" : "--nopreallocj"));
+    clearRawMongoProgramOutput();
+    var conn = startMongodEmpty.apply(null, args);
+    assert(has(journal, "j._0"));
+
+    if (preallocj) {
+        checkDataFiles(conn, path);
+
+        tst.log("a rotated out journal file is recycled");
+        var m = rotateJournal(conn, /recycled journal file \S*j\._0 as \S*(prealloc\.\d)/);
+        // no more was written than fits in j._1, so nothing has taken the file since
+        assert(has(journal, m[1]), m[1] + " isn't there");
+        assert(!has(journal, "j._0"));
+    }
+    else {
+        tst.log("a rotated out journal file is removed");
+        rotateJournal(conn, /old journal file will be removed: \S*j\._0/);
+        assert.soon(function() { return !has(journal, "j._0"); }, "j._0 wasn't removed");
+        assert(!rawMongoProgramOutput().match(/recycled journal file/));
+        printjson(fileNames(journal));
+        assert(!fileNames(journal).some(function(f) { return f.indexOf("prealloc.") == 0; }),
+               "prealloc files with --nopreallocj");
+    }
+
+    stopMongod(port);
+}
+
+run(true);
+run(false);
+
+tst.success();
@@ -0,0 +1,64 @@
+/* journal_format.js
+   Journals written in the chunked 0x414a format, and in the single block 0x4149 format of the
+   previous release (journalSingleBlockSections), are both replayed after a crash by a current
+   mongod.  The writes are big enough for group commits of several compressed chunks.
+*/
+
+testname = "journal_format";
+load("jstests/_tst.js");
+
+var port = 30001;
+
+function work(conn) {
+    var d = conn.getDB("test");
+    // a few MB per document, so each group commit spans several 512KB chunks
+    for (var i = 0; i < 4; i++) {
+        var pad = new Array(3 * 1024 * 1024).join(String.fromCharCode(65 + i));
+        d.foo.insert({ _id: i, pad: pad });
+    }
+    for (var i = 4; i < 1000; i++) {
+        d.foo.insert({ _id: i, x: i * i });
+    }
+    d.foo.update({ _id: 2 }, { $set: { pad: "gone" } });
+    d.foo.ensureIndex({ x: 1 });
+    assert.eq(null, d.runCommand({ getlasterror: 1, j: true }).err);
+    return d.runCommand({ dbhash: 1 }).md5;
+}
+
+function test(singleBlock, expectedVersion) {
+    var path = MongoRunner.dataDir + "/" + testname + expectedVersion;
+
+    tst.log("write a " + expectedVersion + " journal and kill -9");
+    var conn = startMongodEmpty("--port", port, "--dbpath", path, "--journal", "--smallfiles",
+                                "--syncdelay", 0,
+                                "--setParameter", "journalSingleBlockSections=" + singleBlock);
+    var hash = work(conn);
+    stopMongod(port, /*signal*/9);
+
+    tst.log("recover only, dumping the journal");
+    clearRawMongoProgramOutput();
+    // DurDumpJournal | DurRecoverOnly
+    assert.eq(0, runMongoProgram("mongod", "--port", port, "--dbpath", path, "--journal",
+                                 "--smallfiles", "--journalOptions", 5));
+    var out = rawMongoProgramOutput();
+    assert(out.match(new RegExp("JHeader::fileId=\\d+ version:" + expectedVersion)),
+           "journal wasn't written as " + expectedVersion);
+    assert(out.match(/BEGIN section/), "no journal section was replayed");
+    assert(!out.match(/couldn't uncompress journal section/));
+
+    tst.log("restart and check the data");
+    conn = startMongodNoReset("--port", port, "--dbpath", path, "--journal", "--smallfiles");
+    var d = conn.getDB("test");
+    assert.eq(1000, d.foo.count());
+    assert.eq("gone", d.foo.findOne({ _id: 2 }).pad);
+    assert.eq(3 * 1024 * 1024 - 1, d.foo.findOne({ _id: 3 }).pad.length);
+    assert.eq(hash, d.runCommand({ dbhash: 1 }).md5, "data differs after recovery");
+    stopMongod(port);
+}
+
+test(false, "414a");
+
+// as an older release would have left it, replayed by this one
+test(true, "4149");
+
+tst.success();
@@ -0,0 +1,62 @@
+/* remap_backlog.js
+   REMAPPRIVATEVIEW works to a time budget and may stop short of its files.  Drive many remap
+   cycles with writes spread over many files and check that what it leaves for later doesn't
+   grow without limit, and that the data is all there once the journal is replayed.
+*/
+
+testname = "remap_backlog";
+load("jstests/_tst.js");
+
+var path = MongoRunner.dataDir + "/remap_backlog";
+var port = 30001;
+var numDbs = 40;
+var docsPerDb = 2000;
+
+// The limit on uncommitted bytes (dur.h) a full pass is forced at, on 64 bit builds.
+var uncommittedBytesLimit = 100 * 1024 * 1024;
+
+tst.log("start mongod with dur");
+var conn = startMongodEmpty("--port", port, "--dbpath", path, "--dur", "--smallfiles",
+                            "--journalCommitInterval", 5);
+
+// Lots of files so that one pass over them doesn't fit in the budget.
+tst.log("create " + numDbs + " databases");
+for (var i = 0; i < numDbs; i++) {
+    conn.getDB("remap" + i).foo.insert({ _id: -1 });
+}
+conn.getDB("remap0").getLastError();
+
+tst.log("write to all of them while sampling the remap backlog");
+var pad = new Array(1024).join("x");
+var maxBacklog = 0;
+for (var n = 0; n < docsPerDb; n++) {
+    for (var i = 0; i < numDbs; i++) {
+        conn.getDB("remap" + i).foo.insert({ _id: n, pad: pad });
+    }
+    if (n % 100 == 0) {
+        var dur = conn.getDB("admin").serverStatus().dur;
+        assert(dur.remapPrivateViewBacklogBytes !== undefined, "no remapPrivateViewBacklogBytes");
+        maxBacklog = Math.max(maxBacklog, dur.remapPrivateViewBacklogBytes);
+    }
+}
+conn.getDB("remap0").getLastError(null, true);
+print("largest remap backlog: " + maxBacklog + " bytes");
+assert.lt(maxBacklog, 2 * uncommittedBytesLimit, "remap backlog not bounded");
+
+tst.log("backlog drains once writes stop");
+assert.soon(function() {
+    var backlog = conn.getDB("admin").serverStatus().dur.remapPrivateViewBacklogBytes;
+    print("remap backlog: " + backlog);
+    return backlog < 1024 * 1024;
+}, "remap backlog didn't drain", 60 * 1000, 1000);
+
+tst.log("kill -9 mongod and recover");
+stopMongod(port, /*signal*/9);
+conn = startMongodNoReset("--port", port, "--dbpath", path, "--dur", "--smallfiles");
+
+for (var i = 0; i < numDbs; i++) {
+    assert.eq(docsPerDb + 1, conn.getDB("remap" + i).foo.count(), "remap" + i);
+}
+
+stopMongod(port);
+tst.success();
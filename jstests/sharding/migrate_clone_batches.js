@@ -0,0 +1,124 @@
+//
+// Tests chunk migrations whose initial clone spans several _migrateClone batches: one with
+// inserts running against the chunk, one aborted by the donor part way through the clone, and
+// the retry of that one.
+//
+
+var st = new ShardingTest({ shards : 2, mongos : 1,
+                            other : { separateConfig : true, chunksize : 128 } });
+st.stopBalancer();
+
+var mongos = st.s0;
+var shards = mongos.getDB( "config" ).shards.find().toArray();
+var admin = mongos.getDB( "admin" );
+var db = mongos.getDB( "foo" ); // startParallelShell() uses 'db'
+var coll = db.bar;
+
+assert( admin.runCommand({ enableSharding : db + "" }).ok );
+printjson( admin.runCommand({ movePrimary : db + "", to : shards[0]._id }) );
+assert( admin.runCommand({ shardCollection : coll + "", key : { _id : 1 } }).ok );
+
+// About 40MB of small documents, so the clone needs at least three 16MB batches.  Inserted on
+// the shard itself so that nothing splits the chunk.
+var numDocs = 40 * 1024;
+var numConcurrent = 1000;
+var pad = new Array( 1000 ).join( "x" );
+var shardColl = st.shard0.getCollection( coll + "" );
+for ( var i = 0; i < numDocs; i++ ) {
+    shardColl.insert({ _id : i, pad : pad });
+}
+assert.eq( null, shardColl.getDB().getLastError() );
+
+var moveCmd = function( to ) {
+    return { moveChunk : coll + "", find : { _id : 0 }, to : to, _waitForDelete : true };
+};
+
+var checkPlacement = function( onShard, offShard, total ) {
+    assert.eq( total, onShard.getCollection( coll + "" ).count() );
+    assert.eq( 0, offShard.getCollection( coll + "" ).count() );
+    assert.eq( total, coll.find().itcount() );
+    assert.eq( total, coll.distinct( "_id" ).length );
+};
+
+jsTest.log( "Moving the chunk while inserting into it..." );
+
+var inserts = startParallelShell(
+    "for ( var i = 0; i < " + numConcurrent + "; i++ ) {" +
+    "    db.bar.insert({ _id : " + numDocs + " + i, pad : 'concurrent' });" +
+    "}" +
+    "assert.eq( null, db.getLastError() );" );
+
+var result = admin.runCommand( moveCmd( shards[1]._id ) );
+printjson( result );
+assert( result.ok );
+inserts();
+
+checkPlacement( st.shard1, st.shard0, numDocs + numConcurrent );
+
+var entry = mongos.getDB( "config" ).changelog.find({ what : "moveChunk.to", ns : coll + "" })
+                                               .sort({ time : -1 }).limit( 1 ).next();
+printjson( entry );
+assert.lte( numDocs, entry.details.clonedDocs );
+assert.lt( numDocs * pad.length, entry.details.clonedBytes );
+assert( entry.details.clonedBytesPerSec > 0 );
+assert( entry.details.maxCloneLockMicros !== undefined );
+
+jsTest.log( "Aborting a move back part way through the clone..." );
+
+var total = numDocs + numConcurrent;
+var recipientAdmin = st.shard0.getDB( "admin" );
+assert.commandWorked( recipientAdmin.runCommand(
+    { configureFailPoint : "migrateThreadHangDuringClone", mode : "alwaysOn" }) );
+
+var move = startParallelShell(
+    "var res = db.adminCommand(" + tojson( moveCmd( shards[0]._id ) ) + ");" +
+    "printjson( res );" +
+    "assert( !res.ok, 'aborted migration succeeded' );" );
+
+// the first batch is in, the rest are not
+assert.soon( function() {
+    var status = recipientAdmin.runCommand({ _recvChunkStatus : 1 });
+    printjson( status );
+    return status.active && status.state == "clone" &&
+           status.counts.cloned > 0 && status.counts.cloned < total;
+}, "recipient didn't pause in the clone", 5 * 60 * 1000 );
+
+// the donor gives up, as on any error while the clone is in progress
+var donorAdmin = st.shard1.getDB( "admin" );
+var killed = false;
+donorAdmin.currentOp().inprog.forEach( function( op ) {
+    if ( op.query && op.query.moveChunk == coll + "" ) {
+        printjson( op );
+        donorAdmin.killOp( op.opid );
+        killed = true;
+    }
+});
+assert( killed, "no moveChunk to kill on the donor" );
+
+assert.commandWorked( recipientAdmin.runCommand(
+    { configureFailPoint : "migrateThreadHangDuringClone", mode : "off" }) );
+move();
+
+assert.soon( function() {
+    var status = recipientAdmin.runCommand({ _recvChunkStatus : 1 });
+    printjson( status );
+    return !status.active;
+}, "recipient didn't give up on the aborted migration" );
+assert.eq( "fail", recipientAdmin.runCommand({ _recvChunkStatus : 1 }).state );
+
+// nothing moved: the donor still owns everything, the recipient only has orphans
+assert.eq( shards[1]._id, mongos.getDB( "config" ).chunks.findOne({ ns : coll + "" }).shard );
+assert.eq( total, st.shard1.getCollection( coll + "" ).count() );
+assert.eq( total, coll.find().itcount() );
+
+jsTest.log( "Retrying the move..." );
+
+result = admin.runCommand( moveCmd( shards[0]._id ) );
+printjson( result );
+assert( result.ok );
+
+checkPlacement( st.shard0, st.shard1, total );
+assert.eq( pad, coll.findOne({ _id : 0 }).pad );
+assert.eq( "concurrent", coll.findOne({ _id : numDocs }).pad );
+
+st.stop();
@@ -0,0 +1,92 @@
+// dumprestore_segments.js
+
+// Round trips a database through mongodump --segmentSizeMB and --compress and mongorestore.
+// Large collections are dumped in segments listed in their .metadata.json, capped ones never are,
+// and a collection whose name merely looks like a segment is restored as itself.
+
+t = new ToolTest( "dumprestore_segments" );
+
+t.startDB( "foo" );
+db = t.db;
+db.dropDatabase();
+
+var pad = new Array( 1024 ).join( "x" );
+
+// About 6MB, so several 1MB segments.
+for ( var i = 0; i < 6000; i++ ) {
+    db.big.insert( { _id : i , pad : pad } );
+}
+db.big.ensureIndex( { a : 1 } );
+
+// Big enough to be segmented if it weren't capped.
+db.createCollection( "capped" , { capped : true , size : 2 * 1024 * 1024 } );
+for ( var i = 0; i < 4000; i++ ) {
+    db.capped.insert( { _id : 4000 - i , pad : pad } );
+}
+
+// Its file is named like a segment of "big" would have been before segments were recorded in
+// the metadata.
+db.getCollection( "big.segment0001" ).insert( { _id : "not a segment" } );
+assert.eq( null , db.getLastError() );
+
+function snapshot() {
+    return { big : db.big.count() ,
+             bigIds : db.big.find( {} , { _id : 1 } ).sort( { _id : 1 } ).toArray() ,
+             bigIndexes : db.system.indexes.count( { ns : db.big.getFullName() } ) ,
+             capped : db.capped.find( {} , { _id : 1 } ).toArray() ,
+             cappedOptions : db.system.namespaces.findOne( { name : db.capped.getFullName() } ).options ,
+             notSegment : db.getCollection( "big.segment0001" ).find().toArray() };
+}
+var before = snapshot();
+assert.eq( 6000 , before.big );
+assert.lt( before.capped.length , 4000 , "capped collection didn't wrap" );
+
+function dumpedFiles() {
+    return listFiles( t.ext + "/" + db.getName() ).map( function( f ) { return f.baseName; } );
+}
+
+function roundTrip( dumpArgs , expectSegments , expectCompressed ) {
+    resetDbpath( t.ext );
+    var args = [ "dump" , "--out" , t.ext , "-d" , db.getName() ].concat( dumpArgs );
+    assert.eq( 0 , t.runTool.apply( t , args ) , "mongodump " + tojson( dumpArgs ) );
+
+    var files = dumpedFiles();
+    printjson( files );
+    var bigSegments = files.filter( function( f ) { return f.indexOf( "big.$segment" ) == 0; } );
+    var cappedFiles = files.filter( function( f ) { return f.indexOf( "capped." ) == 0 &&
+                                                           f.indexOf( ".metadata.json" ) < 0; } );
+    assert.eq( 1 , cappedFiles.length , "capped collection was segmented" );
+
+    var metadata = JSON.parse( cat( t.ext + "/" + db.getName() + "/big.metadata.json" ) );
+    if ( expectSegments ) {
+        assert.gt( bigSegments.length , 1 , "big wasn't segmented" );
+        assert.eq( bigSegments.sort() , metadata.segments.sort() ,
+                   "metadata doesn't list the segments" );
+    }
+    else {
+        assert.eq( 0 , bigSegments.length );
+        assert.eq( undefined , metadata.segments );
+    }
+
+    var compressed = files.filter( function( f ) { return /\.bson\.snappy$/.test( f ); } );
+    if ( expectCompressed )
+        assert.gt( compressed.length , 0 , "nothing was compressed" );
+    else
+        assert.eq( 0 , compressed.length );
+
+    // --drop must only drop the collections that were dumped, under their own names.
+    db.getCollection( "big.segment0001" ).insert( { _id : "added after dump" } );
+    db.big.remove( { _id : { $lt : 100 } } );
+    db.capped.drop();
+
+    assert.eq( 0 , t.runTool( "restore" , "--dir" , t.ext , "--drop" ) ,
+               "mongorestore " + tojson( dumpArgs ) );
+    assert.eq( before , snapshot() , "round trip " + tojson( dumpArgs ) );
+}
+
+roundTrip( [ "--segmentSizeMB" , "1" ] , true , false );
+roundTrip( [ "--compress" ] , false , true );
+roundTrip( [ "--segmentSizeMB" , "1" , "--compress" ] , true , true );
+roundTrip( [ "--segmentSizeMB" , "1" , "--numParallelCollections" , "1" ] , true , false );
+
+t.stop();
@@ -313,6 +313,147 @@ namespace mongo {
         return ofs;
     }
 
+    template< class V >
+    inline int BucketBasics<V>::keyDataSize( int i ) const {
+        return keyNode( i ).key.dataSize();
+    }
+
+    template< class V >
+    inline int BucketBasics<V>::keyDataSpaceNeeded( const Key& key ) const {
+        return key.dataSize();
+    }
+
+    template< class V >
+    int BucketBasics<V>::keyDataSpaceBound( const Key& key ) {
+        return key.dataSize();
+    }
+
+    template< class V >
+    short BucketBasics<V>::storeKeyData( const Key& key, bool declareWriteIntent ) {
+        short ofs = (short) _alloc( key.dataSize() );
+        char *p = dataAt( ofs );
+        if ( declareWriteIntent )
+            getDur().declareWriteIntent( p, key.dataSize() );
+        memcpy( p, key.data(), key.dataSize() );
+        return ofs;
+    }
+
+    template< class V >
+    inline int BucketBasics<V>::keyPrefixDataSize() const {
+        return 0;
+    }
+
+    template< class V >
+    inline int BucketBasics<V>::packKeyPrefix( char *temp, int ofs ) const {
+        return ofs;
+    }
+
+    template< class V >
+    inline void BucketBasics<V>::setKeyPrefixOfs( int ofs ) {
+    }
+
+    template< class V >
+    void BucketBasics<V>::copyKeyPrefix( const BucketBasics& src ) {
+    }
+
+    template< class V >
+    int BucketBasics<V>::packedDataSizeBound( int refPos ) const {
+        return packedDataSize( refPos );
+    }
+
+    template<>
+    int BucketBasics<V2>::keyDataSize( int i ) const {
+        const unsigned char *stored = (const unsigned char *) this->data + k( i ).keyDataOfs();
+        return 1 + keyNode( i ).key.dataSize() - *stored;
+    }
+
+    template<>
+    int BucketBasics<V2>::keyDataSpaceNeeded( const Key& key ) const {
+        // A bucket without a prefix takes one from the first compact key stored in it, and
+        // that key then shares all of it.
+        if ( this->prefixLen == 0 )
+            return 1 + key.dataSize();
+        return key.storedSize( this->data + this->prefixOfs, this->prefixLen );
+    }
+
+    template<>
+    int BucketBasics<V2>::keyDataSpaceBound( const Key& key ) {
+        return 1 + key.dataSize();
+    }
+
+    template<>
+    short BucketBasics<V2>::storeKeyData( const Key& key, bool declareWriteIntent ) {
+        if ( this->prefixLen == 0 && key.isCompactFormat() ) {
+            char prefix[KeyV2::MaxPrefixLen];
+            int len = key.copyPrefix( prefix );
+            short ofs = (short) _alloc( len );
+            if ( declareWriteIntent ) {
+                getDur().declareWriteIntent( dataAt( ofs ), len );
+                getDur().declareWriteIntent( &this->prefixOfs, sizeof(this->prefixOfs)+sizeof(this->prefixLen) );
+            }
+            memcpy( dataAt( ofs ), prefix, len );
+            this->prefixOfs = ofs;
+            this->prefixLen = len;
+        }
+        const char *prefix = this->data + this->prefixOfs;
+        int size = key.storedSize( prefix, this->prefixLen );
+        short ofs = (short) _alloc( size );
+        char *p = dataAt( ofs );
+        if ( declareWriteIntent )
+            getDur().declareWriteIntent( p, size );
+        key.store( p, prefix, this->prefixLen );
+        return ofs;
+    }
+
+    template<>
+    inline int BucketBasics<V2>::keyPrefixDataSize() const {
+        // an empty bucket gives its prefix up when packed
+        return this->n ? this->prefixLen : 0;
+    }
+
+    template<>
+    inline int BucketBasics<V2>::packKeyPrefix( char *temp, int ofs ) const {
+        if ( this->n == 0 )
+            return ofs;
+        ofs -= this->prefixLen;
+        memcpy( temp + ofs, this->data + this->prefixOfs, this->prefixLen );
+        return ofs;
+    }
+
+    template<>
+    inline void BucketBasics<V2>::setKeyPrefixOfs( int ofs ) {
+        if ( this->n == 0 ) {
+            // nothing refers to the prefix, so the next compact key stored picks a new one
+            this->prefixOfs = 0;
+            this->prefixLen = 0;
+            return;
+        }
+        this->prefixOfs = ofs;
+    }
+
+    template<>
+    void BucketBasics<V2>::copyKeyPrefix( const BucketBasics& src ) {
+        verify( this->n == 0 && this->prefixLen == 0 );
+        if ( src.prefixLen == 0 )
+            return;
+        short ofs = (short) _alloc( src.prefixLen );
+        memcpy( dataAt( ofs ), src.data + src.prefixOfs, src.prefixLen );
+        this->prefixOfs = ofs;
+        this->prefixLen = src.prefixLen;
+    }
+
+    template<>
+    int BucketBasics<V2>::packedDataSizeBound( int refPos ) const {
+        int size = 0;
+        for( int j = 0; j < this->n; ++j ) {
+            if ( mayDropKey( j, refPos ) ) {
+                continue;
+            }
+            size += keyDataSpaceBound( keyNode( j ).key ) + sizeof( _KeyNode );
+        }
+        return size;
+    }
+
     template< class V >
     void BucketBasics<V>::_delKeyAtPos(int keypos, bool mayEmpty) {
         // TODO This should be keypos < n
@@ -338,7 +479,7 @@ namespace mongo {
         KeyNode kn = keyNode(this->n-1);
         recLoc = kn.recordLoc;
         key.assign(kn.key);
-        int keysize = kn.key.dataSize();
+        int keysize = keyDataSize(this->n-1);
 
         massert( 10283 , "rchild not null in btree popBack()", this->nextChild.isNull());
 
@@ -356,7 +497,7 @@ namespace mongo {
     /** add a key.  must be > all existing.  be careful to set next ptr right. */
     template< class V >
     bool BucketBasics<V>::_pushBack(const DiskLoc recordLoc, const Key& key, const Ordering &order, const DiskLoc prevChild) {
-        int bytesNeeded = key.dataSize() + sizeof(_KeyNode);
+        int bytesNeeded = keyDataSpaceNeeded(key) + sizeof(_KeyNode);
         if ( bytesNeeded > this->emptySize )
             return false;
         verify( bytesNeeded <= this->emptySize );
@@ -374,10 +515,7 @@ namespace mongo {
         _KeyNode& kn = k(this->n++);
         kn.prevChildBucket = prevChild;
         kn.recordLoc = recordLoc;
-        kn.setKeyDataOfs( (short) _alloc(key.dataSize()) );
-        short ofs = kn.keyDataOfs();
-        char *p = dataAt(ofs);
-        memcpy(p, key.data(), key.dataSize());
+        kn.setKeyDataOfs( storeKeyData(key, false) );
 
         return true;
     }
@@ -394,7 +532,7 @@ namespace mongo {
     bool BucketBasics<V>::basicInsert(const DiskLoc thisLoc, int &keypos, const DiskLoc recordLoc, const Key& key, const Ordering &order) const {
         check( this->n < 1024 );
         check( keypos >= 0 && keypos <= this->n );
-        int bytesNeeded = key.dataSize() + sizeof(_KeyNode);
+        int bytesNeeded = keyDataSpaceNeeded(key) + sizeof(_KeyNode);
         if ( bytesNeeded > this->emptySize ) {
             _pack(thisLoc, order, keypos);
             if ( bytesNeeded > this->emptySize )
@@ -426,10 +564,7 @@ namespace mongo {
         _KeyNode& kn = b->k(keypos);
         kn.prevChildBucket.Null();
         kn.recordLoc = recordLoc;
-        kn.setKeyDataOfs((short) b->_alloc(key.dataSize()) );
-        char *p = b->dataAt(kn.keyDataOfs());
-        getDur().declareWriteIntent(p, key.dataSize());
-        memcpy(p, key.data(), key.dataSize());
+        kn.setKeyDataOfs( b->storeKeyData(key, true) );
         return true;
     }
 
@@ -452,9 +587,9 @@ namespace mongo {
             if ( mayDropKey( j, refPos ) ) {
                 continue;
             }
-            size += keyNode( j ).key.dataSize() + sizeof( _KeyNode );
+            size += keyDataSize( j ) + sizeof( _KeyNode );
         }
-        return size;
+        return size + keyPrefixDataSize();
     }
 
     /**
@@ -488,6 +623,10 @@ namespace mongo {
         char temp[V::BucketSize];
         int ofs = tdz;
         this->topSize = 0;
+        // data shared by the keys stays at the top, above all key data
+        ofs = packKeyPrefix(temp, ofs);
+        this->topSize += tdz - ofs;
+        const int prefixOfs = ofs;
         int i = 0;
         for ( int j = 0; j < this->n; j++ ) {
             if( mayDropKey( j, refPos ) ) {
@@ -500,7 +639,7 @@ namespace mongo {
                 k( i ) = k( j );
             }
             short ofsold = k(i).keyDataOfs();
-            int sz = keyNode(i).key.dataSize();
+            int sz = keyDataSize(i);
             ofs -= sz;
             this->topSize += sz;
             memcpy(temp+ofs, dataAt(ofsold), sz);
@@ -513,6 +652,7 @@ namespace mongo {
         this->n = i;
         int dataUsed = tdz - ofs;
         memcpy(this->data + ofs, temp + ofs, dataUsed);
+        setKeyPrefixOfs( prefixOfs );
 
         // assertWritable();
         // TEMP TEST getDur().declareWriteIntent(this, sizeof(*this));
@@ -564,7 +704,7 @@ namespace mongo {
         // TODO I think we only want to do the 90% split on the rhs node of the tree.
         int rightSizeLimit = ( this->topSize + sizeof( _KeyNode ) * this->n ) / ( keypos == this->n ? 10 : 2 );
         for( int i = this->n - 1; i > -1; --i ) {
-            rightSize += keyNode( i ).key.dataSize() + sizeof( _KeyNode );
+            rightSize += keyDataSize( i ) + sizeof( _KeyNode );
             if ( rightSize > rightSizeLimit ) {
                 split = i;
                 break;
@@ -596,10 +736,7 @@ namespace mongo {
         _KeyNode &kn = k( i );
         kn.recordLoc = recordLoc;
         kn.prevChildBucket = prevChildBucket;
-        short ofs = (short) _alloc( key.dataSize() );
-        kn.setKeyDataOfs( ofs );
-        char *p = dataAt( ofs );
-        memcpy( p, key.data(), key.dataSize() );
+        kn.setKeyDataOfs( storeKeyData( key, false ) );
     }
 
     template< class V >
@@ -762,6 +899,7 @@ namespace mongo {
         globalIndexCounters->btree( reinterpret_cast<const char*>(this) );
 
         // binary search for this key
+        typename V::Search search(key, order);
         bool dupsChecked = false;
         int l=0;
         int h=this->n-1;
@@ -771,7 +909,7 @@ namespace mongo {
         }
         while ( l <= h ) {
             KeyNode M = this->keyNode(m);
-            int x = key.woCompare(M.key, order);
+            int x = search.compare(M.key);
             if ( x == 0 ) {
                 if( assertIfDup ) {
                     if( k(m).isUnused() ) {
@@ -983,7 +1121,7 @@ namespace mongo {
         {
             const BtreeBucket *l = leftNodeLoc.btree<V>();
             const BtreeBucket *r = rightNodeLoc.btree<V>();
-            if ( ( this->headerSize() + l->packedDataSize( pos ) + r->packedDataSize( pos ) + keyNode( leftIndex ).key.dataSize() + sizeof(_KeyNode) > unsigned( V::BucketSize ) ) ) {
+            if ( ( this->headerSize() + l->packedDataSize( pos ) + r->packedDataSizeBound( pos ) + this->keyDataSpaceBound( keyNode( leftIndex ).key ) + sizeof(_KeyNode) > unsigned( V::BucketSize ) ) ) {
                 return false;
             }
         }
@@ -1002,26 +1140,27 @@ namespace mongo {
         const BtreeBucket *r = BTREE(this->childForPos( leftIndex + 1 ));
 
         int KNS = sizeof( _KeyNode );
-        int rightSizeLimit = ( l->topSize + l->n * KNS + keyNode( leftIndex ).key.dataSize() + KNS + r->topSize + r->n * KNS ) / 2;
+        int separatorSize = this->keyDataSpaceBound( keyNode( leftIndex ).key );
+        int rightSizeLimit = ( l->topSize + l->n * KNS + separatorSize + KNS + r->topSize + r->n * KNS ) / 2;
         // This constraint should be ensured by only calling this function
         // if we go below the low water mark.
         verify( rightSizeLimit < BtreeBucket<V>::bodySize() );
         for( int i = r->n - 1; i > -1; --i ) {
-            rightSize += r->keyNode( i ).key.dataSize() + KNS;
+            rightSize += r->keyDataSize( i ) + KNS;
             if ( rightSize > rightSizeLimit ) {
                 split = l->n + 1 + i;
                 break;
             }
         }
         if ( split == -1 ) {
-            rightSize += keyNode( leftIndex ).key.dataSize() + KNS;
+            rightSize += separatorSize + KNS;
             if ( rightSize > rightSizeLimit ) {
                 split = l->n;
             }
         }
         if ( split == -1 ) {
             for( int i = l->n - 1; i > -1; --i ) {
-                rightSize += l->keyNode( i ).key.dataSize() + KNS;
+                rightSize += l->keyDataSize( i ) + KNS;
                 if ( rightSize > rightSizeLimit ) {
                     split = i;
                     break;
@@ -1195,6 +1334,10 @@ namespace mongo {
         // By definition, if we are below the low water mark and cannot merge
         // then we must actively balance.
         verify( split != l->n );
+        split = fittingSeparatorPos( leftIndex, split, l, r );
+        if ( split == l->n ) {
+            return;
+        }
         if ( split < l->n ) {
             doBalanceLeftToRight( thisLoc, leftIndex, split, l, lchild, r, rchild, id, order );
         }
@@ -1203,6 +1346,35 @@ namespace mongo {
         }
     }
 
+    template< class V >
+    int BtreeBucket<V>::fittingSeparatorPos( int leftIndex, int split, const BtreeBucket *l, const BtreeBucket *r ) const {
+        int KNS = sizeof( _KeyNode );
+        int separatorSize = this->keyDataSpaceBound( keyNode( leftIndex ).key ) + KNS;
+        if ( split < l->n ) {
+            // the separator and keys split + 1 .. n - 1 of l move to r
+            int moved = separatorSize;
+            for( int i = split + 1; i < l->n; ++i ) {
+                moved += this->keyDataSpaceBound( l->keyNode( i ).key ) + KNS;
+            }
+            while( split < l->n && moved > int( r->emptySize ) ) {
+                ++split;
+                moved -= split < l->n ? this->keyDataSpaceBound( l->keyNode( split ).key ) + KNS : separatorSize;
+            }
+        }
+        else {
+            // the separator and keys 0 .. split - l->n - 2 of r move to l
+            int moved = separatorSize;
+            for( int i = 0; i < split - l->n - 1; ++i ) {
+                moved += this->keyDataSpaceBound( r->keyNode( i ).key ) + KNS;
+            }
+            while( split > l->n && moved > int( l->emptySize ) ) {
+                --split;
+                moved -= split > l->n ? this->keyDataSpaceBound( r->keyNode( split - l->n - 1 ).key ) + KNS : separatorSize;
+            }
+        }
+        return split;
+    }
+
     template< class V >
     bool BtreeBucket<V>::mayBalanceWithNeighbors( const DiskLoc thisLoc, IndexDetails &id, const Ordering &order ) const {
         if ( this->parent.isNull() ) { // we are root, there are no neighbors
@@ -1381,6 +1553,8 @@ namespace mongo {
         int split = this->splitPos( keypos );
         DiskLoc rLoc = addBucket(idx);
         BtreeBucket *r = rLoc.btreemod<V>();
+        // keys moving right keep the size they have here
+        r->copyKeyPrefix( *this );
         if ( split_debug )
             out() << "     split:" << split << ' ' << keyNode(split).key.toString() << " n:" << this->n << endl;
         for ( int i = split+1; i < this->n; i++ ) {
@@ -1908,8 +2082,10 @@ namespace mongo {
 
     template class BucketBasics<V0>;
     template class BucketBasics<V1>;
+    template class BucketBasics<V2>;
     template class BtreeBucket<V0>;
     template class BtreeBucket<V1>;
+    template class BtreeBucket<V2>;
     template struct __KeyNode<DiskLoc>;
     template struct __KeyNode<DiskLoc56Bit>;
 
@@ -184,11 +184,14 @@ namespace mongo {
         /* Beginning of the bucket's body */
         char data[4];
 
+        KeyBson _keyAt(short ofs) const { return KeyBson(data + ofs); }
+
     public:
         typedef __KeyNode<DiskLoc> _KeyNode;
         typedef DiskLoc Loc;
         typedef KeyBson Key;
         typedef KeyBson KeyOwned;
+        typedef KeySearch<KeyBson> Search;
         enum { BucketSize = 8192 };
 
         // largest key size we allow.  note we very much need to support bigger keys (somehow) in the future.
@@ -281,6 +284,7 @@ namespace mongo {
         typedef __KeyNode<Loc> _KeyNode;
         typedef KeyV1 Key;
         typedef KeyV1Owned KeyOwned;
+        typedef KeyV1Search Search;
         enum { BucketSize = 8192-16 }; // leave room for Record header
         // largest key size we allow.  note we very much need to support bigger keys (somehow) in the future.
         static const int KeyMax = 1024;
@@ -307,10 +311,60 @@ namespace mongo {
         char data[4];
 
         void _init() { }
+        KeyV1 _keyAt(short ofs) const { return KeyV1(data + ofs); }
+    };
+
+    /**
+     * v:2 buckets are v:1 buckets whose keys may share leading bytes.  The bucket holds one
+     * prefix, taken from the first compact key stored in it, in its bson storage area.  Each
+     * stored key is a byte giving how many bytes of the prefix it begins with, then the rest
+     * of the key.  See KeyV2.
+     */
+    class BtreeData_V2 {
+    public:
+        typedef DiskLoc56Bit Loc;
+        typedef __KeyNode<Loc> _KeyNode;
+        typedef KeyV2 Key;
+        typedef KeyV2Owned KeyOwned;
+        typedef KeySearch<KeyV2> Search;
+        enum { BucketSize = 8192-16 }; // leave room for Record header
+        static const int KeyMax = 1024;
+        // A sentinel value sometimes used to identify a deallocated bucket.
+        static const unsigned short INVALID_N_SENTINEL = 0xffff;
+    protected:
+        /** Parent bucket of this bucket, which isNull() for the root bucket. */
+        Loc parent;
+        /** Given that there are n keys, this is the n index child. */
+        Loc nextChild;
+
+        unsigned short flags;
+
+        /** basicInsert() assumes the next three members are consecutive and in this order: */
+
+        /** Size of the empty region. */
+        unsigned short emptySize;
+        /** Size used for bson storage, including storage of old keys and the prefix. */
+        unsigned short topSize;
+        /* Number of keys in the bucket. */
+        unsigned short n;
+
+        /** Offset and length of the prefix shared by keys in this bucket.  prefixLen is 0 if none. */
+        unsigned short prefixOfs;
+        unsigned short prefixLen;
+
+        /* Beginning of the bucket's body */
+        char data[4];
+
+        void _init() {
+            prefixOfs = 0;
+            prefixLen = 0;
+        }
+        KeyV2 _keyAt(short ofs) const { return KeyV2(data + prefixOfs, data + ofs); }
     };
 
     typedef BtreeData_V0 V0;
     typedef BtreeData_V1 V1;
+    typedef BtreeData_V2 V2;
 
     /**
      * This class adds functionality to BtreeData for managing a single bucket.
@@ -602,6 +656,43 @@ namespace mongo {
          *    _KeyNode data and without shifting any other _KeyNode objects.
          */
         void setKey( int i, const DiskLoc recordLoc, const Key& key, const DiskLoc prevChildBucket );
+
+        /*
+         * Storage of key data.  For v:0 and v:1 a key is stored as is; v:2 buckets store keys
+         * relative to the bucket's prefix and specialize these.
+         */
+
+        /** @return the number of bytes the i-indexed key occupies in the bucket */
+        int keyDataSize( int i ) const;
+        /** @return the number of bytes storing 'key' in this bucket would take now */
+        int keyDataSpaceNeeded( const Key& key ) const;
+        /** @return the most bytes storing 'key' in any bucket could take */
+        static int keyDataSpaceBound( const Key& key );
+        /**
+         * Preconditions: keyDataSpaceNeeded( key ) <= emptySize
+         * Postconditions: 'key' is copied into the bson storage area and its offset is
+         *  returned.  Write intent for the bytes written is declared if 'declareWriteIntent'.
+         */
+        short storeKeyData( const Key& key, bool declareWriteIntent );
+        /**
+         * @return size of the data shared between keys in this bucket, which pack() keeps
+         *  unless the bucket is empty
+         */
+        int keyPrefixDataSize() const;
+        /**
+         * Copy the data shared by the keys to 'temp', ending at 'ofs', and @return its start.
+         * Keys still refer to the old copy until setKeyPrefixOfs() is called.
+         */
+        int packKeyPrefix( char *temp, int ofs ) const;
+        /** Called once packed, with the prefix at 'ofs'.  An empty bucket drops its prefix. */
+        void setKeyPrefixOfs( int ofs );
+        /**
+         * Preconditions: this bucket is empty and writable
+         * Postconditions: keys stored here are stored as they would be in 'src'
+         */
+        void copyKeyPrefix( const BucketBasics& src );
+        /** @return an upper bound on the size keys of this bucket would take in another bucket */
+        int packedDataSizeBound( int refPos ) const;
     };
 
     class IndexDetails;
@@ -909,6 +1000,16 @@ namespace mongo {
          */
         int rebalancedSeparatorPos( const DiskLoc &thisLoc, int leftIndex ) const;
 
+        /**
+         * Preconditions:
+         *  - leftIndex and leftIndex + 1 children are packed
+         *  - split != l->n
+         * @return 'split', moved towards l->n as far as needed for the keys that
+         *  balancing would move to fit in the destination child.  Returns l->n if
+         *  no keys can be moved.  Only keys of v:2 buckets can grow when moved.
+         */
+        int fittingSeparatorPos( int leftIndex, int split, const BtreeBucket *l, const BtreeBucket *r ) const;
+
         /**
          * Preconditions: thisLoc has a parent
          * @return parent's index of thisLoc.
@@ -919,7 +1020,7 @@ namespace mongo {
         Key keyAt(int i) const {
             if( i >= this->n ) 
                 return Key();
-            return Key(this->data + k(i).keyDataOfs());
+            return this->_keyAt(k(i).keyDataOfs());
         }
     protected:
 
@@ -1025,7 +1126,7 @@ namespace mongo {
     template< class V >
     BucketBasics<V>::KeyNode::KeyNode(const BucketBasics<V>& bb, const _KeyNode &k) :
         prevChildBucket(k.prevChildBucket),
-        recordLoc(k.recordLoc), key(bb.data+k.keyDataOfs())
+        recordLoc(k.recordLoc), key(bb._keyAt(k.keyDataOfs()))
     { }
 
 } // namespace mongo;
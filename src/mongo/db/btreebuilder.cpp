@@ -179,5 +179,6 @@ namespace mongo {
 
     template class BtreeBuilder<V0>;
     template class BtreeBuilder<V1>;
+    template class BtreeBuilder<V2>;
 
 }
@@ -33,10 +33,18 @@
 #include <boost/filesystem/operations.hpp>
 
 #include "mongo/db/namespace_details.h"
+#include "mongo/db/storage/free_space_index.h"
 
 
 namespace mongo {
 
+    NamespaceIndex::~NamespaceIndex() {
+        // the database is being closed, dropped or repaired, and the NamespaceDetails are about
+        // to be unmapped
+        if ( _ht )
+            FreeSpaceIndex::forgetRange( _f.getView(), _f.length() );
+    }
+
     NamespaceDetails* NamespaceIndex::details(const StringData& ns) {
         Namespace n(ns);
         return details(n);
@@ -72,6 +80,8 @@ namespace mongo {
         if ( !_ht )
             return;
         Namespace n(ns);
+        if ( NamespaceDetails* d = _ht->get(n) )
+            FreeSpaceIndex::forget( d );
         _ht->kill(n);
 
         for( int i = 0; i<=1; i++ ) {
@@ -49,6 +49,9 @@ namespace mongo {
         NamespaceIndex(const std::string &dir, const std::string &database) :
             _ht( 0 ), _dir( dir ), _database( database ) {}
 
+        /** forgets the in memory state kept for the collections in this file */
+        ~NamespaceIndex();
+
         /* returns true if new db will be created if we init lazily */
         bool exists() const;
 
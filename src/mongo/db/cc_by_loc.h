@@ -26,54 +26,29 @@
  */
 
 /**
- *  Defines CursorId and defines ByLocKey, which pairs up a DiskLoc
- *  and a CursorId and provides a comparison operation.
+ *  Defines CursorId and CCByLoc, the cursors of a database by the DiskLoc they are
+ *  positioned on.
  */
 
 #pragma once
 
-#include <limits>
-#include <map>
+#include <vector>
 
 #include "mongo/db/diskloc.h"
+#include "mongo/platform/unordered_map.h"
 
 namespace mongo {
 
     typedef long long CursorId; /* passed to the client so it can send back on getMore */
     static const CursorId INVALID_CURSOR_ID = -1; // But see SERVER-5726.
 
-    // TODO(acm|mathias): ByLocKey allows constructing a map so we can
-    // invalidate or advance all cursors pointing to a DiskLoc when we
-    // remove that record. During review of moving this class to this
-    // header, Mathias said: "On further thought, I think this need
-    // would be better served by an unordered_map<DiskLoc,
-    // unordered_map<CursorId, ClientCursor*>>." At which point, this
-    // class should be removed.
-
-    struct ByLocKey {
-
-        ByLocKey(const DiskLoc& l, const CursorId& i) : loc(l), id(i) {}
-
-        static ByLocKey min(const DiskLoc& l) {
-            return ByLocKey(l, std::numeric_limits<long long>::min());
-        }
-
-        static ByLocKey max(const DiskLoc& l) {
-            return ByLocKey(l, std::numeric_limits<long long>::max());
-        }
-
-        const DiskLoc loc;
-        const CursorId id;
-    };
-
-    inline bool operator<(const ByLocKey& lhs, const ByLocKey& rhs) {
-        int x = lhs.loc.compare(rhs.loc);
-        if (x)
-            return x < 0;
-        return lhs.id < rhs.id;
-    }
-
     class ClientCursor;
-    typedef std::map<ByLocKey, ClientCursor*> CCByLoc;
+
+    /**
+     * The ClientCursors positioned on each DiskLoc, so that removing a record costs a hash
+     * lookup and a visit to each cursor actually on it.  There is rarely more than one per
+     * DiskLoc, so they're kept in a vector.
+     */
+    typedef unordered_map<DiskLoc, std::vector<ClientCursor*>, DiskLoc::Hasher> CCByLoc;
 
 } // namespace mongo
@@ -30,6 +30,7 @@
 
 #include "mongo/db/clientcursor.h"
 
+#include <algorithm>
 #include <string>
 #include <time.h>
 #include <vector>
@@ -57,7 +58,8 @@
 
 namespace mongo {
 
-    ClientCursor::CCById ClientCursor::clientCursorsById;
+    ClientCursor::CCStripe* const ClientCursor::stripes( new ClientCursor::CCStripe[NumStripes] );
+    ClientCursor::CCByNs ClientCursor::runnerCursorsByNs;
     boost::recursive_mutex& ClientCursor::ccmutex( *(new boost::recursive_mutex()) );
     long long ClientCursor::numberTimedOut = 0;
     set<Runner*> ClientCursor::nonCachedRunners;
@@ -112,9 +114,20 @@ namespace mongo {
             ++_pinValue;
         }
 
-        recursive_scoped_lock lock(ccmutex);
-        _cursorid = allocCursorId_inlock();
-        clientCursorsById.insert( make_pair(_cursorid, this) );
+        while ( 1 ) {
+            CursorId id = allocCursorId();
+            CCStripe& stripe = stripeFor(id);
+            recursive_scoped_lock lock(stripe.mutex);
+            if ( stripe.byId.insert( make_pair(id, this) ).second ) {
+                _cursorid = id;
+                break;
+            }
+        }
+
+        if (NULL != _runner.get()) {
+            recursive_scoped_lock lock(ccmutex);
+            runnerCursorsByNs[_ns].insert(this);
+        }
     }
 
     ClientCursor::~ClientCursor() {
@@ -131,7 +144,18 @@ namespace mongo {
                 setLastLoc_inlock( DiskLoc() );
             }
 
-            clientCursorsById.erase(_cursorid);
+            if (NULL != _runner.get()) {
+                CCByNs::iterator i = runnerCursorsByNs.find(_ns);
+                verify(i != runnerCursorsByNs.end());
+                i->second.erase(this);
+                if (i->second.empty()) {
+                    runnerCursorsByNs.erase(i);
+                }
+            }
+
+            CCStripe& stripe = stripeFor(_cursorid);
+            recursive_scoped_lock stripeLock(stripe.mutex);
+            stripe.byId.erase(_cursorid);
 
             // defensive:
             _cursorid = INVALID_CURSOR_ID;
@@ -143,13 +167,26 @@ namespace mongo {
     // static
     void ClientCursor::assertNoCursors() {
         recursive_scoped_lock lock(ccmutex);
-        if (clientCursorsById.size() > 0) {
-            log() << "ERROR clientcursors exist but should not at this point" << endl;
-            ClientCursor *cc = clientCursorsById.begin()->second;
-            log() << "first one: " << cc->_cursorid << ' ' << cc->_ns << endl;
-            clientCursorsById.clear();
-            verify(false);
+        for (unsigned i = 0; i < NumStripes; i++) {
+            recursive_scoped_lock stripeLock(stripes[i].mutex);
+            if (stripes[i].byId.size() > 0) {
+                log() << "ERROR clientcursors exist but should not at this point" << endl;
+                ClientCursor *cc = stripes[i].byId.begin()->second;
+                log() << "first one: " << cc->_cursorid << ' ' << cc->_ns << endl;
+                stripes[i].byId.clear();
+                verify(false);
+            }
+        }
+    }
+
+    // static
+    unsigned ClientCursor::numCursors() {
+        unsigned n = 0;
+        for (unsigned i = 0; i < NumStripes; i++) {
+            recursive_scoped_lock lock(stripes[i].mutex);
+            n += stripes[i].byId.size();
         }
+        return n;
     }
 
     void ClientCursor::invalidate(const StringData& ns) {
@@ -181,75 +218,78 @@ namespace mongo {
 
         // Look at all cached ClientCursor(s).  The CC may have a Runner, a Cursor, or nothing (see
         // sharding_block.h).
-        CCById::const_iterator it = clientCursorsById.begin();
-        while (it != clientCursorsById.end()) {
-            ClientCursor* cc = it->second;
-
-            // We're only interested in cursors over one db.
-            if (cc->_db != db) {
-                ++it;
-                continue;
+        for (unsigned i = 0; i < NumStripes; i++) {
+            recursive_scoped_lock stripeLock(stripes[i].mutex);
+
+            // Deleting a cursor takes it out of the stripe, so collect them first.
+            vector<ClientCursor*> toDelete;
+            for (CCById::const_iterator it = stripes[i].byId.begin();
+                 it != stripes[i].byId.end(); ++it) {
+                if (shouldDeleteOnInvalidate(it->second, db, ns, isDB)) {
+                    toDelete.push_back(it->second);
+                }
             }
-
-            // Note that a valid ClientCursor state is "no cursor no runner."  This is because
-            // the set of active cursor IDs in ClientCursor is used as representation of query
-            // state.  See sharding_block.h.  TODO(greg,hk): Move this out.
-            if (NULL == cc->c() && NULL == cc->_runner.get()) {
-                ++it;
-                continue;
+            for (vector<ClientCursor*>::iterator it = toDelete.begin(); it != toDelete.end();
+                 ++it) {
+                delete *it;
             }
+        }
+    }
 
-            bool shouldDelete = false;
+    // static
+    bool ClientCursor::shouldDeleteOnInvalidate(ClientCursor* cc, Database* db,
+                                                const StringData& ns, bool isDB) {
+        // We're only interested in cursors over one db.
+        if (cc->_db != db) {
+            return false;
+        }
 
-            // We will only delete CCs with runners that are not actively in use.  The runners that
-            // are actively in use are instead kill()-ed.
-            if (NULL != cc->_runner.get()) {
-                verify(NULL == cc->c());
+        // Note that a valid ClientCursor state is "no cursor no runner."  This is because
+        // the set of active cursor IDs in ClientCursor is used as representation of query
+        // state.  See sharding_block.h.  TODO(greg,hk): Move this out.
+        if (NULL == cc->c() && NULL == cc->_runner.get()) {
+            return false;
+        }
 
-                if (isDB || cc->_runner->ns() == ns) {
-                    // If there is a pinValue >= 100, somebody is actively using the CC and we do
-                    // not delete it.  Instead we notify the holder that we killed it.  The holder
-                    // will then delete the CC.
-                    if (cc->_pinValue >= 100) {
-                        cc->_runner->kill();
-                    }
-                    else {
-                        // pinvalue is <100, so there is nobody actively holding the CC.  We can
-                        // safely delete it as nobody is holding the CC.
-                        shouldDelete = true;
-                    }
-                }
-            }
-            // Begin cursor-only DEPRECATED
-            else if (cc->c()->shouldDestroyOnNSDeletion()) {
-                verify(NULL == cc->_runner.get());
+        bool shouldDelete = false;
 
-                if (isDB) {
-                    // already checked that db matched above
-                    dassert( StringData(cc->_ns).startsWith( ns ) );
-                    shouldDelete = true;
+        // We will only delete CCs with runners that are not actively in use.  The runners that
+        // are actively in use are instead kill()-ed.
+        if (NULL != cc->_runner.get()) {
+            verify(NULL == cc->c());
+
+            if (isDB || cc->_runner->ns() == ns) {
+                // If there is a pinValue >= 100, somebody is actively using the CC and we do
+                // not delete it.  Instead we notify the holder that we killed it.  The holder
+                // will then delete the CC.
+                if (cc->_pinValue >= 100) {
+                    cc->_runner->kill();
                 }
                 else {
-                    if ( ns == cc->_ns ) {
-                        shouldDelete = true;
-                    }
+                    // pinvalue is <100, so there is nobody actively holding the CC.  We can
+                    // safely delete it as nobody is holding the CC.
+                    shouldDelete = true;
                 }
             }
-            // End cursor-only DEPRECATED
-
-            if (shouldDelete) {
-                ClientCursor* toDelete = it->second;
-                CursorId id = toDelete->cursorid();
-                delete toDelete;
-                // We're not following the usual paradigm of saving it, ++it, and deleting the saved
-                // 'it' because deleting 'it' might invalidate the next thing in clientCursorsById.
-                // TODO: Why?
-                it = clientCursorsById.upper_bound(id);
+        }
+        // Begin cursor-only DEPRECATED
+        else if (cc->c()->shouldDestroyOnNSDeletion()) {
+            verify(NULL == cc->_runner.get());
+
+            if (isDB) {
+                // already checked that db matched above
+                dassert( StringData(cc->_ns).startsWith( ns ) );
+                shouldDelete = true;
             }
             else {
-                ++it;
+                if ( ns == cc->_ns ) {
+                    shouldDelete = true;
+                }
             }
         }
+        // End cursor-only DEPRECATED
+
+        return shouldDelete;
     }
 
     /* must call this on a delete so we clean up the cursors. */
@@ -277,39 +317,25 @@ namespace mongo {
             }
         }
 
-        // TODO: This requires optimization.  We walk through *all* CCs and send the delete to every
-        // CC open on the db we're deleting from.  We could:
-        // 1. Map from ns to open runners,
-        // 2. Map from ns -> (a map of DiskLoc -> runners who care about that DL)
-        //
-        // We could also queue invalidations somehow and have them processed later in the runner's
-        // read locks.
-        for (CCById::const_iterator it = clientCursorsById.begin(); it != clientCursorsById.end();
-             ++it) {
-
-            ClientCursor* cc = it->second;
-            // We're only interested in cursors over one db.
-            if (cc->_db != db) { continue; }
-            if (NULL == cc->_runner.get()) { continue; }
-            cc->_runner->invalidate(dl);
+        // Only the cached runners over the collection we're deleting from can be affected.
+        // TODO: Map from ns -> (a map of DiskLoc -> runners who care about that DL), or queue
+        // invalidations somehow and have them processed later in the runner's read locks.
+        CCByNs::const_iterator byNs = runnerCursorsByNs.find(ns.toString());
+        if (byNs != runnerCursorsByNs.end()) {
+            for (set<ClientCursor*>::const_iterator it = byNs->second.begin();
+                 it != byNs->second.end(); ++it) {
+                (*it)->_runner->invalidate(dl);
+            }
         }
 
         // Begin cursor-only.  Only cursors that are in ccByLoc are processed here.
         CCByLoc& bl = db->ccByLoc();
-        CCByLoc::iterator j = bl.lower_bound(ByLocKey::min(dl));
-        CCByLoc::iterator stop = bl.upper_bound(ByLocKey::max(dl));
-        if ( j == stop )
+        CCByLoc::const_iterator j = bl.find(dl);
+        if ( j == bl.end() )
             return;
 
-        vector<ClientCursor*> toAdvance;
-
-        while ( 1 ) {
-            toAdvance.push_back(j->second);
-            DEV verify( j->first.loc == dl );
-            ++j;
-            if ( j == stop )
-                break;
-        }
+        // Copied, as advancing or deleting a cursor moves it off 'dl'.
+        vector<ClientCursor*> toAdvance(j->second);
 
         if( toAdvance.size() >= 3000 ) {
             log() << "perf warning MPW101: " << toAdvance.size() << " cursors for one diskloc "
@@ -467,22 +493,23 @@ namespace mongo {
         // two passes so that we don't need to readlock unless we really do some timeouts
         // we assume here that incrementing _idleAgeMillis outside readlock is ok.
         {
-            recursive_scoped_lock lock(ccmutex);
-            {
-                unsigned sz = clientCursorsById.size();
-                static time_t last;
-                if( sz >= 100000 ) { 
-                    if( time(0) - last > 300 ) {
-                        last = time(0);
-                        log() << "warning number of open cursors is very large: " << sz << endl;
+            unsigned sz = 0;
+            for (unsigned s = 0; s < NumStripes; s++) {
+                recursive_scoped_lock lock(stripes[s].mutex);
+                sz += stripes[s].byId.size();
+                for ( CCById::iterator i = stripes[s].byId.begin(); i != stripes[s].byId.end();
+                      ++i ) {
+                    if( i->second->shouldTimeout( millis ) ) {
+                        foundSomeToTimeout = true;
                     }
                 }
             }
-            for ( CCById::iterator i = clientCursorsById.begin(); i != clientCursorsById.end();  ) {
-                CCById::iterator j = i;
-                i++;
-                if( j->second->shouldTimeout( millis ) ) {
-                    foundSomeToTimeout = true;
+
+            static time_t last;
+            if( sz >= 100000 ) { 
+                if( time(0) - last > 300 ) {
+                    last = time(0);
+                    log() << "warning number of open cursors is very large: " << sz << endl;
                 }
             }
         }
@@ -491,21 +518,23 @@ namespace mongo {
             Lock::GlobalRead lk;
 
             recursive_scoped_lock cclock(ccmutex);
-            CCById::const_iterator it = clientCursorsById.begin();
-            while (it != clientCursorsById.end()) {
-                ClientCursor* cc = it->second;
-                if( cc->shouldTimeout(0) ) {
-                    numberTimedOut++;
-                    LOG(1) << "killing old cursor " << cc->_cursorid << ' ' << cc->_ns
-                           << " idle:" << cc->idleTime() << "ms\n";
-                    ClientCursor* toDelete = it->second;
-                    CursorId id = toDelete->cursorid();
-                    // This is what winds up removing it from the map.
-                    delete toDelete;
-                    it = clientCursorsById.upper_bound(id);
+            for (unsigned s = 0; s < NumStripes; s++) {
+                recursive_scoped_lock lock(stripes[s].mutex);
+                vector<ClientCursor*> toDelete;
+                for ( CCById::iterator i = stripes[s].byId.begin(); i != stripes[s].byId.end();
+                      ++i ) {
+                    ClientCursor* cc = i->second;
+                    if( cc->shouldTimeout(0) ) {
+                        numberTimedOut++;
+                        LOG(1) << "killing old cursor " << cc->_cursorid << ' ' << cc->_ns
+                               << " idle:" << cc->idleTime() << "ms\n";
+                        toDelete.push_back(cc);
+                    }
                 }
-                else {
-                    ++it;
+                // This is what winds up removing them from the map.
+                for (vector<ClientCursor*>::iterator i = toDelete.begin(); i != toDelete.end();
+                     ++i) {
+                    delete *i;
                 }
             }
         }
@@ -532,19 +561,23 @@ namespace mongo {
     }
 
     void ClientCursor::appendStats( BSONObjBuilder& result ) {
-        recursive_scoped_lock lock(ccmutex);
-        result.appendNumber("totalOpen", clientCursorsById.size() );
-        result.appendNumber("clientCursors_size", (int) numCursors());
-        result.appendNumber("timedOut" , numberTimedOut);
+        size_t open = 0;
         unsigned pinned = 0;
         unsigned notimeout = 0;
-        for ( CCById::iterator i = clientCursorsById.begin(); i != clientCursorsById.end(); i++ ) {
-            unsigned p = i->second->_pinValue;
-            if( p >= 100 )
-                pinned++;
-            else if( p > 0 )
-                notimeout++;
+        for (unsigned s = 0; s < NumStripes; s++) {
+            recursive_scoped_lock lock(stripes[s].mutex);
+            open += stripes[s].byId.size();
+            for ( CCById::iterator i = stripes[s].byId.begin(); i != stripes[s].byId.end(); i++ ) {
+                unsigned p = i->second->_pinValue;
+                if( p >= 100 )
+                    pinned++;
+                else if( p > 0 )
+                    notimeout++;
+            }
         }
+        result.appendNumber("totalOpen", open );
+        result.appendNumber("clientCursors_size", (int) open);
+        result.appendNumber("timedOut" , numberTimedOut);
         if( pinned ) 
             result.append("pinned", pinned);
         if( notimeout )
@@ -555,14 +588,15 @@ namespace mongo {
     // ClientCursor creation/deletion/access.
     //
 
-    // Some statics used by allocCursorId_inlock().
+    // Some statics used by allocCursorId().
     namespace {
-        // so we don't have to do find() which is a little slow very often.
-        long long cursorGenTSLast = 0;
+        SimpleMutex cursorGenMutex("cursorGen");
         PseudoRandom* cursorGenRandom = NULL;
     }
 
-    long long ClientCursor::allocCursorId_inlock() {
+    long long ClientCursor::allocCursorId() {
+        SimpleMutex::scoped_lock lk(cursorGenMutex);
+
         // It is important that cursor IDs not be reused within a short period of time.
         if (!cursorGenRandom) {
             scoped_ptr<SecureRandom> sr( SecureRandom::create() );
@@ -579,18 +613,17 @@ namespace mongo {
 
             if ( x < 0 ) { x *= -1; }
 
-            if ( ts != cursorGenTSLast || ClientCursor::find_inlock(x, false) == 0 )
-                break;
+            break;
         }
 
-        cursorGenTSLast = ts;
         return x;
     }
 
     // static
     ClientCursor* ClientCursor::find_inlock(CursorId id, bool warn) {
-        CCById::iterator it = clientCursorsById.find(id);
-        if ( it == clientCursorsById.end() ) {
+        CCById& byId = stripeFor(id).byId;
+        CCById::iterator it = byId.find(id);
+        if ( it == byId.end() ) {
             if ( warn ) {
                 OCCASIONALLY out() << "ClientCursor::find(): cursor not found in map '" << id
                     << "' (ok after a drop)" << endl;
@@ -601,17 +634,18 @@ namespace mongo {
     }
 
     void ClientCursor::find( const string& ns , set<CursorId>& all ) {
-        recursive_scoped_lock lock(ccmutex);
-
-        for ( CCById::iterator i=clientCursorsById.begin(); i!=clientCursorsById.end(); ++i ) {
-            if ( i->second->_ns == ns )
-                all.insert( i->first );
+        for (unsigned s = 0; s < NumStripes; s++) {
+            recursive_scoped_lock lock(stripes[s].mutex);
+            for ( CCById::iterator i=stripes[s].byId.begin(); i!=stripes[s].byId.end(); ++i ) {
+                if ( i->second->_ns == ns )
+                    all.insert( i->first );
+            }
         }
     }
 
     // static
     ClientCursor* ClientCursor::find(CursorId id, bool warn) {
-        recursive_scoped_lock lock(ccmutex);
+        recursive_scoped_lock lock(stripeFor(id).mutex);
         ClientCursor *c = find_inlock(id, warn);
         // if this asserts, your code was not thread safe - you either need to set no timeout
         // for the cursor or keep a ClientCursor::Pointer in scope for it.
@@ -630,6 +664,7 @@ namespace mongo {
 
     bool ClientCursor::erase(CursorId id) {
         recursive_scoped_lock lock(ccmutex);
+        recursive_scoped_lock stripeLock(stripeFor(id).mutex);
         ClientCursor* cursor = find_inlock(id);
         if (!cursor) { return false; }
         _erase_inlock(cursor);
@@ -651,7 +686,7 @@ namespace mongo {
     bool ClientCursor::eraseIfAuthorized(CursorId id) {
         NamespaceString ns;
         {
-            recursive_scoped_lock lock(ccmutex);
+            recursive_scoped_lock lock(stripeFor(id).mutex);
             ClientCursor* cursor = find_inlock(id);
             if (!cursor) {
                 audit::logKillCursorsAuthzCheck(
@@ -680,6 +715,7 @@ namespace mongo {
         // of 2 invariants: that the cursor ID won't be re-used in a short period of time, and that
         // the namespace associated with a cursor cannot change.
         recursive_scoped_lock lock(ccmutex);
+        recursive_scoped_lock stripeLock(stripeFor(id).mutex);
         ClientCursor* cursor = find_inlock(id);
         if (!cursor) {
             // Cursor was deleted in another thread since we found it earlier in this function.
@@ -764,11 +800,17 @@ namespace mongo {
         CCByLoc& bl = _db->ccByLoc();
 
         if (!_lastLoc.isNull()) {
-            bl.erase(ByLocKey(_lastLoc, _cursorid));
+            CCByLoc::iterator i = bl.find(_lastLoc);
+            verify(i != bl.end());
+            vector<ClientCursor*>& atLoc = i->second;
+            atLoc.erase(std::find(atLoc.begin(), atLoc.end(), this));
+            if (atLoc.empty()) {
+                bl.erase(i);
+            }
         }
 
         if (!L.isNull()) {
-            bl[ByLocKey(L,_cursorid)] = this;
+            bl[L].push_back(this);
         }
 
         _lastLoc = L;
@@ -863,7 +905,7 @@ namespace mongo {
     //
 
     ClientCursorPin::ClientCursorPin(long long cursorid) : _cursorid( INVALID_CURSOR_ID ) {
-        recursive_scoped_lock lock( ClientCursor::ccmutex );
+        recursive_scoped_lock lock( ClientCursor::stripeFor(cursorid).mutex );
         ClientCursor *cursor = ClientCursor::find_inlock( cursorid, true );
         if (NULL != cursor) {
             uassert( 12051, "clientcursor already in use? driver problem?",
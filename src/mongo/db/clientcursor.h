@@ -127,7 +127,7 @@ namespace mongo {
         // ClientCursor creation/deletion.
         //
 
-        static unsigned numCursors() { return clientCursorsById.size(); }
+        static unsigned numCursors();
         static void find( const string& ns , set<CursorId>& all );
         static ClientCursor* find(CursorId id, bool warn = true);
 
@@ -274,10 +274,22 @@ namespace mongo {
         friend struct ClientCursorYieldLock;
         friend class CmdCursorInfo;
 
-        // A map from the CursorId to the ClientCursor behind it.
-        // TODO: Consider making this per-connection.
-        typedef map<CursorId, ClientCursor*> CCById;
-        static CCById clientCursorsById;
+        // Open ClientCursors by CursorId, hashed across stripes that each have their own mutex,
+        // so that finding and pinning a cursor, as every getMore does, contends only with work on
+        // cursors in the same stripe.
+        typedef unordered_map<CursorId, ClientCursor*> CCById;
+        struct CCStripe {
+            boost::recursive_mutex mutex;
+            CCById byId;
+        };
+        enum { NumStripes = 64 }; // a power of 2
+        static CCStripe* const stripes;
+        static CCStripe& stripeFor(CursorId id) { return stripes[id & (NumStripes - 1)]; }
+
+        // Open ClientCursors that have a runner, by namespace, so that a deletion only tells the
+        // runners over the collection it deletes from.  Use ccmutex.
+        typedef unordered_map<string, set<ClientCursor*> > CCByNs;
+        static CCByNs runnerCursorsByNs;
 
         // A list of NON-CACHED runners.  Any runner that yields must be put into this map before
         // yielding in order to be notified of invalidation and namespace deletion.  Before the
@@ -289,7 +301,8 @@ namespace mongo {
         // How many cursors have timed out?
         static long long numberTimedOut;
 
-        // This must be held when modifying any static member.
+        // This must be held when modifying nonCachedRunners, runnerCursorsByNs or a database's
+        // ccByLoc, and to delete a ClientCursor.  It is taken before any stripe's mutex.
         static boost::recursive_mutex& ccmutex;
 
         /**
@@ -299,20 +312,28 @@ namespace mongo {
         void init();
 
         /**
-         * Allocates a new CursorId.
-         * Called from init(...).  Assumes ccmutex held.
+         * Generates a candidate CursorId.  init(...) registers the cursor under it, or asks for
+         * another if it is taken.
          */
-        static CursorId allocCursorId_inlock();
+        static CursorId allocCursorId();
 
         /**
          * Find the ClientCursor with the provided ID.  Optionally warn if it's not found.
-         * Assumes ccmutex is held.
+         * Assumes the id's stripe mutex is held.
          */
 
         static ClientCursor* find_inlock(CursorId id, bool warn = true);
 
+        /**
+         * Whether invalidate(ns) should delete 'cc'.  kill()s the runner of a pinned cursor that
+         * it would otherwise delete.  Assumes ccmutex and the cursor's stripe mutex are held.
+         */
+        static bool shouldDeleteOnInvalidate(ClientCursor* cc, Database* db,
+                                             const StringData& ns, bool isDB);
+
         /**
          * Delete the ClientCursor with the provided ID.  masserts if the cursor is pinned.
+         * Assumes ccmutex and the cursor's stripe mutex are held.
          */
         static void _erase_inlock(ClientCursor* cursor);
 
@@ -41,6 +41,7 @@
 #include "mongo/db/stats/counters.h"
 #include "mongo/platform/process_id.h"
 #include "mongo/util/net/listen.h"
+#include "mongo/util/net/message.h"
 #include "mongo/util/processinfo.h"
 #include "mongo/util/ramlog.h"
 #include "mongo/util/version.h"
@@ -324,6 +325,9 @@ namespace mongo {
             BSONObj generateSection(const BSONElement& configElement) const {
                 BSONObjBuilder b;
                 networkCounter.append( b );
+                BSONObjBuilder buffers( b.subobjStart( "messageBuffers" ) );
+                MessageBufferPool::appendStats( buffers );
+                buffers.done();
                 return b.obj();
             }
                 
@@ -39,6 +39,7 @@
 #include "mongo/db/dur.h"
 #include "mongo/db/lockstat.h"
 #include "mongo/db/namespace_string.h"
+#include "mongo/db/server_parameters.h"
 #include "mongo/server.h"
 #include "mongo/util/assert_util.h"
 #include "mongo/util/concurrency/mapsf.h"
@@ -122,6 +123,8 @@ namespace mongo {
     public:
         LockStat stats;
 
+        WrapperForQLock() : stats( true ) { }
+
         void lock_r() { 
             verify( threadState() == 0 );
             lockState().lockedStart( 'r' );
@@ -310,11 +313,32 @@ namespace mongo {
         fassert( 16171 , prevCount != 1 || what == this );
     }
     
+    // when > 0, one in this many lock waits and holds is offered to the contention profiler
+    MONGO_EXPORT_SERVER_PARAMETER( lockProfilingSampleRate, int, 0 );
+
+    static LockContentionProfiler& lockContentionProfiler = *new LockContentionProfiler();
+    static AtomicUInt32 lockProfilingTicks;
+
+    static void profileLock( LockContentionProfiler::Kind kind, char type, long long micros ) {
+        int rate = lockProfilingSampleRate;
+        if ( rate <= 0 )
+            return;
+        if ( rate > 1 && lockProfilingTicks.fetchAndAdd( 1 ) % rate != 0 )
+            return;
+        if ( ! lockContentionProfiler.wants( kind, micros ) )
+            return;
+        CurOp* op = cc().curop();
+        lockContentionProfiler.record( kind, type, micros,
+                                       opToString( op->getOp() ), op->getNS(),
+                                       op->opNum().get() );
+    }
+
     long long Lock::ScopedLock::acquireFinished( LockStat* stat ) {
         long long acquisitionTime = _timer.micros();
         _timer.reset();
         _stat = stat;
         cc().curop()->lockStat().recordAcquireTimeMicros( _type , acquisitionTime );
+        profileLock( LockContentionProfiler::Waiting, _type, acquisitionTime );
         return acquisitionTime;
     }
 
@@ -329,6 +353,7 @@ namespace mongo {
         if ( _stat )
             _stat->recordLockTimeMicros( _type , micros );
         cc().curop()->lockStat().recordLockTimeMicros( _type , micros );
+        profileLock( LockContentionProfiler::Holding, _type, micros );
     }
 
     void Lock::ScopedLock::recordTime() {
@@ -876,4 +901,26 @@ namespace mongo {
 
     } lockStatsServerStatusSection;
 
+    class LockContentionServerStatusSection : public ServerStatusSection {
+    public:
+        LockContentionServerStatusSection() : ServerStatusSection( "lockContention" ){}
+        virtual bool includeByDefault() const { return true; }
+
+        BSONObj generateSection( const BSONElement& configElement ) const {
+            if ( lockProfilingSampleRate <= 0 &&
+                 lockContentionProfiler.samples( LockContentionProfiler::Waiting ).empty() &&
+                 lockContentionProfiler.samples( LockContentionProfiler::Holding ).empty() )
+                return BSONObj();
+
+            BSONObjBuilder b;
+            b.append( "sampleRate" , lockProfilingSampleRate );
+            b.appendElements( lockContentionProfiler.report() );
+            if ( configElement.type() == Object &&
+                 configElement.Obj()["reset"].trueValue() )
+                lockContentionProfiler.reset();
+            return b.obj();
+        }
+
+    } lockContentionServerStatusSection;
+
 }
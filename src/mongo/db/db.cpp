@@ -65,12 +65,14 @@
 #include "mongo/db/repl/replication_server_status.h"
 #include "mongo/db/repl/rs.h"
 #include "mongo/db/restapi.h"
+#include "mongo/db/server_parameters.h"
 #include "mongo/db/startup_warnings.h"
 #include "mongo/db/stats/counters.h"
 #include "mongo/db/stats/snapshots.h"
 #include "mongo/db/storage_options.h"
 #include "mongo/db/ttl.h"
 #include "mongo/platform/process_id.h"
+#include "mongo/s/d_logic.h"
 #include "mongo/s/d_writeback.h"
 #include "mongo/scripting/engine.h"
 #include "mongo/util/background.h"
@@ -239,6 +241,32 @@ namespace mongo {
             if( c ) c->shutdown();
         }
 
+        virtual bool canShareThreads() const { return true; }
+
+        virtual ThreadState* releaseThreadState() {
+            ConnectionState* state = new ConnectionState();
+            state->client.reset( currentClient.release() );
+            state->shardingInfo.reset( ShardedConnectionInfo::release() );
+            return state;
+        }
+
+        virtual void adoptThreadState( ThreadState* threadState ) {
+            scoped_ptr<ConnectionState> state( static_cast<ConnectionState*>( threadState ) );
+            verify( currentClient.get() == 0 );
+            if ( state->client.get() ) {
+                setThreadName( state->client->desc().rawData() );
+            }
+            currentClient.reset( state->client.release() );
+            ShardedConnectionInfo::adopt( state->shardingInfo.release() );
+        }
+
+    private:
+        /** The thread locals a connection uses between requests. */
+        class ConnectionState : public ThreadState {
+        public:
+            auto_ptr<Client> client;
+            auto_ptr<ShardedConnectionInfo> shardingInfo;
+        };
     };
 
     void logStartup() {
@@ -268,11 +296,21 @@ namespace mongo {
         c.insert( name, o);
     }
 
+    // If > 0, client connections are served from a pool of this many threads rather than a
+    // thread each.  Only honored on linux.
+    MONGO_EXPORT_STARTUP_SERVER_PARAMETER(connectionWorkerThreads, int, 0);
+
+    // Seconds a connection served by a worker thread may take to send the rest of a message, or
+    // to take its reply, before it is closed.  0 waits forever.
+    MONGO_EXPORT_STARTUP_SERVER_PARAMETER(connectionWorkerTimeoutSecs, int, 10);
+
     void listen(int port) {
         //testTheDb();
         MessageServer::Options options;
         options.port = port;
         options.ipList = serverGlobalParams.bind_ip;
+        options.workerThreads = connectionWorkerThreads;
+        options.workerTimeoutSecs = connectionWorkerTimeoutSecs;
 
         MessageServer * server = createServer( options , new MyMessageHandler() );
         server->setAsTimeTracker();
@@ -68,6 +68,7 @@
 #include "mongo/db/query_optimizer.h"
 #include "mongo/db/repl/is_master.h"
 #include "mongo/db/repl/oplog.h"
+#include "mongo/db/storage/free_space_index.h"
 #include "mongo/db/write_concern.h"
 #include "mongo/s/d_logic.h"
 #include "mongo/s/d_writeback.h"
@@ -1149,6 +1150,23 @@ namespace mongo {
                 result.append( "capped" , nsd->isCapped() );
                 result.appendNumber( "max" , nsd->maxCappedDocs() );
             }
+            else {
+                FreeSpaceIndex::Stats freeSpace;
+                // only if allocation has already mirrored the lists; collStats isn't worth
+                // building the index for
+                if ( FreeSpaceIndex::peekStats( nsd, &freeSpace ) ) {
+                    BSONObjBuilder fs( result.subobjStart( "freeSpace" ) );
+                    fs.appendNumber( "records" , freeSpace.records );
+                    fs.appendNumber( "size" , freeSpace.bytes / scale );
+                    fs.append( "largestRecord" , freeSpace.largest / scale );
+                    // share of the free space that a record the size of the largest hole
+                    // couldn't use
+                    fs.append( "fragmentation" ,
+                               freeSpace.bytes ?
+                               1.0 - double( freeSpace.largest ) / double( freeSpace.bytes ) : 0.0 );
+                    fs.done();
+                }
+            }
 
             if ( verbose )
                 result.appendArray( "extents" , extents.arr() );
@@ -54,12 +54,43 @@ namespace mongo {
     }
 
 
+    namespace {
+        // below this a reply's documents are copied in after its header: cheaper than a second
+        // buffer to gather
+        const int ZeroCopyReplyMinBytes = 16 * 1024;
+
+        /** @return a header for a reply with no documents yet, for the transport to free */
+        QueryResult* newReplyHeader( int queryResultFlags, int nReturned, int startingFrom,
+                                     long long cursorId ) {
+            QueryResult* qr = static_cast< QueryResult* >( malloc( sizeof( QueryResult ) ) );
+            verify( qr );
+            qr->_resultFlags() = queryResultFlags;
+            qr->len = sizeof( QueryResult );
+            qr->setOperation( opReply );
+            qr->cursorId = cursorId;
+            qr->startingFrom = startingFrom;
+            qr->nReturned = nReturned;
+            return qr;
+        }
+    }
+
     void replyToQuery(int queryResultFlags,
                       AbstractMessagingPort* p, Message& requestMsg,
                       void *data, int size,
                       int nReturned, int startingFrom,
                       long long cursorId 
                       ) {
+        if ( size >= ZeroCopyReplyMinBytes ) {
+            // 'data' is the caller's until we return, by which time the reply has been sent
+            Message resp( newReplyHeader( queryResultFlags, nReturned, startingFrom, cursorId ),
+                          true );
+            resp.appendUnownedData( static_cast< const char* >( data ), size,
+                                    boost::shared_ptr<void>() );
+            MessageBufferPool::noteZeroCopyReply();
+            p->reply(requestMsg, resp, requestMsg.header()->id);
+            return;
+        }
+
         BufBuilder b(32768);
         b.skip(sizeof(QueryResult));
         b.appendBuf(data, size);
@@ -85,12 +116,24 @@ namespace mongo {
 
     void replyToQuery( int queryResultFlags, Message &m, DbResponse &dbresponse, BSONObj obj ) {
         Message *resp = new Message();
-        replyToQuery( queryResultFlags, *resp, obj );
+        if ( obj.isOwned() && obj.objsize() >= ZeroCopyReplyMinBytes ) {
+            // the reply is sent after we return, so it holds a reference to the object's buffer.
+            // whoever reads a DbResponse in process (DBDirectClient) concat()s it first.
+            resp->setData( newReplyHeader( queryResultFlags, 1, 0, 0 ), true );
+            resp->appendUnownedData( obj.objdata(), obj.objsize(),
+                                     boost::shared_ptr<void>( new BSONObj( obj ) ) );
+            MessageBufferPool::noteZeroCopyReply();
+        }
+        else {
+            replyToQuery( queryResultFlags, *resp, obj );
+        }
         dbresponse.response = resp;
         dbresponse.responseTo = m.header()->id;
     }
 
     void replyToQuery( int queryResultFlags, Message& response, const BSONObj& resultObj ) {
+        // always a single buffer: callers such as DBClientCursor::initCommand read the reply
+        // back with singleData()
         BufBuilder bufBuilder;
         bufBuilder.skip( sizeof( QueryResult ));
         bufBuilder.appendBuf( reinterpret_cast< void *>(
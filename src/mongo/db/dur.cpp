@@ -82,6 +82,7 @@
 #include "mongo/db/storage_options.h"
 #include "mongo/server.h"
 #include "mongo/util/concurrency/race.h"
+#include "mongo/util/histogram.h"
 #include "mongo/util/mongoutils/hash.h"
 #include "mongo/util/mongoutils/str.h"
 #include "mongo/util/stacktrace.h"
@@ -109,6 +110,23 @@ namespace mongo {
 
         Stats stats;
 
+        extern size_t privateMapBytes;
+
+        /** time spent in each REMAPPRIVATEVIEW, which stalls everyone as it is done in W.
+            unlike Stats::S this is cumulative rather than per interval.
+        */
+        static Histogram& remapStallMicros() {
+            static Histogram* h = 0;
+            if( h == 0 ) {
+                Histogram::Options opts;
+                opts.numBuckets = 16;
+                opts.bucketSize = 100;
+                opts.exponential = true;
+                h = new Histogram(opts);
+            }
+            return *h;
+        }
+
         void Stats::S::reset() {
             memset(this, 0, sizeof(*this));
         }
@@ -168,7 +186,26 @@ namespace mongo {
         }
 
         BSONObj Stats::asObj() {
-            return other()->_asObj();
+            BSONObjBuilder b;
+            b.appendElements( other()->_asObj() );
+
+            const Histogram& h = remapStallMicros();
+            BSONObjBuilder stalls( b.subobjStart( "remapPrivateViewStallMicros" ) );
+            for ( uint32_t bucket = 0; bucket < h.getBucketsNum(); bucket++ ) {
+                uint64_t count = h.getCount( bucket );
+                if ( count == 0 )
+                    continue;
+                if ( bucket == h.getBucketsNum() - 1 )
+                    stalls.append( "more" , static_cast<long long>( count ) );
+                else
+                    stalls.append( BSONObjBuilder::numStr( static_cast<int>( h.getBoundary( bucket ) ) ) ,
+                                   static_cast<long long>( count ) );
+            }
+            stalls.done();
+
+            b.appendNumber( "remapPrivateViewBacklogBytes" , static_cast<long long>( privateMapBytes ) );
+
+            return b.obj();
         }
 
         void Stats::rotate() {
@@ -458,7 +495,8 @@ namespace mongo {
             OCCASIONALLY log() << "DurParanoid map check " << t.millis() << "ms for " <<  (bytes / (1024*1024)) << "MB" << endl;
         }
 
-        extern size_t privateMapBytes;
+        // target for how long one REMAPPRIVATEVIEW holds W when it isn't behind
+        const unsigned long long RemapPrivateViewBudgetMicros = 20 * 1000;
 
         static void _REMAPPRIVATEVIEW() {
             // todo: Consider using ProcessInfo herein and watching for getResidentSize to drop.  that could be a way 
@@ -499,19 +537,22 @@ namespace mongo {
             if( sz == 0 )
                 return;
 
+            // written since the last pass, plus whatever earlier passes left over
+            const size_t pendingBytes = privateMapBytes;
             {
                 // be careful not to use too much memory if the write rate is 
                 // extremely high
-                double f = privateMapBytes / ((double)UncommittedBytesLimit);
+                double f = pendingBytes / ((double)UncommittedBytesLimit);
                 if( f > fraction ) { 
                     fraction = f;
                 }
-                privateMapBytes = 0;
             }
 
-            unsigned ntodo = (unsigned) (sz * fraction);
+            // files that earlier passes stopped short of are still owed
+            static unsigned deferred;
+            unsigned long long want = (unsigned long long) (sz * fraction) + deferred;
+            unsigned ntodo = (unsigned) std::min( want, (unsigned long long) sz );
             if( ntodo < 1 ) ntodo = 1;
-            if( ntodo > sz ) ntodo = sz;
 
             const set<MongoFile*>::iterator b = files.begin();
             const set<MongoFile*>::iterator e = files.end();
@@ -524,8 +565,20 @@ namespace mongo {
             unsigned startedAt = startAt;
             startAt = (startAt + ntodo) % sz; // mark where to start next time
 
+            // unless we are behind (or low on memory) keep each stall short, and pick up the
+            // remaining files on the following commits.  what we leave is carried forward, so
+            // a backlog grows until it forces a full pass rather than without limit.
+            const bool mustFinish = fraction >= 1 || want >= sz;
+            const unsigned planned = ntodo;
+
             Timer t;
             for( unsigned x = 0; x < ntodo; x++ ) {
+                if( !mustFinish && x > 0 && t.micros() > RemapPrivateViewBudgetMicros ) {
+                    LOG(2) << "journal REMAPPRIVATEVIEW over budget after " << x << " of " << ntodo << endl;
+                    startAt = (startedAt + x) % sz;
+                    ntodo = x;
+                    break;
+                }
                 dassert( i != e );
                 if( (*i)->isDurableMappedFile() ) {
                     DurableMappedFile *mmf = (DurableMappedFile*) *i;
@@ -538,6 +591,10 @@ namespace mongo {
                     if( i == e ) i = b;
                 }
             }
+            deferred = planned - ntodo;
+            // only the share of the pending bytes we got through is off the books
+            privateMapBytes -= (size_t) (pendingBytes * ((double) ntodo / planned));
+
             LOG(2) << "journal REMAPPRIVATEVIEW done startedAt: " << startedAt << " n:" << ntodo << ' ' << t.millis() << "ms" << endl;
         }
 
@@ -547,7 +604,9 @@ namespace mongo {
         void REMAPPRIVATEVIEW() {
             Timer t;
             _REMAPPRIVATEVIEW();
-            stats.curr->_remapPrivateViewMicros += t.micros();
+            unsigned long long micros = t.micros();
+            stats.curr->_remapPrivateViewMicros += micros;
+            remapStallMicros().insert( (uint32_t) std::min( micros, 0xffffffffULL ) );
         }
 
         // this is a pseudo-local variable in the groupcommit functions 
@@ -41,6 +41,7 @@
 #include "mongo/db/dur_journalformat.h"
 #include "mongo/db/dur_journalimpl.h"
 #include "mongo/db/dur_stats.h"
+#include "mongo/db/server_parameters.h"
 #include "mongo/db/storage_options.h"
 #include "mongo/platform/random.h"
 #include "mongo/server.h"
@@ -48,11 +49,13 @@
 #include "mongo/util/checksum.h"
 #include "mongo/util/compress.h"
 #include "mongo/util/concurrency/race.h"
+#include "mongo/util/concurrency/thread_pool.h"
 #include "mongo/util/file.h"
 #include "mongo/util/logfile.h"
 #include "mongo/util/mmap.h"
 #include "mongo/util/mongoutils/str.h"
 #include "mongo/util/net/listen.h" // getelapsedtimemillis
+#include "mongo/util/processinfo.h"
 #include "mongo/util/progress_meter.h"
 #include "mongo/util/timer.h"
 
@@ -62,6 +65,10 @@ namespace mongo {
 
     class AlignedBuilder;
 
+    // Write journal files in the previous (0x4149) format, one compressed block per section, so
+    // that an older mongod can still recover them.  For downgrades and for testing recovery.
+    MONGO_EXPORT_STARTUP_SERVER_PARAMETER(journalSingleBlockSections, bool, false);
+
 
     namespace dur {
         // Rotate after reaching this data size in a journal (j._<n>) file
@@ -163,6 +170,10 @@ namespace mongo {
         JHeader::JHeader(string fname) {
             magic[0] = 'j'; magic[1] = '\n';
             _version = CurrentVersion;
+#if !defined(_NOCOMPRESS)
+            if( journalSingleBlockSections )
+                _version = SingleBlockVersion;
+#endif
             memset(ts, 0, sizeof(ts));
             time_t t = time(0);
             strncpy(ts, time_t_to_String_short(t).c_str(), sizeof(ts)-1);
@@ -262,6 +273,14 @@ namespace mongo {
             LOG(1) << "removeJournalFiles end" << endl;
         }
 
+        /** recycling a journal file writes and fsyncs its header; that is done on this one
+            thread, so files are still retired oldest first, instead of on the commit path.
+        */
+        static ThreadPool& recyclePool() {
+            static ThreadPool* pool = new ThreadPool(1);
+            return *pool;
+        }
+
         /** at clean shutdown */
         bool okToCleanUp = false; // successful recovery would set this to true
         void Journal::cleanup(bool _log) {
@@ -270,6 +289,10 @@ namespace mongo {
 
             if( _log )
                 log() << "journalCleanup..." << endl;
+
+            // let rotated out files finish being recycled before the rest are removed
+            recyclePool().join();
+
             try {
                 SimpleMutex::scoped_lock lk(_curLogFileMutex);
                 closeCurrentJournalFile();
@@ -433,8 +456,12 @@ namespace mongo {
             j.open();
         }
 
+        /** recycles p into a free prealloc.<n> slot rather than deleting it, unless journal
+            preallocation was turned off.  a rotated out file is already full length, so
+            reusing it costs a header write where recreating it costs the whole file.
+        */
         void removeOldJournalFile(boost::filesystem::path p) { 
-            if( usingPreallocate ) {
+            if( usingPreallocate || storageGlobalParams.preallocj ) {
                 try {
                     for( int i = 0; i < NUM_PREALLOC_FILES; i++ ) {
                         boost::filesystem::path filepath = preallocPath(i);
@@ -453,6 +480,8 @@ namespace mongo {
                                 f.fsync();
                             }
                             boost::filesystem::rename(temppath, filepath);
+                            log() << "recycled journal file " << p.string() << " as "
+                                  << filepath.string() << endl;
                             return;
                         }
                     }
@@ -673,7 +702,7 @@ namespace mongo {
                     // eligible for deletion
                     boost::filesystem::path p( f.filename );
                     log() << "old journal file will be removed: " << f.filename << endl;
-                    removeOldJournalFile(p);
+                    recyclePool().schedule(removeOldJournalFile, p);
                 }
                 else {
                     break;
@@ -727,16 +756,59 @@ namespace mongo {
             j.journal(h, uncompressed);
             stats.curr->_writeToJournalMicros += t.micros();
         }
+        // group commits are cut into chunks of about this size, which are compressed in parallel
+        const unsigned CompressChunkSize = 512 * 1024;
+        const unsigned MaxCompressThreads = 4;
+
+        /** threads that help the committing thread compress big group commits */
+        static ThreadPool* compressionPool() {
+            static ThreadPool* pool = 0;
+            static bool initialized = false;
+            if( !initialized ) {
+                unsigned cores = ProcessInfo().getNumCores();
+                if( cores > 1 )
+                    pool = new ThreadPool( std::min(cores, MaxCompressThreads + 1) - 1 );
+                initialized = true;
+            }
+            return pool;
+        }
+
         void Journal::journal(const JSectHeader& h, const AlignedBuilder& uncompressed) {
             RACECHECK
             static AlignedBuilder b(32*1024*1024);
             /* buffer to journal will be
+               JSectHeader
+               JSectChunks, followed by the compressed length of each chunk
+               compressed operations, chunk by chunk
+               JSectFooter
+               or with journalSingleBlockSections
                JSectHeader
                compressed operations
                JSectFooter
             */
+            const bool chunked = !journalSingleBlockSections;
+            ThreadPool* pool = chunked ? compressionPool() : 0;
+            const unsigned len = uncompressed.len();
+            const unsigned nChunks = pool ? std::max(1U, len / CompressChunkSize) : 1;
+
+            // chunk i covers [chunkStart[i], chunkStart[i+1]) of the uncompressed buffer and is
+            // compressed to slotStart[i], its worst case position, before the gaps are closed up
+            static vector<unsigned> chunkStart;
+            static vector<unsigned> slotStart;
+            static vector<size_t> compressedLength;
+            chunkStart.resize(nChunks + 1);
+            slotStart.resize(nChunks + 1);
+            compressedLength.assign(nChunks, 0);
+            for( unsigned i = 0; i <= nChunks; i++ ) {
+                chunkStart[i] = (unsigned) ((unsigned long long) len * i / nChunks);
+                slotStart[i] = i == 0 ? 0 :
+                    slotStart[i-1] + maxCompressedLength(chunkStart[i] - chunkStart[i-1]);
+            }
+
             const unsigned headTailSize = sizeof(JSectHeader) + sizeof(JSectFooter);
-            const unsigned max = maxCompressedLength(uncompressed.len()) + headTailSize;
+            const unsigned tableSize =
+                chunked ? sizeof(JSectChunks) + nChunks * sizeof(unsigned) : 0;
+            const unsigned max = headTailSize + tableSize + slotStart[nChunks];
             b.reset(max);
 
             {
@@ -744,11 +816,37 @@ namespace mongo {
                 b.appendStruct(h);
             }
 
-            size_t compressedLength = 0;
-            rawCompress(uncompressed.buf(), uncompressed.len(), b.cur(), &compressedLength);
-            verify( compressedLength < 0xffffffff );
-            verify( compressedLength < max );
-            b.skip(compressedLength);
+            const unsigned tableOfs = b.skip(tableSize);
+            char *slots = b.cur(); // reset(max) above leaves room for every slot
+
+            const char *src = uncompressed.buf();
+            for( unsigned i = 1; i < nChunks; i++ ) {
+                pool->schedule(rawCompress,
+                               src + chunkStart[i],
+                               (size_t) (chunkStart[i+1] - chunkStart[i]),
+                               slots + slotStart[i],
+                               &compressedLength[i]);
+            }
+            rawCompress(src, chunkStart[1], slots, &compressedLength[0]);
+            if( nChunks > 1 )
+                pool->join();
+
+            unsigned compressedTotal = 0;
+            for( unsigned i = 0; i < nChunks; i++ ) {
+                verify( compressedLength[i] <= slotStart[i+1] - slotStart[i] );
+                if( compressedTotal != slotStart[i] )
+                    memmove(slots + compressedTotal, slots + slotStart[i], compressedLength[i]);
+                compressedTotal += compressedLength[i];
+            }
+            if( chunked ) {
+                JSectChunks *table = (JSectChunks *) b.atOfs(tableOfs);
+                table->nChunks = nChunks;
+                unsigned *tableLens = (unsigned *) (table + 1);
+                for( unsigned i = 0; i < nChunks; i++ )
+                    tableLens[i] = (unsigned) compressedLength[i];
+            }
+            verify( compressedTotal < 0xffffffff );
+            b.skip(compressedTotal);
 
             // footer
             unsigned L = 0xffffffff;
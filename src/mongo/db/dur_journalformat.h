@@ -51,7 +51,9 @@ namespace mongo {
 #if defined(_NOCOMPRESS)
             enum { CurrentVersion = 0x4148 };
 #else
-            enum { CurrentVersion = 0x4149 };
+            // 0x414a sections carry a JSectChunks table and independently compressed chunks;
+            // 0x4149 sections are a single compressed block and are still read on recovery
+            enum { CurrentVersion = 0x414a, SingleBlockVersion = 0x4149 };
 #endif
             unsigned short _version;
 
@@ -67,7 +69,15 @@ namespace mongo {
             char reserved3[8026]; // 8KB total for the file header
             char txt2[2];         // "\n\n" at the end
 
+#if defined(_NOCOMPRESS)
             bool versionOk() const { return _version == CurrentVersion; }
+            bool chunkedSections() const { return true; }
+#else
+            bool versionOk() const {
+                return _version == CurrentVersion || _version == SingleBlockVersion;
+            }
+            bool chunkedSections() const { return _version != SingleBlockVersion; }
+#endif
             bool valid() const { return magic[0] == 'j' && txt2[1] == '\n' && fileId; }
         };
 
@@ -94,6 +104,18 @@ namespace mongo {
             }
         };
 
+        /** Starts the compressed data of a section in files of JHeader::CurrentVersion. The group
+            commit buffer is cut into nChunks pieces that are compressed independently (and in
+            parallel); the compressed length of each follows as an unsigned, then the compressed
+            chunks back to back. Uncompressing them in order and concatenating the results gives
+            back the original buffer.
+        */
+        struct JSectChunks {
+            unsigned nChunks;
+            // unsigned compressedLen[nChunks];
+            // char chunks[];
+        };
+
         /** an individual write operation within a group commit section.  Either the entire section should
             be applied, or nothing.  (We check the md5 for the whole section before doing anything on recovery.)
         */
@@ -115,13 +115,15 @@ namespace mongo {
             const bool _doDurOps;
             string _uncompressed;
         public:
-            JournalSectionIterator(const JSectHeader& h, const void *compressed, unsigned compressedLen, bool doDurOpsRecovering) :
+            JournalSectionIterator(const JSectHeader& h, const void *compressed, unsigned compressedLen, bool chunked, bool doDurOpsRecovering) :
                 _h(h),
                 _lastDbName(0)
                 , _doDurOps(doDurOpsRecovering)
             {
                 verify( doDurOpsRecovering );
-                bool ok = uncompress((const char *)compressed, compressedLen, &_uncompressed);
+                bool ok = chunked ?
+                    uncompressChunks((const char *)compressed, compressedLen) :
+                    uncompress((const char *)compressed, compressedLen, &_uncompressed);
                 if( !ok ) { 
                     // it should always be ok (i think?) as there is a previous check to see that the JSectFooter is ok
                     log() << "couldn't uncompress journal section" << endl;
@@ -143,6 +145,32 @@ namespace mongo {
 
             bool atEof() const { return _entries->atEof(); }
 
+        private:
+            /** see JSectChunks */
+            bool uncompressChunks(const char *p, unsigned len) {
+                BufReader br(p, len);
+                try {
+                    unsigned nChunks;
+                    br.read(nChunks);
+                    if( nChunks > len / sizeof(unsigned) )
+                        return false;
+                    const unsigned *lens = (const unsigned *) br.skip(nChunks * sizeof(unsigned));
+                    string chunk;
+                    for( unsigned i = 0; i < nChunks; i++ ) {
+                        const char *c = (const char *) br.skip(lens[i]);
+                        if( !uncompress(c, lens[i], &chunk) )
+                            return false;
+                        _uncompressed.append(chunk);
+                    }
+                }
+                catch( BufReader::eof& ) {
+                    return false;
+                }
+                return br.atEof();
+            }
+
+        public:
+
             unsigned long long seqNumber() const { return _h.seqNumber; }
 
             /** get the next entry from the log.  this function parses and combines JDbContext and JEntry's.
@@ -390,7 +418,7 @@ namespace mongo {
 
             auto_ptr<JournalSectionIterator> i;
             if( _recovering ) {
-                i = auto_ptr<JournalSectionIterator>(new JournalSectionIterator(*h, p, len, _recovering));
+                i = auto_ptr<JournalSectionIterator>(new JournalSectionIterator(*h, p, len, _chunkedSections, _recovering));
             }
             else { 
                 i = auto_ptr<JournalSectionIterator>(new JournalSectionIterator(*h, /*after header*/p, /*w/out header*/len));
@@ -459,9 +487,11 @@ namespace mongo {
                         uasserted(13536, str::stream() << "journal version number mismatch " << h._version);
                     }
                     fileId = h.fileId;
+                    _chunkedSections = h.chunkedSections();
                     if (storageGlobalParams.durOptions &
                         StorageGlobalParams::DurDumpJournal) {
-                        log() << "JHeader::fileId=" << fileId << endl;
+                        log() << "JHeader::fileId=" << fileId << " version:" << hex << h._version
+                              << dec << endl;
                     }
                 }
 
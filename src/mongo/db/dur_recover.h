@@ -57,7 +57,7 @@ namespace mongo {
             } last;        
         public:
             RecoveryJob() : _lastDataSyncedFromLastRun(0), 
-                _mx("recovery"), _recovering(false) { _lastSeqMentionedInConsoleLog = 1; }
+                _mx("recovery"), _recovering(false), _chunkedSections(true) { _lastSeqMentionedInConsoleLog = 1; }
             void go(vector<boost::filesystem::path>& files);
             ~RecoveryJob();
 
@@ -84,6 +84,7 @@ namespace mongo {
             mongo::mutex _mx; // protects _mmfs
         private:
             bool _recovering; // are we in recovery or WRITETODATAFILES
+            bool _chunkedSections; // does the journal file being recovered use JSectChunks
 
             static RecoveryJob &_instance;
         };
@@ -104,6 +104,23 @@ namespace mongo {
         }
     }
 
+    PlanStage::StageState CollectionScan::workBatch(size_t maxWorks, vector<WorkingSetID>* out,
+                                                    WorkingSetID* fetchOut) {
+        // Calling our own work() directly rather than through the vtable lets the compiler inline
+        // the whole scan loop.
+        for (size_t i = 0; i < maxWorks; ++i) {
+            WorkingSetID id;
+            StageState state = CollectionScan::work(&id);
+            if (PlanStage::ADVANCED == state) {
+                out->push_back(id);
+            }
+            else if (PlanStage::NEED_TIME != state) {
+                return state;
+            }
+        }
+        return PlanStage::NEED_TIME;
+    }
+
     bool CollectionScan::isEOF() {
         if (_nsDropped) { return true; }
         if (NULL == _iter) { return false; }
@@ -50,6 +50,8 @@ namespace mongo {
                        const MatchExpression* filter);
 
         virtual StageState work(WorkingSetID* out);
+        virtual StageState workBatch(size_t maxWorks, std::vector<WorkingSetID>* out,
+                                     WorkingSetID* fetchOut);
         virtual bool isEOF();
 
         virtual void invalidate(const DiskLoc& dl);
@@ -40,7 +40,13 @@ namespace mongo {
     MONGO_FP_DECLARE(fetchInMemorySucceed);
 
     FetchStage::FetchStage(WorkingSet* ws, PlanStage* child, const MatchExpression* filter)
-        : _ws(ws), _child(child), _filter(filter), _idBeingPagedIn(WorkingSet::INVALID_ID) { }
+        : _ws(ws),
+          _child(child),
+          _filter(filter),
+          _idBeingPagedIn(WorkingSet::INVALID_ID),
+          _childBatchPos(0),
+          _childBatchState(PlanStage::NEED_TIME),
+          _childBatchFetchId(WorkingSet::INVALID_ID) { }
 
     FetchStage::~FetchStage() { }
 
@@ -51,6 +57,14 @@ namespace mongo {
             return false;
         }
 
+        // We still have to return what's left of our child's last batch, or how it ended.
+        if (_childBatchPos < _childBatch.size()) {
+            return false;
+        }
+        if (PlanStage::NEED_TIME != _childBatchState && PlanStage::IS_EOF != _childBatchState) {
+            return false;
+        }
+
         return _child->isEOF();
     }
 
@@ -79,7 +93,7 @@ namespace mongo {
         // If we're here, we're not waiting for a DiskLoc to be fetched.  Get another to-be-fetched
         // result from our child.
         WorkingSetID id;
-        StageState status = _child->work(&id);
+        StageState status = childWork(&id);
 
         if (PlanStage::ADVANCED == status) {
             WorkingSetMember* member = _ws->get(id);
@@ -125,6 +139,99 @@ namespace mongo {
         }
     }
 
+    PlanStage::StageState FetchStage::childWork(WorkingSetID* id) {
+        if (_childBatchPos < _childBatch.size()) {
+            *id = _childBatch[_childBatchPos++];
+            return PlanStage::ADVANCED;
+        }
+
+        _childBatch.clear();
+        _childBatchPos = 0;
+
+        if (PlanStage::NEED_TIME != _childBatchState) {
+            StageState status = _childBatchState;
+            *id = _childBatchFetchId;
+            _childBatchState = PlanStage::NEED_TIME;
+            _childBatchFetchId = WorkingSet::INVALID_ID;
+            return status;
+        }
+
+        return _child->work(id);
+    }
+
+    PlanStage::StageState FetchStage::workBatch(size_t maxWorks, vector<WorkingSetID>* out,
+                                                WorkingSetID* fetchOut) {
+        // Finish off a fetch or a partially processed batch one result at a time.
+        if (WorkingSet::INVALID_ID != _idBeingPagedIn
+            || _childBatchPos < _childBatch.size()
+            || PlanStage::NEED_TIME != _childBatchState) {
+            return PlanStage::workBatch(maxWorks, out, fetchOut);
+        }
+
+        ++_commonStats.works;
+        if (isEOF()) { return PlanStage::IS_EOF; }
+
+        _childBatch.clear();
+        _childBatchPos = 0;
+        StageState status = _child->workBatch(maxWorks, &_childBatch, &_childBatchFetchId);
+        _commonStats.works += _childBatch.size();
+
+        while (_childBatchPos < _childBatch.size()) {
+            WorkingSetID id = _childBatch[_childBatchPos++];
+            WorkingSetMember* member = _ws->get(id);
+
+            if (member->hasObj()) {
+                ++_specificStats.alreadyHasObj;
+            }
+            else {
+                verify(WorkingSetMember::LOC_AND_IDX == member->state);
+                verify(member->hasLoc());
+
+                Record* record = member->loc.rec();
+                const char* data = record->dataNoThrowing();
+
+                if (!recordInMemory(data)) {
+                    // Stop here and pass a fetch request up.  The rest of the batch, and how it
+                    // ended, are handed out by childWork(...) afterwards.
+                    _childBatchState = status;
+                    _idBeingPagedIn = id;
+                    *fetchOut = id;
+                    ++_commonStats.needFetch;
+                    return PlanStage::NEED_FETCH;
+                }
+
+                member->keyData.clear();
+                member->obj = BSONObj(data);
+                member->state = WorkingSetMember::LOC_AND_UNOWNED_OBJ;
+            }
+
+            if (Filter::passes(member, _filter)) {
+                if (NULL != _filter) {
+                    ++_specificStats.matchTested;
+                }
+                out->push_back(id);
+                ++_commonStats.advanced;
+            }
+            else {
+                _ws->free(id);
+                ++_commonStats.needTime;
+            }
+        }
+
+        _childBatch.clear();
+        _childBatchPos = 0;
+
+        if (PlanStage::NEED_FETCH == status) {
+            *fetchOut = _childBatchFetchId;
+            ++_commonStats.needFetch;
+        }
+        else if (PlanStage::NEED_TIME == status) {
+            ++_commonStats.needTime;
+        }
+        _childBatchFetchId = WorkingSet::INVALID_ID;
+        return status;
+    }
+
     void FetchStage::prepareToYield() {
         ++_commonStats.yields;
         _child->prepareToYield();
@@ -140,6 +247,14 @@ namespace mongo {
 
         _child->invalidate(dl);
 
+        // The rest of our child's batch is ours to invalidate.
+        for (size_t i = _childBatchPos; i < _childBatch.size(); ++i) {
+            WorkingSetMember* member = _ws->get(_childBatch[i]);
+            if (member->hasLoc() && member->loc == dl) {
+                WorkingSetCommon::fetchAndInvalidateLoc(member);
+            }
+        }
+
         // If we're holding on to an object that we're waiting for the runner to page in...
         if (WorkingSet::INVALID_ID != _idBeingPagedIn) {
             WorkingSetMember* member = _ws->get(_idBeingPagedIn);
@@ -50,6 +50,8 @@ namespace mongo {
 
         virtual bool isEOF();
         virtual StageState work(WorkingSetID* out);
+        virtual StageState workBatch(size_t maxWorks, std::vector<WorkingSetID>* out,
+                                     WorkingSetID* fetchOut);
 
         virtual void prepareToYield();
         virtual void recoverFromYield();
@@ -70,6 +72,12 @@ namespace mongo {
          */
         StageState fetchCompleted(WorkingSetID* out);
 
+        /**
+         * Get the next result from our child, taking it from the rest of a batch we stopped short
+         * of if there is one.  Same semantics as _child->work(id).
+         */
+        StageState childWork(WorkingSetID* id);
+
         // _ws is not owned by us.
         WorkingSet* _ws;
         scoped_ptr<PlanStage> _child;
@@ -81,6 +89,17 @@ namespace mongo {
         // a "please page this in" result and hold on to the WSID until the next call to work(...).
         WorkingSetID _idBeingPagedIn;
 
+        // When workBatch(...) has to request a fetch part way through a batch from our child,
+        // the rest of that batch is kept here and handed out by childWork(...).
+        std::vector<WorkingSetID> _childBatch;
+        size_t _childBatchPos;
+
+        // The state our child's batch ended with, and the id it wanted fetched if that state is
+        // NEED_FETCH.  Reported once _childBatch is drained.  NEED_TIME if there's nothing to
+        // report.
+        StageState _childBatchState;
+        WorkingSetID _childBatchFetchId;
+
         // Stats
         CommonStats _commonStats;
         FetchStats _specificStats;
@@ -198,6 +198,22 @@ namespace mongo {
         return PlanStage::NEED_TIME;
     }
 
+    PlanStage::StageState IndexScan::workBatch(size_t maxWorks, vector<WorkingSetID>* out,
+                                               WorkingSetID* fetchOut) {
+        // See CollectionScan::workBatch.
+        for (size_t i = 0; i < maxWorks; ++i) {
+            WorkingSetID id;
+            StageState state = IndexScan::work(&id);
+            if (PlanStage::ADVANCED == state) {
+                out->push_back(id);
+            }
+            else if (PlanStage::NEED_TIME != state) {
+                return state;
+            }
+        }
+        return PlanStage::NEED_TIME;
+    }
+
     bool IndexScan::isEOF() {
         if (NULL == _indexCursor.get()) {
             // Have to call work() at least once.
@@ -77,6 +77,8 @@ namespace mongo {
         virtual ~IndexScan() { }
 
         virtual StageState work(WorkingSetID* out);
+        virtual StageState workBatch(size_t maxWorks, std::vector<WorkingSetID>* out,
+                                     WorkingSetID* fetchOut);
         virtual bool isEOF();
         virtual void prepareToYield();
         virtual void recoverFromYield();
@@ -28,6 +28,8 @@
 
 #include "mongo/db/exec/limit.h"
 
+#include <algorithm>
+
 namespace mongo {
 
     LimitStage::LimitStage(int limit, WorkingSet* ws, PlanStage* child)
@@ -64,6 +66,33 @@ namespace mongo {
         }
     }
 
+    PlanStage::StageState LimitStage::workBatch(size_t maxWorks, vector<WorkingSetID>* out,
+                                                WorkingSetID* fetchOut) {
+        if (isEOF()) {
+            ++_commonStats.works;
+            return PlanStage::IS_EOF;
+        }
+
+        // Our child can't produce more results than it does units of work, so if we never ask it
+        // for more work than we have results left to return, we never have to drop any.
+        size_t first = out->size();
+        StageState status = _child->workBatch(std::min(maxWorks,
+                                                       static_cast<size_t>(_numToReturn)),
+                                              out, fetchOut);
+        size_t produced = out->size() - first;
+
+        _numToReturn -= produced;
+        _commonStats.works += produced + 1;
+        _commonStats.advanced += produced;
+        if (PlanStage::NEED_FETCH == status) {
+            ++_commonStats.needFetch;
+        }
+        else if (PlanStage::NEED_TIME == status) {
+            ++_commonStats.needTime;
+        }
+        return status;
+    }
+
     void LimitStage::prepareToYield() {
         ++_commonStats.yields;
         _child->prepareToYield();
@@ -48,6 +48,8 @@ namespace mongo {
 
         virtual bool isEOF();
         virtual StageState work(WorkingSetID* out);
+        virtual StageState workBatch(size_t maxWorks, std::vector<WorkingSetID>* out,
+                                     WorkingSetID* fetchOut);
 
         virtual void prepareToYield();
         virtual void recoverFromYield();
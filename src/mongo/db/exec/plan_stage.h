@@ -28,6 +28,8 @@
 
 #pragma once
 
+#include <vector>
+
 #include "mongo/db/exec/plan_stats.h"
 #include "mongo/db/exec/working_set.h"
 
@@ -167,6 +169,44 @@ namespace mongo {
          */
         virtual StageState work(WorkingSetID* out) = 0;
 
+        /**
+         * Perform up to 'maxWorks' units of work on the query in one call.  Every result produced
+         * is appended to 'out', in order.  The caller owns the results exactly as if they had been
+         * returned one at a time by work(...).
+         *
+         * The batch ends early if a unit of work returns anything other than ADVANCED or
+         * NEED_TIME.  Returns:
+         *   NEED_TIME if all 'maxWorks' units of work were performed.
+         *   IS_EOF, DEAD or FAILURE if that was the state that ended the batch.
+         *   NEED_FETCH if that was the state that ended the batch.  *fetchOut is set to the
+         *   WSID to fetch, with the same semantics as work(...).
+         * Never returns ADVANCED.  Results in 'out' are valid whatever the return value.
+         *
+         * Stages are only yielded and invalidated between batches.  Results handed out in a
+         * batch and not yet consumed are the caller's to invalidate.
+         *
+         * The default implementation calls work(...) in a loop.  Stages that can move a block of
+         * results through more cheaply than one virtual call per result override it.
+         */
+        virtual StageState workBatch(size_t maxWorks, std::vector<WorkingSetID>* out,
+                                     WorkingSetID* fetchOut) {
+            for (size_t i = 0; i < maxWorks; ++i) {
+                WorkingSetID id;
+                StageState state = work(&id);
+                if (ADVANCED == state) {
+                    out->push_back(id);
+                }
+                else if (NEED_FETCH == state) {
+                    *fetchOut = id;
+                    return state;
+                }
+                else if (NEED_TIME != state) {
+                    return state;
+                }
+            }
+            return NEED_TIME;
+        }
+
         /**
          * Returns true if no more work can be done on the query / out of results.
          */
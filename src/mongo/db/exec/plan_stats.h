@@ -237,12 +237,16 @@ namespace mongo {
     };
 
     struct SortStats : public SpecificStats {
-        SortStats() : forcedFetches(0) { }
+        SortStats() : forcedFetches(0), spills(0) { }
 
         virtual ~SortStats() { }
 
         // How many records were we forced to fetch as the result of an invalidation?
         uint64_t forcedFetches;
+
+        // How many times did we run out of memory and hand the buffered results to the external
+        // sorter?  Currently 0 or 1.
+        uint64_t spills;
     };
 
     struct MergeSortStats : public SpecificStats {
@@ -265,4 +269,16 @@ namespace mongo {
         uint64_t chunkSkips;
     };
 
+    struct TextStats : public SpecificStats {
+        TextStats() : keysExamined(0), fetches(0) { }
+
+        virtual ~TextStats() { }
+
+        // Index keys read, over all the query's terms.
+        uint64_t keysExamined;
+
+        // Documents read to filter or rescore them.  Returning a result isn't counted.
+        uint64_t fetches;
+    };
+
 }  // namespace mongo
@@ -54,79 +54,86 @@ namespace mongo {
 
     bool ProjectionStage::isEOF() { return _child->isEOF(); }
 
-    PlanStage::StageState ProjectionStage::work(WorkingSetID* out) {
-        ++_commonStats.works;
-
-        if (isEOF()) { return PlanStage::IS_EOF; }
-        WorkingSetID id;
-        StageState status = _child->work(&id);
-
-        if (PlanStage::ADVANCED == status) {
-            WorkingSetMember* member = _ws->get(id);
+    Status ProjectionStage::transform(WorkingSetMember* member) {
+        BSONObj newObj;
+        if (_covered) {
+            // TODO: Rip execution out of the lite_projection and pass a WSM to something
+            // which does the right thing depending on the covered vs. noncovered cases.
+            BSONObjBuilder bob;
+            if (_proj->_includeID) {
+                BSONElement elt;
+                member->getFieldDotted("_id", &elt);
+                verify(!elt.eoo());
+                bob.appendAs(elt, "_id");
+            }
 
-            BSONObj newObj;
-            if (_covered) {
-                // TODO: Rip execution out of the lite_projection and pass a WSM to something
-                // which does the right thing depending on the covered vs. noncovered cases.
-                BSONObjBuilder bob;
-                if (_proj->_includeID) {
-                    BSONElement elt;
-                    member->getFieldDotted("_id", &elt);
-                    verify(!elt.eoo());
-                    bob.appendAs(elt, "_id");
+            BSONObjIterator it(_proj->_source);
+            while (it.more()) {
+                BSONElement specElt = it.next();
+                if (mongoutils::str::equals("_id", specElt.fieldName())) {
+                    continue;
                 }
 
-                BSONObjIterator it(_proj->_source);
-                while (it.more()) {
-                    BSONElement specElt = it.next();
-                    if (mongoutils::str::equals("_id", specElt.fieldName())) {
-                        continue;
-                    }
-
-                    BSONElement keyElt;
-                    // We can project a field that doesn't exist.  We just ignore it.
-                    if (member->getFieldDotted(specElt.fieldName(), &keyElt) && !keyElt.eoo()) {
-                        bob.appendAs(keyElt, specElt.fieldName());
-                    }
+                BSONElement keyElt;
+                // We can project a field that doesn't exist.  We just ignore it.
+                if (member->getFieldDotted(specElt.fieldName(), &keyElt) && !keyElt.eoo()) {
+                    bob.appendAs(keyElt, specElt.fieldName());
                 }
-                newObj = bob.obj();
             }
-            else {
-                // Planner should have done this.
-                verify(member->hasObj());
+            newObj = bob.obj();
+        }
+        else {
+            // Planner should have done this.
+            verify(member->hasObj());
 
-                MatchDetails matchDetails;
+            MatchDetails matchDetails;
 
-                // If it's a positional projection we need a MatchDetails.
-                if (_proj->transformRequiresDetails()) {
-                    matchDetails.requestElemMatchKey();
-                    verify(_fullExpression->matchesBSON(member->obj, &matchDetails));
-                }
+            // If it's a positional projection we need a MatchDetails.
+            if (_proj->transformRequiresDetails()) {
+                matchDetails.requestElemMatchKey();
+                verify(_fullExpression->matchesBSON(member->obj, &matchDetails));
+            }
 
-                BSONObjBuilder bob;
-                Status projStatus = _proj->transform(member->obj, &bob, &matchDetails);
-                if (!projStatus.isOK()) {
-                    warning() << "Couldn't execute projection, status = " << projStatus.toString() << endl;
-                    return PlanStage::FAILURE;
-                }
+            BSONObjBuilder bob;
+            Status projStatus = _proj->transform(member->obj, &bob, &matchDetails);
+            if (!projStatus.isOK()) {
+                return projStatus;
+            }
 
-                StringData textField = _proj->getTextScoreFieldName();
-                if (!textField.empty()) {
-                    // TODO: Do we want to warn() or otherwise error if there's no text stage?
-                    if (member->hasComputed(WSM_COMPUTED_TEXT_SCORE)) {
-                        const TextScoreComputedData* score
-                            = static_cast<const TextScoreComputedData*>(member->getComputed(WSM_COMPUTED_TEXT_SCORE));
-                        bob.append(textField, score->getScore());
-                    }
+            StringData textField = _proj->getTextScoreFieldName();
+            if (!textField.empty()) {
+                // TODO: Do we want to warn() or otherwise error if there's no text stage?
+                if (member->hasComputed(WSM_COMPUTED_TEXT_SCORE)) {
+                    const TextScoreComputedData* score
+                        = static_cast<const TextScoreComputedData*>(member->getComputed(WSM_COMPUTED_TEXT_SCORE));
+                    bob.append(textField, score->getScore());
                 }
-
-                newObj = bob.obj();
             }
 
-            member->state = WorkingSetMember::OWNED_OBJ;
-            member->obj = newObj;
-            member->keyData.clear();
-            member->loc = DiskLoc();
+            newObj = bob.obj();
+        }
+
+        member->state = WorkingSetMember::OWNED_OBJ;
+        member->obj = newObj;
+        member->keyData.clear();
+        member->loc = DiskLoc();
+        return Status::OK();
+    }
+
+    PlanStage::StageState ProjectionStage::work(WorkingSetID* out) {
+        ++_commonStats.works;
+
+        if (isEOF()) { return PlanStage::IS_EOF; }
+        WorkingSetID id;
+        StageState status = _child->work(&id);
+
+        if (PlanStage::ADVANCED == status) {
+            WorkingSetMember* member = _ws->get(id);
+            Status projStatus = transform(member);
+            if (!projStatus.isOK()) {
+                warning() << "Couldn't execute projection, status = " << projStatus.toString() << endl;
+                return PlanStage::FAILURE;
+            }
 
             *out = id;
             ++_commonStats.advanced;
@@ -139,6 +146,39 @@ namespace mongo {
         return status;
     }
 
+    PlanStage::StageState ProjectionStage::workBatch(size_t maxWorks,
+                                                     vector<WorkingSetID>* out,
+                                                     WorkingSetID* fetchOut) {
+        if (isEOF()) {
+            ++_commonStats.works;
+            return PlanStage::IS_EOF;
+        }
+
+        size_t first = out->size();
+        StageState status = _child->workBatch(maxWorks, out, fetchOut);
+        _commonStats.works += out->size() - first + 1;
+
+        for (size_t i = first; i < out->size(); ++i) {
+            Status projStatus = transform(_ws->get((*out)[i]));
+            if (!projStatus.isOK()) {
+                warning() << "Couldn't execute projection, status = " << projStatus.toString() << endl;
+                // Only the results we've already projected are handed out.
+                for (size_t j = i; j < out->size(); ++j) {
+                    _ws->free((*out)[j]);
+                }
+                out->resize(i);
+                return PlanStage::FAILURE;
+            }
+            ++_commonStats.advanced;
+        }
+
+        if (PlanStage::NEED_FETCH == status) {
+            ++_commonStats.needFetch;
+        }
+
+        return status;
+    }
+
     void ProjectionStage::prepareToYield() {
         ++_commonStats.yields;
         _child->prepareToYield();
@@ -52,6 +52,8 @@ namespace mongo {
 
         virtual bool isEOF();
         virtual StageState work(WorkingSetID* out);
+        virtual StageState workBatch(size_t maxWorks, std::vector<WorkingSetID>* out,
+                                     WorkingSetID* fetchOut);
 
         virtual void prepareToYield();
         virtual void recoverFromYield();
@@ -60,6 +62,11 @@ namespace mongo {
         PlanStageStats* getStats();
 
     private:
+        /**
+         * Replace the data in 'member' with its projection.
+         */
+        Status transform(WorkingSetMember* member);
+
         // Not owned by us.
         LiteProjection* _proj;
         bool _covered;
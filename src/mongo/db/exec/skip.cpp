@@ -28,6 +28,8 @@
 
 #include "mongo/db/exec/skip.h"
 
+#include <algorithm>
+
 namespace mongo {
 
     SkipStage::SkipStage(int toSkip, WorkingSet* ws, PlanStage* child)
@@ -72,6 +74,39 @@ namespace mongo {
         }
     }
 
+    PlanStage::StageState SkipStage::workBatch(size_t maxWorks, vector<WorkingSetID>* out,
+                                               WorkingSetID* fetchOut) {
+        if (isEOF()) {
+            ++_commonStats.works;
+            return PlanStage::IS_EOF;
+        }
+
+        size_t first = out->size();
+        StageState status = _child->workBatch(maxWorks, out, fetchOut);
+        size_t produced = out->size() - first;
+        _commonStats.works += produced + 1;
+
+        // Drop results from the front of the batch while we're still skipping.
+        size_t toDrop = std::min(produced, static_cast<size_t>(_toSkip));
+        if (toDrop > 0) {
+            for (size_t i = first; i < first + toDrop; ++i) {
+                _ws->free((*out)[i]);
+            }
+            out->erase(out->begin() + first, out->begin() + first + toDrop);
+            _toSkip -= toDrop;
+            _commonStats.needTime += toDrop;
+        }
+
+        _commonStats.advanced += produced - toDrop;
+        if (PlanStage::NEED_FETCH == status) {
+            ++_commonStats.needFetch;
+        }
+        else if (PlanStage::NEED_TIME == status) {
+            ++_commonStats.needTime;
+        }
+        return status;
+    }
+
     void SkipStage::prepareToYield() {
         ++_commonStats.yields;
         _child->prepareToYield();
@@ -32,10 +32,13 @@
 
 #include "mongo/db/exec/working_set_common.h"
 #include "mongo/db/index/btree_key_generator.h"
+#include "mongo/db/server_parameters.h"
+#include "mongo/db/storage_options.h"
 
 namespace mongo {
 
-    const size_t kMaxBytes = 32 * 1024 * 1024;
+    // How much result data a single sort may buffer in memory before it spills to disk.
+    MONGO_EXPORT_SERVER_PARAMETER(internalQueryExecMaxBlockingSortBytes, int, 32 * 1024 * 1024);
 
     namespace {
         void dumpKeys(const BSONObjSet& keys) {
@@ -59,12 +62,71 @@ namespace mongo {
         BSONObj pattern;
     };
 
+    struct SortStage::SpilledResult {
+        SpilledResult() : spillNumber(0) { }
+
+        // Null if the result had no DiskLoc.
+        DiskLoc loc;
+
+        // The value of SortStage::_numSpilled when this result was spilled.
+        long long spillNumber;
+
+        BSONObj obj;
+
+        // Members for Sorter.
+        struct SorterDeserializeSettings {};
+
+        void serializeForSorter(BufBuilder& buf) const {
+            loc.serializeForSorter(buf);
+            buf.appendNum(spillNumber);
+            obj.serializeForSorter(buf);
+        }
+
+        static SpilledResult deserializeForSorter(BufReader& buf,
+                                                  const SorterDeserializeSettings&) {
+            SpilledResult result;
+            result.loc = DiskLoc::deserializeForSorter(buf, DiskLoc::SorterDeserializeSettings());
+            result.spillNumber = buf.read<long long>();
+            result.obj = BSONObj::deserializeForSorter(buf, BSONObj::SorterDeserializeSettings());
+            return result;
+        }
+
+        int memUsageForSorter() const {
+            return sizeof(SpilledResult) + obj.objsize();
+        }
+
+        SpilledResult getOwned() const {
+            SpilledResult result(*this);
+            result.obj = obj.getOwned();
+            return result;
+        }
+    };
+
+    // Orders spilled results the same way WorkingSetComparator orders buffered ones.
+    struct SortStage::SpilledResultComparator {
+        typedef std::pair<BSONObj, SpilledResult> Data;
+
+        explicit SpilledResultComparator(const BSONObj& p) : pattern(p) { }
+
+        int operator()(const Data& lhs, const Data& rhs) const {
+            int result = lhs.first.woCompare(rhs.first, pattern, false /* ignore field names */);
+            if (0 != result) {
+                return result;
+            }
+            return lhs.second.loc.compare(rhs.second.loc);
+        }
+
+        BSONObj pattern;
+    };
+
     SortStage::SortStage(const SortStageParams& params, WorkingSet* ws, PlanStage* child)
         : _ws(ws),
           _child(child),
           _pattern(params.pattern),
+          _limit(params.limit),
           _sorted(false),
           _resultIterator(_data.end()),
+          _numSpilled(0),
           _bounds(params.bounds),
           _hasBounds(params.hasBounds),
           _memUsage(0) {
@@ -94,16 +156,18 @@ namespace mongo {
     bool SortStage::isEOF() {
         // We're done when our child has no more results, we've sorted the child's results, and
         // we've returned all sorted results.
-        return _child->isEOF() && _sorted && (_data.end() == _resultIterator);
+        if (!_child->isEOF() || !_sorted) {
+            return false;
+        }
+        if (NULL != _sortedIter.get()) {
+            return !_sortedIter->more();
+        }
+        return _data.end() == _resultIterator;
     }
 
     PlanStage::StageState SortStage::work(WorkingSetID* out) {
         ++_commonStats.works;
 
-        if (_memUsage > kMaxBytes) {
-            return PlanStage::FAILURE;
-        }
-
         if (isEOF()) { return PlanStage::IS_EOF; }
 
         // Still reading in results to sort.
@@ -112,82 +176,21 @@ namespace mongo {
             StageState code = _child->work(&id);
 
             if (PlanStage::ADVANCED == code) {
-                // Add it into the map for quick invalidation if it has a valid DiskLoc.
-                // A DiskLoc may be invalidated at any time (during a yield).  We need to get into
-                // the WorkingSet as quickly as possible to handle it.
-                WorkingSetMember* member = _ws->get(id);
-                if (member->hasLoc()) {
-                    _wsidByDiskLoc[member->loc] = id;
-                }
-
-                // Do some accounting to make sure we're not using too much memory.
-                if (member->hasLoc()) {
-                    _memUsage += sizeof(DiskLoc);
-                }
-
-                // We are not supposed (yet) to sort over anything other than objects.  In other
-                // words, the query planner wouldn't put a sort atop anything that wouldn't have a
-                // collection scan as a leaf.
-                verify(member->hasObj());
-                _memUsage += member->obj.objsize();
-
-                // We will sort '_data' in the same order an index over '_pattern' would
-                // have. This has very nuanced implications. Consider the sort pattern {a:1}
-                // and the document {a:[1,10]}. We have potentially two keys we could use to
-                // sort on. Here we extract these keys. In the next step we decide which one to
-                // use.
-                BSONObjCmp patternCmp(_pattern);
-                BSONObjSet keys(patternCmp);
-                // XXX keyGen will throw on a "parallel array"
-                _keyGen->getKeys(member->obj, &keys);
-                // dumpKeys(keys);
-
-                // To decide which key to use in sorting, we consider not only the sort pattern
-                // but also if a given key, matches the query. Assume a query {a: {$gte: 5}} and
-                // a document {a:1}. That document wouldn't match. In the same sense, the key '1'
-                // in an array {a: [1,10]} should not be considered as being part of the result
-                // set and thus that array should sort based on the '10' key. To find such key,
-                // we use the bounds for the query.
-                BSONObj sortKey;
-                for (BSONObjSet::const_iterator it = keys.begin(); it != keys.end(); ++it) {
-                    if (!_hasBounds) {
-                        sortKey = *it;
-                        break;
-                    }
-
-                    if (_boundsChecker->isValidKey(*it)) {
-                        sortKey = *it;
-                        break;
-                    }
-                }
-
-                if (sortKey.isEmpty()) {
-                    // We assume that if the document made it throught the sort stage, than it
-                    // matches the query and thus should contain at least on array item that
-                    // is within the query bounds.
-                    cout << "can't find bounds for obj " << member->obj.toString() << endl;
-                    cout << "bounds are " << _bounds.toString() << endl;
-                    verify(0);
-                }
-
-                // We let the data stay in the WorkingSet and sort using the selected portion
-                // of the object in that working set member.
-                SortableDataItem item;
-                item.wsid = id;
-                item.sortKey = sortKey;
-                if (member->hasLoc()) {
-                    item.loc = member->loc;
-                }
-                _data.push_back(item);
-
+                addToBuffer(id);
                 ++_commonStats.needTime;
                 return PlanStage::NEED_TIME;
             }
             else if (PlanStage::IS_EOF == code) {
                 // TODO: We don't need the lock for this.  We could ask for a yield and do this work
                 // unlocked.  Also, this is performing a lot of work for one call to work(...)
-                std::sort(_data.begin(), _data.end(), *_cmp);
-                _resultIterator = _data.begin();
+                if (NULL != _sorter.get()) {
+                    _sortedIter.reset(_sorter->done());
+                    _sorter.reset();
+                }
+                else {
+                    std::sort(_data.begin(), _data.end(), *_cmp);
+                    _resultIterator = _data.begin();
+                }
                 _sorted = true;
                 ++_commonStats.needTime;
                 return PlanStage::NEED_TIME;
@@ -204,6 +207,10 @@ namespace mongo {
             }
         }
 
+        if (NULL != _sortedIter.get()) {
+            return workSpilled(out);
+        }
+
         // Returning results.
         verify(_resultIterator != _data.end());
         verify(_sorted);
@@ -228,6 +235,183 @@ namespace mongo {
         return PlanStage::ADVANCED;
     }
 
+    void SortStage::addToBuffer(WorkingSetID id) {
+        // Add it into the map for quick invalidation if it has a valid DiskLoc.
+        // A DiskLoc may be invalidated at any time (during a yield).  We need to get into
+        // the WorkingSet as quickly as possible to handle it.
+        WorkingSetMember* member = _ws->get(id);
+        if (member->hasLoc()) {
+            _wsidByDiskLoc[member->loc] = id;
+        }
+
+        // We are not supposed (yet) to sort over anything other than objects.  In other
+        // words, the query planner wouldn't put a sort atop anything that wouldn't have a
+        // collection scan as a leaf.
+        verify(member->hasObj());
+
+        // We will sort '_data' in the same order an index over '_pattern' would
+        // have. This has very nuanced implications. Consider the sort pattern {a:1}
+        // and the document {a:[1,10]}. We have potentially two keys we could use to
+        // sort on. Here we extract these keys. In the next step we decide which one to
+        // use.
+        BSONObjCmp patternCmp(_pattern);
+        BSONObjSet keys(patternCmp);
+        // XXX keyGen will throw on a "parallel array"
+        _keyGen->getKeys(member->obj, &keys);
+        // dumpKeys(keys);
+
+        // To decide which key to use in sorting, we consider not only the sort pattern
+        // but also if a given key, matches the query. Assume a query {a: {$gte: 5}} and
+        // a document {a:1}. That document wouldn't match. In the same sense, the key '1'
+        // in an array {a: [1,10]} should not be considered as being part of the result
+        // set and thus that array should sort based on the '10' key. To find such key,
+        // we use the bounds for the query.
+        BSONObj sortKey;
+        for (BSONObjSet::const_iterator it = keys.begin(); it != keys.end(); ++it) {
+            if (!_hasBounds) {
+                sortKey = *it;
+                break;
+            }
+
+            if (_boundsChecker->isValidKey(*it)) {
+                sortKey = *it;
+                break;
+            }
+        }
+
+        if (sortKey.isEmpty()) {
+            // We assume that if the document made it throught the sort stage, than it
+            // matches the query and thus should contain at least on array item that
+            // is within the query bounds.
+            cout << "can't find bounds for obj " << member->obj.toString() << endl;
+            cout << "bounds are " << _bounds.toString() << endl;
+            verify(0);
+        }
+
+        // Once we've spilled, everything else goes straight to the external sorter.
+        if (NULL != _sorter.get()) {
+            spillMember(id, sortKey);
+            return;
+        }
+
+        // We let the data stay in the WorkingSet and sort using the selected portion
+        // of the object in that working set member.
+        SortableDataItem item;
+        item.wsid = id;
+        item.sortKey = sortKey;
+        if (member->hasLoc()) {
+            item.loc = member->loc;
+        }
+
+        // Do some accounting to make sure we're not using too much memory.
+        _memUsage += member->obj.objsize();
+        if (member->hasLoc()) {
+            _memUsage += sizeof(DiskLoc);
+        }
+
+        if (0 == _limit) {
+            _data.push_back(item);
+        }
+        else if (_data.size() < _limit) {
+            _data.push_back(item);
+            std::push_heap(_data.begin(), _data.end(), *_cmp);
+        }
+        else {
+            // _data is a max-heap of the best '_limit' results.  Keep whichever of the worst of
+            // those and the new result sorts first.
+            SortableDataItem* evict = &item;
+            if ((*_cmp)(item, _data.front())) {
+                std::pop_heap(_data.begin(), _data.end(), *_cmp);
+                std::swap(item, _data.back());
+                std::push_heap(_data.begin(), _data.end(), *_cmp);
+            }
+            freeBuffered(evict->wsid);
+        }
+
+        if (_memUsage > static_cast<size_t>(internalQueryExecMaxBlockingSortBytes)) {
+            spillBuffer();
+        }
+    }
+
+    void SortStage::freeBuffered(WorkingSetID id) {
+        WorkingSetMember* member = _ws->get(id);
+        if (member->hasLoc()) {
+            _wsidByDiskLoc.erase(member->loc);
+            _memUsage -= sizeof(DiskLoc);
+        }
+        _memUsage -= member->obj.objsize();
+        _ws->free(id);
+    }
+
+    void SortStage::spillBuffer() {
+        verify(NULL == _sorter.get());
+
+        SortOptions opts;
+        opts.Limit(_limit)
+            .MaxMemoryUsageBytes(internalQueryExecMaxBlockingSortBytes)
+            .ExtSortAllowed()
+            .TempDir(storageGlobalParams.dbpath + "/_tmp");
+        _sorter.reset(SpillSorter::make(opts, SpilledResultComparator(_pattern)));
+        ++_specificStats.spills;
+
+        for (size_t i = 0; i < _data.size(); ++i) {
+            // Flagged results would be dropped when returned anyway.
+            if (_ws->isFlagged(_data[i].wsid)) {
+                _ws->free(_data[i].wsid);
+                continue;
+            }
+            spillMember(_data[i].wsid, _data[i].sortKey);
+        }
+
+        _data.clear();
+        _resultIterator = _data.end();
+        _wsidByDiskLoc.clear();
+        _memUsage = 0;
+    }
+
+    void SortStage::spillMember(WorkingSetID id, const BSONObj& sortKey) {
+        WorkingSetMember* member = _ws->get(id);
+
+        SpilledResult result;
+        if (member->hasLoc()) {
+            result.loc = member->loc;
+            _wsidByDiskLoc.erase(member->loc);
+        }
+        result.spillNumber = _numSpilled++;
+        result.obj = member->obj.getOwned();
+        _sorter->add(sortKey.getOwned(), result);
+
+        _ws->free(id);
+    }
+
+    PlanStage::StageState SortStage::workSpilled(WorkingSetID* out) {
+        SpillSorter::Data next = _sortedIter->next();
+        const SpilledResult& result = next.second;
+
+        // Drop results whose DiskLoc was invalidated after they were spilled, as we would have
+        // dropped them had they still been buffered.
+        if (!result.loc.isNull()) {
+            InvalidationMap::const_iterator it = _invalidatedSinceSpill.find(result.loc);
+            if (_invalidatedSinceSpill.end() != it && it->second > result.spillNumber) {
+                return PlanStage::NEED_TIME;
+            }
+        }
+
+        *out = _ws->allocate();
+        WorkingSetMember* member = _ws->get(*out);
+        member->obj = result.obj.getOwned();
+        if (result.loc.isNull()) {
+            member->state = WorkingSetMember::OWNED_OBJ;
+        }
+        else {
+            member->loc = result.loc;
+            member->state = WorkingSetMember::LOC_AND_UNOWNED_OBJ;
+        }
+
+        ++_commonStats.advanced;
+        return PlanStage::ADVANCED;
+    }
+
     void SortStage::prepareToYield() {
         ++_commonStats.yields;
         _child->prepareToYield();
@@ -261,6 +445,10 @@ namespace mongo {
             _wsidByDiskLoc.erase(it);
             ++_specificStats.forcedFetches;
         }
+
+        if (_numSpilled > 0) {
+            _invalidatedSinceSpill[dl] = _numSpilled;
+        }
     }
 
     PlanStageStats* SortStage::getStats() {
@@ -273,3 +461,8 @@ namespace mongo {
     }
 
 }  // namespace mongo
+
+#include "mongo/db/sorter/sorter.cpp"
+MONGO_CREATE_SORTER(mongo::BSONObj,
+                    mongo::SortStage::SpilledResult,
+                    mongo::SortStage::SpilledResultComparator);
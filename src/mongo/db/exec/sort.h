@@ -37,6 +37,7 @@
 #include "mongo/db/exec/plan_stage.h"
 #include "mongo/db/exec/working_set.h"
 #include "mongo/db/query/index_bounds.h"
+#include "mongo/db/sorter/sorter.h"
 #include "mongo/platform/unordered_map.h"
 
 namespace mongo {
@@ -51,6 +52,12 @@ namespace mongo {
      *
      * Preconditions: For each field in 'pattern', all inputs in the child must handle a
      * getFieldDotted for that field.
+     *
+     * Results are buffered in the WorkingSet until they use more than the blocking sort memory
+     * budget.  At that point everything buffered is copied into an external Sorter, which spills
+     * sorted runs to disk and merges them when the child is exhausted.  If a limit was pushed
+     * down, only the best 'limit' results are kept in memory and the external sorter used after a
+     * spill is a top-k one.
      */
     class SortStage : public PlanStage {
     public:
@@ -68,6 +75,30 @@ namespace mongo {
         PlanStageStats* getStats();
 
     private:
+        /**
+         * Computes the sort key of the child result 'id' and buffers it, spilling if we're over
+         * the memory budget.
+         */
+        void addToBuffer(WorkingSetID id);
+
+        /**
+         * Moves every buffered result into _sorter, creating it.
+         */
+        void spillBuffer();
+
+        /**
+         * Copies the result 'id' into _sorter and frees it from the WorkingSet.
+         */
+        void spillMember(WorkingSetID id, const BSONObj& sortKey);
+
+        /**
+         * Frees a buffered result, along with any bookkeeping we hold for it.
+         */
+        void freeBuffered(WorkingSetID id);
+
+        // Returns the next sorted result from the external sorter via 'out'.
+        StageState workSpilled(WorkingSetID* out);
+
         // Not owned by us.
         WorkingSet* _ws;
 
@@ -77,6 +108,9 @@ namespace mongo {
         // Our sort pattern.
         BSONObj _pattern;
 
+        // Equal to 0 for no limit.
+        size_t _limit;
+
         // Have we sorted our data? If so, we can access _resultIterator. If not,
         // we're still populating _data.
         bool _sorted;
@@ -107,6 +141,28 @@ namespace mongo {
         struct WorkingSetComparator;
         boost::scoped_ptr<WorkingSetComparator> _cmp;
 
+        //
+        // External sort.  Only used once the buffered results outgrow the memory budget.
+        //
+
+        // A copy of a result handed to the external sorter.  Defined in sort.cpp.
+        struct SpilledResult;
+        struct SpilledResultComparator;
+        typedef Sorter<BSONObj, SpilledResult> SpillSorter;
+
+        boost::scoped_ptr<SpillSorter> _sorter;
+        boost::scoped_ptr<SortIteratorInterface<BSONObj, SpilledResult> > _sortedIter;
+
+        // Number of results given to _sorter.  Each spilled result remembers the count at the time
+        // it was added.
+        long long _numSpilled;
+
+        // A spilled result can't be invalidated in place.  Instead we remember the value of
+        // _numSpilled when its DiskLoc was invalidated, and drop the result on the way out if it
+        // was spilled before then.
+        typedef unordered_map<DiskLoc, long long, DiskLoc::Hasher> InvalidationMap;
+        InvalidationMap _invalidatedSinceSpill;
+
         // Bounds we should consider before sorting.
         IndexBounds _bounds;
 
@@ -134,7 +190,7 @@ namespace mongo {
     // Parameters that must be provided to a SortStage
     class SortStageParams {
     public:
-        SortStageParams() : hasBounds(false) { }
+        SortStageParams() : hasBounds(false), limit(0) { }
 
         // How we're sorting.
         BSONObj pattern;
@@ -143,9 +199,8 @@ namespace mongo {
 
         bool hasBounds;
 
-        // TODO: Implement this.
         // Must be >= 0.  Equal to 0 for no limit.
-        // int limit;
+        size_t limit;
     };
 
 }  // namespace mongo
@@ -27,18 +27,31 @@
  */
 
 #include "mongo/db/exec/text.h"
+
+#include <algorithm>
+#include <functional>
+
 #include "mongo/db/exec/filter.h"
 #include "mongo/db/exec/working_set.h"
 #include "mongo/db/exec/working_set_computed_data.h"
 #include "mongo/db/jsobj.h"
 #include "mongo/db/query/internal_plans.h"
+#include "mongo/db/server_parameters.h"
 
 namespace mongo {
 
+    // Whether text stages stop reading keys once their best 'limit' results are known.
+    MONGO_EXPORT_SERVER_PARAMETER(internalQueryTextTopK, bool, true);
+
+    namespace {
+        // Fewest keys read between two checks for whether the top results are known.
+        const size_t MinKeysBetweenChecks = 128;
+    }
+
     TextStage::TextStage(const TextStageParams& params, WorkingSet* ws,
                          const MatchExpression* filter)
         : _params(params), _ftsMatcher(params.query, params.spec), _ws(ws), _filter(filter),
-          _filledOutResults(false), _curResult(0) { }
+          _filledOutResults(false), _topK(false), _curResult(0) { }
 
     TextStage::~TextStage() {
     }
@@ -105,7 +118,9 @@ namespace mongo {
 
     PlanStageStats* TextStage::getStats() {
         _commonStats.isEOF = isEOF();
-        return new PlanStageStats(_commonStats, STAGE_TEXT);
+        auto_ptr<PlanStageStats> ret(new PlanStageStats(_commonStats, STAGE_TEXT));
+        ret->specific.reset(new TextStats(_specificStats));
+        return ret.release();
     }
 
     PlanStage::StageState TextStage::fillOutResults() {
@@ -139,24 +154,49 @@ namespace mongo {
             scanners.push_back(ixscan);
         }
 
-        // For each index scan, read all results and store scores.
+        _topK = internalQueryTextTopK && _params.limit > 0 && scanners.size() <= MaxTopKTerms;
+        _termBounds.assign(scanners.size(), MAX_WEIGHT);
+
+        // Read the index scans and store scores.  When reading the top 'limit', take a key from
+        // each scan in turn so that every term's bound comes down together, and stop once the
+        // top results are known; otherwise read each scan to the end before the next.
         size_t currentIndexScanner = 0;
-        while (currentIndexScanner < scanners.size()) {
-            BSONObj keyObj;
-            DiskLoc loc;
+        size_t scannersAtEOF = 0;
+        vector<bool> atEOF(scanners.size(), false);
+        size_t keysSinceCheck = 0;
+        while (scannersAtEOF < scanners.size()) {
+            if (atEOF[currentIndexScanner]) {
+                currentIndexScanner = (currentIndexScanner + 1) % scanners.size();
+                continue;
+            }
 
             WorkingSetID id;
             PlanStage::StageState state = scanners[currentIndexScanner]->work(&id);
 
             if (PlanStage::ADVANCED == state) {
+                ++_specificStats.keysExamined;
                 WorkingSetMember* wsm = _ws->get(id);
                 IndexKeyDatum& keyDatum = wsm->keyData.back();
-                filterAndScore(keyDatum.keyData, wsm->loc);
+                filterAndScore(currentIndexScanner, keyDatum.keyData, wsm->loc);
                 _ws->free(id);
+
+                if (_topK) {
+                    currentIndexScanner = (currentIndexScanner + 1) % scanners.size();
+
+                    // Each check looks at every document seen, so check less often as there
+                    // are more of them.
+                    if (++keysSinceCheck >= std::max(MinKeysBetweenChecks, _scores.size())) {
+                        keysSinceCheck = 0;
+                        if (haveTopResults()) { break; }
+                    }
+                }
             }
             else if (PlanStage::IS_EOF == state) {
                 // Done with this scan.
-                ++currentIndexScanner;
+                atEOF[currentIndexScanner] = true;
+                ++scannersAtEOF;
+                _termBounds[currentIndexScanner] = 0;
+                currentIndexScanner = (currentIndexScanner + 1) % scanners.size();
             }
             else if (PlanStage::NEED_FETCH == state) {
                 // We're calling work() on ixscans and they have no way to return a fetch.
@@ -178,15 +218,16 @@ namespace mongo {
         // Filter for phrases and negative terms, score and truncate.
         for (ScoreMap::iterator i = _scores.begin(); i != _scores.end(); ++i) {
             DiskLoc loc = i->first;
-            double score = i->second;
+            double score = i->second.score;
 
             // Ignore non-matched documents.
             if (score < 0) {
                 continue;
             }
 
-            // Filter for phrases and negated terms
-            if (_params.query.hasNonTermPieces()) {
+            // Filter for phrases and negated terms, unless filterAndScore() already has.
+            if (!_topK && _params.query.hasNonTermPieces()) {
+                ++_specificStats.fetches;
                 Record* rec_p = loc.rec();
                 if (!_ftsMatcher.matchesNonTerm(BSONObj::make(rec_p))) {
                     continue;
@@ -195,6 +236,23 @@ namespace mongo {
             _results.push_back(ScoredLocation(loc, score));
         }
 
+        if (_topK) {
+            if (_results.size() > _params.limit) {
+                std::nth_element(_results.begin(), _results.begin() + _params.limit,
+                                 _results.end());
+                _results.resize(_params.limit);
+            }
+
+            // A document may have keys for some terms that were never read.  Its score for a
+            // single term is the key's.
+            if (_params.query.getTerms().size() > 1) {
+                for (size_t i = 0; i < _results.size(); ++i) {
+                    _results[i].score = scoreFromDocument(_results[i].loc);
+                }
+                _specificStats.fetches += _results.size();
+            }
+        }
+
         // Sort results by score (not always in correct order, especially w.r.t. multiterm).
         sort(_results.begin(), _results.end());
 
@@ -210,7 +268,7 @@ namespace mongo {
         return PlanStage::NEED_TIME;
     }
 
-    void TextStage::filterAndScore(BSONObj key, DiskLoc loc) {
+    void TextStage::filterAndScore(size_t term, BSONObj key, DiskLoc loc) {
         // Locate score within possibly compound key: {prefix,term,score,suffix}.
         BSONObjIterator keyIt(key);
         for (unsigned i = 0; i < _params.spec.numExtraBefore(); i++) {
@@ -221,20 +279,32 @@ namespace mongo {
 
         BSONElement scoreElement = keyIt.next();
         double documentTermScore = scoreElement.number();
-        double& documentAggregateScore = _scores[loc];
+
+        // Keys are read in descending score order, so none left for this term scores higher.
+        _termBounds[term] = documentTermScore;
+
+        TextRecordData& data = _scores[loc];
+        double& documentAggregateScore = data.score;
         
         // Handle filtering.
         if (documentAggregateScore < 0) {
             // We have already rejected this document.
             return;
         }
-        if (documentAggregateScore == 0 && _filter) {
-            // We have not seen this document before and need to apply a filter.
+        if (documentAggregateScore == 0
+            && (_filter || (_topK && _params.query.hasNonTermPieces()))) {
+            // We have not seen this document before and need to apply a filter.  A document
+            // that can't be returned mustn't hold a place in the top results.
+            ++_specificStats.fetches;
             Record* rec_p = loc.rec();
             BSONObj doc = BSONObj::make(rec_p);
 
             // TODO: Covered index matching logic here.
-            if (!_filter->matchesBSON(doc)) {
+            if (_filter && !_filter->matchesBSON(doc)) {
+                documentAggregateScore = -1;
+                return;
+            }
+            if (_topK && _params.query.hasNonTermPieces() && !_ftsMatcher.matchesNonTerm(doc)) {
                 documentAggregateScore = -1;
                 return;
             }
@@ -242,6 +312,81 @@ namespace mongo {
 
         // Aggregate relevance score, term keys.
         documentAggregateScore += documentTermScore;
+        data.termsSeen |= 1U << term;
+    }
+
+    bool TextStage::haveTopResults() const {
+        // The most a document not seen yet can score.
+        double unseenBound = 0;
+        for (size_t i = 0; i < _termBounds.size(); ++i) {
+            unseenBound += _termBounds[i];
+        }
+
+        vector<double> scores;
+        scores.reserve(_scores.size());
+        for (ScoreMap::const_iterator i = _scores.begin(); i != _scores.end(); ++i) {
+            if (i->second.score >= 0) {
+                scores.push_back(i->second.score);
+            }
+        }
+        if (scores.size() < _params.limit) {
+            return false;
+        }
+
+        // The 'limit'-th best score so far; no document's score goes down as more is read.
+        std::nth_element(scores.begin(), scores.begin() + (_params.limit - 1), scores.end(),
+                         std::greater<double>());
+        const double threshold = scores[_params.limit - 1];
+
+        // Ties are broken by DiskLoc, so a document that could only equal the threshold may
+        // still need to be found.
+        if (unseenBound >= threshold) {
+            return false;
+        }
+
+        // Only documents that can reach the threshold with the terms not yet read for them can
+        // be in the top results.  These are known if there are no more than 'limit' of them,
+        // or if all of their scores are final, as ties among them are broken by DiskLoc.
+        size_t canReach = 0;
+        bool anyIncomplete = false;
+        for (ScoreMap::const_iterator i = _scores.begin(); i != _scores.end(); ++i) {
+            const TextRecordData& data = i->second;
+            if (data.score < 0) {
+                continue;
+            }
+            double upperBound = data.score;
+            for (size_t term = 0; term < _termBounds.size(); ++term) {
+                if (!(data.termsSeen & (1U << term))) {
+                    upperBound += _termBounds[term];
+                }
+            }
+            if (upperBound < threshold) {
+                continue;
+            }
+            ++canReach;
+            anyIncomplete = anyIncomplete || upperBound > data.score;
+            if (canReach > _params.limit && anyIncomplete) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    double TextStage::scoreFromDocument(const DiskLoc& loc) const {
+        fts::TermFrequencyMap termScores;
+        _params.spec.scoreDocument(loc.obj(), _params.spec.defaultLanguage(), "", false,
+                                   &termScores);
+
+        // Summed in the order the index scans are, as reading every key would.
+        double score = 0;
+        const vector<string>& terms = _params.query.getTerms();
+        for (size_t i = 0; i < terms.size(); ++i) {
+            fts::TermFrequencyMap::const_iterator it = termScores.find(terms[i]);
+            if (it != termScores.end()) {
+                score += it->second;
+            }
+        }
+        return score;
     }
 
 }  // namespace mongo
@@ -30,6 +30,7 @@
 
 #include "mongo/db/diskloc.h"
 #include "mongo/db/exec/plan_stage.h"
+#include "mongo/db/exec/plan_stats.h"
 #include "mongo/db/fts/fts_index_format.h"
 #include "mongo/db/fts/fts_matcher.h"
 #include "mongo/db/fts/fts_query.h"
@@ -77,6 +78,11 @@ namespace mongo {
     /**
      * Implements a blocking stage that returns text search results.
      *
+     * Each term's index keys are read in descending score order.  Reading the terms' scans in
+     * turn, the stage stops as soon as no document it has not credited in full can make the
+     * best 'limit' any more: the score of the last key read from a scan bounds what any key
+     * left in it can add.  Only the documents returned are then rescored from their text.
+     *
      * Prerequisites: None; is a leaf node.
      * Output type: LOC_AND_OBJ_UNOWNED.
      */
@@ -113,13 +119,24 @@ namespace mongo {
             }
         };
 
+        // Past this many terms a document's terms seen don't fit in a TextRecordData, and every
+        // key is read.
+        static const size_t MaxTopKTerms = 32;
+
         // Helper for buffering results array.  Returns NEED_TIME (if any results were produced),
         // IS_EOF, or FAILURE.
         StageState fillOutResults();
 
         // Helper to update _scores with a new-found (term, score) pair for this document.  Also
-        // rejects documents that don't match this stage's filter.
-        void filterAndScore(BSONObj key, DiskLoc loc);
+        // rejects documents that don't match this stage's filter, and, when reading the top
+        // 'limit', its phrases and negated terms.
+        void filterAndScore(size_t term, BSONObj key, DiskLoc loc);
+
+        // True once the best 'limit' documents are known from the keys read so far.
+        bool haveTopResults() const;
+
+        // The score of the document at 'loc', summed over the query's terms as the index has it.
+        double scoreFromDocument(const DiskLoc& loc) const;
 
         // Parameters of this text stage.
         TextStageParams _params;
@@ -135,14 +152,32 @@ namespace mongo {
 
         // Stats.
         CommonStats _commonStats;
+        TextStats _specificStats;
 
         // State bit for work().  True if results have been buffered.
         bool _filledOutResults;
 
+        // True if reading stops once the best 'limit' documents are known, rather than after
+        // every key of every term.
+        bool _topK;
+
+        struct TextRecordData {
+            TextRecordData() : score(0), termsSeen(0) { }
+
+            // Scores of the keys read for this doc, or -1 if it was rejected.
+            double score;
+
+            // Bit i is set once a key of the i-th query term has been read for this doc.
+            unsigned termsSeen;
+        };
+
         // Map: diskloc -> aggregate score for doc.
-        typedef unordered_map<DiskLoc, double, DiskLoc::Hasher> ScoreMap;
+        typedef unordered_map<DiskLoc, TextRecordData, DiskLoc::Hasher> ScoreMap;
         ScoreMap _scores;
 
+        // Per term, the most that any key not yet read for it can add to a doc's score.
+        std::vector<double> _termBounds;
+
         // Score-ordered result set of documents (as DiskLoc's).
         std::vector<ScoredLocation> _results;
 
@@ -37,32 +37,39 @@ namespace mongo {
     WorkingSet::WorkingSet() : _nextId(0) { }
 
     WorkingSet::~WorkingSet() {
-        for (DataMap::const_iterator i = _data.begin(); i != _data.end(); ++i) {
-            delete i->second;
+        for (size_t i = 0; i < _slabs.size(); ++i) {
+            delete[] _slabs[i];
         }
     }
 
     WorkingSetID WorkingSet::allocate() {
-        verify(_data.end() == _data.find(_nextId));
-        _data[_nextId] = new WorkingSetMember();
-        return _nextId++;
-    }
+        WorkingSetID id;
+        if (!_freeList.empty()) {
+            id = _freeList.back();
+            _freeList.pop_back();
+        }
+        else {
+            if (_nextId == static_cast<WorkingSetID>(_slabs.size()) * kSlabSize) {
+                _slabs.push_back(new WorkingSetMember[kSlabSize]);
+            }
+            id = _nextId++;
+        }
 
-    WorkingSetMember* WorkingSet::get(const WorkingSetID& i) {
-        DataMap::iterator it = _data.find(i);
-        verify(_data.end() != it);
-        return it->second;
+        WorkingSetMember* member = &_slabs[id >> kSlabShift][id & (kSlabSize - 1)];
+        verify(!member->_inUse);
+        member->_inUse = true;
+        return id;
     }
 
     void WorkingSet::free(const WorkingSetID& i) {
-        DataMap::iterator it = _data.find(i);
-        verify(_data.end() != it);
-        delete it->second;
-        _data.erase(it);
-
-        unordered_set<WorkingSetID>::iterator flagIt = _flagged.find(i);
-        if (_flagged.end() != flagIt) {
-            _flagged.erase(flagIt);
+        verify(i >= 0 && i < _nextId);
+        WorkingSetMember* member = &_slabs[i >> kSlabShift][i & (kSlabSize - 1)];
+        verify(member->_inUse);
+        member->reset();
+        _freeList.push_back(i);
+
+        if (!_flagged.empty()) {
+            _flagged.erase(i);
         }
     }
 
@@ -80,13 +87,28 @@ namespace mongo {
         return _flagged.end() != _flagged.find(id);
     }
 
-    WorkingSetMember::WorkingSetMember() : state(WorkingSetMember::INVALID) { }
+    WorkingSetMember::WorkingSetMember() : state(WorkingSetMember::INVALID), _inUse(false) {
+        for (size_t i = 0; i < WSM_COMPUTED_NUM_TYPES; ++i) {
+            _computed[i] = NULL;
+        }
+    }
 
     WorkingSetMember::~WorkingSetMember() {
-        unordered_map<size_t, WorkingSetComputedData*>::const_iterator it;
-        for (it = _computed.begin(); it != _computed.end(); it++) {
-            delete it->second;
+        for (size_t i = 0; i < WSM_COMPUTED_NUM_TYPES; ++i) {
+            delete _computed[i];
+        }
+    }
+
+    void WorkingSetMember::reset() {
+        for (size_t i = 0; i < WSM_COMPUTED_NUM_TYPES; ++i) {
+            delete _computed[i];
+            _computed[i] = NULL;
         }
+        loc = DiskLoc();
+        obj = BSONObj();
+        keyData.clear();
+        state = INVALID;
+        _inUse = false;
     }
 
     bool WorkingSetMember::hasLoc() const {
@@ -106,13 +128,12 @@ namespace mongo {
     }
 
     bool WorkingSetMember::hasComputed(const WorkingSetComputedDataType type) const {
-        return _computed.end() != _computed.find(type);
+        return NULL != _computed[type];
     }
 
     const WorkingSetComputedData* WorkingSetMember::getComputed(const WorkingSetComputedDataType type) const {
-        unordered_map<size_t, WorkingSetComputedData*>::const_iterator it = _computed.find(type);
-        verify(_computed.end() != it);
-        return it->second;
+        verify(NULL != _computed[type]);
+        return _computed[type];
     }
 
     void WorkingSetMember::addComputed(WorkingSetComputedData* data) {
@@ -29,6 +29,8 @@
 #pragma once
 
 #include <vector>
+
+#include "mongo/base/disallow_copying.h"
 #include "mongo/db/diskloc.h"
 #include "mongo/db/jsobj.h"
 #include "mongo/platform/unordered_map.h"
@@ -43,8 +45,14 @@ namespace mongo {
      * All data in use by a query.  Data is passed through the stage tree by referencing the ID of
      * an element of the working set.  Stages can add elements to the working set, delete elements
      * from the working set, or mutate elements in the working set.
+     *
+     * Members live in fixed-size slabs that are never moved or released until the WorkingSet is
+     * destroyed, so a WorkingSetMember* stays valid across calls to allocate().  Freed IDs go on a
+     * free list and are handed out again by allocate(), so a query that churns through many
+     * results keeps reusing the same few members rather than going to the heap for each one.
      */
     class WorkingSet {
+        MONGO_DISALLOW_COPYING(WorkingSet);
     public:
         static const WorkingSetID INVALID_ID;
 
@@ -87,12 +95,18 @@ namespace mongo {
         bool isFlagged(WorkingSetID id) const;
 
     private:
-        typedef unordered_map<WorkingSetID, WorkingSetMember*> DataMap;
+        // Members per slab.  Must be a power of two.
+        static const int kSlabShift = 7;
+        static const WorkingSetID kSlabSize = 1 << kSlabShift;
+
+        // Each entry is an array of kSlabSize members.  Owned here.
+        std::vector<WorkingSetMember*> _slabs;
 
-        DataMap _data;
+        // IDs that have been freed and may be handed out again by allocate().
+        std::vector<WorkingSetID> _freeList;
 
-        // The WorkingSetID returned by the next call to allocate().  Should refer to the next valid
-        // ID.  IDs allocated contiguously.  Should never point at an in-use ID.  
+        // The ID handed out by allocate() once the free list is empty.  Every ID below this one
+        // has a slot in _slabs.
         WorkingSetID _nextId;
 
         // All WSIDs invalidated during evaluation of a predicate (AND).
@@ -121,6 +135,9 @@ namespace mongo {
     enum WorkingSetComputedDataType {
         WSM_COMPUTED_TEXT_SCORE = 0,
         WSM_COMPUTED_GEO_DISTANCE = 1,
+
+        // Must be last.
+        WSM_COMPUTED_NUM_TYPES,
     };
 
     /**
@@ -201,7 +218,27 @@ namespace mongo {
         bool getFieldDotted(const string& field, BSONElement* out) const;
 
     private:
-        unordered_map<size_t, WorkingSetComputedData*> _computed;
+        friend class WorkingSet;
+
+        /**
+         * Return the member to its just-constructed state so that its slot can be reused.  The
+         * capacity of keyData is kept.
+         */
+        void reset();
+
+        // Indexed by WorkingSetComputedDataType.  NULL if there is no data of that type.  Owned
+        // here.
+        WorkingSetComputedData* _computed[WSM_COMPUTED_NUM_TYPES];
+
+        // Is this slot handed out by the WorkingSet?  Used only for sanity checks.
+        bool _inUse;
     };
 
+    inline WorkingSetMember* WorkingSet::get(const WorkingSetID& i) {
+        dassert(i >= 0 && i < _nextId);
+        WorkingSetMember* member = &_slabs[i >> kSlabShift][i & (kSlabSize - 1)];
+        dassert(member->_inUse);
+        return member;
+    }
+
 }  // namespace mongo
@@ -50,7 +50,6 @@ namespace {
         }
 
         void tearDown() {
-            ws = WorkingSet();
             member = NULL;
         }
 
@@ -144,4 +143,83 @@ namespace {
         ASSERT_FALSE(member->getFieldDotted("y", &elt));
     }
 
+    class DummyComputedData : public WorkingSetComputedData {
+    public:
+        DummyComputedData() : WorkingSetComputedData(WSM_COMPUTED_TEXT_SCORE) { }
+        WorkingSetComputedData* clone() const { return new DummyComputedData(); }
+    };
+
+    TEST_F(WorkingSetFixture, computedData) {
+        ASSERT_FALSE(member->hasComputed(WSM_COMPUTED_TEXT_SCORE));
+        ASSERT_FALSE(member->hasComputed(WSM_COMPUTED_GEO_DISTANCE));
+
+        member->addComputed(new DummyComputedData());
+        ASSERT_TRUE(member->hasComputed(WSM_COMPUTED_TEXT_SCORE));
+        ASSERT_FALSE(member->hasComputed(WSM_COMPUTED_GEO_DISTANCE));
+        ASSERT_EQUALS(WSM_COMPUTED_TEXT_SCORE,
+                      member->getComputed(WSM_COMPUTED_TEXT_SCORE)->type());
+    }
+
+    TEST(WorkingSetTest, freedIdsAreReused) {
+        WorkingSet ws;
+        WorkingSetID first = ws.allocate();
+        WorkingSetID second = ws.allocate();
+        ASSERT_NOT_EQUALS(first, second);
+
+        ws.free(first);
+        ASSERT_EQUALS(first, ws.allocate());
+        ASSERT_NOT_EQUALS(second, ws.allocate());
+    }
+
+    TEST(WorkingSetTest, reusedMemberIsReset) {
+        WorkingSet ws;
+        WorkingSetID id = ws.allocate();
+        WorkingSetMember* member = ws.get(id);
+        member->state = WorkingSetMember::OWNED_OBJ;
+        member->obj = BSON("x" << 1);
+        member->loc = DiskLoc(1, 1);
+        member->keyData.push_back(IndexKeyDatum(BSON("x" << 1), BSON("" << 1)));
+        member->addComputed(new DummyComputedData());
+        ws.flagForReview(id);
+        ASSERT_TRUE(ws.isFlagged(id));
+
+        ws.free(id);
+        ASSERT_FALSE(ws.isFlagged(id));
+
+        ASSERT_EQUALS(id, ws.allocate());
+        member = ws.get(id);
+        ASSERT_EQUALS(WorkingSetMember::INVALID, member->state);
+        ASSERT_TRUE(member->obj.isEmpty());
+        ASSERT_TRUE(member->loc.isNull());
+        ASSERT_TRUE(member->keyData.empty());
+        ASSERT_FALSE(member->hasComputed(WSM_COMPUTED_TEXT_SCORE));
+    }
+
+    // Members must not move when the working set grows.
+    TEST(WorkingSetTest, membersDoNotMove) {
+        WorkingSet ws;
+        WorkingSetID firstId = ws.allocate();
+        WorkingSetMember* first = ws.get(firstId);
+        first->state = WorkingSetMember::OWNED_OBJ;
+        first->obj = BSON("x" << 1);
+
+        vector<WorkingSetID> ids;
+        for (int i = 0; i < 10000; ++i) {
+            ids.push_back(ws.allocate());
+        }
+
+        ASSERT_EQUALS(first, ws.get(firstId));
+        ASSERT_EQUALS(1, first->obj["x"].numberInt());
+
+        // Every id is distinct and refers to a distinct member.
+        set<WorkingSetID> distinctIds(ids.begin(), ids.end());
+        ASSERT_EQUALS(ids.size(), distinctIds.size());
+        set<WorkingSetMember*> distinctMembers;
+        for (size_t i = 0; i < ids.size(); ++i) {
+            distinctMembers.insert(ws.get(ids[i]));
+            ws.free(ids[i]);
+        }
+        ASSERT_EQUALS(ids.size(), distinctMembers.size());
+    }
+
 }  // namespace
@@ -78,13 +78,33 @@ namespace mongo {
 
     BSONObjExternalSorter::BSONObjExternalSorter(const ExternalSortComparison* comp,
                                                  long maxFileSize)
-        : _mayInterrupt(boost::make_shared<bool>(false))
+        : _comp(comp)
+        , _mayInterrupt(boost::make_shared<bool>(false))
         , _sorter(Sorter<BSONObj, DiskLoc>::make(
                     SortOptions().TempDir(storageGlobalParams.dbpath + "/_tmp")
                                  .ExtSortAllowed()
                                  .MaxMemoryUsageBytes(maxFileSize),
                     OldExtSortComparator(comp, _mayInterrupt)))
+        , _absorbedFiles(0)
     {}
+
+    void BSONObjExternalSorter::absorb(BSONObjExternalSorter* other) {
+        _absorbed.push_back(shared_ptr<Iterator>(other->_sorter->done()));
+        _absorbedFiles += other->numFiles();
+    }
+
+    auto_ptr<BSONObjExternalSorter::Iterator> BSONObjExternalSorter::iterator() {
+        if (_absorbed.empty()) {
+            return auto_ptr<Iterator>(_sorter->done());
+        }
+
+        vector<shared_ptr<Iterator> > iters;
+        iters.swap(_absorbed);
+        iters.push_back(shared_ptr<Iterator>(_sorter->done()));
+        return auto_ptr<Iterator>(Iterator::merge(iters,
+                                                  SortOptions(),
+                                                  OldExtSortComparator(_comp, _mayInterrupt)));
+    }
 }
 
 #include "mongo/db/sorter/sorter.cpp"
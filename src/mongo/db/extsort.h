@@ -71,16 +71,25 @@ namespace mongo {
             _sorter->add(o.getOwned(), loc);
         }
 
-        auto_ptr<Iterator> iterator() { return auto_ptr<Iterator>(_sorter->done()); }
+        /**
+         * Makes iterator() merge in everything added to 'other', which must use an equivalent
+         * comparison.  Nothing more may be added to 'other' afterwards.
+         */
+        void absorb( BSONObjExternalSorter* other );
+
+        auto_ptr<Iterator> iterator();
 
         void sort( bool mayInterrupt ) { *_mayInterrupt = mayInterrupt; }
-        int numFiles() { return _sorter->numFiles(); }
+        int numFiles() { return _sorter->numFiles() + _absorbedFiles; }
         long getCurSizeSoFar() { return _sorter->memUsed(); }
         void hintNumObjects(long long) {} // unused
 
     private:
+        const ExternalSortComparison* _comp;
         shared_ptr<bool> _mayInterrupt;
         scoped_ptr<Sorter<BSONObj, DiskLoc> > _sorter;
+        vector<shared_ptr<Iterator> > _absorbed;
+        int _absorbedFiles;
     };
 #else
     /**
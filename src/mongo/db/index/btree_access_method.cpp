@@ -43,7 +43,7 @@ namespace mongo {
     BtreeBasedAccessMethod::BtreeBasedAccessMethod(IndexDescriptor *descriptor)
         : _descriptor(descriptor), _ordering(Ordering::make(_descriptor->keyPattern())) {
 
-        verify(0 == descriptor->version() || 1 == descriptor->version());
+        verify(0 <= descriptor->version() && descriptor->version() <= 2);
         _interface = BtreeInterface::interfaces[descriptor->version()];
     }
 
@@ -254,7 +254,8 @@ namespace mongo {
         if (0 == descriptor->version()) {
             _keyGenerator.reset(new BtreeKeyGeneratorV0(fieldNames, fixed,
                 _descriptor->isSparse()));
-        } else if (1 == descriptor->version()) {
+        } else if (1 == descriptor->version() || 2 == descriptor->version()) {
+            // v:2 keys are KeyV1 keys, only their storage in a bucket differs
             _keyGenerator.reset(new BtreeKeyGeneratorV1(fieldNames, fixed,
                 _descriptor->isSparse()));
         } else {
@@ -29,6 +29,7 @@
 #include "mongo/db/index/btree_based_builder.h"
 
 #include "mongo/db/btreebuilder.h"
+#include "mongo/db/index/btree_access_method_internal.h"
 #include "mongo/db/index/catalog_hack.h"
 #include "mongo/db/index/index_descriptor.h"
 #include "mongo/db/index/index_access_method.h"
@@ -38,13 +39,31 @@
 #include "mongo/db/repl/is_master.h"
 #include "mongo/db/repl/oplog.h"
 #include "mongo/db/repl/rs.h"
+#include "mongo/db/server_parameters.h"
 #include "mongo/db/sort_phase_one.h"
+#include "mongo/util/concurrency/thread_pool.h"
 #include "mongo/util/processinfo.h"
+#include "mongo/util/queue.h"
 
 namespace mongo {
 
     int oldCompare(const BSONObj& l,const BSONObj& r, const Ordering &o); // key.cpp
 
+    // Number of threads generating and sorting keys in a foreground index build.  With 1 the
+    // building thread does it all.
+    MONGO_EXPORT_SERVER_PARAMETER(internalIndexBuildKeyThreads, int, 1);
+
+    namespace {
+        // Documents handed to a key generation worker at a time.
+        const size_t kKeyBatchSize = 512;
+
+        // Number of batches that may wait for a worker before the collection scan blocks.
+        const size_t kKeyQueueDepth = 16;
+
+        // Memory for sorting keys before spilling, split between the workers.
+        const long kPhaseOneSortBytes = 100 * 1024 * 1024;
+    }
+
     class ExternalSortComparisonV0 : public ExternalSortComparison {
     public:
         ExternalSortComparisonV0(const BSONObj& ordering) : _ordering(Ordering::make(ordering)) { }
@@ -139,8 +158,10 @@ namespace mongo {
     DiskLoc BtreeBasedBuilder::makeEmptyIndex(const IndexDetails& idx) {
         if (0 == idx.version()) {
             return BtreeBucket<V0>::addBucket(idx);
-        } else {
+        } else if (1 == idx.version()) {
             return BtreeBucket<V1>::addBucket(idx);
+        } else {
+            return BtreeBucket<V2>::addBucket(idx);
         }
     }
 
@@ -149,7 +170,8 @@ namespace mongo {
         if (0 == version) {
             return new ExternalSortComparisonV0(keyPattern);
         } else {
-            verify(1 == version);
+            // v:2 indexes order keys exactly as v:1 indexes do
+            verify(1 == version || 2 == version);
             return new ExternalSortComparisonV1(keyPattern);
         }
     }
@@ -169,6 +191,14 @@ namespace mongo {
         BtreeBasedAccessMethod* iam =collection->getIndexCatalog()->getBtreeBasedIndex( idx );
 
         auto_ptr<Runner> runner(InternalPlanner::collectionScan(collection->ns().ns()));
+
+        const int numThreads = internalIndexBuildKeyThreads;
+        if (numThreads > 1) {
+            addKeysToPhaseOneParallel(runner.get(), iam, phaseOne, progressMeter, mayInterrupt,
+                                      numThreads);
+            return;
+        }
+
         BSONObj o;
         DiskLoc loc;
         Runner::RunnerState state;
@@ -188,6 +218,141 @@ namespace mongo {
 
     }
 
+    class BtreeBasedBuilder::KeyPartition : boost::noncopyable {
+    public:
+        // Documents and their locations.  The documents point into the data files, which can't
+        // change while the building thread holds the write lock.
+        typedef vector<pair<BSONObj, DiskLoc> > Batch;
+
+        KeyPartition(BtreeBasedAccessMethod* iam, const ExternalSortComparison* cmp,
+                     long maxFileSize)
+            : _iam(iam)
+            , _queue(kKeyQueueDepth)
+            , _errorCode(0) {
+            _phaseOne.sorter.reset(new BSONObjExternalSorter(cmp, maxFileSize));
+        }
+
+        /// Queue 'batch' for the worker, which takes ownership.  NULL marks the end of input.
+        void push(Batch* batch) { _queue.push(batch); }
+
+        /// The worker thread's body.  Returns once NULL is popped.
+        void run() {
+            while (Batch* next = _queue.blockingPop()) {
+                boost::scoped_ptr<Batch> batch(next);
+
+                // After an error we only drain the queue so the scan never blocks on us.
+                if (_errorCode)
+                    continue;
+
+                try {
+                    for (size_t i = 0; i < batch->size(); i++) {
+                        BSONObjSet keys;
+                        _iam->getKeys((*batch)[i].first, &keys);
+                        // We have no Client; the building thread checks for interrupts.
+                        _phaseOne.addKeys(keys, (*batch)[i].second, false);
+                    }
+                }
+                catch (const DBException& e) {
+                    _errorCode = e.getCode();
+                    _errmsg = e.what();
+                }
+                catch (const std::exception& e) {
+                    _errorCode = 17303;
+                    _errmsg = e.what();
+                }
+            }
+        }
+
+        /// Rethrows on the calling thread any error the worker hit.  Only call after run().
+        void rethrowError() const {
+            if (_errorCode)
+                uasserted(_errorCode, _errmsg);
+        }
+
+        SortPhaseOne& phaseOne() { return _phaseOne; }
+
+    private:
+        BtreeBasedAccessMethod* const _iam;
+        BlockingQueue<Batch*> _queue;
+        SortPhaseOne _phaseOne;
+
+        int _errorCode;
+        string _errmsg;
+    };
+
+    void BtreeBasedBuilder::addKeysToPhaseOneParallel(Runner* runner,
+                                                      BtreeBasedAccessMethod* iam,
+                                                      SortPhaseOne* phaseOne,
+                                                      ProgressMeter* progressMeter,
+                                                      bool mayInterrupt,
+                                                      int numThreads) {
+        vector<shared_ptr<KeyPartition> > partitions;
+        for (int i = 0; i < numThreads; i++) {
+            partitions.push_back(boost::make_shared<KeyPartition>(iam,
+                                                                  phaseOne->sortCmp.get(),
+                                                                  kPhaseOneSortBytes / numThreads));
+        }
+
+        ThreadPool pool(numThreads);
+        for (int i = 0; i < numThreads; i++) {
+            pool.schedule(&KeyPartition::run, partitions[i].get());
+        }
+
+        // Batches go round robin; the merge below restores the overall order.
+        KeyPartition::Batch* batch = NULL;
+        size_t nextPartition = 0;
+        BSONObj o;
+        DiskLoc loc;
+        Runner::RunnerState state;
+        try {
+            while (Runner::RUNNER_ADVANCED == (state = runner->getNext(&o, &loc))) {
+                RARELY killCurrentOp.checkForInterrupt( !mayInterrupt );
+                if (!batch) {
+                    batch = new KeyPartition::Batch();
+                    batch->reserve(kKeyBatchSize);
+                }
+                batch->push_back(make_pair(o, loc));
+                progressMeter->hit();
+
+                if (batch->size() == kKeyBatchSize) {
+                    partitions[nextPartition++ % numThreads]->push(batch);
+                    batch = NULL;
+                }
+            }
+        }
+        catch (...) {
+            // The workers must be stopped before we unwind past them.
+            delete batch;
+            for (int i = 0; i < numThreads; i++) {
+                partitions[i]->push(NULL);
+            }
+            pool.join();
+            throw;
+        }
+
+        if (batch) {
+            partitions[nextPartition % numThreads]->push(batch);
+        }
+        for (int i = 0; i < numThreads; i++) {
+            partitions[i]->push(NULL);
+        }
+        pool.join();
+
+        for (int i = 0; i < numThreads; i++) {
+            partitions[i]->rethrowError();
+        }
+
+        uassert(17050, "Internal error reading docs from collection", Runner::RUNNER_EOF == state);
+
+        for (int i = 0; i < numThreads; i++) {
+            SortPhaseOne& partial = partitions[i]->phaseOne();
+            phaseOne->n += partial.n;
+            phaseOne->nkeys += partial.nkeys;
+            phaseOne->multi = phaseOne->multi || partial.multi;
+            phaseOne->sorter->absorb(partial.sorter.get());
+        }
+    }
+
     uint64_t BtreeBasedBuilder::fastBuildIndex( Collection* collection,
                                                 IndexDescriptor* idx,
                                                 bool mayInterrupt ) {
@@ -255,6 +420,17 @@ namespace mongo {
                                          pm,
                                          t,
                                          mayInterrupt);
+        else if( idx->version() == 2 )
+            buildBottomUpPhases2And3<V2>(dupsAllowed,
+                                         idx,
+                                         sorter,
+                                         dropDups,
+                                         dupsToDrop,
+                                         op,
+                                         &phase1,
+                                         pm,
+                                         t,
+                                         mayInterrupt);
         else
             verify(false);
 
@@ -35,6 +35,7 @@
 
 namespace IndexUpdateTests {
     class AddKeysToPhaseOne;
+    class AddKeysToPhaseOneParallel;
     class InterruptAddKeysToPhaseOne;
     class DoDropDups;
     class InterruptDoDropDups;
@@ -44,12 +45,14 @@ namespace mongo {
 
     class Collection;
     class BSONObjExternalSorter;
+    class BtreeBasedAccessMethod;
     class ExternalSortComparison;
     class IndexDescriptor;
     class IndexDetails;
     class NamespaceDetails;
     class ProgressMeter;
     class ProgressMeterHolder;
+    class Runner;
     struct SortPhaseOne;
 
     class BtreeBasedBuilder {
@@ -64,6 +67,7 @@ namespace mongo {
 
     private:
         friend class IndexUpdateTests::AddKeysToPhaseOne;
+        friend class IndexUpdateTests::AddKeysToPhaseOneParallel;
         friend class IndexUpdateTests::InterruptAddKeysToPhaseOne;
         friend class IndexUpdateTests::DoDropDups;
         friend class IndexUpdateTests::InterruptDoDropDups;
@@ -73,6 +77,18 @@ namespace mongo {
                                       const BSONObj& order, SortPhaseOne* phaseOne,
                                       ProgressMeter* progressMeter, bool mayInterrupt );
 
+        class KeyPartition;
+
+        /**
+         * Like the loop in addKeysToPhaseOne, but documents are handed in batches to
+         * 'numThreads' workers which generate and sort their keys.  The workers' sorters are
+         * then merged into phaseOne's.
+         */
+        static void addKeysToPhaseOneParallel(Runner* runner, BtreeBasedAccessMethod* iam,
+                                              SortPhaseOne* phaseOne,
+                                              ProgressMeter* progressMeter, bool mayInterrupt,
+                                              int numThreads);
+
         static void doDropDups(Collection* collection, const set<DiskLoc>& dupsToDrop,
                                bool mayInterrupt );
     };
@@ -616,6 +616,125 @@ namespace mongo {
         return p - _keyData;
     }
 
+    namespace {
+        /** loaded big endian, unsigned compares order bytes like memcmp */
+        inline unsigned long long loadBigEndian64(const unsigned char *p) {
+            unsigned long long x = 0;
+            for( int i = 0; i < 8; i++ )
+                x = (x << 8) | p[i];
+            return x;
+        }
+
+        inline unsigned loadBigEndian32(const unsigned char *p) {
+            return ((unsigned) p[0] << 24) | ((unsigned) p[1] << 16) | ((unsigned) p[2] << 8) | p[3];
+        }
+
+        /** a stored number as an unsigned that orders as compare() does. no NaNs in compact keys */
+        inline unsigned long long orderedNumber(const unsigned char *p) {
+            double d = (reinterpret_cast< const PackedDouble* >(p))->d;
+            if( d == 0 )
+                d = 0; // -0 == 0
+            unsigned long long x;
+            memcpy(&x, &d, sizeof(x));
+            const unsigned long long sign = 1ULL << 63;
+            return (x & sign) ? ~x : (x | sign);
+        }
+
+        /** dates are signed in compact keys */
+        inline unsigned long long orderedDate(const unsigned char *p) {
+            long long x;
+            memcpy(&x, p, sizeof(x));
+            return ((unsigned long long) x) ^ (1ULL << 63);
+        }
+
+        template< class T >
+        inline int compareWords(T l, T r) {
+            return l < r ? -1 : (l != r);
+        }
+    }
+
+    KeyV1Search::KeyV1Search(const KeyV1& key, const Ordering& o) :
+        _key(key), _o(o), _prepared(false) {
+        if( !key.isCompactFormat() )
+            return;
+
+        const unsigned char *p = (const unsigned char *) key.data();
+        unsigned mask = 1;
+        for( int i = 0; i < MaxElements; i++ ) {
+            Element& e = _elements[i];
+            e.bits = *p;
+            e.descending = o.descending(mask) != 0;
+            e.data = p + 1;
+            switch( *p & cCANONTYPEMASK ) {
+            case cdouble:
+                e.word = orderedNumber(p + 1);
+                break;
+            case cdate:
+                e.word = orderedDate(p + 1);
+                break;
+            case coid:
+                e.word = loadBigEndian64(p + 1);
+                e.tail = loadBigEndian32(p + 9);
+                break;
+            default:
+                ;
+            }
+            if( (*p & cHASMORE) == 0 ) {
+                _prepared = true;
+                return;
+            }
+            p += sizeOfElement(p);
+            mask <<= 1;
+        }
+    }
+
+    int KeyV1Search::compare(const KeyV1& right) const {
+        if( !_prepared || !right.isCompactFormat() )
+            return _key.woCompare(right, _o);
+
+        const unsigned char *r = (const unsigned char *) right.data();
+        for( const Element *e = _elements; ; e++ ) {
+            const unsigned char rbits = *r;
+            int x = (e->bits & cCANONTYPEMASK) - (rbits & cCANONTYPEMASK);
+            if( x == 0 ) {
+                switch( e->bits & cCANONTYPEMASK ) {
+                case cdouble:
+                    x = compareWords(e->word, orderedNumber(r + 1));
+                    r += 9;
+                    break;
+                case cdate:
+                    x = compareWords(e->word, orderedDate(r + 1));
+                    r += 9;
+                    break;
+                case coid:
+                    x = compareWords(e->word, loadBigEndian64(r + 1));
+                    if( x == 0 )
+                        x = compareWords(e->tail, loadBigEndian32(r + 9));
+                    r += 13;
+                    break;
+                case cstring:
+                case cbindata:
+                    {
+                        const unsigned char *l = e->data - 1;
+                        x = mongo::compare(l, r); // updates r
+                        break;
+                    }
+                default:
+                    // no value: null, bools, minkey, maxkey
+                    r++;
+                }
+            }
+            if( x )
+                return e->descending ? -x : x;
+
+            x = ((int)(e->bits & cHASMORE)) - ((int)(rbits & cHASMORE));
+            if( x )
+                return x;
+            if( (e->bits & cHASMORE) == 0 )
+                return 0;
+        }
+    }
+
     bool KeyV1::woEqual(const KeyV1& right) const {
         const unsigned char *l = _keyData;
         const unsigned char *r = right._keyData;
@@ -680,6 +799,201 @@ namespace mongo {
         return true;
     }
 
+    /**
+     * Walks the elements of a compact format KeyV2 whose leading bytes may be in the bucket
+     * prefix.  An element straddling the prefix and the stored suffix is copied so that callers
+     * always see whole elements.
+     */
+    class KeyV2Reader {
+    public:
+        explicit KeyV2Reader(const KeyV2& k) :
+            _p(k._prefixLen ? k._prefix : k._keyData),
+            _end(k._prefixLen ? k._prefix + k._prefixLen : 0),
+            _suffix(k._keyData) {
+        }
+
+        const unsigned char* element() {
+            if( _end == 0 )
+                return _p;
+            unsigned avail = _end - _p;
+            // the size of an element is determined by its first two bytes
+            unsigned char head[2] = { _p[0], avail > 1 ? _p[1] : _suffix[0] };
+            unsigned sz = sizeOfElement(head);
+            if( sz <= avail )
+                return _p;
+            memcpy(_split, _p, avail);
+            memcpy(_split + avail, _suffix, sz - avail);
+            return _split;
+        }
+
+        void advance(unsigned sz) {
+            if( _end != 0 ) {
+                unsigned avail = _end - _p;
+                if( sz < avail ) {
+                    _p += sz;
+                    return;
+                }
+                _p = _suffix + (sz - avail);
+                _end = 0;
+                return;
+            }
+            _p += sz;
+        }
+
+    private:
+        const unsigned char *_p;
+        const unsigned char *_end; // end of the prefix part, 0 once in the suffix
+        const unsigned char *_suffix;
+        unsigned char _split[2+255]; // largest element is a string: type, length, 255 bytes
+    };
+
+    KeyV2Owned::KeyV2Owned(const BSONObj& obj) : _owned(obj) {
+        setContiguous(_owned.data());
+    }
+
+    void KeyV2::copyBytes(char *dest, unsigned from, unsigned to) const {
+        if( from < _prefixLen ) {
+            unsigned n = min(to, _prefixLen) - from;
+            memcpy(dest, _prefix + from, n);
+            dest += n;
+            from += n;
+        }
+        if( from < to )
+            memcpy(dest, _keyData + (from - _prefixLen), to - from);
+    }
+
+    int KeyV2::dataSize() const {
+        if( _prefixLen == 0 )
+            return KeyV1::dataSize();
+
+        KeyV2Reader r(*this);
+        int size = 0;
+        while( 1 ) {
+            const unsigned char *e = r.element();
+            unsigned sz = sizeOfElement(e);
+            size += sz;
+            if( (*e & cHASMORE) == 0 )
+                break;
+            r.advance(sz);
+        }
+        return size;
+    }
+
+    BSONObj KeyV2::toBson() const {
+        if( _prefixLen == 0 )
+            return KeyV1::toBson();
+
+        int size = dataSize();
+        BufBuilder b(size);
+        copyBytes(b.skip(size), 0, size);
+        return KeyV1(b.buf()).toBson();
+    }
+
+    unsigned KeyV2::leadingMatch(const unsigned char *prefix, unsigned prefixLen) const {
+        dassert( _prefixLen == 0 );
+        // Encoded keys are prefix free, so a compact key that matches the start of another
+        // key differs from it before running off its own end.
+        unsigned i = 0;
+        while( i < prefixLen && _keyData[i] == prefix[i] )
+            i++;
+        return i;
+    }
+
+    unsigned KeyV2::commonBytes(const KeyV2& r) const {
+        if( _prefixLen && r._prefixLen )
+            return _prefix == r._prefix ? min(_prefixLen, r._prefixLen) : 0;
+        if( _prefixLen )
+            return r.leadingMatch(_prefix, _prefixLen);
+        if( r._prefixLen )
+            return leadingMatch(r._prefix, r._prefixLen);
+        return 0;
+    }
+
+    int KeyV2::woCompare(const KeyV2& right, const Ordering &order) const {
+        if( _prefixLen == 0 && right._prefixLen == 0 )
+            return KeyV1::woCompare(right, order);
+
+        // a prefix compressed key is always compact, the other may not be
+        if( !isCompactFormat() || !right.isCompactFormat() )
+            return toBson().woCompare(right.toBson(), order, /*considerfieldname*/false);
+
+        // Elements lying wholly in the bytes the keys are known to share need no comparing.
+        // In a bucket binary search that is typically the leading fields of a compound key.
+        const unsigned common = commonBytes(right);
+        KeyV2Reader l(*this);
+        KeyV2Reader r(right);
+        unsigned pos = 0;
+        unsigned mask = 1;
+        while( 1 ) {
+            const unsigned char *le = l.element();
+            const unsigned char *re = r.element();
+            unsigned lsz = sizeOfElement(le);
+            unsigned rsz = sizeOfElement(re);
+            char lval = *le;
+            char rval = *re;
+            if( pos + lsz > common ) {
+                int x = compare(le, re);
+                if( x ) {
+                    if( order.descending(mask) )
+                        x = -x;
+                    return x;
+                }
+                x = ((int)(lval & cHASMORE)) - ((int)(rval & cHASMORE));
+                if( x )
+                    return x;
+            }
+            if( (lval & cHASMORE) == 0 )
+                break;
+            pos += lsz;
+            l.advance(lsz);
+            r.advance(rsz);
+            mask <<= 1;
+        }
+        return 0;
+    }
+
+    bool KeyV2::woEqual(const KeyV2& right) const {
+        if( _prefixLen == 0 && right._prefixLen == 0 )
+            return KeyV1::woEqual(right);
+        if( !isCompactFormat() || !right.isCompactFormat() )
+            return toBson().equal(right.toBson());
+        return woCompare(right, nullOrdering) == 0;
+    }
+
+    int KeyV2::sharedPrefixLen(const char *prefix, int prefixLen, int size) const {
+        if( prefixLen == 0 || !isCompactFormat() )
+            return 0;
+        int n = min(prefixLen, size);
+        int i = 0;
+        if( prefix == (const char *) _prefix ) {
+            // already stored against this prefix
+            i = _prefixLen;
+        }
+        while( i < n && (char) byteAt(i) == prefix[i] )
+            i++;
+        return i;
+    }
+
+    int KeyV2::storedSize(const char *prefix, int prefixLen) const {
+        int size = dataSize();
+        return 1 + size - sharedPrefixLen(prefix, prefixLen, size);
+    }
+
+    void KeyV2::store(char *dest, const char *prefix, int prefixLen) const {
+        int size = dataSize();
+        int shared = sharedPrefixLen(prefix, prefixLen, size);
+        *dest = (char) (unsigned char) shared;
+        copyBytes(dest + 1, shared, size);
+    }
+
+    int KeyV2::copyPrefix(char *dest) const {
+        if( !isCompactFormat() )
+            return 0;
+        int n = min(dataSize(), (int) MaxPrefixLen);
+        copyBytes(dest, 0, n);
+        return n;
+    }
+
     struct CmpUnitTest : public StartupTest {
         void run() {
             char a[2];
@@ -39,6 +39,9 @@ namespace mongo {
         KeyBson is a legacy wrapper implementation for old BSONObj style keys for v:0 indexes.
 
         KeyV1 is the new implementation.
+
+        KeyV2 (v:2 indexes) uses the KeyV1 encoding, but within a btree bucket the leading bytes
+        of a key may be shared with a prefix stored once per bucket.
     */
     class KeyBson /* "KeyV0" */ { 
     public:
@@ -127,4 +130,141 @@ namespace mongo {
         void traditional(const BSONObj& obj); // store as traditional bson not as compact format
     };
 
+    /** A search key compared against many keys with the key type's own woCompare. */
+    template< class Key >
+    class KeySearch {
+    public:
+        KeySearch(const Key& key, const Ordering& o) : _key(key), _o(o) { }
+        int compare(const Key& r) const { return _key.woCompare(r, _o); }
+    private:
+        const Key& _key;
+        const Ordering& _o;
+    };
+
+    /**
+     * A KeyV1 search key prepared once for comparing against many keys, as in a bucket binary
+     * search.  Each element of a compact key is normalized up front, with the ordering folded
+     * in: numbers, dates and oids become unsigned words that compare the way woCompare orders
+     * them.  A comparison then decodes only the other key, a word compare per fixed size
+     * element, with no float compares, memcmp calls or ordering lookups.
+     *
+     * compare() has the sign of key.woCompare(r, o).
+     */
+    class KeyV1Search {
+    public:
+        KeyV1Search(const KeyV1& key, const Ordering& o);
+        int compare(const KeyV1& r) const;
+
+    private:
+        // an Ordering can describe 32 fields, so longer keys take the woCompare path
+        enum { MaxElements = 32 };
+
+        struct Element {
+            unsigned char bits;         // type and cHASMORE as stored
+            bool descending;
+            unsigned long long word;    // ordered number, date or leading oid bytes
+            unsigned tail;              // trailing oid bytes
+            const unsigned char *data;  // string and bindata: the bytes after the type byte
+        };
+
+        const KeyV1& _key;
+        const Ordering& _o;
+        bool _prepared;
+        Element _elements[MaxElements];
+    };
+
+    // corresponding to BtreeData_V2
+    class KeyV2 : private KeyV1 {
+        void operator=(const KeyV2&);
+    public:
+        /** longest prefix a bucket will share between its keys */
+        enum { MaxPrefixLen = 255 };
+
+        KeyV2() : _prefix(0), _prefixLen(0) { }
+
+        KeyV2(const KeyV2& rhs) : KeyV1(), _prefix(rhs._prefix), _prefixLen(rhs._prefixLen) {
+            _keyData = rhs._keyData;
+        }
+
+        void assign(const KeyV2& rhs) {
+            _prefix = rhs._prefix;
+            _prefixLen = rhs._prefixLen;
+            _keyData = rhs._keyData;
+        }
+
+        /** @param keyData a contiguous key in KeyV1 format */
+        explicit KeyV2(const char *keyData) : KeyV1(keyData), _prefix(0), _prefixLen(0) { }
+
+        /**
+         * A key as stored in a v:2 bucket: a byte giving how much of 'bucketPrefix' the key
+         * starts with, followed by the rest of the key.
+         */
+        KeyV2(const char *bucketPrefix, const char *stored) :
+            KeyV1(stored + 1),
+            _prefix((const unsigned char *) bucketPrefix),
+            _prefixLen(*(const unsigned char *) stored) {
+        }
+
+        /** Compares element by element, skipping whole elements both keys share in a prefix. */
+        int woCompare(const KeyV2& r, const Ordering &o) const;
+        bool woEqual(const KeyV2& r) const;
+        BSONObj toBson() const;
+        string toString() const { return toBson().toString(); }
+
+        /** @return size of the whole key, including any part shared with the bucket prefix */
+        int dataSize() const;
+
+        /** @return size of the key when stored in a bucket whose prefix is 'prefix' */
+        int storedSize(const char *prefix, int prefixLen) const;
+
+        /**
+         * Store this key in a bucket whose prefix is 'prefix'.  'dest' must have storedSize()
+         * bytes available.
+         */
+        void store(char *dest, const char *prefix, int prefixLen) const;
+
+        /**
+         * Copy out the leading bytes of this key, at most MaxPrefixLen, for use as a bucket
+         * prefix.  Only compact format keys are shared; @return 0 for others.
+         */
+        int copyPrefix(char *dest) const;
+
+        bool isCompactFormat() const { return firstByte() != IsBSON; }
+        bool isValid() const { return KeyV1::isValid(); }
+
+    protected:
+        friend class KeyV2Reader;
+        unsigned char firstByte() const { return _prefixLen ? *_prefix : *_keyData; }
+        void setContiguous(const char *keyData) {
+            _prefix = 0;
+            _prefixLen = 0;
+            _keyData = (const unsigned char *) keyData;
+        }
+
+        const unsigned char *_prefix;
+        unsigned _prefixLen;
+
+    private:
+        unsigned char byteAt(unsigned i) const {
+            return i < _prefixLen ? _prefix[i] : _keyData[i - _prefixLen];
+        }
+        /** copy bytes [from, to) of the whole key to 'dest' */
+        void copyBytes(char *dest, unsigned from, unsigned to) const;
+        /** @return number of leading bytes known to be identical in this key and 'r' */
+        unsigned commonBytes(const KeyV2& r) const;
+        /** @return how many leading bytes of 'prefix' this contiguous key starts with */
+        unsigned leadingMatch(const unsigned char *prefix, unsigned prefixLen) const;
+        int sharedPrefixLen(const char *prefix, int prefixLen, int size) const;
+    };
+
+    class KeyV2Owned : public KeyV2 {
+        void operator=(const KeyV2Owned&);
+    public:
+        /** @obj a BSON object to be translated to KeyV2 format, see KeyV1Owned */
+        KeyV2Owned(const BSONObj& obj);
+
+    private:
+        KeyV1Owned _owned;
+    };
+
 };
@@ -33,10 +33,49 @@
 
 #include "mongo/db/lockstat.h"
 
+#include <algorithm>
+#include <limits>
+
 #include "mongo/db/jsobj.h"
+#include "mongo/util/histogram.h"
 
 namespace mongo { 
 
+    namespace {
+        // buckets end at 8us, 16us, ... ~8.4s, then everything longer
+        const uint32_t latencyBuckets = 22;
+        const uint32_t latencyFirstBucketMicros = 8;
+
+        Histogram* newLatencyHistogram() {
+            Histogram::Options opts;
+            opts.numBuckets = latencyBuckets;
+            opts.bucketSize = latencyFirstBucketMicros;
+            opts.exponential = true;
+            return new Histogram( opts );
+        }
+    }
+
+    LockStat::LockStat() {
+        for ( int i = 0; i < N; i++ ) {
+            _acquireLatency[i] = 0;
+            _lockedLatency[i] = 0;
+        }
+    }
+
+    LockStat::LockStat( bool trackLatency ) {
+        for ( int i = 0; i < N; i++ ) {
+            _acquireLatency[i] = trackLatency ? newLatencyHistogram() : 0;
+            _lockedLatency[i] = trackLatency ? newLatencyHistogram() : 0;
+        }
+    }
+
+    LockStat::~LockStat() {
+        for ( int i = 0; i < N; i++ ) {
+            delete _acquireLatency[i];
+            delete _lockedLatency[i];
+        }
+    }
+
     BSONObj LockStat::report() const { 
         BSONObjBuilder b;
 
@@ -47,6 +86,16 @@ namespace mongo {
         BSONObjBuilder a( b.subobjStart( "timeAcquiringMicros" ) );
         _append( a , timeAcquiring );
         a.done();
+
+        if ( _acquireLatency[0] ) {
+            BSONObjBuilder l( b.subobjStart( "lockedLatencyMicros" ) );
+            _appendLatency( l , _lockedLatency );
+            l.done();
+
+            BSONObjBuilder al( b.subobjStart( "acquiringLatencyMicros" ) );
+            _appendLatency( al , _acquireLatency );
+            al.done();
+        }
         
         return b.obj();
     }
@@ -79,6 +128,40 @@ namespace mongo {
         }
     }
 
+    /**
+     * { <mode> : { <bucket upper bound> : count, ... } } with empty buckets and modes left out.
+     * The last bucket is open ended and reported as "more".
+     */
+    void LockStat::_appendLatency( BSONObjBuilder& builder, Histogram* const* histograms ) {
+        for ( int i = 0; i < N; i++ ) {
+            const Histogram* h = histograms[i];
+            BSONObjBuilder m;
+            bool any = false;
+            for ( uint32_t bucket = 0; bucket < h->getBucketsNum(); bucket++ ) {
+                uint64_t count = h->getCount( bucket );
+                if ( count == 0 )
+                    continue;
+                any = true;
+                if ( bucket == h->getBucketsNum() - 1 )
+                    m.append( "more" , static_cast<long long>( count ) );
+                else
+                    m.append( BSONObjBuilder::numStr( static_cast<int>( h->getBoundary( bucket ) ) ) ,
+                              static_cast<long long>( count ) );
+            }
+            if ( any )
+                builder.append( string( 1, nameFor( i ) ) , m.obj() );
+        }
+    }
+
+    void LockStat::_recordLatency( Histogram* histogram, long long micros ) {
+        if ( ! histogram )
+            return;
+        if ( micros < 0 )
+            micros = 0;
+        histogram->insert( static_cast<uint32_t>(
+                std::min( micros, static_cast<long long>( std::numeric_limits<uint32_t>::max() ) ) ) );
+    }
+
     unsigned LockStat::mapNo(char type) {
         switch( type ) { 
         case 'R' : return 0;
@@ -103,10 +186,14 @@ namespace mongo {
 
 
     void LockStat::recordAcquireTimeMicros( char type , long long micros ) {
-        timeAcquiring[mapNo(type)].fetchAndAdd( micros );
+        unsigned i = mapNo(type);
+        timeAcquiring[i].fetchAndAdd( micros );
+        _recordLatency( _acquireLatency[i], micros );
     }
     void LockStat::recordLockTimeMicros( char type , long long micros ) {
-        timeLocked[mapNo(type)].fetchAndAdd( micros );
+        unsigned i = mapNo(type);
+        timeLocked[i].fetchAndAdd( micros );
+        _recordLatency( _lockedLatency[i], micros );
     }
 
     void LockStat::reset() {
@@ -115,4 +202,74 @@ namespace mongo {
             timeLocked[i].store(0);
         }
     }
+
+    LockContentionProfiler::LockContentionProfiler()
+        : _mutex( "LockContentionProfiler" ) {
+    }
+
+    bool LockContentionProfiler::wants( Kind kind, long long micros ) const {
+        return micros > _threshold[kind].load();
+    }
+
+    namespace {
+        bool longerThan( const LockContentionProfiler::Sample& a,
+                         const LockContentionProfiler::Sample& b ) {
+            return a.micros > b.micros;
+        }
+    }
+
+    void LockContentionProfiler::record( Kind kind, char mode, long long micros,
+                                         const StringData& op, const StringData& ns,
+                                         long long opid ) {
+        scoped_lock lk( _mutex );
+        std::vector<Sample>& samples = _samples[kind];
+        if ( samples.size() == MaxSamples && micros <= samples.back().micros )
+            return;
+
+        Sample s;
+        s.mode = mode;
+        s.micros = micros;
+        s.op = op.toString();
+        s.ns = ns.toString();
+        s.opid = opid;
+
+        samples.insert( std::upper_bound( samples.begin(), samples.end(), s, longerThan ), s );
+        if ( samples.size() > MaxSamples )
+            samples.pop_back();
+        if ( samples.size() == MaxSamples )
+            _threshold[kind].store( samples.back().micros );
+    }
+
+    void LockContentionProfiler::reset() {
+        scoped_lock lk( _mutex );
+        for ( int i = 0; i < 2; i++ ) {
+            _samples[i].clear();
+            _threshold[i].store( 0 );
+        }
+    }
+
+    std::vector<LockContentionProfiler::Sample> LockContentionProfiler::samples( Kind kind ) const {
+        scoped_lock lk( _mutex );
+        return _samples[kind];
+    }
+
+    BSONObj LockContentionProfiler::report() const {
+        static const char* const names[] = { "longestWaits", "longestHolds" };
+        BSONObjBuilder b;
+        for ( int i = 0; i < 2; i++ ) {
+            std::vector<Sample> kept = samples( static_cast<Kind>( i ) );
+            BSONArrayBuilder arr( b.subarrayStart( names[i] ) );
+            for ( unsigned j = 0; j < kept.size(); j++ ) {
+                BSONObjBuilder s( arr.subobjStart() );
+                s.append( "mode" , string( 1, kept[j].mode ) );
+                s.append( "micros" , kept[j].micros );
+                s.append( "op" , kept[j].op );
+                s.append( "ns" , kept[j].ns );
+                s.append( "opid" , kept[j].opid );
+                s.done();
+            }
+            arr.done();
+        }
+        return b.obj();
+    }
 }
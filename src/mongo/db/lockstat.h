@@ -31,16 +31,33 @@
 
 #pragma once
 
+#include <vector>
+
+#include "mongo/base/disallow_copying.h"
+#include "mongo/base/string_data.h"
 #include "mongo/platform/atomic_word.h"
+#include "mongo/util/concurrency/mutex.h"
 #include "mongo/util/timer.h"
 
 namespace mongo { 
 
     class BSONObj;
+    class Histogram;
 
     class LockStat { 
+        MONGO_DISALLOW_COPYING(LockStat);
         enum { N = 4 };
     public:
+        LockStat();
+
+        /**
+         * @param trackLatency also keep per mode histograms of acquire and held times.  Meant
+         *        for the long lived per database stats rather than the per operation ones.
+         */
+        explicit LockStat( bool trackLatency );
+
+        ~LockStat();
+
         void recordAcquireTimeMicros( char type , long long micros );
         void recordLockTimeMicros( char type , long long micros );
 
@@ -52,14 +69,61 @@ namespace mongo {
         long long getTimeLocked( char type ) const { return timeLocked[mapNo(type)].load(); }
     private:
         static void _append( BSONObjBuilder& builder, const AtomicInt64* data );
+        static void _appendLatency( BSONObjBuilder& builder, Histogram* const* histograms );
+        static void _recordLatency( Histogram* histogram, long long micros );
         
         // RWrw
         // in micros
         AtomicInt64 timeAcquiring[N];
         AtomicInt64 timeLocked[N];
 
+        // null unless tracking latency
+        Histogram* _acquireLatency[N];
+        Histogram* _lockedLatency[N];
+
         static unsigned mapNo(char type);
         static char nameFor(unsigned offset);
     };
 
+    /**
+     * Keeps the longest lock waits and holds seen, along with the operation responsible, so that
+     * the source of lock contention can be found from serverStatus.  Callers decide how often to
+     * offer samples; wants() is cheap and should be checked before building the strings passed
+     * to record().
+     */
+    class LockContentionProfiler {
+        MONGO_DISALLOW_COPYING(LockContentionProfiler);
+    public:
+        enum Kind { Waiting = 0, Holding = 1 };
+        enum { MaxSamples = 10 };
+
+        struct Sample {
+            char mode;
+            long long micros;
+            std::string op;
+            std::string ns;
+            long long opid;
+        };
+
+        LockContentionProfiler();
+
+        /** @return true if a sample of 'micros' would make it into the kept set right now */
+        bool wants( Kind kind, long long micros ) const;
+
+        void record( Kind kind, char mode, long long micros,
+                     const StringData& op, const StringData& ns, long long opid );
+
+        void reset();
+
+        /** longest first */
+        std::vector<Sample> samples( Kind kind ) const;
+
+        BSONObj report() const;
+
+    private:
+        mutable mongo::mutex _mutex;
+        std::vector<Sample> _samples[2]; // sorted longest first, at most MaxSamples
+        AtomicInt64 _threshold[2];       // shortest kept sample once full, else 0
+    };
+
 }
@@ -128,7 +128,7 @@ namespace mongo {
     public:
         string name() const { return r.name; }
         LockStat stats;
-        WrapperForRWLock(const StringData& name) : r(name) { }
+        WrapperForRWLock(const StringData& name) : r(name), stats(true) { }
         void lock()          { r.lock(); }
         void lock_shared()   { r.lock_shared(); }
         void unlock()        { r.unlock(); }
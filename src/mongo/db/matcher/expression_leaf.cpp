@@ -395,9 +395,92 @@ namespace mongo {
             _hasEmptyArray = true;
 
         _equalities.insert( e );
+
+        if ( !_hashedEqualities.empty() ) {
+            _hashedEqualities.insert( e );
+        }
+        else if ( _equalities.size() > HashedLookupThreshold ) {
+            _hashedEqualities.insert( _equalities.begin(), _equalities.end() );
+        }
         return Status::OK();
     }
 
+    bool ArrayFilterEntries::contains( const BSONElement& elem ) const {
+        if ( !_hashedEqualities.empty() )
+            return _hashedEqualities.count( elem ) > 0;
+        return _equalities.count( elem ) > 0;
+    }
+
+    namespace {
+
+        // 64 bit FNV-1a
+        const unsigned long long kFnvPrime = 1099511628211ULL;
+        const unsigned long long kFnvOffset = 14695981039346656037ULL;
+
+        inline unsigned long long hashBytes( const void* data, size_t len,
+                                             unsigned long long h ) {
+            const unsigned char* p = static_cast<const unsigned char*>( data );
+            for ( size_t i = 0; i < len; i++ ) {
+                h ^= p[i];
+                h *= kFnvPrime;
+            }
+            return h;
+        }
+
+        unsigned long long hashValue( const BSONElement& e, unsigned long long h ) {
+            int canonicalType = e.canonicalType();
+            h = hashBytes( &canonicalType, sizeof( canonicalType ), h );
+
+            switch ( e.type() ) {
+            case NumberDouble:
+            case NumberInt:
+            case NumberLong: {
+                // Numbers of any type are compared as doubles unless both are longs, so hash
+                // the double.  Longs too close to tell apart as doubles only collide.
+                double d = e.number();
+                if ( d == 0 )
+                    d = 0; // -0.0 == 0.0
+                if ( isNaN( d ) )
+                    return h; // all NaNs are equal
+                return hashBytes( &d, sizeof( d ), h );
+            }
+            case String:
+            case Symbol:
+            case Code:
+                return hashBytes( e.valuestr(), e.valuestrsize(), h );
+            case Bool:
+            case Date:
+            case Timestamp:
+            case jstOID:
+            case BinData:
+            case DBRef:
+                return hashBytes( e.value(), e.valuesize(), h );
+            case RegEx:
+                h = hashBytes( e.regex(), strlen( e.regex() ), h );
+                return hashBytes( e.regexFlags(), strlen( e.regexFlags() ), h );
+            case Object:
+            case Array: {
+                // embedded objects compare field names too
+                BSONObjIterator i( e.embeddedObject() );
+                while ( i.more() ) {
+                    BSONElement sub = i.next();
+                    h = hashBytes( sub.fieldName(), sub.fieldNameSize(), h );
+                    h = hashValue( sub, h );
+                }
+                return h;
+            }
+            default:
+                // null, MinKey, MaxKey, CodeWScope...: the type alone is enough to be consistent
+                return h;
+            }
+        }
+
+    } // namespace
+
+    size_t ArrayFilterEntries::ValueHasher::operator()( const BSONElement& e ) const {
+        return static_cast<size_t>( hashValue( e, kFnvOffset ) );
+    }
+
     Status ArrayFilterEntries::addRegex( RegexMatchExpression* expr ) {
         _regexes.push_back( expr );
         return Status::OK();
@@ -420,6 +503,7 @@ namespace mongo {
         toFillIn._hasNull = _hasNull;
         toFillIn._hasEmptyArray = _hasEmptyArray;
         toFillIn._equalities = _equalities;
+        toFillIn._hashedEqualities = _hashedEqualities;
         for ( unsigned i = 0; i < _regexes.size(); i++ )
             toFillIn._regexes.push_back( static_cast<RegexMatchExpression*>(_regexes[i]->shallowClone()) );
     }
@@ -37,6 +37,7 @@
 #include "mongo/bson/bsonobj.h"
 #include "mongo/bson/bsonmisc.h"
 #include "mongo/db/matcher/expression.h"
+#include "mongo/platform/unordered_set.h"
 
 namespace mongo {
 
@@ -282,7 +283,7 @@ namespace mongo {
         Status addRegex( RegexMatchExpression* expr );
 
         const BSONElementSet& equalities() const { return _equalities; }
-        bool contains( const BSONElement& elem ) const { return _equalities.count(elem) > 0; }
+        bool contains( const BSONElement& elem ) const;
 
         size_t numRegexes() const { return _regexes.size(); }
         RegexMatchExpression* regex( int idx ) const { return _regexes[idx]; }
@@ -296,10 +297,31 @@ namespace mongo {
 
         void copyTo( ArrayFilterEntries& toFillIn ) const;
 
+        /**
+         * Hashes an element's value consistently with BSONElementCmpWithoutField: values that
+         * compare equal, such as numbers of different types, hash equal.
+         */
+        struct ValueHasher {
+            size_t operator()( const BSONElement& e ) const;
+        };
+
+        struct ValueEq {
+            bool operator()( const BSONElement& l, const BSONElement& r ) const {
+                return l.woCompare( r, false ) == 0;
+            }
+        };
+
+        /** Past this many equalities contains() uses a hash table rather than the ordered set. */
+        static const size_t HashedLookupThreshold = 16;
+
     private:
+        typedef unordered_set<BSONElement, ValueHasher, ValueEq> HashedElementSet;
+
         bool _hasNull; // if _equalities has a jstNULL element in it
         bool _hasEmptyArray;
         BSONElementSet _equalities;
+        // same contents as _equalities once it is larger than HashedLookupThreshold, else empty
+        HashedElementSet _hashedEqualities;
         std::vector<RegexMatchExpression*> _regexes;
     };
 
@@ -1314,6 +1314,61 @@ namespace mongo {
     }
 
 
+    TEST( InMatchExpression, MatchesElementManyHashed ) {
+        // Enough equalities that lookups go through the hash table.
+        BSONArrayBuilder operandBuilder;
+        for ( int i = 0; i < 1000; i += 2 ) {
+            operandBuilder.append( i );
+        }
+        operandBuilder.append( "r" );
+        operandBuilder.append( 2.5 );
+        operandBuilder.append( BSON( "x" << 1 << "y" << BSON_ARRAY( 2 << 3 ) ) );
+        operandBuilder.append( BSON_ARRAY( 4 << 5 ) );
+        BSONObj operand = operandBuilder.arr();
+        InMatchExpression in;
+        BSONObjIterator it( operand );
+        while ( it.more() ) {
+            ASSERT( in.getArrayFilterEntries()->addEquality( it.next() ).isOK() );
+        }
+
+        for ( int i = 0; i < 1000; ++i ) {
+            BSONObj match = BSON( "a" << i );
+            ASSERT_EQUALS( i % 2 == 0, in.matchesSingleElement( match[ "a" ] ) );
+        }
+        // Numbers of other types with equal values match.
+        BSONObj matchDouble = BSON( "a" << 10.0 );
+        BSONObj matchLong = BSON( "a" << 20LL );
+        BSONObj matchNegativeZero = BSON( "a" << -0.0 );
+        BSONObj matchFraction = BSON( "a" << 2.5 );
+        BSONObj notMatchFraction = BSON( "a" << 10.5 );
+        ASSERT( in.matchesSingleElement( matchDouble[ "a" ] ) );
+        ASSERT( in.matchesSingleElement( matchLong[ "a" ] ) );
+        ASSERT( in.matchesSingleElement( matchNegativeZero[ "a" ] ) );
+        ASSERT( in.matchesSingleElement( matchFraction[ "a" ] ) );
+        ASSERT( !in.matchesSingleElement( notMatchFraction[ "a" ] ) );
+
+        BSONObj matchString = BSON( "a" << "r" );
+        BSONObj notMatchString = BSON( "a" << "s" );
+        ASSERT( in.matchesSingleElement( matchString[ "a" ] ) );
+        ASSERT( !in.matchesSingleElement( notMatchString[ "a" ] ) );
+
+        // Embedded objects match on field names and values, with numbers of any type.
+        BSONObj matchObject = BSON( "a" << BSON( "x" << 1.0 << "y" << BSON_ARRAY( 2LL << 3 ) ) );
+        BSONObj notMatchObject = BSON( "a" << BSON( "z" << 1 << "y" << BSON_ARRAY( 2 << 3 ) ) );
+        BSONObj matchArray = BSON( "a" << BSON_ARRAY( 4 << 5.0 ) );
+        BSONObj notMatchArray = BSON( "a" << BSON_ARRAY( 5 << 4 ) );
+        ASSERT( in.matchesSingleElement( matchObject[ "a" ] ) );
+        ASSERT( !in.matchesSingleElement( notMatchObject[ "a" ] ) );
+        ASSERT( in.matchesSingleElement( matchArray[ "a" ] ) );
+        ASSERT( !in.matchesSingleElement( notMatchArray[ "a" ] ) );
+
+        // A copy matches the same way.
+        InMatchExpression copy;
+        in.copyTo( &copy );
+        ASSERT( copy.matchesSingleElement( matchLong[ "a" ] ) );
+        ASSERT( !copy.matchesSingleElement( notMatchFraction[ "a" ] ) );
+    }
+
     TEST( InMatchExpression, MatchesScalar ) {
         BSONObj operand = BSON_ARRAY( 5 );
         InMatchExpression in;
@@ -39,6 +39,7 @@
 #include "mongo/db/index_legacy.h"
 #include "mongo/db/json.h"
 #include "mongo/db/storage/durable_mapped_file.h"
+#include "mongo/db/storage/free_space_index.h"
 #include "mongo/db/ops/delete.h"
 #include "mongo/db/ops/update.h"
 #include "mongo/db/pdfile.h"
@@ -151,6 +152,7 @@ namespace mongo {
             DiskLoc oldHead = list;
             getDur().writingDiskLoc(list) = dloc;
             d->nextDeleted() = oldHead;
+            FreeSpaceIndex::get(this)->added(dloc, d->lengthWithHeaders(), oldHead);
         }
     }
 
@@ -263,6 +265,14 @@ namespace mongo {
        returned item is out of the deleted list upon return
     */
     DiskLoc NamespaceDetails::__stdAlloc(int len, bool peekOnly) {
+        {
+            DiskLoc bestFit;
+            if ( FreeSpaceIndex::get(this)->alloc(len, peekOnly, &bestFit) )
+                return bestFit;
+        }
+
+        // too many deleted records to keep an index of, search the chains
+
         DiskLoc *prev;
         DiskLoc *bestprev = 0;
         DiskLoc bestmatch;
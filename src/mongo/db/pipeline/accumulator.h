@@ -53,6 +53,15 @@ namespace mongo {
         /// The name of the op as used in a serialization of the pipeline.
         virtual const char* getOpName() const = 0;
 
+        /** Fold the state of 'other' into this accumulator.
+         *  'other' must be of the same type and must have seen input that came after ours.
+         *  The default goes through getValue(true) and process(..., true); subclasses whose
+         *  state can be combined directly override this.
+         */
+        virtual void merge(const Accumulator& other) {
+            process(other.getValue(/*toBeMerged=*/true), /*merging=*/true);
+        }
+
         int memUsageForSorter() const {
             dassert(_memUsageBytes != 0); // This would mean subclass didn't set it
             return _memUsageBytes;
@@ -77,6 +86,7 @@ namespace mongo {
         virtual void processInternal(const Value& input, bool merging);
         virtual Value getValue(bool toBeMerged) const;
         virtual const char* getOpName() const;
+        virtual void merge(const Accumulator& other);
         virtual void reset();
 
         static intrusive_ptr<Accumulator> create();
@@ -125,6 +135,7 @@ namespace mongo {
         virtual void processInternal(const Value& input, bool merging);
         virtual Value getValue(bool toBeMerged) const;
         virtual const char* getOpName() const;
+        virtual void merge(const Accumulator& other);
         virtual void reset();
 
         static intrusive_ptr<Accumulator> create();
@@ -143,6 +154,7 @@ namespace mongo {
         virtual void processInternal(const Value& input, bool merging);
         virtual Value getValue(bool toBeMerged) const;
         virtual const char* getOpName() const;
+        virtual void merge(const Accumulator& other);
         virtual void reset();
 
         static intrusive_ptr<Accumulator> createMin();
@@ -161,6 +173,7 @@ namespace mongo {
         virtual void processInternal(const Value& input, bool merging);
         virtual Value getValue(bool toBeMerged) const;
         virtual const char* getOpName() const;
+        virtual void merge(const Accumulator& other);
         virtual void reset();
 
         static intrusive_ptr<Accumulator> create();
@@ -177,6 +190,7 @@ namespace mongo {
         virtual void processInternal(const Value& input, bool merging);
         virtual Value getValue(bool toBeMerged) const;
         virtual const char* getOpName() const;
+        virtual void merge(const Accumulator& other);
         virtual void reset();
 
         static intrusive_ptr<Accumulator> create();
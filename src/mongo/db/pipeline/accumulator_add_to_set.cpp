@@ -59,6 +59,18 @@ namespace mongo {
         }
     }
 
+    void AccumulatorAddToSet::merge(const Accumulator& other) {
+        dassert(str::equals(getOpName(), other.getOpName()));
+        const AccumulatorAddToSet& rhs = static_cast<const AccumulatorAddToSet&>(other);
+
+        for (SetType::const_iterator it = rhs.set.begin(); it != rhs.set.end(); ++it) {
+            bool inserted = set.insert(*it).second;
+            if (inserted) {
+                _memUsageBytes += it->getApproximateSize();
+            }
+        }
+    }
+
     Value AccumulatorAddToSet::getValue(bool toBeMerged) const {
         vector<Value> valVec(set.begin(), set.end());
         return Value::consume(valVec);
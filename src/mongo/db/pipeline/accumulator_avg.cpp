@@ -58,6 +58,14 @@ namespace {
         }
     }
 
+    void AccumulatorAvg::merge(const Accumulator& other) {
+        dassert(str::equals(getOpName(), other.getOpName()));
+        const AccumulatorAvg& rhs = static_cast<const AccumulatorAvg&>(other);
+
+        _total += rhs._total;
+        _count += rhs._count;
+    }
+
     intrusive_ptr<Accumulator> AccumulatorAvg::create() {
         return new AccumulatorAvg();
     }
@@ -45,6 +45,11 @@ namespace mongo {
         }
     }
 
+    void AccumulatorMinMax::merge(const Accumulator& other) {
+        dassert(str::equals(getOpName(), other.getOpName()));
+        processInternal(static_cast<const AccumulatorMinMax&>(other)._val, /*merging=*/true);
+    }
+
     Value AccumulatorMinMax::getValue(bool toBeMerged) const {
         return _val;
     }
@@ -56,6 +56,14 @@ namespace mongo {
         }
     }
 
+    void AccumulatorPush::merge(const Accumulator& other) {
+        dassert(str::equals(getOpName(), other.getOpName()));
+        const AccumulatorPush& rhs = static_cast<const AccumulatorPush&>(other);
+
+        vpValue.insert(vpValue.end(), rhs.vpValue.begin(), rhs.vpValue.end());
+        _memUsageBytes += rhs._memUsageBytes - sizeof(rhs);
+    }
+
     Value AccumulatorPush::getValue(bool toBeMerged) const {
         return Value(vpValue);
     }
@@ -56,6 +56,15 @@ namespace mongo {
         }
     }
 
+    void AccumulatorSum::merge(const Accumulator& other) {
+        dassert(str::equals(getOpName(), other.getOpName()));
+        const AccumulatorSum& rhs = static_cast<const AccumulatorSum&>(other);
+
+        totalType = Value::getWidestNumeric(totalType, rhs.totalType);
+        longTotal += rhs.longTotal;
+        doubleTotal += rhs.doubleTotal;
+    }
+
     intrusive_ptr<Accumulator> AccumulatorSum::create() {
         return new AccumulatorSum();
     }
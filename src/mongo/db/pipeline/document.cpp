@@ -66,7 +66,50 @@ namespace mongo {
             }
         }
 
-        // if we got here, there's no such field
+        // if we got here, there's no such field among those loaded so far
+        if (_lazyOffset)
+            return const_cast<DocumentStorage*>(this)->loadLazyFields(&requested);
+
+        return Position();
+    }
+
+    DocumentStorage::DocumentStorage(const BSONObj& bson, const BSONObj& owner)
+        : _buffer(NULL)
+        , _bufferEnd(NULL)
+        , _usedBytes(0)
+        , _numFields(0)
+        , _hashTabMask(0)
+        , _bson(bson)
+        , _bsonOwner(owner)
+        , _lazyOffset(bson.isEmpty() ? 0 : sizeof(int)) // first element follows the size
+        , _bsonBacked(true)
+    {}
+
+    Position DocumentStorage::loadLazyFields(const StringData* stopAt) {
+        while (_lazyOffset) {
+            const BSONElement elem(_bson.objdata() + _lazyOffset);
+            if (elem.eoo()) {
+                _lazyOffset = 0;
+                break;
+            }
+            _lazyOffset += elem.size();
+
+            const StringData name = elem.fieldNameStringData();
+            const Position pos = getNextPosition();
+            if (elem.type() == Object && !elem.embeddedObject().isEmpty()) {
+                // Sub-documents are lazy too, sharing our buffer.
+                const BSONObj& owner = _bsonOwner.isEmpty() ? _bson : _bsonOwner;
+                Document sub(new DocumentStorage(elem.embeddedObject(), owner));
+                appendField(name) = Value(sub);
+            }
+            else {
+                appendField(name) = Value(elem);
+            }
+
+            if (stopAt && name == *stopAt)
+                return pos;
+        }
+
         return Position();
     }
 
@@ -195,6 +238,10 @@ namespace mongo {
         out->_usedBytes = _usedBytes;
         out->_numFields = _numFields;
         out->_hashTabMask = _hashTabMask;
+        out->_bson = _bson;
+        out->_bsonOwner = _bsonOwner;
+        out->_lazyOffset = _lazyOffset;
+        out->_bsonBacked = _bsonBacked;
 
         // Tell values that they have been memcpyed (updates ref counts)
         for (DocumentStorageIterator it = out->iteratorAll(); !it.atEnd(); it.advance()) {
@@ -224,6 +271,25 @@ namespace mongo {
         *this = md.freeze();
     }
 
+    Document Document::fromBsonLazy(const BSONObj& bson) {
+        if (bson.isEmpty())
+            return Document();
+
+        verify(bson.isOwned());
+        return Document(new DocumentStorage(bson, BSONObj()));
+    }
+
+    void Document::loadLazyFields() const {
+        if (!_storage)
+            return;
+
+        // iterator() loads this level, and only Object fields are loaded lazily below it.
+        for (DocumentStorageIterator it = storage().iterator(); !it.atEnd(); it.advance()) {
+            if (it->val.getType() == Object)
+                it->val.getDocument().loadLazyFields();
+        }
+    }
+
     BSONObjBuilder& operator << (BSONObjBuilderValueStream& builder, const Document& doc) {
         BSONObjBuilder subobj(builder.subobjStart());
         doc.toBson(&subobj);
@@ -232,12 +298,21 @@ namespace mongo {
     }
 
     void Document::toBson(BSONObjBuilder* pBuilder) const {
+        if (storage().isBsonBacked()) {
+            // Nothing has changed since this was read, so copy the original without loading it.
+            pBuilder->appendElements(storage().bson());
+            return;
+        }
+
         for (DocumentStorageIterator it = storage().iterator(); !it.atEnd(); it.advance()) {
             *pBuilder << it->nameSD() << it->val;
         }
     }
 
     BSONObj Document::toBson() const {
+        if (storage().isBsonBacked() && storage().bson().isOwned())
+            return storage().bson();
+
         BSONObjBuilder bb;
         toBson(&bb);
         return bb.obj();
@@ -322,11 +397,16 @@ namespace mongo {
         size_t size = sizeof(DocumentStorage);
         size += storage().allocatedBytes();
 
-        for (DocumentStorageIterator it = storage().iterator(); !it.atEnd(); it.advance()) {
+        // Only counts the fields loaded so far, so that estimating the size of a lazy document
+        // doesn't load it. The rest are counted as part of the backing BSONObj.
+        for (DocumentStorageIterator it = storage().iteratorAll(); !it.atEnd(); it.advance()) {
             size += it->val.getApproximateSize();
             size -= sizeof(Value); // already accounted for above
         }
 
+        if (storage().isBsonBacked())
+            size += storage().bson().objsize();
+
         return size;
     }
 
@@ -71,6 +71,18 @@ namespace mongo {
         /// Create a new Document deep-converted from the given BSONObj.
         explicit Document(const BSONObj& bson);
 
+        /** Create a Document that converts fields of the given owned BSONObj only when they are
+         *  first looked up, and serializes back to it until modified through MutableDocument.
+         *  Looking up a field loads all fields before it; iterating loads them all.
+         */
+        static Document fromBsonLazy(const BSONObj& bson);
+
+        /** Loads every field of a lazy Document and of its lazy sub-documents. Looking up a field
+         *  of a lazy Document writes to storage that it may share with other Documents, so this
+         *  must be called before handing it to another thread.
+         */
+        void loadLazyFields() const;
+
         void swap(Document& rhs) { _storage.swap(rhs._storage); }
 
         /// Look up a field by key name. Returns Value() if no such field. O(1)
@@ -167,6 +179,7 @@ namespace mongo {
 
     private:
         friend class FieldIterator;
+        friend class DocumentStorage;
         friend class ValueStorage;
         friend class MutableDocument;
         friend class MutableValue;
@@ -251,7 +264,7 @@ namespace mongo {
      *
      *  To preserve the immutability of Documents, MutableDocument will
      *  shallow-clone its storage on write (COW) if it is shared with any other
-     *  Documents.
+     *  Documents. Writing to a lazy Document loads all of its fields first.
      */
     class MutableDocument : boost::noncopyable {
     public:
@@ -392,7 +405,10 @@ namespace mongo {
                 return clonedStorage();
 
             // This function exists to ensure this is safe
-            return const_cast<DocumentStorage&>(*storagePtr());
+            DocumentStorage& ds = const_cast<DocumentStorage&>(*storagePtr());
+            if (MONGO_unlikely( ds.isBsonBacked() ))
+                ds.detachFromBson();
+            return ds;
         }
         DocumentStorage& newStorage() {
             reset(new DocumentStorage);
@@ -400,7 +416,9 @@ namespace mongo {
         }
         DocumentStorage& clonedStorage() {
             reset(storagePtr()->clone().get());
-            return const_cast<DocumentStorage&>(*storagePtr());
+            DocumentStorage& ds = const_cast<DocumentStorage&>(*storagePtr());
+            ds.detachFromBson();
+            return ds;
         }
 
         // recursive helpers for same-named public methods
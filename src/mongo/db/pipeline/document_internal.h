@@ -166,7 +166,16 @@ namespace mongo {
                           , _usedBytes(0)
                           , _numFields(0)
                           , _hashTabMask(0)
+                          , _lazyOffset(0)
+                          , _bsonBacked(false)
         {}
+
+        /** Storage whose fields are read from 'bson' as they are first looked up.
+         *  'owner' keeps 'bson' alive if it is embedded in a larger object, otherwise it is empty
+         *  and 'bson' must be owned.
+         */
+        DocumentStorage(const BSONObj& bson, const BSONObj& owner);
+
         ~DocumentStorage();
 
         static const DocumentStorage& emptyDoc() {
@@ -220,12 +229,14 @@ namespace mongo {
          */
         void reserveFields(size_t expectedFields);
 
-        /// This skips missing values
+        /// This skips missing values. Loads all remaining fields of a lazy document.
         DocumentStorageIterator iterator() const {
+            if (MONGO_unlikely(_lazyOffset))
+                const_cast<DocumentStorage*>(this)->loadLazyFields(NULL);
             return DocumentStorageIterator(_firstElement, end(), false);
         }
 
-        /// This includes missing values
+        /// This includes missing values but only the fields that have been loaded so far
         DocumentStorageIterator iteratorAll() const {
             return DocumentStorageIterator(_firstElement, end(), true);
         }
@@ -237,8 +248,29 @@ namespace mongo {
             return !_buffer ? 0 : (_bufferEnd - _buffer + hashTabBytes());
         }
 
+        /** True while the fields are exactly those of the BSONObj this was created from.
+         *  Such storage can be serialized by copying bson().
+         */
+        bool isBsonBacked() const { return _bsonBacked; }
+        const BSONObj& bson() const { return _bson; }
+
+        /// Loads any fields not yet read from the backing BSONObj and then forgets it.
+        void detachFromBson() {
+            if (_lazyOffset)
+                loadLazyFields(NULL);
+            _bson = BSONObj();
+            _bsonOwner = BSONObj();
+            _bsonBacked = false;
+        }
+
     private:
 
+        /** Appends fields from _bson in order until one named *stopAt has been added, returning
+         *  its Position. With stopAt NULL, or if there is no such field, loads all of them and
+         *  returns Position().
+         */
+        Position loadLazyFields(const StringData* stopAt);
+
         /// Same as lastElement->next() or firstElement() if empty.
         const ValueElement* end() const { return _firstElement->plusBytes(_usedBytes); }
 
@@ -305,6 +337,15 @@ namespace mongo {
         unsigned _usedBytes; // position where next field would start
         unsigned _numFields; // this includes removed fields
         unsigned _hashTabMask; // equal to hashTabBuckets()-1 but used more often
+
+        // Lazy documents (see Document::fromBsonLazy) copy fields out of _bson only as they are
+        // looked up. Fields are always loaded in order so Positions never move. Loading writes
+        // through const methods to storage that may be shared, so a lazy Document must be fully
+        // loaded (Document::loadLazyFields) before another thread may read it.
+        BSONObj _bson;
+        BSONObj _bsonOwner; // holds _bson's buffer when _bson is a sub-object
+        unsigned _lazyOffset; // offset of the next field to load in _bson, 0 if none remain
+        bool _bsonBacked; // see isBsonBacked()
         // When adding a field, make sure to update clone() method
     };
 }
@@ -530,12 +530,38 @@ namespace mongo {
     private:
         DocumentSourceGroup(const intrusive_ptr<ExpressionContext> &pExpCtx);
 
-        /// Spill groups map to disk and returns an iterator to the file.
-        shared_ptr<Sorter<Value, Value>::Iterator> spill();
+        typedef vector<intrusive_ptr<Accumulator> > Accumulators;
+        typedef boost::unordered_map<Value, Accumulators, Value::Hash> GroupsMap;
+
+        /// Spill a groups map to disk, empty it and return an iterator to the file.
+        shared_ptr<Sorter<Value, Value>::Iterator> spill(GroupsMap* groupsToSpill);
 
         // Only used by spill. Would be function-local if that were legal in C++03.
         class SpillSTLComparator;
 
+        /**
+          Feed the ROOT document already set in 'variables' to the accumulators of group 'id'
+          in 'groupsMap', creating them if needed.  Adds the change in memory used to
+          '*memoryUsageBytes' and returns true if this was a new group.
+         */
+        bool accumulate(const Value& id,
+                        Variables* variables,
+                        GroupsMap* groupsMap,
+                        int* memoryUsageBytes);
+
+        /*
+          populate() with the accumulation spread over worker threads.  Input is partitioned
+          on the hash of the group key, so each group lives in exactly one partition and sees
+          its input in order.  Each partition has its own share of the memory limit and
+          spills on its own.  If any partition spilled, every partition's groups end up in
+          'sortedFiles'; otherwise they are all gathered into 'groups'.
+         */
+        void populateParallel(int numPartitions,
+                              vector<shared_ptr<Sorter<Value, Value>::Iterator> >* sortedFiles);
+
+        // One worker's share of the groups.  Defined in document_source_group.cpp.
+        class Partition;
+
         /*
           Before returning anything, this source must fetch everything from
           the underlying source and group it.  populate() is used to do that
@@ -547,8 +573,6 @@ namespace mongo {
 
         intrusive_ptr<Expression> pIdExpression;
 
-        typedef vector<intrusive_ptr<Accumulator> > Accumulators;
-        typedef boost::unordered_map<Value, Accumulators, Value::Hash> GroupsMap;
         GroupsMap groups;
 
         /*
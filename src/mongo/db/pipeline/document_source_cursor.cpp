@@ -145,9 +145,11 @@ namespace mongo {
                     if ( !_collMetadata->keyBelongsToMe( kp.extractSingleKey( next ) ) ) continue;
                 }
 
+                // Without a projection the whole document is needed, but often only a few of its
+                // fields are ever looked at, so convert them lazily.
                 _currentBatch.push_back(_projection
                                             ? documentFromBsonWithDeps(next, _dependencies)
-                                            : Document(next));
+                                            : Document::fromBsonLazy(next.getOwned()));
             }
 
             if (_limit) {
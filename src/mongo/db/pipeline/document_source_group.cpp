@@ -36,8 +36,17 @@
 #include "mongo/db/pipeline/expression.h"
 #include "mongo/db/pipeline/expression_context.h"
 #include "mongo/db/pipeline/value.h"
+#include "mongo/db/server_parameters.h"
+#include "mongo/util/concurrency/thread_pool.h"
+#include "mongo/util/queue.h"
 
 namespace mongo {
+    // Number of threads $group accumulates on.  1 accumulates on the calling thread.
+    MONGO_EXPORT_SERVER_PARAMETER(internalAggregationGroupThreads, int, 1);
+
+    // Bytes of groups $group holds in memory before spilling, split among the threads above.
+    MONGO_EXPORT_SERVER_PARAMETER(internalDocumentSourceGroupMaxMemoryBytes, int, 100*1024*1024);
+
     const char DocumentSourceGroup::groupName[] = "$group";
 
     const char *DocumentSourceGroup::getSourceName() const {
@@ -179,7 +188,7 @@ namespace mongo {
         , _doingMerge(false)
         , _spilled(false)
         , _extSortAllowed(pExpCtx->extSortAllowed && !pExpCtx->inRouter)
-        , _maxMemoryUsageBytes(100*1024*1024)
+        , _maxMemoryUsageBytes(internalDocumentSourceGroupMaxMemoryBytes)
     {}
 
     void DocumentSourceGroup::addAccumulator(
@@ -351,73 +360,91 @@ namespace mongo {
         };
     }
 
+    bool DocumentSourceGroup::accumulate(const Value& id,
+                                         Variables* variables,
+                                         GroupsMap* groupsMap,
+                                         int* memoryUsageBytes) {
+        const size_t numAccumulators = vpAccumulatorFactory.size();
+
+        /*
+          Look for the _id value in the map; if it's not there, add a
+          new entry with a blank accumulator.
+        */
+        const size_t oldSize = groupsMap->size();
+        vector<intrusive_ptr<Accumulator> >& group = (*groupsMap)[id];
+        const bool inserted = groupsMap->size() != oldSize;
+
+        if (inserted) {
+            *memoryUsageBytes += id.getApproximateSize();
+
+            // Add the accumulators
+            group.reserve(numAccumulators);
+            for (size_t i = 0; i < numAccumulators; i++) {
+                group.push_back(vpAccumulatorFactory[i]());
+            }
+        } else {
+            for (size_t i = 0; i < numAccumulators; i++) {
+                // subtract old mem usage. New usage added back after processing.
+                *memoryUsageBytes -= group[i]->memUsageForSorter();
+            }
+        }
+
+        /* tickle all the accumulators for the group we found */
+        dassert(numAccumulators == group.size());
+        for (size_t i = 0; i < numAccumulators; i++) {
+            group[i]->process(vpExpression[i]->evaluate(variables), _doingMerge);
+            *memoryUsageBytes += group[i]->memUsageForSorter();
+        }
+
+        return inserted;
+    }
+
     void DocumentSourceGroup::populate() {
         const size_t numAccumulators = vpAccumulatorFactory.size();
         dassert(numAccumulators == vpExpression.size());
 
         // pushed to on spill()
         vector<shared_ptr<Sorter<Value, Value>::Iterator> > sortedFiles;
-        int memoryUsageBytes = 0;
-
-        // This loop consumes all input from pSource and buckets it based on pIdExpression.
-        while (boost::optional<Document> input = pSource->getNext()) {
-            if (memoryUsageBytes > _maxMemoryUsageBytes) {
-                uassert(16945, "Exceeded memory limit for $group, but didn't allow external sort",
-                        _extSortAllowed);
-                sortedFiles.push_back(spill());
-                memoryUsageBytes = 0;
-            }
 
-            _variables->setRoot(*input);
+        if (internalAggregationGroupThreads > 1) {
+            populateParallel(internalAggregationGroupThreads, &sortedFiles);
+        }
+        else {
+            int memoryUsageBytes = 0;
+
+            // This loop consumes all input from pSource and buckets it based on pIdExpression.
+            while (boost::optional<Document> input = pSource->getNext()) {
+                if (memoryUsageBytes > _maxMemoryUsageBytes) {
+                    uassert(16945,
+                            "Exceeded memory limit for $group, but didn't allow external sort",
+                            _extSortAllowed);
+                    sortedFiles.push_back(spill(&groups));
+                    memoryUsageBytes = 0;
+                }
 
-            /* get the _id value */
-            Value id = pIdExpression->evaluate(_variables.get());
+                _variables->setRoot(*input);
 
-            /* treat missing values the same as NULL SERVER-4674 */
-            if (id.missing())
-                id = Value(BSONNULL);
+                /* get the _id value */
+                Value id = pIdExpression->evaluate(_variables.get());
 
-            /*
-              Look for the _id value in the map; if it's not there, add a
-              new entry with a blank accumulator.
-            */
-            const size_t oldSize = groups.size();
-            vector<intrusive_ptr<Accumulator> >& group = groups[id];
-            const bool inserted = groups.size() != oldSize;
-
-            if (inserted) {
-                memoryUsageBytes += id.getApproximateSize();
+                /* treat missing values the same as NULL SERVER-4674 */
+                if (id.missing())
+                    id = Value(BSONNULL);
 
-                // Add the accumulators
-                group.reserve(numAccumulators);
-                for (size_t i = 0; i < numAccumulators; i++) {
-                    group.push_back(vpAccumulatorFactory[i]());
-                }
-            } else {
-                for (size_t i = 0; i < numAccumulators; i++) {
-                    // subtract old mem usage. New usage added back after processing.
-                    memoryUsageBytes -= group[i]->memUsageForSorter();
-                }
-            }
+                const bool inserted = accumulate(id, _variables.get(), &groups, &memoryUsageBytes);
 
-            /* tickle all the accumulators for the group we found */
-            dassert(numAccumulators == group.size());
-            for (size_t i = 0; i < numAccumulators; i++) {
-                group[i]->process(vpExpression[i]->evaluate(_variables.get()), _doingMerge);
-                memoryUsageBytes += group[i]->memUsageForSorter();
-            }
+                // We are done with the ROOT document so release it.
+                _variables->clearRoot();
 
-            // We are done with the ROOT document so release it.
-            _variables->clearRoot();
-
-            DEV {
-                // In debug mode, spill every time we have a duplicate id to stress merge logic.
-                if (!inserted // is a dup
-                        && !pExpCtx->inRouter // can't spill to disk in router
-                        && !_extSortAllowed // don't change behavior when testing external sort
-                        && sortedFiles.size() < 20 // don't open too many FDs
-                        ) {
-                    sortedFiles.push_back(spill());
+                DEV {
+                    // In debug mode, spill every time we have a duplicate id to stress merge logic.
+                    if (!inserted // is a dup
+                            && !pExpCtx->inRouter // can't spill to disk in router
+                            && !_extSortAllowed // don't change behavior when testing external sort
+                            && sortedFiles.size() < 20 // don't open too many FDs
+                            ) {
+                        sortedFiles.push_back(spill(&groups));
+                    }
                 }
             }
         }
@@ -426,7 +453,7 @@ namespace mongo {
         if (!sortedFiles.empty()) {
             _spilled = true;
             if (!groups.empty()) {
-                sortedFiles.push_back(spill());
+                sortedFiles.push_back(spill(&groups));
             }
 
             // We won't be using groups again so free its memory.
@@ -452,6 +479,204 @@ namespace mongo {
         populated = true;
     }
 
+    namespace {
+        // Number of input documents handed to a partition at a time.
+        const size_t kPartitionBatchSize = 256;
+
+        // Number of batches that may wait for a partition before the reader blocks.
+        const size_t kPartitionQueueDepth = 16;
+    }
+
+    class DocumentSourceGroup::Partition : boost::noncopyable {
+    public:
+        // Input documents along with their already evaluated group keys.
+        typedef vector<pair<Value, Document> > Batch;
+
+        Partition(DocumentSourceGroup* group, int maxMemoryUsageBytes)
+            : _group(group)
+            , _variables(new Variables(group->_variables->getNumVars()))
+            , _queue(kPartitionQueueDepth)
+            , _memoryUsageBytes(0)
+            , _maxMemoryUsageBytes(maxMemoryUsageBytes)
+            , _errorCode(0)
+        {}
+
+        /// Queue 'batch' for the worker, which takes ownership.  NULL marks the end of input.
+        void push(Batch* batch) { _queue.push(batch); }
+
+        /// The worker thread's body.  Returns once NULL is popped.
+        void run() {
+            while (Batch* next = _queue.blockingPop()) {
+                boost::scoped_ptr<Batch> batch(next);
+
+                // After an error we only drain the queue so the reader never blocks on us.
+                if (_errorCode)
+                    continue;
+
+                try {
+                    process(*batch);
+                }
+                catch (const DBException& e) {
+                    _errorCode = e.getCode();
+                    _errmsg = e.what();
+                }
+                catch (const std::exception& e) {
+                    _errorCode = 17300;
+                    _errmsg = e.what();
+                }
+            }
+        }
+
+        /// Rethrows on the calling thread any error the worker hit.  Only call after run().
+        void rethrowError() const {
+            if (_errorCode)
+                uasserted(_errorCode, _errmsg);
+        }
+
+        GroupsMap& groups() { return _groups; }
+        vector<shared_ptr<Sorter<Value, Value>::Iterator> >& sortedFiles() { return _sortedFiles; }
+
+    private:
+        void process(const Batch& batch) {
+            for (size_t i = 0; i < batch.size(); i++) {
+                if (_memoryUsageBytes > _maxMemoryUsageBytes) {
+                    uassert(16945,
+                            "Exceeded memory limit for $group, but didn't allow external sort",
+                            _group->_extSortAllowed);
+                    _sortedFiles.push_back(_group->spill(&_groups));
+                    _memoryUsageBytes = 0;
+                }
+
+                _variables->setRoot(batch[i].second);
+                _group->accumulate(batch[i].first, _variables.get(), &_groups, &_memoryUsageBytes);
+                _variables->clearRoot();
+            }
+        }
+
+        DocumentSourceGroup* const _group;
+
+        // Each worker needs its own since expressions write to them.
+        const boost::scoped_ptr<Variables> _variables;
+
+        BlockingQueue<Batch*> _queue;
+
+        GroupsMap _groups;
+        vector<shared_ptr<Sorter<Value, Value>::Iterator> > _sortedFiles;
+        int _memoryUsageBytes;
+        const int _maxMemoryUsageBytes;
+
+        // Set by the worker if processing failed.
+        int _errorCode;
+        string _errmsg;
+    };
+
+    void DocumentSourceGroup::populateParallel(
+            int numPartitions,
+            vector<shared_ptr<Sorter<Value, Value>::Iterator> >* sortedFiles) {
+        vector<shared_ptr<Partition> > partitions;
+        for (int i = 0; i < numPartitions; i++) {
+            partitions.push_back(
+                boost::make_shared<Partition>(this, _maxMemoryUsageBytes / numPartitions));
+        }
+
+        ThreadPool pool(numPartitions);
+        for (int i = 0; i < numPartitions; i++) {
+            pool.schedule(&Partition::run, partitions[i].get());
+        }
+
+        // The batch being filled for each partition.
+        vector<Partition::Batch*> batches(numPartitions, static_cast<Partition::Batch*>(NULL));
+        const Value::Hash hasher = Value::Hash();
+
+        try {
+            // Here we only compute the _id and route each document to its partition; the
+            // accumulators are evaluated by the workers.
+            while (boost::optional<Document> input = pSource->getNext()) {
+                // The worker reads this on another thread, and upstream stages may share parts of
+                // it with documents going to other workers.
+                input->loadLazyFields();
+
+                _variables->setRoot(*input);
+                Value id = pIdExpression->evaluate(_variables.get());
+                _variables->clearRoot();
+
+                /* treat missing values the same as NULL SERVER-4674 */
+                if (id.missing())
+                    id = Value(BSONNULL);
+
+                const size_t partition = hasher(id) % numPartitions;
+                if (!batches[partition]) {
+                    batches[partition] = new Partition::Batch();
+                    batches[partition]->reserve(kPartitionBatchSize);
+                }
+                batches[partition]->push_back(make_pair(id, *input));
+
+                if (batches[partition]->size() == kPartitionBatchSize) {
+                    partitions[partition]->push(batches[partition]);
+                    batches[partition] = NULL;
+                }
+            }
+        }
+        catch (...) {
+            // The workers must be stopped before we unwind past them.
+            for (int i = 0; i < numPartitions; i++) {
+                delete batches[i];
+                partitions[i]->push(NULL);
+            }
+            pool.join();
+            throw;
+        }
+
+        for (int i = 0; i < numPartitions; i++) {
+            if (batches[i])
+                partitions[i]->push(batches[i]);
+            partitions[i]->push(NULL);
+        }
+        pool.join();
+
+        for (int i = 0; i < numPartitions; i++) {
+            partitions[i]->rethrowError();
+        }
+
+        for (int i = 0; i < numPartitions; i++) {
+            const vector<shared_ptr<Sorter<Value, Value>::Iterator> >& files =
+                partitions[i]->sortedFiles();
+            sortedFiles->insert(sortedFiles->end(), files.begin(), files.end());
+        }
+
+        if (!sortedFiles->empty()) {
+            // Some partition ran out of memory, so all of them go through the sorter.  A group is
+            // only ever in one partition so the files merge the same way as serial spills.
+            for (int i = 0; i < numPartitions; i++) {
+                if (!partitions[i]->groups().empty()) {
+                    sortedFiles->push_back(spill(&partitions[i]->groups()));
+                }
+            }
+            return;
+        }
+
+        // Everything fit in memory; gather the partitions' groups.
+        for (int i = 0; i < numPartitions; i++) {
+            GroupsMap& partitionGroups = partitions[i]->groups();
+            for (GroupsMap::iterator it = partitionGroups.begin(); it != partitionGroups.end();
+                    ++it) {
+                const size_t oldSize = groups.size();
+                Accumulators& group = groups[it->first];
+                if (groups.size() != oldSize) {
+                    group.swap(it->second);
+                    continue;
+                }
+
+                // Only reachable if the same key ended up in two partitions.  The later
+                // partition's input is treated as having come after ours.
+                for (size_t j = 0; j < group.size(); j++) {
+                    group[j]->merge(*it->second[j]);
+                }
+            }
+            GroupsMap().swap(partitionGroups);
+        }
+    }
+
     class DocumentSourceGroup::SpillSTLComparator {
     public:
         bool operator() (const GroupsMap::value_type* lhs, const GroupsMap::value_type* rhs) const {
@@ -459,10 +684,12 @@ namespace mongo {
         }
     };
 
-    shared_ptr<Sorter<Value, Value>::Iterator> DocumentSourceGroup::spill() {
+    shared_ptr<Sorter<Value, Value>::Iterator> DocumentSourceGroup::spill(
+            GroupsMap* groupsToSpill) {
         vector<const GroupsMap::value_type*> ptrs; // using pointers to speed sorting
-        ptrs.reserve(groups.size());
-        for (GroupsMap::const_iterator it=groups.begin(), end=groups.end(); it != end; ++it) {
+        ptrs.reserve(groupsToSpill->size());
+        for (GroupsMap::const_iterator it = groupsToSpill->begin(), end = groupsToSpill->end();
+                it != end; ++it) {
             ptrs.push_back(&*it);
         }
 
@@ -494,7 +721,7 @@ namespace mongo {
             break;
         }
 
-        groups.clear();
+        groupsToSpill->clear();
 
         return shared_ptr<Sorter<Value, Value>::Iterator>(writer.done());
     }
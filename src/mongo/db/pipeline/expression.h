@@ -75,6 +75,9 @@ namespace mongo {
         void clearRoot() { _root = Document(); }
         const Document& getRoot() const { return _root; }
 
+        /// The number of variables, other than ROOT, that this can hold.
+        size_t getNumVars() const { return _numVars; }
+
         void setValue(Id id, const Value& value);
         Value getValue(Id id) const;
 
@@ -28,6 +28,8 @@
 
 #include "mongo/db/query/cached_plan_runner.h"
 
+#include "mongo/db/client.h"
+#include "mongo/db/database.h"
 #include "mongo/db/diskloc.h"
 #include "mongo/db/jsobj.h"
 #include "mongo/db/exec/plan_stage.h"
@@ -37,6 +39,7 @@
 #include "mongo/db/query/plan_cache.h"
 #include "mongo/db/query/plan_executor.h"
 #include "mongo/db/query/type_explain.h"
+#include "mongo/db/structure/collection.h"
 
 namespace mongo {
 
@@ -117,24 +120,15 @@ namespace mongo {
     void CachedPlanRunner::updateCache() {
         _updatedCache = true;
 
-        // We're done.  Update the cache.
-        PlanCache* cache = PlanCache::get(_canonicalQuery->ns());
+        // We're done.  Update the cache.  The collection may have gone away while we yielded.
+        Database* db = cc().database();
+        if (NULL == db) { return; }
+        Collection* collection = db->getCollection(_canonicalQuery->ns());
+        if (NULL == collection) { return; }
+        PlanCache* cache = collection->infoCache()->getPlanCache();
 
-        // TODO: Is this an error?
-        if (NULL == cache) { return; }
-
-        // TODO: How do we decide this?
-        bool shouldRemovePlan = false;
-
-        if (shouldRemovePlan) {
-            if (!cache->remove(*_canonicalQuery, *_cachedQuery->solution)) {
-                warning() << "Cached plan runner couldn't remove plan from cache.  Maybe"
-                    " somebody else did already?";
-                return;
-            }
-        }
-
-        // We're done running.  Update cache.
+        // We're done running.  Update cache.  The cache evicts the plan if it has been doing much
+        // worse than it did when it was picked.
         auto_ptr<CachedSolutionFeedback> feedback(new CachedSolutionFeedback());
         feedback->stats = _exec->getStats();
         cache->feedback(*_canonicalQuery, *_cachedQuery->solution, feedback.release());
@@ -184,6 +184,13 @@ namespace mongo {
             res->setIsMultiKey(indexStats->isMultiKey);
             res->setIndexOnly(covered);
         }
+        else if (leaf->stageType == STAGE_TEXT) {
+            TextStats* textStats = static_cast<TextStats*>(leaf->specific.get());
+            res->setCursor("TextCursor");
+            res->setNScanned(textStats->keysExamined);
+            res->setNScannedObjects(textStats->fetches);
+            res->setIndexOnly(false);
+        }
         else {
             return Status(ErrorCodes::InternalError, "cannot interpret execution plan");
         }
@@ -357,13 +357,9 @@ namespace mongo {
             // Create our various intervals.
 
             bool thisBoundExact = false;
-            for (BSONElementSet::iterator it = afr.equalities().begin();
-                 it != afr.equalities().end(); ++it) {
-
-                translateEquality(*it, isHashed, oilOut, &thisBoundExact);
-                if (!thisBoundExact) {
-                    *exactOut = false;
-                }
+            translateEqualities(afr.equalities(), isHashed, oilOut, &thisBoundExact);
+            if (!thisBoundExact) {
+                *exactOut = false;
             }
 
             for (size_t i = 0; i < afr.numRegexes(); ++i) {
@@ -485,15 +481,28 @@ namespace mongo {
         // This can happen.
         if (iv.empty()) { return; }
 
-        // Step 1: sort.
-        std::sort(iv.begin(), iv.end(), IntervalComparison);
+        // Step 1: sort.  The points of an $in list arrive in order already, so check first.
+        bool sorted = true;
+        for (size_t i = 1; i < iv.size(); ++i) {
+            if (IntervalComparison(iv[i], iv[i - 1])) {
+                sorted = false;
+                break;
+            }
+        }
+        if (!sorted) {
+            std::sort(iv.begin(), iv.end(), IntervalComparison);
+        }
 
-        // Step 2: Walk through and merge.
-        size_t i = 0;
-        while (i < iv.size() - 1) {
-            // Compare i with i + 1.
-            Interval::IntervalComparison cmp = iv[i].compare(iv[i + 1]);
-            // QLOG() << "comparing " << iv[i].toString() << " with " << iv[i+1].toString()
+        // Step 2: Walk through and merge into a new list.  Erasing from 'iv' as we go would be
+        // quadratic in the number of intervals.
+        vector<Interval> result;
+        result.reserve(iv.size());
+        result.push_back(iv[0]);
+        for (size_t i = 1; i < iv.size(); ++i) {
+            Interval& last = result.back();
+            // Compare the last merged interval with i.
+            Interval::IntervalComparison cmp = last.compare(iv[i]);
+            // QLOG() << "comparing " << last.toString() << " with " << iv[i].toString()
                  // << " cmp is " << Interval::cmpstr(cmp) << endl;
 
             // This means our sort didn't work.
@@ -501,34 +510,30 @@ namespace mongo {
 
             // Intervals are correctly ordered.
             if (Interval::INTERVAL_PRECEDES == cmp) {
-                // We can move to the next pair.
-                ++i;
+                result.push_back(iv[i]);
             }
             else if (Interval::INTERVAL_EQUALS == cmp || Interval::INTERVAL_WITHIN == cmp) {
-                // Interval 'i' is equal to i+1, or is contained within i+1.
-                // Remove interval i and don't move to the next value of 'i'.
-                iv.erase(iv.begin() + i);
+                // The last interval is equal to i, or is contained within i.  Replace it.
+                last = iv[i];
             }
             else if (Interval::INTERVAL_CONTAINS == cmp) {
-                // Interval 'i' contains i+1, remove i+1 and don't move to the next value of 'i'.
-                iv.erase(iv.begin() + i + 1);
+                // The last interval contains i, drop i.
             }
             else if (Interval::INTERVAL_OVERLAPS_BEFORE == cmp
                      || Interval::INTERVAL_PRECEDES_COULD_UNION == cmp) {
-                // We want to merge intervals i and i+1.
-                // Interval 'i' starts before interval 'i+1'.
+                // We want to merge the last interval and i.
+                // The last interval starts before interval 'i'.
                 BSONObjBuilder bob;
-                bob.appendAs(iv[i].start, "");
-                bob.appendAs(iv[i + 1].end, "");
+                bob.appendAs(last.start, "");
+                bob.appendAs(iv[i].end, "");
                 BSONObj data = bob.obj();
-                bool startInclusive = iv[i].startInclusive;
-                bool endInclusive = iv[i + i].endInclusive;
-                iv.erase(iv.begin() + i);
-                // iv[i] is now the former iv[i + 1]
-                iv[i] = makeRangeInterval(data, startInclusive, endInclusive);
-                // Don't increment 'i'.
+                last = makeRangeInterval(data, last.startInclusive, iv[i].endInclusive);
+            }
+            else {
+                verify(0);
             }
         }
+        iv.swap(result);
     }
 
     // static
@@ -602,6 +607,52 @@ namespace mongo {
         oilOut->intervals.push_back(makePointInterval(bob.obj()));
     }
 
+    // static
+    void IndexBoundsBuilder::translateEqualities(const BSONElementSet& equalities, bool isHashed,
+                                                 OrderedIntervalList* oil, bool* exact) {
+        *exact = true;
+        bool thisBoundExact = false;
+
+        // Hashed points are each copied out as they are hashed anyway.
+        if (isHashed) {
+            for (BSONElementSet::const_iterator it = equalities.begin();
+                 it != equalities.end(); ++it) {
+                translateEquality(*it, isHashed, oil, &thisBoundExact);
+                if (!thisBoundExact) {
+                    *exact = false;
+                }
+            }
+            return;
+        }
+
+        BSONObjBuilder bob;
+        for (BSONElementSet::const_iterator it = equalities.begin();
+             it != equalities.end(); ++it) {
+            if (Array == it->type()) {
+                translateEquality(*it, isHashed, oil, &thisBoundExact);
+                if (!thisBoundExact) {
+                    *exact = false;
+                }
+                continue;
+            }
+            // XXX: it's exact if the index isn't sparse?
+            if (it->isNull()) {
+                *exact = false;
+            }
+            bob.appendAs(*it, "");
+        }
+
+        BSONObj points = bob.obj();
+        BSONObjIterator pi(points);
+        while (pi.more()) {
+            Interval ival;
+            ival._intervalData = points;
+            ival.startInclusive = ival.endInclusive = true;
+            ival.start = ival.end = pi.next();
+            oil->intervals.push_back(ival);
+        }
+    }
+
     // static
     void IndexBoundsBuilder::translateEquality(const BSONElement& data, bool isHashed,
                                                OrderedIntervalList* oil, bool* exact) {
@@ -121,6 +121,13 @@ namespace mongo {
         static void translateEquality(const BSONElement& data, bool isHashed,
                                       OrderedIntervalList* oil, bool* exact);
 
+        /**
+         * Same as calling translateEquality for each of 'equalities', but the points of a long
+         * $in list share one copy of their values rather than each having its own.
+         */
+        static void translateEqualities(const BSONElementSet& equalities, bool isHashed,
+                                        OrderedIntervalList* oil, bool* exact);
+
         static void unionize(OrderedIntervalList* oilOut);
         static void intersectize(const OrderedIntervalList& arg, OrderedIntervalList* oilOut);
     };
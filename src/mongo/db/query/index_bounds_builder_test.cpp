@@ -0,0 +1,118 @@
+/**
+ *    Copyright (C) 2013 10gen Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+/**
+ * This file contains tests for mongo/db/query/index_bounds_builder.cpp
+ */
+
+#include "mongo/db/query/index_bounds_builder.h"
+
+#include "mongo/db/jsobj.h"
+#include "mongo/db/json.h"
+#include "mongo/db/matcher/expression_parser.h"
+#include "mongo/unittest/unittest.h"
+
+using namespace mongo;
+
+namespace {
+
+    /**
+     * Translates 'query', a predicate on field 'a', to bounds on an ascending index on 'a'.
+     */
+    void translate(const BSONObj& query, OrderedIntervalList* oil, bool* exact) {
+        StatusWithMatchExpression swme = MatchExpressionParser::parse(query);
+        ASSERT(swme.isOK());
+        auto_ptr<MatchExpression> expr(swme.getValue());
+        BSONObj keyPattern = BSON("a" << 1);
+        IndexBoundsBuilder::translate(expr.get(), keyPattern.firstElement(), oil, exact);
+    }
+
+    TEST(IndexBoundsBuilderTest, TranslateLargeIn) {
+        BSONArrayBuilder values;
+        for (int i = 999; i >= 0; --i) {
+            values.append(i);
+            // duplicates of other numeric types are the same point
+            values.append(static_cast<double>(i));
+        }
+        OrderedIntervalList oil;
+        bool exact = false;
+        translate(BSON("a" << BSON("$in" << values.arr())), &oil, &exact);
+
+        ASSERT(exact);
+        ASSERT_EQUALS(1000U, oil.intervals.size());
+        for (int i = 0; i < 1000; ++i) {
+            ASSERT(oil.intervals[i].isPoint());
+            ASSERT_EQUALS(i, oil.intervals[i].start.numberInt());
+        }
+    }
+
+    TEST(IndexBoundsBuilderTest, TranslateInWithRegexAndNull) {
+        OrderedIntervalList oil;
+        bool exact = true;
+        translate(fromjson("{a: {$in: [3, /^foo/, null, 1]}}"), &oil, &exact);
+
+        // null bounds are not exact
+        ASSERT(!exact);
+        ASSERT_EQUALS(5U, oil.intervals.size());
+        ASSERT(oil.intervals[0].isPoint());
+        ASSERT(oil.intervals[0].start.isNull());
+        ASSERT_EQUALS(1, oil.intervals[1].start.numberInt());
+        ASSERT_EQUALS(3, oil.intervals[2].start.numberInt());
+        ASSERT_EQUALS("foo", oil.intervals[3].start.String());
+        ASSERT_EQUALS("fop", oil.intervals[3].end.String());
+        ASSERT_EQUALS(RegEx, oil.intervals[4].start.type());
+    }
+
+    TEST(IndexBoundsBuilderTest, UnionizeMergesOverlapping) {
+        OrderedIntervalList oil;
+        oil.intervals.push_back(IndexBoundsBuilder::makeRangeInterval(BSON("" << 5 << "" << 8),
+                                                                      true, false));
+        oil.intervals.push_back(IndexBoundsBuilder::makePointInterval(BSON("" << 6)));
+        oil.intervals.push_back(IndexBoundsBuilder::makeRangeInterval(BSON("" << 1 << "" << 3),
+                                                                      true, true));
+        oil.intervals.push_back(IndexBoundsBuilder::makeRangeInterval(BSON("" << 2 << "" << 4),
+                                                                      false, false));
+        oil.intervals.push_back(IndexBoundsBuilder::makePointInterval(BSON("" << 10)));
+        oil.intervals.push_back(IndexBoundsBuilder::makePointInterval(BSON("" << 10)));
+        IndexBoundsBuilder::unionize(&oil);
+
+        ASSERT_EQUALS(3U, oil.intervals.size());
+        // [1, 3] and (2, 4) merge
+        ASSERT_EQUALS(1, oil.intervals[0].start.numberInt());
+        ASSERT(oil.intervals[0].startInclusive);
+        ASSERT_EQUALS(4, oil.intervals[0].end.numberInt());
+        ASSERT(!oil.intervals[0].endInclusive);
+        // [5, 8) contains 6
+        ASSERT_EQUALS(5, oil.intervals[1].start.numberInt());
+        ASSERT_EQUALS(8, oil.intervals[1].end.numberInt());
+        // duplicate points collapse
+        ASSERT(oil.intervals[2].isPoint());
+        ASSERT_EQUALS(10, oil.intervals[2].start.numberInt());
+    }
+
+}  // namespace
@@ -28,16 +28,20 @@
 
 #include "mongo/db/query/multi_plan_runner.h"
 
+#include "mongo/db/client.h"
+#include "mongo/db/database.h"
 #include "mongo/db/diskloc.h"
 #include "mongo/db/jsobj.h"
 #include "mongo/db/exec/plan_stage.h"
 #include "mongo/db/exec/working_set_common.h"
 #include "mongo/db/query/canonical_query.h"
 #include "mongo/db/query/explain_plan.h"
+#include "mongo/db/query/plan_cache.h"
 #include "mongo/db/query/plan_executor.h"
 #include "mongo/db/query/qlog.h"
 #include "mongo/db/query/query_solution.h"
 #include "mongo/db/query/type_explain.h"
+#include "mongo/db/structure/collection.h"
 
 namespace mongo {
 
@@ -291,7 +295,8 @@ namespace mongo {
 
         if (_failure || _killed) { return false; }
 
-        size_t bestChild = PlanRanker::pickBestPlan(_candidates, NULL);
+        auto_ptr<PlanRankingDecision> why(new PlanRankingDecision());
+        size_t bestChild = PlanRanker::pickBestPlan(_candidates, why.get());
 
         // Run the best plan.  Store it.
         _bestPlan.reset(new PlanExecutor(_candidates[bestChild].ws,
@@ -318,11 +323,11 @@ namespace mongo {
             }
         }
 
-        // TODO:
-        // Store the choice we just made in the cache.
-        // QueryPlanCache* cache = PlanCache::get(somenamespace);
-        // cache->add(_query, *_candidates[bestChild]->solution, decision->bestPlanStats);
-        // delete decision;
+        // Store the choice we just made in the cache.  If the winner needed a backup plan it
+        // isn't a choice we want to repeat.
+        if (backupChild == bestChild) {
+            cacheBestSolution(why.release());
+        }
 
         // Clear out the candidate plans, leaving only stats as we're all done w/them.
         for (size_t i = 0; i < _candidates.size(); ++i) {
@@ -349,6 +354,18 @@ namespace mongo {
         return true;
     }
 
+    void MultiPlanRunner::cacheBestSolution(PlanRankingDecision* why) {
+        auto_ptr<PlanRankingDecision> autoWhy(why);
+
+        // The cache is per-collection.  Internal clients may run us without a collection.
+        Database* db = cc().database();
+        if (NULL == db) { return; }
+        Collection* collection = db->getCollection(_query->ns());
+        if (NULL == collection) { return; }
+
+        collection->infoCache()->getPlanCache()->add(*_query, *_bestSolution, autoWhy.release());
+    }
+
     bool MultiPlanRunner::workAllPlans() {
         bool planHitEOF = false;
 
@@ -110,6 +110,12 @@ namespace mongo {
         void allPlansSaveState();
         void allPlansRestoreState();
 
+        /**
+         * Record _bestSolution as the plan to use for queries shaped like _query.  Takes
+         * ownership of 'why'.
+         */
+        void cacheBestSolution(PlanRankingDecision* why);
+
         // Were we killed by an invalidate?
         bool _killed;
 
@@ -143,24 +143,6 @@ namespace mongo {
         verify(rawCanonicalQuery);
         auto_ptr<CanonicalQuery> canonicalQuery(rawCanonicalQuery);
 
-        // Try to look up a cached solution for the query.
-        // TODO: Can the cache have negative data about a solution?
-        PlanCache* localCache = PlanCache::get(canonicalQuery->ns());
-        if (NULL != localCache) {
-            CachedSolution* cs = localCache->get(*canonicalQuery);
-            if (NULL != cs) {
-                // We have a cached solution.  Hand the canonical query and cached solution off to
-                // the cached plan runner, which takes ownership of both.
-                WorkingSet* ws;
-                PlanStage* root;
-                verify(StageBuilder::build(*cs->solution, &root, &ws));
-                *out = new CachedPlanRunner(canonicalQuery.release(), cs, root, ws);
-                return Status::OK();
-            }
-        }
-
-        // No entry in cache for the query.  We have to solve the query ourself.
-
         // Get the indices that we could possibly use.
         Database* db = cc().database();
         verify( db );
@@ -256,6 +238,38 @@ namespace mongo {
             return Status::OK();
         }
         else {
+            // Try to look up a cached solution for the query.  The cache only knows the shape of
+            // the plan that won the last time a query like this one was run, so look for the
+            // solution with that shape.
+            // TODO: Can the cache have negative data about a solution?
+            PlanCache* cache = collection->infoCache()->getPlanCache();
+            CachedSolution* rawCS = cache->get(*canonicalQuery);
+            if (NULL != rawCS) {
+                auto_ptr<CachedSolution> cs(rawCS);
+                for (size_t i = 0; i < solutions.size(); ++i) {
+                    if (PlanCache::getSolutionKey(*solutions[i]) != cs->solutionKey) { continue; }
+
+                    // We have a cached solution.  Hand the canonical query and cached solution off
+                    // to the cached plan runner, which takes ownership of both.
+                    cs->solution.reset(solutions[i]);
+                    for (size_t j = 0; j < solutions.size(); ++j) {
+                        if (j != i) { delete solutions[j]; }
+                    }
+
+                    PlanCache::reportCachedSolution(true);
+                    WorkingSet* ws;
+                    PlanStage* root;
+                    verify(StageBuilder::build(*cs->solution, &root, &ws));
+                    *out = new CachedPlanRunner(canonicalQuery.release(), cs.release(), root, ws);
+                    return Status::OK();
+                }
+
+                // None of our solutions look like the cached one.  Fall through and race them;
+                // the winner replaces the stale entry.
+                PlanCache::reportCachedSolution(false);
+                QLOG() << "No solution matches cached plan " << cs->solutionKey << endl;
+            }
+
             // Many solutions.  Let the MultiPlanRunner pick the best, update the cache, and so on.
             auto_ptr<MultiPlanRunner> mpr(new MultiPlanRunner(canonicalQuery.release()));
             for (size_t i = 0; i < solutions.size(); ++i) {
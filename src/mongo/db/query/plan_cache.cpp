@@ -0,0 +1,352 @@
+/**
+ *    Copyright (C) 2013 10gen Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#include "mongo/db/query/plan_cache.h"
+
+#include "mongo/base/counter.h"
+#include "mongo/client/dbclientinterface.h"
+#include "mongo/db/commands/server_status.h"
+#include "mongo/db/query/canonical_query.h"
+#include "mongo/db/query/qlog.h"
+#include "mongo/db/server_parameters.h"
+
+namespace mongo {
+
+    // Server parameters
+    MONGO_EXPORT_SERVER_PARAMETER(planCacheMaxEntries, int, 5000);
+    MONGO_EXPORT_SERVER_PARAMETER(planCacheWriteOpsBetweenFlush, int, 1000);
+
+    static Counter64 planCacheHits;
+    static ServerStatusMetricField<Counter64> displayPlanCacheHits(
+            "queryExecutor.planCache.hits", &planCacheHits);
+
+    // Entries found for a query none of whose solutions had the cached shape
+    static Counter64 planCacheStale;
+    static ServerStatusMetricField<Counter64> displayPlanCacheStale(
+            "queryExecutor.planCache.stale", &planCacheStale);
+
+    static Counter64 planCacheMisses;
+    static ServerStatusMetricField<Counter64> displayPlanCacheMisses(
+            "queryExecutor.planCache.misses", &planCacheMisses);
+
+    static Counter64 planCacheEvictions;
+    static ServerStatusMetricField<Counter64> displayPlanCacheEvictions(
+            "queryExecutor.planCache.evictions", &planCacheEvictions);
+
+    // static
+    const size_t PlanCache::kMaxFeedback = 20;
+
+    // static
+    const double PlanCache::kEvictionRatio = 10.0;
+
+    namespace {
+
+        /**
+         * Appends the structure of 'tree' to 'keyBuilder': the type and path of every node, but
+         * none of the values.  The tree has been normalized by CanonicalQuery so that equivalent
+         * predicates have the same structure.
+         */
+        void encodeMatchExpression(const MatchExpression* tree, StringBuilder* keyBuilder) {
+            *keyBuilder << static_cast<int>(tree->matchType()) << ':' << tree->path();
+
+            if (tree->numChildren() > 0) {
+                *keyBuilder << '(';
+                for (size_t i = 0; i < tree->numChildren(); ++i) {
+                    if (i > 0) {
+                        *keyBuilder << ',';
+                    }
+                    encodeMatchExpression(tree->getChild(i), keyBuilder);
+                }
+                *keyBuilder << ')';
+            }
+        }
+
+        void encodeSolutionNode(const QuerySolutionNode* node, StringBuilder* keyBuilder) {
+            if (STAGE_SHARDING_FILTER == node->getType()) {
+                verify(1 == node->children.size());
+                encodeSolutionNode(node->children[0], keyBuilder);
+                return;
+            }
+
+            *keyBuilder << static_cast<int>(node->getType());
+
+            if (STAGE_IXSCAN == node->getType()) {
+                const IndexScanNode* ixn = static_cast<const IndexScanNode*>(node);
+                *keyBuilder << ixn->indexKeyPattern.toString() << ixn->direction;
+            }
+            else if (STAGE_COLLSCAN == node->getType()) {
+                const CollectionScanNode* csn = static_cast<const CollectionScanNode*>(node);
+                *keyBuilder << csn->direction;
+            }
+
+            if (!node->children.empty()) {
+                *keyBuilder << '(';
+                for (size_t i = 0; i < node->children.size(); ++i) {
+                    if (i > 0) {
+                        *keyBuilder << ',';
+                    }
+                    encodeSolutionNode(node->children[i], keyBuilder);
+                }
+                *keyBuilder << ')';
+            }
+        }
+
+        /**
+         * How many results did the root of 'stats' produce per call to work()?
+         */
+        double productivity(const PlanStageStats* stats) {
+            if (NULL == stats || 0 == stats->common.works) {
+                return 0;
+            }
+            return static_cast<double>(stats->common.advanced)
+                 / static_cast<double>(stats->common.works);
+        }
+
+    }  // namespace
+
+    PlanCache::Entry::~Entry() {
+        for (size_t i = 0; i < feedback.size(); ++i) {
+            delete feedback[i];
+        }
+    }
+
+    PlanCache::PlanCache() : _mutex("PlanCache"), _writeOpsSinceFlush(0) { }
+
+    PlanCache::~PlanCache() {
+        _clear_inlock();
+    }
+
+    // static
+    bool PlanCache::shouldCacheQuery(const CanonicalQuery& query) {
+        const LiteParsedQuery& pq = query.getParsed();
+        return pq.getHint().isEmpty()
+            && pq.getMin().isEmpty()
+            && pq.getMax().isEmpty()
+            && !pq.isSnapshot()
+            && !pq.isExplain()
+            && !pq.hasOption(QueryOption_CursorTailable);
+    }
+
+    // static
+    PlanCacheKey PlanCache::getPlanCacheKey(const CanonicalQuery& query) {
+        const LiteParsedQuery& pq = query.getParsed();
+
+        StringBuilder keyBuilder;
+        encodeMatchExpression(query.root(), &keyBuilder);
+        keyBuilder << "|s" << pq.getSort().toString();
+        keyBuilder << "|p" << pq.getProj().toString();
+
+        // A limit or skip adds stages to every candidate plan, and a limit also changes which
+        // plan wins the race.
+        keyBuilder << "|l" << (0 != pq.getNumToReturn()) << (0 != pq.getSkip());
+
+        return keyBuilder.str();
+    }
+
+    // static
+    std::string PlanCache::getSolutionKey(const QuerySolution& solution) {
+        if (NULL == solution.root) {
+            return "";
+        }
+
+        StringBuilder keyBuilder;
+        encodeSolutionNode(solution.root.get(), &keyBuilder);
+        return keyBuilder.str();
+    }
+
+    bool PlanCache::add(const CanonicalQuery& query, const QuerySolution& solution,
+                        PlanRankingDecision* why) {
+        auto_ptr<PlanRankingDecision> decision(why);
+
+        if (!shouldCacheQuery(query)) { return false; }
+
+        std::string solutionKey = getSolutionKey(solution);
+        if (solutionKey.empty()) { return false; }
+
+        PlanCacheKey key = getPlanCacheKey(query);
+
+        scoped_lock lk(_mutex);
+
+        EntryMap::iterator existing = _entries.find(key);
+        if (_entries.end() != existing) {
+            _removeEntry_inlock(existing);
+        }
+
+        // Make room for the new entry.
+        while (!_lru.empty() && _entries.size() >= static_cast<size_t>(planCacheMaxEntries)) {
+            EntryMap::iterator oldest = _entries.find(_lru.back());
+            verify(_entries.end() != oldest);
+            _removeEntry_inlock(oldest);
+            planCacheEvictions.increment();
+        }
+
+        auto_ptr<Entry> entry(new Entry());
+        entry->solutionKey = solutionKey;
+        entry->productivity = productivity(decision->statsOfWinner);
+        entry->decision.reset(decision.release());
+
+        _lru.push_front(key);
+        entry->lruPosition = _lru.begin();
+        _entries[key] = entry.release();
+
+        QLOG() << "Cached solution " << solutionKey << " for query shape " << key << endl;
+        return true;
+    }
+
+    CachedSolution* PlanCache::get(const CanonicalQuery& query) {
+        if (!shouldCacheQuery(query)) { return NULL; }
+
+        PlanCacheKey key = getPlanCacheKey(query);
+
+        scoped_lock lk(_mutex);
+
+        EntryMap::const_iterator it = _entries.find(key);
+        if (_entries.end() == it) {
+            planCacheMisses.increment();
+            return NULL;
+        }
+
+        Entry* entry = it->second;
+
+        // Mark the entry as most recently used.
+        _lru.splice(_lru.begin(), _lru, entry->lruPosition);
+
+        auto_ptr<CachedSolution> cs(new CachedSolution());
+        cs->key = key;
+        cs->solutionKey = entry->solutionKey;
+        cs->decision.reset(new PlanRankingDecision());
+        cs->decision->onlyOneSolution = entry->decision->onlyOneSolution;
+        return cs.release();
+    }
+
+    // static
+    void PlanCache::reportCachedSolution(bool used) {
+        if (used) {
+            planCacheHits.increment();
+        }
+        else {
+            planCacheStale.increment();
+        }
+    }
+
+    bool PlanCache::feedback(const CanonicalQuery& query, const QuerySolution& solution,
+                             CachedSolutionFeedback* feedback) {
+        auto_ptr<CachedSolutionFeedback> autoFeedback(feedback);
+
+        PlanCacheKey key = getPlanCacheKey(query);
+        std::string solutionKey = getSolutionKey(solution);
+
+        scoped_lock lk(_mutex);
+
+        EntryMap::iterator it = _entries.find(key);
+        if (_entries.end() == it || it->second->solutionKey != solutionKey) {
+            return false;
+        }
+
+        Entry* entry = it->second;
+        entry->feedback.push_back(autoFeedback.release());
+        if (entry->feedback.size() < kMaxFeedback) {
+            return true;
+        }
+
+        // We have enough feedback to judge the plan.  If it has been doing much worse than it did
+        // when it won, the data has probably changed underneath it: evict it so that the next
+        // query of this shape races the candidates again.
+        double total = 0;
+        for (size_t i = 0; i < entry->feedback.size(); ++i) {
+            total += productivity(entry->feedback[i]->stats);
+        }
+        double average = total / entry->feedback.size();
+
+        if (average * kEvictionRatio < entry->productivity) {
+            QLOG() << "Evicting degraded plan " << solutionKey << " for query shape " << key
+                   << ": average productivity " << average << " vs. " << entry->productivity
+                   << " when cached" << endl;
+            _removeEntry_inlock(it);
+            planCacheEvictions.increment();
+            return true;
+        }
+
+        // The plan is holding up.  Start collecting a fresh round of feedback.
+        for (size_t i = 0; i < entry->feedback.size(); ++i) {
+            delete entry->feedback[i];
+        }
+        entry->feedback.clear();
+        return true;
+    }
+
+    bool PlanCache::remove(const CanonicalQuery& query, const QuerySolution& solution) {
+        PlanCacheKey key = getPlanCacheKey(query);
+        std::string solutionKey = getSolutionKey(solution);
+
+        scoped_lock lk(_mutex);
+
+        EntryMap::iterator it = _entries.find(key);
+        if (_entries.end() == it || it->second->solutionKey != solutionKey) {
+            return false;
+        }
+
+        _removeEntry_inlock(it);
+        return true;
+    }
+
+    void PlanCache::clear() {
+        scoped_lock lk(_mutex);
+        _clear_inlock();
+    }
+
+    void PlanCache::notifyOfWriteOp() {
+        scoped_lock lk(_mutex);
+        if (_entries.empty()) { return; }
+        if (++_writeOpsSinceFlush >= planCacheWriteOpsBetweenFlush) {
+            _clear_inlock();
+        }
+    }
+
+    size_t PlanCache::size() const {
+        scoped_lock lk(_mutex);
+        return _entries.size();
+    }
+
+    void PlanCache::_removeEntry_inlock(EntryMap::iterator it) {
+        Entry* entry = it->second;
+        _lru.erase(entry->lruPosition);
+        _entries.erase(it);
+        delete entry;
+    }
+
+    void PlanCache::_clear_inlock() {
+        for (EntryMap::iterator it = _entries.begin(); it != _entries.end(); ++it) {
+            delete it->second;
+        }
+        _entries.clear();
+        _lru.clear();
+        _writeOpsSinceFlush = 0;
+    }
+
+}  // namespace mongo
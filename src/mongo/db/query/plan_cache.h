@@ -28,12 +28,21 @@
 
 #pragma once
 
+#include <boost/scoped_ptr.hpp>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
 #include "mongo/db/exec/plan_stats.h"
 #include "mongo/db/query/plan_ranker.h"
 #include "mongo/db/query/query_solution.h"
+#include "mongo/util/concurrency/mutex.h"
 
 namespace mongo {
 
+    class CanonicalQuery;
+
     /**
      * TODO: Debug commands:
      * 1. show canonical form of query
@@ -42,33 +51,50 @@ namespace mongo {
      * 4. clear all elements from cache / otherwise manipulate cache.
      */
 
+    /**
+     * The shape of a query: the structure of its predicate, its sort and its projection, but none
+     * of the values it is comparing against.  Queries with the same key are answered by the same
+     * plan shape.
+     */
+    typedef std::string PlanCacheKey;
+
     /**
      * When the CachedPlanRunner runs a cached query, it can provide feedback to the cache.  This
      * feedback is available to anyone who retrieves that query in the future.
      */
     struct CachedSolutionFeedback {
+        CachedSolutionFeedback() : stats(NULL) { }
+        ~CachedSolutionFeedback() { delete stats; }
+
+        // Owned by us.
         PlanStageStats* stats;
+    private:
+        MONGO_DISALLOW_COPYING(CachedSolutionFeedback);
     };
 
     /**
      * A cached solution to a query.
+     *
+     * QuerySolutions carry index bounds and filters that are specific to the values of the query
+     * that produced them, so the cache does not hand out the winning solution itself.  Instead
+     * it records the shape of the winner ('solutionKey').  The query is re-planned and whichever
+     * candidate has that shape is run directly, skipping the MultiPlanRunner.
      */
     struct CachedSolution {
-        ~CachedSolution() {
-            for (size_t i = 0; i < feedback.size(); ++i) {
-                delete feedback[i];
-            }
-        }
+        CachedSolution() { }
+
+        // The shape of the query this solution was cached for.
+        PlanCacheKey key;
+
+        // The shape of the best solution for the query.  See PlanCache::getSolutionKey.
+        std::string solutionKey;
 
-        // The best solution for the CanonicalQuery.
+        // The best solution for the CanonicalQuery.  Filled in by whoever re-plans the query.
         scoped_ptr<QuerySolution> solution;
 
-        // Why the best solution was picked.
+        // Why the best solution was picked.  The stats of the winner stay in the cache and are
+        // not copied out, so decision->statsOfWinner is always NULL here.
         scoped_ptr<PlanRankingDecision> decision;
-
-        // Annotations from cached runs.
-        // TODO: How many of these do we really want to keep?
-        vector<CachedSolutionFeedback*> feedback;
     private:
         MONGO_DISALLOW_COPYING(CachedSolution);
     };
@@ -77,57 +103,143 @@ namespace mongo {
      * Caches the best solution to a query.  Aside from the (CanonicalQuery -> QuerySolution)
      * mapping, the cache contains information on why that mapping was made, and statistics on the
      * cache entry's actual performance on subsequent runs.
+     *
+     * There is one PlanCache per collection; it is owned by the collection's CollectionInfoCache
+     * and is cleared whenever an index is added or dropped and after every
+     * 'planCacheWriteOpsBetweenFlush' writes to the collection.  The number of entries is bounded
+     * by 'planCacheMaxEntries'; the least recently used entry is evicted first.
+     *
+     * The cache can be read by several threads holding a read lock at once, so all methods are
+     * internally synchronized.
      */
     class PlanCache {
+        MONGO_DISALLOW_COPYING(PlanCache);
     public:
+        // How many feedback entries are collected before deciding if a plan has degraded.
+        static const size_t kMaxFeedback;
+
+        // A cached plan is evicted once its observed productivity (results per call to work())
+        // falls below the productivity it had when it won the race, divided by this ratio.
+        static const double kEvictionRatio;
+
+        PlanCache();
+        ~PlanCache();
+
+        /**
+         * Returns false if 'query' must always be planned from scratch: hinted, min/max,
+         * snapshot, tailable and explain queries are never cached.
+         */
+        static bool shouldCacheQuery(const CanonicalQuery& query);
+
         /**
-         * Get the (global) cache for the provided namespace.  Must not be held across yields.
-         * As such, there is no locking required.
+         * Computes the shape of 'query'.  Two queries that differ only in the values they compare
+         * against have the same key.
          */
-        static PlanCache* get(const string& ns) { return NULL; }
+        static PlanCacheKey getPlanCacheKey(const CanonicalQuery& query);
+
+        /**
+         * Computes the shape of 'solution': its stage types, and for index scans the key pattern
+         * and direction, but not the bounds.  Sharding filters are left out as they depend on how
+         * the query was planned rather than on the query.  Returns the empty string if the
+         * solution is empty.
+         */
+        static std::string getSolutionKey(const QuerySolution& solution);
 
         /**
          * Record 'solution' as the best plan for 'query' which was picked for reasons detailed in
          * 'why'.
          *
-         * Takes ownership of all arguments.
+         * Takes ownership of 'why'.
          *
-         * If the mapping was added successfully, returns true.
-         * If the mapping already existed or some other error occurred, returns false;
+         * If the mapping was added successfully, returns true.  An existing entry for the shape of
+         * 'query' is replaced.  If the query or solution can't be cached, returns false.
          */
-        bool add(CanonicalQuery* query, QuerySolution* solution, PlanRankingDecision* why) {
-            return false;
-        }
+        bool add(const CanonicalQuery& query, const QuerySolution& solution,
+                 PlanRankingDecision* why);
 
         /**
          * Look up the cached solution for the provided query.  If a cached solution exists, return
          * a copy of it which the caller then owns.  If no cached solution exists, returns NULL.
-         *
-         * TODO: Allow querying for exact query and querying for the shape of the query.
+         * The caller must then call reportCachedSolution().
+         */
+        CachedSolution* get(const CanonicalQuery& query);
+
+        /**
+         * Called once the planner knows whether a solution returned by get() was 'used', that is,
+         * whether one of the query's solutions had its shape.  Counted as a hit if so, and as a
+         * stale lookup, after which the candidates are raced, if not.
          */
-        CachedSolution* get(const CanonicalQuery& query) {
-            return NULL;
-        }
+        static void reportCachedSolution(bool used);
 
         /**
          * When the CachedPlanRunner runs a plan out of the cache, we want to record data about the
          * plan's performance.  Cache takes ownership of 'feedback'.
          *
          * If the (query, solution) pair isn't in the cache, the cache deletes feedback and returns
-         * false.  Otherwise, returns true.
+         * false.  Otherwise, returns true.  Recording feedback may evict the plan if it has
+         * performed much worse than it did when it was picked.
          */
         bool feedback(const CanonicalQuery& query, const QuerySolution& solution,
-                      const CachedSolutionFeedback* feedback) {
-            return false;
-        }
+                      CachedSolutionFeedback* feedback);
 
         /**
          * Remove the (query, solution) pair from our cache.  Returns true if the plan was removed,
          * false if it wasn't found.
          */
-        bool remove(const CanonicalQuery& query, const QuerySolution& solution) {
-            return false;
-        }
+        bool remove(const CanonicalQuery& query, const QuerySolution& solution);
+
+        /**
+         * Remove every entry from the cache.
+         */
+        void clear();
+
+        /**
+         * Must be called on every write to the collection.  The plan picked for a query shape can
+         * go stale as the data changes, so the cache is flushed every
+         * 'planCacheWriteOpsBetweenFlush' writes.
+         */
+        void notifyOfWriteOp();
+
+        /**
+         * How many query shapes are cached?
+         */
+        size_t size() const;
+
+    private:
+        struct Entry {
+            Entry() : productivity(0) { }
+            ~Entry();
+
+            std::string solutionKey;
+
+            // Owned here.
+            scoped_ptr<PlanRankingDecision> decision;
+
+            // Productivity of the winner during the race, see PlanCache::kEvictionRatio.
+            double productivity;
+
+            // Owned here.  At most kMaxFeedback entries.
+            std::vector<CachedSolutionFeedback*> feedback;
+
+            // Position of this entry's key in PlanCache::_lru.
+            std::list<PlanCacheKey>::iterator lruPosition;
+        private:
+            MONGO_DISALLOW_COPYING(Entry);
+        };
+
+        typedef std::map<PlanCacheKey, Entry*> EntryMap;
+
+        void _removeEntry_inlock(EntryMap::iterator it);
+        void _clear_inlock();
+
+        mutable mongo::mutex _mutex;
+
+        EntryMap _entries;
+
+        // Most recently used key at the front.
+        std::list<PlanCacheKey> _lru;
+
+        int _writeOpsSinceFlush;
     };
 
 }  // namespace mongo
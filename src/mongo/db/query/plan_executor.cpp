@@ -33,11 +33,19 @@
 #include "mongo/db/exec/working_set.h"
 #include "mongo/db/exec/working_set_common.h"
 #include "mongo/db/pdfile.h"
+#include "mongo/db/server_parameters.h"
 
 namespace mongo {
 
+    // Server parameter
+    MONGO_EXPORT_SERVER_PARAMETER(planExecutorBatchSize, int, 64);
+
     PlanExecutor::PlanExecutor(WorkingSet* ws, PlanStage* rt)
-        : _workingSet(ws) , _root(rt) , _killed(false) {
+        : _workingSet(ws),
+          _root(rt),
+          _killed(false),
+          _batchPos(0),
+          _batchState(PlanStage::NEED_TIME) {
     }
 
     PlanExecutor::~PlanExecutor() {
@@ -52,7 +60,18 @@ namespace mongo {
     }
 
     void PlanExecutor::saveState() {
-        if (!_killed) { _root->prepareToYield(); }
+        if (_killed) { return; }
+
+        _root->prepareToYield();
+
+        // Whatever we've read ahead but not returned matched before the yield.  Keep it as it
+        // was then: an unowned obj points at the record, which can change underneath us.
+        for (size_t i = _batchPos; i < _batch.size(); ++i) {
+            WorkingSetMember* member = _workingSet->get(_batch[i]);
+            if (member->hasUnownedObj()) {
+                member->obj = member->obj.getOwned();
+            }
+        }
     }
 
     bool PlanExecutor::restoreState() {
@@ -63,7 +82,19 @@ namespace mongo {
     }
 
     void PlanExecutor::invalidate(const DiskLoc& dl) {
-        if (!_killed) { _root->invalidate(dl); }
+        if (_killed) { return; }
+
+        _root->invalidate(dl);
+
+        // Results we've read ahead but not returned are ours.  Like the sort stage does with its
+        // buffered results, keep a copy of any whose DiskLoc is going away.
+        for (size_t i = _batchPos; i < _batch.size(); ++i) {
+            WorkingSetMember* member = _workingSet->get(_batch[i]);
+            if (member->hasLoc() && member->loc == dl) {
+                WorkingSetCommon::fetchAndInvalidateLoc(member);
+                _workingSet->flagForReview(_batch[i]);
+            }
+        }
     }
 
     void PlanExecutor::setYieldPolicy(Runner::YieldPolicy policy) {
@@ -79,6 +110,35 @@ namespace mongo {
         if (_killed) { return Runner::RUNNER_DEAD; }
 
         for (;;) {
+            // Hand out what we've already read ahead, then report how the batch ended.
+            if (_batchPos < _batch.size()) {
+                WorkingSetID id = _batch[_batchPos++];
+                if (NULL != dlOut && !_workingSet->get(id)->hasLoc()) {
+                    // Invalidated since we read it.  The caller wants to act on the
+                    // document where it is, and it isn't there anymore.
+                    _workingSet->free(id);
+                    continue;
+                }
+                return returnResult(id, objOut, dlOut);
+            }
+            _batch.clear();
+            _batchPos = 0;
+
+            if (PlanStage::NEED_TIME != _batchState) {
+                PlanStage::StageState code = _batchState;
+                _batchState = PlanStage::NEED_TIME;
+                if (PlanStage::IS_EOF == code) {
+                    return Runner::RUNNER_EOF;
+                }
+                else if (PlanStage::DEAD == code) {
+                    return Runner::RUNNER_DEAD;
+                }
+                else {
+                    verify(PlanStage::FAILURE == code);
+                    return Runner::RUNNER_ERROR;
+                }
+            }
+
             // Yield, if we can yield ourselves.
             if (NULL != _yieldPolicy.get() && _yieldPolicy->shouldYield()) {
                 saveState();
@@ -87,93 +147,111 @@ namespace mongo {
                 restoreState();
             }
 
-            WorkingSetID id;
-            PlanStage::StageState code = _root->work(&id);
-
-            if (PlanStage::ADVANCED == code) {
-                WorkingSetMember* member = _workingSet->get(id);
-
-                if (NULL != objOut) {
-                    if (WorkingSetMember::LOC_AND_IDX == member->state) {
-                        if (1 != member->keyData.size()) {
-                            _workingSet->free(id);
-                            return Runner::RUNNER_ERROR;
-                        }
-                        *objOut = member->keyData[0].keyData;
-                    }
-                    else if (member->hasObj()) {
-                        *objOut = member->obj;
-                    }
-                    else {
-                        _workingSet->free(id);
-                        return Runner::RUNNER_ERROR;
-                    }
-                }
-
-                if (NULL != dlOut) {
-                    if (member->hasLoc()) {
-                        *dlOut = member->loc;
-                    }
-                    else {
-                        _workingSet->free(id);
-                        return Runner::RUNNER_ERROR;
-                    }
+            WorkingSetID id = WorkingSet::INVALID_ID;
+            PlanStage::StageState code;
+            // Only read ahead for callers that just want the results.  A caller that wants
+            // DiskLocs is going to write to them, and yields between results in ways we don't
+            // see, so it gets each one as the plan produces it.
+            if (planExecutorBatchSize > 1 && NULL == dlOut) {
+                code = _root->workBatch(planExecutorBatchSize, &_batch, &id);
+            }
+            else {
+                code = _root->work(&id);
+                if (PlanStage::ADVANCED == code) {
+                    return returnResult(id, objOut, dlOut);
                 }
-                _workingSet->free(id);
-                return Runner::RUNNER_ADVANCED;
             }
-            else if (PlanStage::NEED_TIME == code) {
-                // Fall through to yield check at end of large conditional.
+
+            if (PlanStage::NEED_TIME == code) {
+                // Fall through to yield check at top of loop.
             }
             else if (PlanStage::NEED_FETCH == code) {
-                // id has a loc and refers to an obj we need to fetch.
-                WorkingSetMember* member = _workingSet->get(id);
-
-                // This must be true for somebody to request a fetch and can only change when an
-                // invalidation happens, which is when we give up a lock.  Don't give up the
-                // lock between receiving the NEED_FETCH and actually fetching(?).
-                verify(member->hasLoc());
-
-                // Actually bring record into memory.
-                Record* record = member->loc.rec();
-
-                // If we're allowed to, go to disk outside of the lock.
-                if (NULL != _yieldPolicy.get()) {
-                    saveState();
-                    _yieldPolicy->yield(record);
-                    if (_killed) { return Runner::RUNNER_DEAD; }
-                    restoreState();
-                }
-                else {
-                    // We're set to manually yield.  We go to disk in the lock.
-                    record->touch();
-                }
+                // Fetch before handing out the batch.  If we yield to do so, saveState() keeps
+                // the batch as it was and invalidate() covers anything that moves.
+                if (!fetch(id)) { return Runner::RUNNER_DEAD; }
+            }
+            else {
+                verify(PlanStage::IS_EOF == code || PlanStage::DEAD == code
+                       || PlanStage::FAILURE == code);
+                _batchState = code;
+            }
+        }
+    }
 
-                // Record should be in memory now.  Log if it's not.
-                if (!Record::likelyInPhysicalMemory(record->dataNoThrowing())) {
-                    OCCASIONALLY {
-                        warning() << "Record wasn't in memory immediately after fetch: "
-                                  << member->loc.toString() << endl;
-                    }
-                }
+    Runner::RunnerState PlanExecutor::returnResult(WorkingSetID id, BSONObj* objOut,
+                                                   DiskLoc* dlOut) {
+        WorkingSetMember* member = _workingSet->get(id);
 
-                // Note that we're not freeing id.  Fetch semantics say that we shouldn't.
+        if (NULL != objOut) {
+            if (WorkingSetMember::LOC_AND_IDX == member->state) {
+                if (1 != member->keyData.size()) {
+                    _workingSet->free(id);
+                    return Runner::RUNNER_ERROR;
+                }
+                *objOut = member->keyData[0].keyData;
             }
-            else if (PlanStage::IS_EOF == code) {
-                return Runner::RUNNER_EOF;
+            else if (member->hasObj()) {
+                *objOut = member->obj;
             }
-            else if (PlanStage::DEAD == code) {
-                return Runner::RUNNER_DEAD;
+            else {
+                _workingSet->free(id);
+                return Runner::RUNNER_ERROR;
+            }
+        }
+
+        if (NULL != dlOut) {
+            if (member->hasLoc()) {
+                *dlOut = member->loc;
             }
             else {
-                verify(PlanStage::FAILURE == code);
+                _workingSet->free(id);
                 return Runner::RUNNER_ERROR;
             }
         }
+        _workingSet->free(id);
+        return Runner::RUNNER_ADVANCED;
+    }
+
+    bool PlanExecutor::fetch(WorkingSetID id) {
+        // id has a loc and refers to an obj we need to fetch.
+        WorkingSetMember* member = _workingSet->get(id);
+
+        // This must be true for somebody to request a fetch and can only change when an
+        // invalidation happens, which is when we give up a lock.  Don't give up the
+        // lock between receiving the NEED_FETCH and actually fetching(?).
+        verify(member->hasLoc());
+
+        // Actually bring record into memory.
+        Record* record = member->loc.rec();
+
+        // If we're allowed to, go to disk outside of the lock.
+        if (NULL != _yieldPolicy.get()) {
+            saveState();
+            _yieldPolicy->yield(record);
+            if (_killed) { return false; }
+            restoreState();
+        }
+        else {
+            // We're set to manually yield.  We go to disk in the lock.
+            record->touch();
+        }
+
+        // Record should be in memory now.  Log if it's not.
+        if (!Record::likelyInPhysicalMemory(record->dataNoThrowing())) {
+            OCCASIONALLY {
+                warning() << "Record wasn't in memory immediately after fetch: "
+                          << member->loc.toString() << endl;
+            }
+        }
+
+        // Note that we're not freeing id.  Fetch semantics say that we shouldn't.
+        return true;
     }
 
     bool PlanExecutor::isEOF() {
-        return _killed || _root->isEOF();
+        if (_killed) { return true; }
+        if (_batchPos < _batch.size()) { return false; }
+        return _root->isEOF();
     }
 
     void PlanExecutor::kill() {
@@ -29,8 +29,10 @@
 #pragma once
 
 #include <boost/scoped_ptr.hpp>
+#include <vector>
 
 #include "mongo/base/status.h"
+#include "mongo/db/exec/plan_stage.h"
 #include "mongo/db/query/runner.h"
 #include "mongo/db/query/runner_yield_policy.h"
 
@@ -38,9 +40,6 @@ namespace mongo {
 
     class BSONObj;
     class DiskLoc;
-    class PlanStage;
-    struct PlanStageStats;
-    class WorkingSet;
 
     /**
      * A PlanExecutor is the abstraction that knows how to crank a tree of stages into execution.
@@ -49,6 +48,12 @@ namespace mongo {
      *
      * Executes a plan.  Used by a runner.  Calls work() on a plan until a result is produced.
      * Stops when the plan is EOF or if the plan errors.
+     *
+     * If the 'planExecutorBatchSize' server parameter is more than 1 the plan is run with
+     * workBatch(...) instead, and results are handed out of the batch one at a time.  Yielding
+     * happens between batches.  Callers of getNext(...) that ask for DiskLocs don't get a batch,
+     * as they modify what they're handed and yield behind our back.  Results still buffered over
+     * a yield are owned copies of what matched before it.
      */
     class PlanExecutor {
     public:
@@ -99,6 +104,17 @@ namespace mongo {
         void kill();
 
     private:
+        /**
+         * Fill out the runner's view of the result 'id' and free it.
+         */
+        Runner::RunnerState returnResult(WorkingSetID id, BSONObj* objOut, DiskLoc* dlOut);
+
+        /**
+         * Page in the record that 'id' refers to on behalf of a stage that asked for it.  Returns
+         * false if we were killed while yielding to do so.
+         */
+        bool fetch(WorkingSetID id);
+
         boost::scoped_ptr<WorkingSet> _workingSet;
         boost::scoped_ptr<PlanStage> _root;
         boost::scoped_ptr<RunnerYieldPolicy> _yieldPolicy;
@@ -106,6 +122,14 @@ namespace mongo {
         // Did somebody drop an index we care about or the namespace we're looking at?  If so,
         // we'll be killed.
         bool _killed;
+
+        // Results of the last batch that we haven't returned yet.  They are ours to invalidate.
+        std::vector<WorkingSetID> _batch;
+        size_t _batchPos;
+
+        // How the last batch ended, if it ended with IS_EOF, DEAD or FAILURE.  Reported once
+        // _batch is drained.  NEED_TIME otherwise.
+        PlanStage::StageState _batchState;
     };
 
 }  // namespace mongo
@@ -83,6 +83,7 @@ namespace mongo {
      */
     struct PlanRankingDecision {
         PlanRankingDecision() : statsOfWinner(NULL), onlyOneSolution(false) { }
+        ~PlanRankingDecision() { delete statsOfWinner; }
 
         // Owned by us.
         PlanStageStats* statsOfWinner;
@@ -91,6 +92,8 @@ namespace mongo {
 
         // TODO: We can place anything we want here.  What's useful to the cache?  What's useful to
         // planning and optimization?
+    private:
+        MONGO_DISALLOW_COPYING(PlanRankingDecision);
     };
 
 }  // namespace mongo
@@ -1060,7 +1060,8 @@ namespace mongo {
             solnRoot = sfn;
         }
 
-        bool blockingSort = false;
+        // Non-NULL if we had to add a blocking sort.  Points into the solution tree.
+        SortNode* blockingSort = NULL;
 
         // Sort the results, if there is a sort specified.
         if (!query.getParsed().getSort().isEmpty()) {
@@ -1097,7 +1098,7 @@ namespace mongo {
                         getBoundsForSort(query, sort);
                         sort->children.push_back(solnRoot);
                         solnRoot = sort;
-                        blockingSort = true;
+                        blockingSort = sort;
                     }
                 }
             }
@@ -1163,7 +1164,13 @@ namespace mongo {
         }
 
         if (0 != query.getParsed().getNumToReturn() &&
-            (blockingSort || !query.getParsed().wantMore())) {
+            (NULL != blockingSort || !query.getParsed().wantMore())) {
+
+            // The sort only has to keep the results that will survive the skip and limit.
+            if (NULL != blockingSort) {
+                blockingSort->limit = query.getParsed().getSkip()
+                                    + query.getParsed().getNumToReturn();
+            }
 
             LimitNode* limit = new LimitNode();
             limit->limit = query.getParsed().getNumToReturn();
@@ -482,6 +482,8 @@ namespace mongo {
         *ss << "SORT\n";
         addIndent(ss, indent + 1);
         *ss << "pattern = " << pattern.toString() << endl;
+        addIndent(ss, indent + 1);
+        *ss << "limit = " << limit << endl;
         addCommon(ss, indent);
         *ss << "Child:" << endl;
         children[0]->appendToString(ss, indent + 2);
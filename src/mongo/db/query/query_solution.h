@@ -403,7 +403,7 @@ namespace mongo {
     };
 
     struct SortNode : public QuerySolutionNode {
-        SortNode() : hasBounds(false) { }
+        SortNode() : hasBounds(false), limit(0) { }
         virtual ~SortNode() { }
 
         virtual StageType getType() const { return STAGE_SORT; }
@@ -432,6 +432,9 @@ namespace mongo {
 
         // XXX
         IndexBounds bounds;
+
+        // Sum of skip and limit, if a limit was pushed down.  0 for no limit.
+        size_t limit;
     };
 
     struct LimitNode : public QuerySolutionNode {
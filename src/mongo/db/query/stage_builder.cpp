@@ -103,6 +103,7 @@ namespace mongo {
             params.pattern = sn->pattern;
             params.bounds = sn->bounds;
             params.hasBounds = sn->hasBounds;
+            params.limit = sn->limit;
             return new SortStage(params, ws, childStage);
         }
         else if (STAGE_PROJECTION == root->getType()) {
@@ -435,6 +435,9 @@ namespace replset {
             bufferCountGauge.increment();
             bufferSizeGauge.increment(getSize(o));
 
+            // start faulting in what this op will touch while earlier batches are applied
+            theReplSet->getPrefetchPipeline().add(o);
+
             {
                 boost::unique_lock<boost::mutex> lock(_mutex);
                 _lastH = o["h"].numberLong();
@@ -436,6 +436,11 @@ namespace mongo {
             if (!_self->config().arbiterOnly) {
                 bb.appendTimestamp("optime", lastOpTimeWritten.asDate());
                 bb.appendDate("optimeDate", lastOpTimeWritten.getSecs() * 1000LL);
+                if (myState.secondary() || myState.recovering()) {
+                    BSONObjBuilder batch(bb.subobjStart("lastApplyBatch"));
+                    replset::appendLastApplyBatchStats(&batch);
+                    batch.done();
+                }
             }
 
             int maintenance = _maintenanceMode;
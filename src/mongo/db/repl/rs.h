@@ -567,6 +567,8 @@ namespace mongo {
         threadpool::ThreadPool _writerPool;
         // persistent pool of worker threads for prefetching
         threadpool::ThreadPool _prefetcherPool;
+        // prefetches ops as they are buffered, ahead of their batch
+        replset::OplogPrefetchPipeline _prefetchPipeline;
 
     public:
         // Allow index prefetching to be turned on/off
@@ -585,6 +587,7 @@ namespace mongo {
         static const int replPrefetcherThreadCount;
         threadpool::ThreadPool& getPrefetchPool() { return _prefetcherPool; }
         threadpool::ThreadPool& getWriterPool() { return _writerPool; }
+        replset::OplogPrefetchPipeline& getPrefetchPipeline() { return _prefetchPipeline; }
 
         static const int maxSyncSourceLagSecs;
 
@@ -659,6 +662,9 @@ namespace mongo {
         void fillIsMaster(BSONObjBuilder& b) { _fillIsMaster(b); }
         threadpool::ThreadPool& getPrefetchPool() { return ReplSetImpl::getPrefetchPool(); }
         threadpool::ThreadPool& getWriterPool() { return ReplSetImpl::getWriterPool(); }
+        replset::OplogPrefetchPipeline& getPrefetchPipeline() {
+            return ReplSetImpl::getPrefetchPipeline();
+        }
 
         /**
          * We have a new config (reconfig) - apply it.
@@ -39,12 +39,16 @@
 #include "mongo/db/d_concurrency.h"
 #include "mongo/db/namespace_string.h"
 #include "mongo/db/prefetch.h"
+#include "mongo/db/server_parameters.h"
 #include "mongo/db/repl/bgsync.h"
 #include "mongo/db/repl/oplog.h"
 #include "mongo/db/repl/rs.h"
 #include "mongo/db/repl/rs_sync.h"
+#include "mongo/db/stats/counters.h"
 #include "mongo/db/storage_options.h"
+#include "mongo/db/structure/collection.h"
 #include "mongo/util/fail_point_service.h"
+#include "mongo/util/processinfo.h"
 #include "mongo/db/commands/server_status.h"
 #include "mongo/db/stats/timer_stats.h"
 #include "mongo/base/counter.h"
@@ -76,7 +80,165 @@ namespace replset {
     static Counter64 opsAppliedStats;
     static ServerStatusMetricField<Counter64> displayOpsApplied( "repl.apply.ops",
                                                                 &opsAppliedStats );
+    // Number and time of the runs of inserts applied under a single lock
+    static TimerStats insertRunStats;
+    static ServerStatusMetricField<TimerStats> displayInsertRuns( "repl.apply.insertRuns",
+                                                                  &insertRunStats );
+    // The oplog entries applied as part of an insert run
+    static Counter64 insertRunOpsStats;
+    static ServerStatusMetricField<Counter64> displayInsertRunOps( "repl.apply.insertRunOps",
+                                                                   &insertRunOpsStats );
+
+    // The most recently applied batch; see appendLastApplyBatchStats()
+    static AtomicInt64 lastBatchOps;
+    static AtomicInt64 lastBatchInsertRunOps;
+    static AtomicInt64 lastBatchLagSecs;
+    static AtomicInt64 currentBatchInsertRunOps;
+
+    void appendLastApplyBatchStats(BSONObjBuilder* b) {
+        b->appendNumber("ops", lastBatchOps.load());
+        b->appendNumber("insertRunOps", lastBatchInsertRunOps.load());
+        b->appendNumber("lagSecs", lastBatchLagSecs.load());
+    }
+
+    namespace {
+        class LastApplyBatchServerStatusMetric : public ServerStatusMetric {
+        public:
+            LastApplyBatchServerStatusMetric() : ServerStatusMetric("repl.apply.lastBatch") {}
+            virtual void appendAtLeaf( BSONObjBuilder& b ) const {
+                BSONObjBuilder bb( b.subobjStart( _leafName ) );
+                appendLastApplyBatchStats( &bb );
+                bb.done();
+            }
+        } lastApplyBatchServerStatusMetric;
+    }
+
+
+    void initializePrefetchThread();
+
+    // Most ops the prefetch pipeline keeps in flight; 0 turns it off.
+    MONGO_EXPORT_SERVER_PARAMETER(replPrefetchPipelineMaxDepth, int, 1024);
+
+    // Major page faults per second above which the pipeline prefetches further ahead
+    static const long long prefetchPipelineFaultsPerSec = 10;
+
+    // Ops prefetched by the pipeline ahead of their batch
+    static Counter64 pipelinePrefetchStats;
+    static ServerStatusMetricField<Counter64> displayPipelinePrefetch( "repl.preload.pipelined",
+                                                                      &pipelinePrefetchStats );
+
+    namespace {
+        class PrefetchPipelineDepthServerStatusMetric : public ServerStatusMetric {
+        public:
+            PrefetchPipelineDepthServerStatusMetric()
+                : ServerStatusMetric("repl.preload.pipelineDepth") {}
+            virtual void appendAtLeaf( BSONObjBuilder& b ) const {
+                b.append( _leafName, theReplSet ? theReplSet->getPrefetchPipeline().getDepth() : 0 );
+            }
+        } prefetchPipelineDepthServerStatusMetric;
+    }
+
+    const int OplogPrefetchPipeline::minDepth;
+
+    OplogPrefetchPipeline::OplogPrefetchPipeline(int nThreads) :
+        _pool(nThreads), _mutex("OplogPrefetchPipeline"), _inFlight(0), _depth(minDepth),
+        _lastFaults(-1), _lastAdapt(0)
+    {}
+
+    void OplogPrefetchPipeline::add(const BSONObj& op) {
+        const int maxDepth = replPrefetchPipelineMaxDepth;
+        if (maxDepth <= 0) {
+            return;
+        }
+        // the only ops prefetchPagesForReplicatedOp() does anything for
+        const char opType = *op.getStringField("op");
+        if (opType != 'i' && opType != 'u' && opType != 'd') {
+            return;
+        }
+
+        {
+            scoped_lock lk(_mutex);
+            adaptDepth_inlock(maxDepth);
+            if (_inFlight >= _depth) {
+                // SyncTail will prefetch it with the rest of its batch
+                return;
+            }
+            _inFlight++;
+            _queued.insert(op["ts"]._opTime().asDate());
+        }
+        pipelinePrefetchStats.increment();
+        _pool.schedule(&OplogPrefetchPipeline::prefetch, this, op);
+    }
 
+    bool OplogPrefetchPipeline::claim(const BSONObj& op) {
+        const unsigned long long ts = op["ts"]._opTime().asDate();
+        scoped_lock lk(_mutex);
+        // ops are applied in order, so anything older was dropped from the buffer (e.g. on a
+        // rollback) and will never be claimed.  Their prefetches are left to finish unrecorded.
+        _queued.erase(_queued.begin(), _queued.lower_bound(ts));
+        _done.erase(_done.begin(), _done.lower_bound(ts));
+
+        // The pool runs ops in the order they were added, so this only waits on ops older than
+        // the ones the applier has yet to gather.
+        while (_queued.count(ts)) {
+            _prefetched.wait(lk.boost());
+        }
+        return _done.erase(ts) != 0;
+    }
+
+    int OplogPrefetchPipeline::getDepth() const {
+        scoped_lock lk(_mutex);
+        return _depth;
+    }
+
+    void OplogPrefetchPipeline::prefetch(const BSONObj& op) {
+        initializePrefetchThread();
+        // We are not a batch participant: faulting pages in under a database read lock while
+        // the previous batch applies would hold up its writers.  So this waits for
+        // ParallelBatchWriterMode like any reader, and runs while the applier gathers the next
+        // batch.  claim() waits for it before that batch takes ParallelBatchWriterMode.
+        SyncTail::prefetchOp(op);
+
+        const unsigned long long ts = op["ts"]._opTime().asDate();
+        scoped_lock lk(_mutex);
+        _inFlight--;
+        if (_queued.erase(ts)) {
+            _done.insert(ts);
+        }
+        _prefetched.notify_all();
+    }
+
+    void OplogPrefetchPipeline::adaptDepth_inlock(int maxDepth) {
+        const time_t now = time(0);
+        if (now == _lastAdapt) {
+            _depth = std::min(_depth, maxDepth);
+            return;
+        }
+
+        BSONObjBuilder b;
+        ProcessInfo().getExtraInfo(b);
+        const BSONObj info = b.done();
+        if (!info["page_faults"].isNumber()) {
+            // no way to tell; always run as far ahead as allowed
+            _depth = maxDepth;
+            _lastAdapt = now;
+            return;
+        }
+
+        const long long faults = info["page_faults"].numberLong();
+        if (_lastFaults >= 0) {
+            const long long faultsPerSec = (faults - _lastFaults) / (now - _lastAdapt);
+            if (faultsPerSec > prefetchPipelineFaultsPerSec) {
+                _depth *= 2;
+            }
+            else {
+                _depth = std::max(_depth / 2, static_cast<int>(minDepth));
+            }
+        }
+        _depth = std::min(_depth, maxDepth);
+        _lastFaults = faults;
+        _lastAdapt = now;
+    }
 
     SyncTail::SyncTail(BackgroundSyncInterface *q) :
         Sync(""), oplogVersion(0), _networkQueue(q)
@@ -128,6 +290,84 @@ namespace replset {
         return ok;
     }
 
+    // static
+    std::vector<BSONObj>::const_iterator SyncTail::findInsertRunEnd(
+            std::vector<BSONObj>::const_iterator begin,
+            std::vector<BSONObj>::const_iterator end) {
+        std::vector<BSONObj>::const_iterator it = begin;
+        StringData ns;
+        for ( ; it != end && it - begin < replInsertRunLimitOperations; ++it) {
+            if (*it->getStringField("op") != 'i') {
+                break;
+            }
+            // index builds and system collections keep going through syncApply()
+            const StringData opNs = it->getStringField("ns");
+            if (it == begin) {
+                const NamespaceString nss(opNs);
+                if (!nss.isValid() || nss.isSystem()) {
+                    break;
+                }
+                ns = opNs;
+            }
+            else if (opNs != ns) {
+                break;
+            }
+            // without an _id the insert has to be matched on the whole document
+            if (!it->getObjectField("o").hasField("_id")) {
+                break;
+            }
+        }
+        return it == begin ? begin + 1 : it;
+    }
+
+    // Inserts 'doc' directly; returns false if it has to be applied as an upsert instead,
+    // e.g. because this op is being replayed and the document is already there.
+    static bool insertForReplication(Collection* collection, const BSONObj& doc) {
+        try {
+            return collection->insertDocument(doc, false).isOK();
+        }
+        catch (const DBException& e) {
+            if (e.getCode() != ErrorCodes::DuplicateKey) {
+                throw;
+            }
+            return false;
+        }
+    }
+
+    bool SyncTail::syncApplyInsertRun(std::vector<BSONObj>::const_iterator begin,
+                                      std::vector<BSONObj>::const_iterator end,
+                                      bool convertUpdateToUpsert) {
+        const char *ns = begin->getStringField("ns");
+        TimerHolder timer(&insertRunStats);
+
+        Lock::DBWrite lk(ns);
+        Client::Context ctx(ns, storageGlobalParams.dbpath);
+        ctx.getClient()->curop()->reset();
+
+        // Keys are still generated per document, by insertDocument.  Each document's keys have to
+        // go in with its DiskLoc and be rolled back alone if one of them is a duplicate, so the
+        // run shares the lock and the commit check but not key generation.
+        bool ok = true;
+        for (std::vector<BSONObj>::const_iterator it = begin; it != end; ++it) {
+            // looked up each time since an upsert below may have created the collection
+            Collection* collection = ctx.db()->getCollection(ns);
+            if (collection &&
+                collection->getIndexCatalog()->findIdIndex() &&
+                insertForReplication(collection, it->getObjectField("o"))) {
+                replOpCounters.gotInsert();
+            }
+            else if (applyOperation_inlock(*it, true, convertUpdateToUpsert)) {
+                ok = false;
+            }
+            opsAppliedStats.increment();
+        }
+        insertRunOpsStats.increment(end - begin);
+        currentBatchInsertRunOps.fetchAndAdd(end - begin);
+        getDur().commitIfNeeded();
+
+        return ok;
+    }
+
     void initializePrefetchThread() {
         if (!ClientBasic::getCurrent()) {
             Client::initThread("repl prefetch worker");
@@ -155,13 +395,19 @@ namespace replset {
         // idempotent operations for this to work.  See SERVER-6825
         bool convertUpdatesToUpserts = theReplSet->oplogVersion > 1 ? true : false;
 
-        for (std::vector<BSONObj>::const_iterator it = ops.begin();
-             it != ops.end();
-             ++it) {
+        std::vector<BSONObj>::const_iterator it = ops.begin();
+        while (it != ops.end()) {
+            std::vector<BSONObj>::const_iterator runEnd = SyncTail::findInsertRunEnd(it, ops.end());
             try {
-                if (!st->syncApply(*it, convertUpdatesToUpserts)) {
+                if (runEnd - it > 1) {
+                    if (!st->syncApplyInsertRun(it, runEnd, convertUpdatesToUpserts)) {
+                        fassertFailedNoTrace(17302);
+                    }
+                }
+                else if (!st->syncApply(*it, convertUpdatesToUpserts)) {
                     fassertFailedNoTrace(16359);
                 }
+                it = runEnd;
             } catch (const DBException& e) {
                 error() << "writer worker caught exception: " << causedBy(e)
                         << " on: " << it->toString() << endl;
@@ -224,13 +470,17 @@ namespace replset {
         }
     }
 
-    // Doles out all the work to the reader pool threads and waits for them to complete
+    // Doles out all the work to the reader pool threads and waits for them to complete.  Ops
+    // the prefetch pipeline has taken are waited for there instead.
     void SyncTail::prefetchOps(const std::deque<BSONObj>& ops) {
         threadpool::ThreadPool& prefetcherPool = theReplSet->getPrefetchPool();
+        OplogPrefetchPipeline& pipeline = theReplSet->getPrefetchPipeline();
         for (std::deque<BSONObj>::const_iterator it = ops.begin();
              it != ops.end();
              ++it) {
-            prefetcherPool.schedule(&prefetchOp, *it);
+            if (!pipeline.claim(*it)) {
+                prefetcherPool.schedule(&prefetchOp, *it);
+            }
         }
         prefetcherPool.join();
     }
@@ -267,7 +517,14 @@ namespace replset {
         // stop all readers until we're done
         Lock::ParallelBatchWriterMode pbwm;
 
+        currentBatchInsertRunOps.store(0);
         applyOps(writerVectors, applyFunc);
+
+        lastBatchOps.store(ops.size());
+        lastBatchInsertRunOps.store(currentBatchInsertRunOps.load());
+        if (!ops.empty()) {
+            lastBatchLagSecs.store(time(0) - ops.back()["ts"]._opTime().getSecs());
+        }
     }
 
 
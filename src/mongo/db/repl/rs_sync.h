@@ -29,12 +29,16 @@
 #pragma once
 
 #include <deque>
+#include <set>
 #include <vector>
 
+#include <boost/thread/condition.hpp>
+
 #include "mongo/db/client.h"
 #include "mongo/db/dur.h"
 #include "mongo/db/jsobj.h"
 #include "mongo/db/repl/sync.h"
+#include "mongo/util/concurrency/mutex.h"
 #include "mongo/util/concurrency/thread_pool.h"
 
 namespace mongo {
@@ -42,6 +46,56 @@ namespace replset {
 
     class BackgroundSyncInterface;
 
+    /**
+     * Prefetches ops as the background sync thread buffers them.  The pipeline's threads are not
+     * batch participants, so they wait out the apply of the current batch like any reader; the
+     * pages the next batch needs are faulted in as soon as it has been applied, while the applier
+     * is still gathering the next batch.  Before applying a batch SyncTail claims its ops: those
+     * the pipeline has prefetched are skipped by SyncTail's own prefetch, and those it still has
+     * queued are waited for, so every op is prefetched before it is applied.
+     *
+     * How many ops may be in flight adapts to the process' major page fault rate: it doubles
+     * while we are faulting and halves while everything is resident, within
+     * [minDepth, replPrefetchPipelineMaxDepth].
+     */
+    class OplogPrefetchPipeline {
+        MONGO_DISALLOW_COPYING(OplogPrefetchPipeline);
+    public:
+        static const int minDepth = 16;
+
+        explicit OplogPrefetchPipeline(int nThreads);
+
+        /** Called by the background sync thread for each op it buffers. */
+        void add(const BSONObj& op);
+
+        /**
+         * Called as 'op' is about to be applied, before ParallelBatchWriterMode is taken.  Waits
+         * for the pipeline's prefetch of 'op' if it is queued or running.
+         * @return true if the pipeline prefetched 'op', in which case it needn't be prefetched
+         * again.
+         */
+        bool claim(const BSONObj& op);
+
+        int getDepth() const;
+
+    private:
+        void prefetch(const BSONObj& op);
+
+        /** Re-evaluates _depth at most once a second. */
+        void adaptDepth_inlock(int maxDepth);
+
+        threadpool::ThreadPool _pool;
+
+        mutable mongo::mutex _mutex; // guards everything below
+        boost::condition _prefetched; // notified as each op's prefetch finishes
+        std::set<unsigned long long> _queued; // timestamps of ops added, prefetch not finished
+        std::set<unsigned long long> _done; // timestamps of ops prefetched and not yet claimed
+        int _inFlight;
+        int _depth;
+        long long _lastFaults;
+        time_t _lastAdapt;
+    };
+
     /**
      * "Normal" replica set syncing
      */
@@ -52,6 +106,27 @@ namespace replset {
         virtual ~SyncTail();
         virtual bool syncApply(const BSONObj &o, bool convertUpdateToUpsert = false);
 
+        /**
+         * Apply a run of inserts into one namespace, as found by findInsertRunEnd(), under a
+         * single lock acquisition and journal commit check.  Each document is inserted directly;
+         * one that is already present is applied as an upsert, as syncApply() would.
+         * @return bool success (true) or failure (false)
+         */
+        virtual bool syncApplyInsertRun(std::vector<BSONObj>::const_iterator begin,
+                                        std::vector<BSONObj>::const_iterator end,
+                                        bool convertUpdateToUpsert = false);
+
+        /**
+         * @return the end of the run of batchable inserts into the same namespace that starts at
+         *         'begin', or begin + 1 if the op at 'begin' can't start a run.
+         */
+        static std::vector<BSONObj>::const_iterator findInsertRunEnd(
+                std::vector<BSONObj>::const_iterator begin,
+                std::vector<BSONObj>::const_iterator end);
+
+        // Used by the thread pool readers to prefetch an op
+        static void prefetchOp(const BSONObj& op);
+
         /**
          * Apply ops from applyGTEObj's ts to at least minValidObj's ts.  Note that, due to
          * batching, this may end up applying ops beyond minValidObj's ts.
@@ -112,6 +187,8 @@ namespace replset {
         static const unsigned int replBatchLimitBytes = dur::UncommittedBytesLimit;
         static const int replBatchLimitSeconds = 1;
         static const unsigned int replBatchLimitOperations = 5000;
+        // Cap on how many inserts a writer applies under one lock acquisition.
+        static const int replInsertRunLimitOperations = 500;
 
         // Prefetch and write a deque of operations, using the supplied function.
         // Initial Sync and Sync Tail each use a different function.
@@ -125,8 +202,6 @@ namespace replset {
 
         // Doles out all the work to the reader pool threads and waits for them to complete
         void prefetchOps(const std::deque<BSONObj>& ops);
-        // Used by the thread pool readers to prefetch an op
-        static void prefetchOp(const BSONObj& op);
 
         // Doles out all the work to the writer pool threads and waits for them to complete
         void applyOps(const std::vector< std::vector<BSONObj> >& writerVectors, 
@@ -160,5 +235,11 @@ namespace replset {
     void multiSyncApply(const std::vector<BSONObj>& ops, SyncTail* st);
     void multiInitialSyncApply(const std::vector<BSONObj>& ops, SyncTail* st);
 
+    /**
+     * Appends the number of ops in the most recently applied batch, how many of them were applied
+     * as insert runs, and how many seconds behind its last op the batch finished.
+     */
+    void appendLastApplyBatchStats(BSONObjBuilder* b);
+
 } // namespace replset
 } // namespace mongo
@@ -34,6 +34,7 @@
 
 #include <boost/filesystem/operations.hpp>
 
+#include "mongo/db/commands/server_status.h"
 #include "mongo/db/d_concurrency.h"
 #include "mongo/db/dur.h"
 #include "mongo/db/lockstate.h"
@@ -207,4 +208,21 @@ namespace mongo {
         }
     }
 
+    namespace {
+
+        class FileAllocatorSSS : public ServerStatusSection {
+        public:
+            FileAllocatorSSS() : ServerStatusSection( "fileAllocator" ){}
+            virtual bool includeByDefault() const { return true; }
+
+            BSONObj generateSection(const BSONElement& configElement) const {
+                BSONObjBuilder b;
+                FileAllocator::get()->appendStats( b );
+                return b.obj();
+            }
+
+        } fileAllocatorSSS;
+
+    }
+
 }
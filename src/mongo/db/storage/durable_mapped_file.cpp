@@ -47,9 +47,44 @@ using namespace mongoutils;
 
 namespace mongo {
 
+    void DurableMappedFile::noteDirty(size_t ofs, size_t len) {
+        if( len == 0 )
+            return;
+        if( _dirtyRegions.empty() )
+            _dirtyRegions.resize( (length() + RemapRegionSize - 1) / RemapRegionSize );
+        size_t last = std::min( (ofs + len - 1) / RemapRegionSize, _dirtyRegions.size() - 1 );
+        for( size_t r = ofs / RemapRegionSize; r <= last; r++ )
+            _dirtyRegions[r] = true;
+    }
+
     void DurableMappedFile::remapThePrivateView() {
         verify(storageGlobalParams.dur);
 
+#if !defined(_WIN32)
+        if( !_dirtyRegions.empty() ) {
+            // only written regions have copy on write pages in the private view; remap each run
+            // of them and leave the rest of the view (and its page table entries) alone
+            const unsigned long long len = length();
+            size_t r = 0;
+            while( r < _dirtyRegions.size() ) {
+                if( !_dirtyRegions[r] ) {
+                    r++;
+                    continue;
+                }
+                size_t end = r;
+                while( end < _dirtyRegions.size() && _dirtyRegions[end] ) {
+                    _dirtyRegions[end] = false;
+                    end++;
+                }
+                unsigned long long ofs = (unsigned long long) r * RemapRegionSize;
+                unsigned long long stop = std::min( len, (unsigned long long) end * RemapRegionSize );
+                remapPrivateViewRange( _view_private, ofs, (size_t) (stop - ofs) );
+                r = end;
+            }
+            return;
+        }
+#endif
+
         // todo 1.9 : it turns out we require that we always remap to the same address.
         // so the remove / add isn't necessary and can be removed?
         void *old = _view_private;
@@ -57,6 +92,7 @@ namespace mongo {
         _view_private = remapPrivateView(_view_private);
         //privateViews.add(_view_private, this);
         fassert( 16112, _view_private == old );
+        _dirtyRegions.assign( _dirtyRegions.size(), false );
     }
 
     /** register view. threadsafe */
@@ -31,6 +31,8 @@
 
 #pragma once
 
+#include <vector>
+
 #include "mongo/util/mmap.h"
 #include "mongo/util/paths.h"
 
@@ -95,15 +97,24 @@ namespace mongo {
         */
         bool& willNeedRemap() { return _willNeedRemap; }
 
+        /** notes that [ofs, ofs+len) of the private view has been written.  called from
+            PREPLOGBUFFER so that remapThePrivateView() only replaces the regions touched.
+        */
+        void noteDirty(size_t ofs, size_t len);
+
+        /** replace the written regions of the private view with fresh mappings of the file */
         void remapThePrivateView();
 
         virtual bool isDurableMappedFile() { return true; }
 
     private:
+        // granularity of dirty tracking for remapping; a multiple of the page size
+        static const size_t RemapRegionSize = 4 * 1024 * 1024;
 
         void *_view_write;
         void *_view_private;
         bool _willNeedRemap;
+        std::vector<bool> _dirtyRegions; // one per RemapRegionSize bytes of the file
         RelativePath _p;   // e.g. "somepath/dbname"
         int _fileSuffixNo;  // e.g. 3.  -1="ns"
 
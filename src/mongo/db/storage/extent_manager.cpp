@@ -374,7 +374,11 @@ namespace mongo {
         // no space in an existing file
         // allocate files until we either get one big enough or hit maxSize
         for ( int i = 0; i < 8; i++ ) {
-            DataFile* f = addAFile( size, false );
+            // keep a file allocating in the background ahead of this one, so that the next
+            // time we're here the file is already there rather than being zeroed under the lock
+            bool preallocateNext = maxFileNoForQuota <= 0 ||
+                static_cast<int>( numFiles() ) + 1 < maxFileNoForQuota;
+            DataFile* f = addAFile( size, preallocateNext );
 
             if ( f->getHeader()->unusedLength >= size ) {
                 return _createExtentInFile( numFiles() - 1, f, size, maxFileNoForQuota );
@@ -0,0 +1,275 @@
+// free_space_index.cpp
+
+/**
+*    Copyright (C) 2013 10gen Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*    As a special exception, the copyright holders give permission to link the
+*    code of portions of this program with the OpenSSL library under certain
+*    conditions as described in each individual source file and distribute
+*    linked combinations including the program with the OpenSSL library. You
+*    must comply with the GNU Affero General Public License in all respects for
+*    all of the code used other than as permitted herein. If you modify file(s)
+*    with this exception, you may extend this exception to your version of the
+*    file(s), but you are not obligated to do so. If you do not wish to do so,
+*    delete this exception statement from your version. If you delete this
+*    exception statement from all source files in the program, then also delete
+*    it in the license file.
+*/
+
+#include "mongo/db/storage/free_space_index.h"
+
+#include <map>
+
+#include "mongo/db/dur.h"
+#include "mongo/db/namespace_details.h"
+#include "mongo/db/pdfile.h"
+#include "mongo/platform/atomic_word.h"
+
+namespace mongo {
+
+    namespace {
+        SimpleMutex indexesMutex( "FreeSpaceIndex" );
+        typedef std::map<NamespaceDetails*, FreeSpaceIndex*> Indexes;
+        Indexes indexes; // shrinks only through forget() and forgetRange()
+
+        // entries mirrored by all the indexes, held under MaxTotalIndexedRecords
+        AtomicInt64 totalEntries;
+    }
+
+    FreeSpaceIndex* FreeSpaceIndex::get( NamespaceDetails* d ) {
+        SimpleMutex::scoped_lock lk( indexesMutex );
+        FreeSpaceIndex*& index = indexes[d];
+        if ( !index )
+            index = new FreeSpaceIndex( d );
+        return index;
+    }
+
+    void FreeSpaceIndex::forget( NamespaceDetails* d ) {
+        SimpleMutex::scoped_lock lk( indexesMutex );
+        Indexes::iterator i = indexes.find( d );
+        if ( i == indexes.end() )
+            return;
+        delete i->second;
+        indexes.erase( i );
+    }
+
+    void FreeSpaceIndex::forgetRange( const void* begin, unsigned long long len ) {
+        NamespaceDetails* first = (NamespaceDetails*) begin;
+        NamespaceDetails* last = (NamespaceDetails*) ( (const char*) begin + len );
+
+        SimpleMutex::scoped_lock lk( indexesMutex );
+        Indexes::iterator i = indexes.lower_bound( first );
+        Indexes::iterator end = indexes.lower_bound( last );
+        for ( Indexes::iterator j = i; j != end; ++j )
+            delete j->second;
+        indexes.erase( i, end );
+    }
+
+    bool FreeSpaceIndex::peekStats( NamespaceDetails* d, Stats* stats ) {
+        SimpleMutex::scoped_lock lk( indexesMutex );
+        Indexes::iterator i = indexes.find( d );
+        if ( i == indexes.end() )
+            return false;
+
+        FreeSpaceIndex* index = i->second;
+        scoped_lock indexLk( index->_mutex );
+        if ( !index->_built || index->_tooBig || !index->_headsMatch() )
+            return false;
+
+        stats->records = index->_entries.size();
+        stats->bytes = index->_bytes;
+        stats->largest = index->_bySize.empty() ? 0 : index->_bySize.rbegin()->first;
+        return true;
+    }
+
+    FreeSpaceIndex::FreeSpaceIndex( NamespaceDetails* d )
+        : _d( d ),
+          _mutex( "FreeSpaceIndex" ),
+          _built( false ),
+          _tooBig( false ),
+          _bytes( 0 ) {
+        BOOST_STATIC_ASSERT( NumBuckets == Buckets );
+    }
+
+    FreeSpaceIndex::~FreeSpaceIndex() {
+        _clear( false );
+    }
+
+    bool FreeSpaceIndex::_reserve() {
+        if ( _entries.size() >= MaxIndexedRecords )
+            return false;
+        if ( totalEntries.addAndFetch( 1 ) > static_cast<long long>( MaxTotalIndexedRecords ) ) {
+            totalEntries.subtractAndFetch( 1 );
+            return false;
+        }
+        return true;
+    }
+
+    void FreeSpaceIndex::_clear( bool tooBig ) {
+        totalEntries.subtractAndFetch( _entries.size() );
+        _bySize.clear();
+        _entries.clear();
+        _bytes = 0;
+        _tooBig = tooBig;
+    }
+
+    bool FreeSpaceIndex::_headsMatch() const {
+        if ( _firstExtent != _d->firstExtent() )
+            return false;
+        for ( int b = 0; b < NumBuckets; b++ ) {
+            if ( _heads[b] != _d->deletedListEntry( b ) )
+                return false;
+        }
+        return true;
+    }
+
+    void FreeSpaceIndex::_rebuild() {
+        _clear( false );
+        _built = true;
+
+        _firstExtent = _d->firstExtent();
+        for ( int b = 0; b < NumBuckets; b++ )
+            _heads[b] = _d->deletedListEntry( b );
+
+        for ( int b = 0; b < NumBuckets; b++ ) {
+            DiskLoc prev;
+            for ( DiskLoc cur = _heads[b]; !cur.isNull(); cur = cur.drec()->nextDeleted() ) {
+                if ( !_reserve() ) {
+                    _clear( true );
+                    return;
+                }
+                Entry e;
+                e.prev = prev;
+                e.len = cur.drec()->lengthWithHeaders();
+                _entries[cur] = e;
+                _bySize.insert( std::make_pair( e.len, cur ) );
+                _bytes += e.len;
+                prev = cur;
+            }
+        }
+    }
+
+    bool FreeSpaceIndex::_sync() {
+        // too fragmented to mirror, or no room left under the global limit: stays that way,
+        // rather than walking the lists every time, until the collection is dropped or its
+        // database closed
+        if ( _tooBig )
+            return false;
+        if ( !_built || !_headsMatch() )
+            _rebuild();
+        return !_tooBig;
+    }
+
+    bool FreeSpaceIndex::_linkedAsExpected( const DiskLoc& dloc, const Entry& e ) const {
+        if ( dloc.drec()->lengthWithHeaders() != e.len )
+            return false;
+        if ( e.prev.isNull() )
+            return _d->deletedListEntry( NamespaceDetails::bucket( e.len ) ) == dloc;
+        return e.prev.drec()->nextDeleted() == dloc;
+    }
+
+    void FreeSpaceIndex::_unlink( const DiskLoc& dloc, const Entry& e ) {
+        DeletedRecord* r = dloc.drec();
+        const DiskLoc next = r->nextDeleted();
+
+        if ( e.prev.isNull() ) {
+            int b = NamespaceDetails::bucket( e.len );
+            getDur().writingDiskLoc( _d->deletedListEntry( b ) ) = next;
+            _heads[b] = next;
+        }
+        else {
+            getDur().writingDiskLoc( e.prev.drec()->nextDeleted() ) = next;
+        }
+        r->nextDeleted().writing().setInvalid(); // defensive.
+
+        if ( !next.isNull() ) {
+            Entries::iterator n = _entries.find( next );
+            if ( n != _entries.end() )
+                n->second.prev = e.prev;
+        }
+
+        _bySize.erase( std::make_pair( e.len, dloc ) );
+        _bytes -= e.len;
+        _entries.erase( dloc );
+        totalEntries.subtractAndFetch( 1 );
+    }
+
+    bool FreeSpaceIndex::alloc( int len, bool peekOnly, DiskLoc* out ) {
+        scoped_lock lk( _mutex );
+
+        // a record that isn't where we expect means the lists were edited without us; rebuild
+        // once and look again
+        for ( int attempt = 0; attempt < 2; attempt++ ) {
+            if ( attempt > 0 )
+                _rebuild();
+            if ( !_sync() )
+                return false;
+
+            BySize::iterator i = _bySize.lower_bound( std::make_pair( len, DiskLoc() ) );
+            if ( i == _bySize.end() ) {
+                *out = DiskLoc();
+                return true;
+            }
+
+            const DiskLoc found = i->second;
+            Entries::iterator e = _entries.find( found );
+            if ( e == _entries.end() || !_linkedAsExpected( found, e->second ) )
+                continue;
+
+            if ( !peekOnly ) {
+                verify( found.drec()->extentOfs() < found.getOfs() );
+                Entry entry = e->second;
+                _unlink( found, entry );
+            }
+            *out = found;
+            return true;
+        }
+
+        return false;
+    }
+
+    void FreeSpaceIndex::added( const DiskLoc& dloc, int len, const DiskLoc& oldHead ) {
+        scoped_lock lk( _mutex );
+
+        if ( !_built || _tooBig )
+            return;
+
+        const int b = NamespaceDetails::bucket( len );
+        if ( _heads[b] != oldHead || _firstExtent != _d->firstExtent() ) {
+            // something else has been at the lists; start over when next needed
+            _built = false;
+            return;
+        }
+
+        if ( !_reserve() ) {
+            _clear( true );
+            return;
+        }
+
+        if ( !oldHead.isNull() ) {
+            Entries::iterator old = _entries.find( oldHead );
+            if ( old != _entries.end() )
+                old->second.prev = dloc;
+        }
+
+        Entry e;
+        e.len = len;
+        _entries[dloc] = e;
+        _bySize.insert( std::make_pair( len, dloc ) );
+        _bytes += len;
+        _heads[b] = dloc;
+    }
+
+}
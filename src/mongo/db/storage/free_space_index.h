@@ -0,0 +1,151 @@
+// free_space_index.h
+
+/**
+*    Copyright (C) 2013 10gen Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*    As a special exception, the copyright holders give permission to link the
+*    code of portions of this program with the OpenSSL library under certain
+*    conditions as described in each individual source file and distribute
+*    linked combinations including the program with the OpenSSL library. You
+*    must comply with the GNU Affero General Public License in all respects for
+*    all of the code used other than as permitted herein. If you modify file(s)
+*    with this exception, you may extend this exception to your version of the
+*    file(s), but you are not obligated to do so. If you do not wish to do so,
+*    delete this exception statement from your version. If you delete this
+*    exception statement from all source files in the program, then also delete
+*    it in the license file.
+*/
+
+#pragma once
+
+#include <set>
+#include <utility>
+
+#include "mongo/base/disallow_copying.h"
+#include "mongo/db/diskloc.h"
+#include "mongo/platform/unordered_map.h"
+#include "mongo/util/concurrency/mutex.h"
+
+namespace mongo {
+
+    class BSONObjBuilder;
+    class NamespaceDetails;
+
+    /**
+     * An in memory best fit index over the deleted record lists of a non capped collection.
+     *
+     * The singly linked lists in NamespaceDetails stay authoritative; this mirrors them, with
+     * each DeletedRecord's predecessor, so that allocation finds the smallest DeletedRecord that
+     * fits with one ordered lookup and unlinks it without walking its chain.
+     *
+     * The mirror is built from disk on first use.  It is rebuilt whenever the list heads on disk
+     * stop matching what it expects, or a record it hands out is no longer linked where it
+     * thinks, so edits made to the lists behind its back cost a rebuild rather than correctness.
+     *
+     * Mutating calls must be made with the collection write locked.
+     */
+    class FreeSpaceIndex {
+        MONGO_DISALLOW_COPYING(FreeSpaceIndex);
+    public:
+        // past this many deleted records the collection is left to the on disk lists
+        static const size_t MaxIndexedRecords = 1024 * 1024;
+
+        // nor will all collections together mirror more than this many, about 200MB
+        static const size_t MaxTotalIndexedRecords = 2 * 1024 * 1024;
+
+        struct Stats {
+            long long records;
+            long long bytes;
+            int largest;
+        };
+
+        ~FreeSpaceIndex();
+
+        /** the index for 'd', created (empty, not yet built) if need be */
+        static FreeSpaceIndex* get( NamespaceDetails* d );
+
+        /** drops the index of a collection that is going away */
+        static void forget( NamespaceDetails* d );
+
+        /**
+         * Drops the indexes of every collection whose NamespaceDetails lie in the 'len' bytes at
+         * 'begin': the .ns file of a database that is being closed, dropped or repaired.
+         */
+        static void forgetRange( const void* begin, unsigned long long len );
+
+        /**
+         * Reports on 'd' if it already has an index that is built and current, without
+         * building one.
+         * @return false if there is no such index
+         */
+        static bool peekStats( NamespaceDetails* d, Stats* stats );
+
+        /**
+         * Finds the smallest deleted record of at least 'len' bytes, and unless 'peekOnly',
+         * unlinks it from its deleted list.
+         * @param out set to the record, or null if there's no room in the collection
+         * @return false if the index can't be used (too many records to mirror), in which
+         *         case nothing was done and the caller should search the lists itself
+         */
+        bool alloc( int len, bool peekOnly, DiskLoc* out );
+
+        /**
+         * Called once 'dloc' has been pushed on the head of its deleted list.
+         * @param oldHead what the head of that list was before
+         */
+        void added( const DiskLoc& dloc, int len, const DiskLoc& oldHead );
+
+    private:
+        explicit FreeSpaceIndex( NamespaceDetails* d );
+
+        struct Entry {
+            DiskLoc prev; // null if at the head of its list
+            int len;
+        };
+
+        typedef std::set< std::pair<int, DiskLoc> > BySize;
+        typedef unordered_map<DiskLoc, Entry, DiskLoc::Hasher> Entries;
+
+        /** rebuilds from disk if the lists have been changed without us. @return usable */
+        bool _sync();
+        void _rebuild();
+        bool _headsMatch() const;
+
+        /** counts a new entry against the global limit. @return false if it's over */
+        bool _reserve();
+
+        /** forgets every entry, and gives up on the collection if 'tooBig' */
+        void _clear( bool tooBig );
+
+        /** @return true if 'dloc' is linked on disk where the mirror has it */
+        bool _linkedAsExpected( const DiskLoc& dloc, const Entry& e ) const;
+
+        void _unlink( const DiskLoc& dloc, const Entry& e );
+
+        NamespaceDetails* const _d;
+        mongo::mutex _mutex; // collStats reads under a read lock
+
+        bool _built;
+        bool _tooBig;
+        enum { NumBuckets = 19 }; // NamespaceDetails' Buckets
+        DiskLoc _heads[NumBuckets]; // expected heads of the deleted lists
+        DiskLoc _firstExtent; // catches the NamespaceDetails being reused by another collection
+        long long _bytes;
+
+        BySize _bySize;
+        Entries _entries;
+    };
+
+}
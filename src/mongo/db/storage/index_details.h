@@ -192,7 +192,7 @@ namespace mongo {
                     it may not mean we can build the index version in question: we may not maintain building 
                     of indexes in old formats in the future.
         */
-        static bool isASupportedIndexVersionNumber(int v) { return (v&1)==v; } // v == 0 || v == 1
+        static bool isASupportedIndexVersionNumber(int v) { return v >= 0 && v <= 2; }
     };
 
 } // namespace mongo
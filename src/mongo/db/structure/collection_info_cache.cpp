@@ -33,6 +33,7 @@
 #include "mongo/db/d_concurrency.h"
 #include "mongo/db/namespace_details.h"
 #include "mongo/db/namespace_details-inl.h"
+#include "mongo/db/query/plan_cache.h"
 #include "mongo/db/structure/collection.h"
 #include "mongo/util/debug_util.h"
 
@@ -45,7 +46,10 @@ namespace mongo {
         : _collection( collection ),
           _keysComputed( false ),
           _qcCacheMutex( "_qcCacheMutex" ),
-          _qcWriteCount( 0 ) {}
+          _qcWriteCount( 0 ),
+          _planCache( new PlanCache() ) {}
+
+    CollectionInfoCache::~CollectionInfoCache() {}
 
     void CollectionInfoCache::reset() {
         Lock::assertWriteLocked( _collection->ns().ns() );
@@ -73,6 +77,8 @@ namespace mongo {
     }
 
     void CollectionInfoCache::notifyOfWriteOp() {
+        _planCache->notifyOfWriteOp();
+
         scoped_lock lk( _qcCacheMutex );
         if ( _qcCache.empty() )
             return;
@@ -81,6 +87,8 @@ namespace mongo {
     }
 
     void CollectionInfoCache::clearQueryCache() {
+        _planCache->clear();
+
         scoped_lock lk( _qcCacheMutex );
         _clearQueryCache_inlock();
     }
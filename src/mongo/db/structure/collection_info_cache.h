@@ -30,6 +30,8 @@
 
 #pragma once
 
+#include <boost/scoped_ptr.hpp>
+
 #include "mongo/db/index_set.h"
 #include "mongo/db/querypattern.h"
 
@@ -37,6 +39,7 @@
 namespace mongo {
 
     class Collection;
+    class PlanCache;
 
     /**
      * this is for storing things that you want to cache about a single collection
@@ -46,6 +49,7 @@ namespace mongo {
     public:
 
         CollectionInfoCache( Collection* collection );
+        ~CollectionInfoCache();
 
         /*
          * resets entire cache state
@@ -77,6 +81,12 @@ namespace mongo {
         void registerCachedQueryPlanForPattern( const QueryPattern &pattern,
                                                 const CachedQueryPlan &cachedQueryPlan );
 
+        /**
+         * plan cache for the new query framework
+         * cleared along with the old query optimizer cache
+         */
+        PlanCache* getPlanCache() { return _planCache.get(); }
+
     private:
 
         Collection* _collection; // not owned
@@ -95,6 +105,10 @@ namespace mongo {
         int _qcWriteCount;
         std::map<QueryPattern,CachedQueryPlan> _qcCache;
 
+        // --- for new query framework
+
+        boost::scoped_ptr<PlanCache> _planCache;
+
     };
 
 }
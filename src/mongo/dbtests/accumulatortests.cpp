@@ -826,6 +826,116 @@ namespace AccumulatorTests {
         
     } // namespace Sum
 
+    namespace Merge {
+
+        /** Feeds 'lhs' and 'rhs' to separate accumulators, merges them and returns the result. */
+        Value mergeOf( intrusive_ptr<Accumulator> (*factory)(),
+                       const vector<Value>& lhs,
+                       const vector<Value>& rhs ) {
+            intrusive_ptr<Accumulator> left = factory();
+            intrusive_ptr<Accumulator> right = factory();
+            for( size_t i = 0; i < lhs.size(); ++i ) {
+                left->process( lhs[ i ], false );
+            }
+            for( size_t i = 0; i < rhs.size(); ++i ) {
+                right->process( rhs[ i ], false );
+            }
+            left->merge( *right );
+            return left->getValue( false );
+        }
+
+        /** Integer and double partial sums merge to a double. */
+        class Sum {
+        public:
+            void run() {
+                vector<Value> lhs;
+                lhs.push_back( Value( 5 ) );
+                vector<Value> rhs;
+                rhs.push_back( Value( 1.5 ) );
+                Value sum = mergeOf( AccumulatorSum::create, lhs, rhs );
+                ASSERT_EQUALS( NumberDouble, sum.getType() );
+                ASSERT_EQUALS( 6.5, sum.getDouble() );
+            }
+        };
+
+        /** Partial averages merge by count, not by averaging the averages. */
+        class Avg {
+        public:
+            void run() {
+                vector<Value> lhs;
+                lhs.push_back( Value( 1 ) );
+                vector<Value> rhs;
+                rhs.push_back( Value( 2 ) );
+                rhs.push_back( Value( 6 ) );
+                ASSERT_EQUALS( 3, mergeOf( AccumulatorAvg::create, lhs, rhs ).getDouble() );
+            }
+        };
+
+        /** Min and max keep the extreme of both sides; an empty side has no effect. */
+        class MinMax {
+        public:
+            void run() {
+                vector<Value> lhs;
+                lhs.push_back( Value( 4 ) );
+                lhs.push_back( Value( 2 ) );
+                vector<Value> rhs;
+                rhs.push_back( Value( 3 ) );
+                rhs.push_back( Value( 7 ) );
+                ASSERT_EQUALS( 2, mergeOf( AccumulatorMinMax::createMin, lhs, rhs ).getInt() );
+                ASSERT_EQUALS( 7, mergeOf( AccumulatorMinMax::createMax, lhs, rhs ).getInt() );
+                ASSERT_EQUALS( 2, mergeOf( AccumulatorMinMax::createMin, lhs,
+                                           vector<Value>() ).getInt() );
+            }
+        };
+
+        /** Pushed values keep their order, ours first. */
+        class Push {
+        public:
+            void run() {
+                vector<Value> lhs;
+                lhs.push_back( Value( 1 ) );
+                vector<Value> rhs;
+                rhs.push_back( Value( 2 ) );
+                rhs.push_back( Value( 3 ) );
+                Value result = mergeOf( AccumulatorPush::create, lhs, rhs );
+                const vector<Value>& merged = result.getArray();
+                ASSERT_EQUALS( 3U, merged.size() );
+                ASSERT_EQUALS( 1, merged[ 0 ].getInt() );
+                ASSERT_EQUALS( 2, merged[ 1 ].getInt() );
+                ASSERT_EQUALS( 3, merged[ 2 ].getInt() );
+            }
+        };
+
+        /** A value present on both sides appears once. */
+        class AddToSet {
+        public:
+            void run() {
+                vector<Value> lhs;
+                lhs.push_back( Value( 1 ) );
+                lhs.push_back( Value( 2 ) );
+                vector<Value> rhs;
+                rhs.push_back( Value( 2 ) );
+                rhs.push_back( Value( 3 ) );
+                ASSERT_EQUALS( 3U, mergeOf( AccumulatorAddToSet::create, lhs, rhs )
+                                   .getArray().size() );
+            }
+        };
+
+        /** Accumulators without their own merge() go through getValue(true). */
+        class First {
+        public:
+            void run() {
+                vector<Value> lhs;
+                lhs.push_back( Value( 1 ) );
+                vector<Value> rhs;
+                rhs.push_back( Value( 2 ) );
+                ASSERT_EQUALS( 1, mergeOf( AccumulatorFirst::create, lhs, rhs ).getInt() );
+                ASSERT_EQUALS( 2, mergeOf( AccumulatorLast::create, lhs, rhs ).getInt() );
+            }
+        };
+
+    } // namespace Merge
+
     class All : public Suite {
     public:
         All() : Suite( "accumulator" ) {
@@ -902,6 +1012,13 @@ namespace AccumulatorTests {
             add<Sum::IntNull>();
             add<Sum::IntUndefined>();
             add<Sum::NoOverflowBeforeDouble>();
+
+            add<Merge::Sum>();
+            add<Merge::Avg>();
+            add<Merge::MinMax>();
+            add<Merge::Push>();
+            add<Merge::AddToSet>();
+            add<Merge::First>();
         }
     } myall;
 
@@ -47,3 +47,207 @@ namespace BtreeTests0 {
 namespace BtreeTests1 {
 #include "mongo/dbtests/btreetests.inl"
 }
+
+#undef BtreeBucket
+#undef btree
+#undef btreemod
+#define BtreeBucket BtreeBucket<V2>
+#define btree btree<V2>
+#define btreemod btreemod<V2>
+#undef testName
+#define testName "btree2"
+#undef BTVERSION
+#define BTVERSION 2
+namespace BtreeTests2 {
+#include "mongo/dbtests/btreetests.inl"
+}
+
+#undef BtreeBucket
+#undef btree
+#undef btreemod
+#undef testName
+#undef BTVERSION
+
+/** v:2 buckets share leading key bytes, so they are checked with keys that have them. */
+namespace BtreeTests2Prefix {
+
+    const char* ns() {
+        return "unittests.btreetests2";
+    }
+
+    /** @return a key whose first 150 bytes are the same as those of its neighbours */
+    BSONObj sharedPrefixKey( int i, int prefixLen = 150 ) {
+        char num[ 16 ];
+        sprintf( num, "%.8d", i );
+        return BSON( "" << string( prefixLen, 'p' ) + num );
+    }
+
+    class Ensure {
+    public:
+        Ensure() {
+            _c.ensureIndex( ns(), BSON( "a" << 1 ), false, "testIndex", false, false, 2 );
+        }
+        ~Ensure() {
+            _c.dropCollection( ns() );
+        }
+    private:
+        DBDirectClient _c;
+    };
+
+    class Base : public Ensure {
+    public:
+        Base() : _context( ns() ) { }
+        virtual ~Base() { }
+    protected:
+        IndexDetails& id() {
+            NamespaceDetails *nsd = nsdetails( ns() );
+            verify( nsd );
+            verify( nsd->getTotalIndexCount() >= 2 );
+            return nsd->idx( 1 );
+        }
+        const BtreeBucket<V2>* bt() {
+            return id().head.btree<V2>();
+        }
+        Ordering order() {
+            return Ordering::make( id().keyPattern() );
+        }
+        void checkValid( int nKeys ) {
+            bt()->assertValid( id().keyPattern(), true );
+            ASSERT_EQUALS( nKeys, bt()->fullValidate( id().head, id().keyPattern(), 0, true ) );
+        }
+        void insert( const BSONObj &key ) {
+            bt()->bt_insert( id().head, DiskLoc( 0, 2 ), key, order(), true, id(), true );
+            getDur().commitIfNeeded();
+        }
+        bool unindex( const BSONObj &key ) {
+            getDur().commitIfNeeded();
+            return bt()->unindex( id().head, id(), key, DiskLoc( 0, 2 ) );
+        }
+        bool present( const BSONObj &key ) {
+            int pos;
+            bool found;
+            bt()->locate( id(), id().head, key, order(), pos, found, DiskLoc( 0, 2 ), 1 );
+            return found;
+        }
+    private:
+        Lock::GlobalWrite _lk;
+        Client::Context _context;
+    };
+
+    /**
+     * Inserts keys in scattered order, mixing in keys too long for the compact format, then
+     * removes them so buckets are merged and balanced.
+     */
+    class InsertRemove : public Base {
+    public:
+        void run() {
+            const int n = 2000;
+            for( int i = 0; i < n; ++i ) {
+                insert( key( ( i * 7919 ) % n ) );
+            }
+            checkValid( n );
+            for( int i = 0; i < n; ++i ) {
+                ASSERT( present( key( i ) ) );
+            }
+            for( int i = 0; i < n; i += 2 ) {
+                ASSERT( unindex( key( i ) ) );
+            }
+            checkValid( n / 2 );
+            for( int i = 0; i < n; ++i ) {
+                ASSERT_EQUALS( i % 2 == 1, present( key( i ) ) );
+            }
+            for( int i = 1; i < n; i += 2 ) {
+                ASSERT( unindex( key( i ) ) );
+            }
+            checkValid( 0 );
+        }
+    private:
+        static BSONObj key( int i ) {
+            // a string over 255 bytes is not stored in compact format
+            return sharedPrefixKey( i, i % 10 == 0 ? 300 : 150 );
+        }
+    };
+
+    /** Keys sharing a long prefix take far fewer buckets in a v:2 index than in a v:1 index. */
+    class FewerBuckets {
+    public:
+        void run() {
+            long long v1 = buckets( 1 );
+            long long v2 = buckets( 2 );
+            ASSERT( v2 * 2 < v1 );
+        }
+    private:
+        static long long buckets( int version ) {
+            DBDirectClient c;
+            c.dropCollection( ns() );
+            c.ensureIndex( ns(), BSON( "a" << 1 ), false, "testIndex", false, false, version );
+            for( int i = 0; i < 2000; ++i ) {
+                c.insert( ns(), BSON( "a" << sharedPrefixKey( i ).firstElement().String() ) );
+            }
+            long long n;
+            {
+                Client::WriteContext ctx( ns() );
+                NamespaceDetails *nsd = nsdetails( ns() );
+                ASSERT_EQUALS( version, nsd->idx( 1 ).version() );
+                n = nsdetails( nsd->idx( 1 ).indexNamespace() )->numRecords();
+            }
+            c.dropCollection( ns() );
+            return n;
+        }
+    };
+
+    /** A key split between a bucket prefix and its stored bytes compares as the whole key. */
+    class KeySplitCompare {
+    public:
+        void run() {
+            vector<BSONObj> keys;
+            keys.push_back( BSON( "" << "abc" << "" << 1 ) );
+            keys.push_back( BSON( "" << "abc" << "" << 2 ) );
+            keys.push_back( BSON( "" << "abd" ) );
+            keys.push_back( BSON( "" << 3 << "" << "zzzy" ) );
+            keys.push_back( BSON( "" << 3 << "" << "zzzz" ) );
+            keys.push_back( BSON( "" << 3.5 ) );
+            Ordering order = Ordering::make( BSON( "a" << 1 << "b" << -1 ) );
+            for( unsigned p = 0; p < keys.size(); ++p ) {
+                KeyV2Owned prefixKey( keys[ p ] );
+                char prefix[ KeyV2::MaxPrefixLen ];
+                int prefixLen = prefixKey.copyPrefix( prefix );
+                for( int len = 0; len <= prefixLen; ++len ) {
+                    for( unsigned i = 0; i < keys.size(); ++i ) {
+                        KeyV2Owned a( keys[ i ] );
+                        char stored[ 64 ];
+                        ASSERT( a.storedSize( prefix, len ) <= (int) sizeof( stored ) );
+                        a.store( stored, prefix, len );
+                        KeyV2 split( prefix, stored );
+                        ASSERT_EQUALS( a.dataSize(), split.dataSize() );
+                        for( unsigned j = 0; j < keys.size(); ++j ) {
+                            KeyV2Owned b( keys[ j ] );
+                            ASSERT_EQUALS( sign( a.woCompare( b, order ) ),
+                                           sign( split.woCompare( b, order ) ) );
+                            ASSERT_EQUALS( sign( b.woCompare( a, order ) ),
+                                           sign( b.woCompare( split, order ) ) );
+                            ASSERT_EQUALS( a.woEqual( b ), split.woEqual( b ) );
+                        }
+                    }
+                }
+            }
+        }
+    private:
+        static int sign( int x ) {
+            return x < 0 ? -1 : x > 0 ? 1 : 0;
+        }
+    };
+
+    class All : public Suite {
+    public:
+        All() : Suite( "btree2prefix" ) {
+        }
+
+        void setupTests() {
+            add< InsertRemove >();
+            add< FewerBuckets >();
+            add< KeySplitCompare >();
+        }
+    } myall;
+
+} // namespace BtreeTests2Prefix
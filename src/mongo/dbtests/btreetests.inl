@@ -598,6 +598,8 @@
             return found;
         }
         int headerSize() const { return BtreeBucket::headerSize(); }
+        /** @return the bytes 'key' takes in a bucket where it shares nothing with other keys */
+        static int keySpace( const BSONObj &key ) { return keyDataSpaceBound( KeyOwned( key ) ); }
         int packedDataSize( int pos ) const { return BtreeBucket::packedDataSize( pos ); }
         void fixParentPtrs( const DiskLoc &thisLoc ) { BtreeBucket::fixParentPtrs( thisLoc ); }
         void forcePack() {
@@ -932,7 +934,7 @@
                 verify( nextSize > 0 );
                 BSONObj newKey = key( startKey++, nextSize );
                 t->push( newKey, DiskLoc() );
-                size += BtreeBucket::KeyOwned(newKey).dataSize() + sizeof( _KeyNode );
+                size += ArtificialTree::keySpace( newKey ) + sizeof( _KeyNode );
                 _count += 1;
             }
             if( t->packedDataSize( 0 ) != targetSize ) {
@@ -953,10 +955,10 @@
             return simpleKey( a, size );
         }
         static int bigSize() {
-            return BtreeBucket::KeyOwned(bigKey( 'a' )).dataSize();
+            return ArtificialTree::keySpace( bigKey( 'a' ) );
         }
         static int biggestSize() {
-            return BtreeBucket::KeyOwned(biggestKey( 'a' )).dataSize();
+            return ArtificialTree::keySpace( biggestKey( 'a' ) );
         }
         int _count;
     };
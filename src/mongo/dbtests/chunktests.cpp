@@ -49,6 +49,7 @@ namespace mongo {
             }
             
             chunkRanges.reloadAll( chunkMap );
+            _buildRoutingTable( NULL );
         }
     };
     
@@ -26,6 +26,11 @@
 #include "mongo/db/storage_options.h"
 #include "mongo/dbtests/dbtests.h"
 
+namespace mongo {
+    extern int internalAggregationGroupThreads;
+    extern int internalDocumentSourceGroupMaxMemoryBytes;
+}  // namespace mongo
+
 namespace DocumentSourceTests {
 
     static const char* const ns = "unittests.documentsourcetests";
@@ -405,13 +410,15 @@ namespace DocumentSourceTests {
 
         class Base : public DocumentSourceCursor::Base {
         protected:
-            void createGroup( const BSONObj &spec, bool inShard = false ) {
+            void createGroup( const BSONObj &spec, bool inShard = false,
+                              bool extSortAllowed = false ) {
                 BSONObj namedSpec = BSON( "$group" << spec );
                 BSONElement specElement = namedSpec.firstElement();
 
                 intrusive_ptr<ExpressionContext> expressionContext =
                         new ExpressionContext(InterruptStatusMongod::status, NamespaceString(ns));
                 expressionContext->inShard = inShard;
+                expressionContext->extSortAllowed = extSortAllowed;
                 expressionContext->tempDir = storageGlobalParams.dbpath + "/_tmp";
 
                 _group = DocumentSourceGroup::createFromBson( specElement, expressionContext );
@@ -881,6 +888,95 @@ namespace DocumentSourceTests {
             string expectedResultSetString() { return "[{_id:[1,2,3],a:[[4,5,6]]}]"; }
         };
 
+        /** Sets the $group thread count and memory limit for the life of the object. */
+        class GroupSettings {
+        public:
+            GroupSettings( int threads, int maxMemoryBytes ) :
+                _oldThreads( internalAggregationGroupThreads ),
+                _oldMaxMemoryBytes( internalDocumentSourceGroupMaxMemoryBytes ) {
+                internalAggregationGroupThreads = threads;
+                internalDocumentSourceGroupMaxMemoryBytes = maxMemoryBytes;
+            }
+            ~GroupSettings() {
+                internalAggregationGroupThreads = _oldThreads;
+                internalDocumentSourceGroupMaxMemoryBytes = _oldMaxMemoryBytes;
+            }
+        private:
+            const int _oldThreads;
+            const int _oldMaxMemoryBytes;
+        };
+
+        class ParallelBase : public Base {
+        protected:
+            /** The groups, sorted by _id, with $addToSet results sorted. */
+            BSONObj runGroup( int threads, int maxMemoryBytes = 100 * 1024 * 1024,
+                              bool extSortAllowed = false ) {
+                GroupSettings settings( threads, maxMemoryBytes );
+
+                createSource();
+                createGroup( fromjson( "{_id:'$id',sum:{$sum:'$a'},avg:{$avg:'$a'},"
+                                       "min:{$min:'$a'},max:{$max:'$a'},list:{$push:'$a'},"
+                                       "first:{$first:'$a'},last:{$last:'$a'},"
+                                       "set:{$addToSet:'$b'}}" ),
+                             false, extSortAllowed );
+                IdMap resultSet;
+                while (boost::optional<Document> current = group()->getNext()) {
+                    resultSet[ current->getField( "_id" ) ] = *current;
+                }
+                assertExhausted( group() );
+
+                BSONArrayBuilder bsonResultSet;
+                for( IdMap::const_iterator i = resultSet.begin(); i != resultSet.end(); ++i ) {
+                    // $addToSet has no defined order.
+                    MutableDocument result( i->second );
+                    vector<Value> set = result.peek()[ "set" ].getArray();
+                    sort( set.begin(), set.end(), ValueCmp() );
+                    result[ "set" ] = Value( set );
+                    bsonResultSet << result.freeze();
+                }
+                return bsonResultSet.arr();
+            }
+        };
+
+        /** Accumulating on several threads produces the same groups as on one. */
+        class Parallel : public ParallelBase {
+        public:
+            void run() {
+                for( int i = 0; i < 2000; ++i ) {
+                    client.insert( ns, BSON( "id" << i % 37 << "a" << i << "b" << i % 5 ) );
+                }
+                BSONObj serial = runGroup( 1 );
+                ASSERT_EQUALS( 37, serial.nFields() );
+                ASSERT_EQUALS( serial, runGroup( 4 ) );
+            }
+        };
+
+        /**
+         * Several threads over the memory limit each spill, and the merged spills produce the same
+         * groups as one thread that kept them all in memory.
+         */
+        class ParallelSpill : public ParallelBase {
+        public:
+            void run() {
+                // Long ids and $push lists, so every partition goes over its share many times.
+                const string pad( 100, 'x' );
+                for( int i = 0; i < 20000; ++i ) {
+                    client.insert( ns, BSON( "id" << BSON( "n" << i % 997 << "pad" << pad )
+                                             << "a" << i << "b" << i % 5 ) );
+                }
+                BSONObj inMemory = runGroup( 1 );
+                ASSERT_EQUALS( 997, inMemory.nFields() );
+
+                const int maxMemoryBytes = 256 * 1024;
+
+                // The partitions do go over their share: without external sort they give up.
+                ASSERT_THROWS( runGroup( 4, maxMemoryBytes ), UserException );
+
+                ASSERT_EQUALS( inMemory, runGroup( 4, maxMemoryBytes, true ) );
+                ASSERT_EQUALS( inMemory, runGroup( 3, maxMemoryBytes, true ) );
+            }
+        };
+
     } // namespace DocumentSourceGroup
 
     namespace DocumentSourceProject {
@@ -1909,6 +2005,8 @@ namespace DocumentSourceTests {
             add<DocumentSourceGroup::Dependencies>();
             add<DocumentSourceGroup::StringConstantIdAndAccumulatorExpressions>();
             add<DocumentSourceGroup::ArrayConstantAccumulatorExpression>();
+            add<DocumentSourceGroup::Parallel>();
+            add<DocumentSourceGroup::ParallelSpill>();
 
             add<DocumentSourceProject::Inclusion>();
             add<DocumentSourceProject::Optimize>();
@@ -332,6 +332,52 @@ namespace DocumentTests {
             }
         };
 
+        /** A lazy Document loads fields as they are looked up and serializes to its source. */
+        class LazyFromBson {
+        public:
+            void run() {
+                BSONObj obj = BSON( "a" << 1 << "b" << "q" << "c" << BSON( "d" << 2 ) << "e" << 3 );
+                Document lazy = Document::fromBsonLazy( obj );
+                ASSERT( obj.objdata() == lazy.toBson().objdata() );
+
+                ASSERT_EQUALS( "q", lazy["b"].getString() );
+                ASSERT( lazy["z"].missing() );
+                ASSERT_EQUALS( 2, lazy.getNestedField( FieldPath( "c.d" ) ).getInt() );
+                ASSERT( obj.objdata() == lazy.toBson().objdata() );
+
+                Document eager = fromBson( obj );
+                ASSERT_EQUALS( eager, lazy );
+                ASSERT_EQUALS( eager.positionOf( "e" ), lazy.positionOf( "e" ) );
+                ASSERT_EQUALS( 4U, lazy.size() );
+                ASSERT_EQUALS( obj, toBson( lazy ) );
+
+                ASSERT( Document::fromBsonLazy( BSONObj() ).empty() );
+            }
+        };
+
+        /** Modifying a lazy Document copies it and leaves the source untouched. */
+        class LazyCopyOnWrite {
+        public:
+            void run() {
+                BSONObj obj = BSON( "a" << 1 << "b" << BSON( "c" << 2 ) << "d" << 3 );
+                Document lazy = Document::fromBsonLazy( obj );
+                const Position apos = lazy.positionOf( "a" );
+
+                MutableDocument md( lazy );
+                md.setField( apos, Value( 10 ) );
+                md.setNestedField( FieldPath( "b.c" ), Value( 20 ) );
+                md.addField( "e", Value( 4 ) );
+                Document modified = md.freeze();
+
+                ASSERT_EQUALS( DOC( "a" << 10 << "b" << DOC( "c" << 20 ) << "d" << 3 << "e" << 4 ),
+                               modified );
+                ASSERT_EQUALS( BSON( "a" << 10 << "b" << BSON( "c" << 20 ) << "d" << 3 << "e" << 4 ),
+                               modified.toBson() );
+                ASSERT( obj.objdata() == lazy.toBson().objdata() );
+                ASSERT_EQUALS( BSON( "a" << 1 << "b" << BSON( "c" << 2 ) << "d" << 3 ), obj );
+            }
+        };
+
         class AllTypesDoc {
         public:
             void run() {
@@ -1415,6 +1461,8 @@ namespace DocumentTests {
             add<Document::FieldIteratorEmpty>();
             add<Document::FieldIteratorSingle>();
             add<Document::FieldIteratorMultiple>();
+            add<Document::LazyFromBson>();
+            add<Document::LazyCopyOnWrite>();
             add<Document::AllTypesDoc>();
 
             add<Value::BSONArrayTest>();
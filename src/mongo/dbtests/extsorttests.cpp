@@ -284,6 +284,38 @@ namespace ExtSortTests {
         }
     };
 
+    /** Merge the contents of other sorters into a sorter's output. */
+    class SortAbsorb {
+    public:
+        void run() {
+            BSONObjExternalSorter sorter( _aFirstSort );
+            BSONObjExternalSorter odd( _aFirstSort );
+            BSONObjExternalSorter spilled( _aFirstSort, 1024 );
+
+            for ( int i = 0; i < 1000; i++ ) {
+                BSONObjExternalSorter& target = ( i % 3 == 0 ? sorter :
+                                                  i % 3 == 1 ? odd : spilled );
+                target.add( BSON( "a" << ( i * 7 ) % 1000 ), DiskLoc( 0, i ), false );
+            }
+            int spilledFiles = spilled.numFiles();
+            ASSERT( spilledFiles > 0 );
+
+            sorter.absorb( &odd );
+            sorter.absorb( &spilled );
+            sorter.sort( false );
+            ASSERT( sorter.numFiles() >= spilledFiles );
+
+            auto_ptr<BSONObjExternalSorter::Iterator> i = sorter.iterator();
+            int num = 0;
+            while ( i->more() ) {
+                pair<BSONObj,DiskLoc> p = i->next();
+                ASSERT_EQUALS( num, p.first["a"].number() );
+                num++;
+            }
+            ASSERT_EQUALS( 1000, num );
+        }
+    };
+
     /**
      * BSONObjExternalSorter::add() aborts if the current operation is interrupted, even if storage
      * system writes have occurred.
@@ -400,6 +432,7 @@ namespace ExtSortTests {
             add<Sort1e6>();
             add<SortNull>();
             add<Sort130>();
+            add<SortAbsorb>();
             add<InterruptAdd>( false );
             add<InterruptAdd>( true );
             add<InterruptSort>( false );
@@ -29,6 +29,10 @@
 
 #include "mongo/dbtests/dbtests.h"
 
+namespace mongo {
+    extern int internalIndexBuildKeyThreads;
+}
+
 namespace IndexUpdateTests {
 
     static const char* const _ns = "unittests.indexupdate";
@@ -159,6 +163,64 @@ namespace IndexUpdateTests {
         bool _mayInterrupt;
     };
 
+    /**
+     * With several key generation threads, addKeysToPhaseOne() produces the same sorted keys as
+     * with one.
+     */
+    class AddKeysToPhaseOneParallel : public IndexBuildBase {
+    public:
+        AddKeysToPhaseOneParallel() : _oldThreads( internalIndexBuildKeyThreads ) {
+        }
+        ~AddKeysToPhaseOneParallel() {
+            internalIndexBuildKeyThreads = _oldThreads;
+        }
+        void run() {
+            // Enough documents for several batches per thread; every tenth one is multikey.
+            int32_t nDocs = 10000;
+            for( int32_t i = 0; i < nDocs; ++i ) {
+                if ( i % 10 == 0 ) {
+                    _client.insert( _ns, BSON( "a" << BSON_ARRAY( -i << nDocs + i ) ) );
+                }
+                else {
+                    _client.insert( _ns, BSON( "a" << nDocs - i ) );
+                }
+            }
+
+            IndexDescriptor* id = addIndexWithInfo();
+            internalIndexBuildKeyThreads = 4;
+            SortPhaseOne phaseOne;
+            ProgressMeterHolder pm (cc().curop()->setMessage("AddKeysToPhaseOneParallel",
+                                                             "AddKeysToPhaseOneParallel Progress",
+                                                             nDocs,
+                                                             nDocs));
+            BtreeBasedBuilder::addKeysToPhaseOne( collection(),
+                                                  id,
+                                                  BSON( "a" << 1 ),
+                                                  &phaseOne,
+                                                  pm.get(), true );
+            ASSERT_EQUALS( static_cast<uint64_t>( nDocs ), phaseOne.n );
+            ASSERT_EQUALS( static_cast<uint64_t>( nDocs + nDocs / 10 ), phaseOne.nkeys );
+            ASSERT( phaseOne.multi );
+
+            // The merged keys come out in order.
+            phaseOne.sorter->sort( false );
+            auto_ptr<BSONObjExternalSorter::Iterator> i = phaseOne.sorter->iterator();
+            uint64_t nKeys = 0;
+            BSONObj last;
+            while ( i->more() ) {
+                BSONObj key = i->next().first;
+                if ( nKeys > 0 ) {
+                    ASSERT( last.firstElement().number() <= key.firstElement().number() );
+                }
+                last = key.getOwned();
+                ++nKeys;
+            }
+            ASSERT_EQUALS( phaseOne.nkeys, nKeys );
+        }
+    private:
+        int _oldThreads;
+    };
+
     /** buildBottomUpPhases2And3() builds a btree from the keys in an external sorter. */
     class BuildBottomUp : public IndexBuildBase {
     public:
@@ -755,6 +817,7 @@ namespace IndexUpdateTests {
             add<AddKeysToPhaseOne>();
             add<InterruptAddKeysToPhaseOne>( false );
             add<InterruptAddKeysToPhaseOne>( true );
+            add<AddKeysToPhaseOneParallel>();
             add<BuildBottomUp>();
             add<InterruptBuildBottomUp>( false );
             add<InterruptBuildBottomUp>( true );
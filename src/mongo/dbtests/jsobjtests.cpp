@@ -72,6 +72,17 @@ namespace JsobjTests {
                 cout << r3 << endl;
             }
             ASSERT(ok);
+            {
+                // a prepared search key must order keys as woCompare does, either direction
+                const Ordering orderings[] = { Ordering::make(BSONObj()),
+                                               Ordering::make(BSON("a" << -1 << "b" << 1)) };
+                for( int i = 0; i < 2; i++ ) {
+                    int expected = k.woCompare(*kLast, orderings[i]);
+                    int got = KeyV1Search(k, orderings[i]).compare(*kLast);
+                    ASSERT_EQUALS( expected < 0, got < 0 );
+                    ASSERT_EQUALS( expected > 0, got > 0 );
+                }
+            }
             if( k.isCompactFormat() && kLast->isCompactFormat() ) { // only check if not bson as bson woEqual is broken! (or was may2011)
                 if( k.woEqual(*kLast) != (r2 == 0) ) { // check woEqual matches
                     cout << r2 << endl;
@@ -594,6 +605,14 @@ namespace JsobjTests {
                 keyTest( BSON("abc" << false ) );
                 keyTest( BSON("abc" << false << "b" << true ) );
 
+                // negative zero, and oids whose bytes differ in sign bit
+                keyTest( BSON("" << 0.0) );
+                keyTest( BSON("" << -0.0) );
+                keyTest( BSON("" << -1.5 << "" << -0.0) );
+                keyTest( BSON("" << OID("7f0000000000000000000001")) );
+                keyTest( BSON("" << OID("ff0000000000000000000001")) );
+                keyTest( BSON("" << OID("ff0000000000000000000080")) );
+
                 Date_t now = jsTime();
                 keyTest( BSON("" << now << "" << 3 << "" << jstNULL << "" << true) );
                 keyTest( BSON("" << now << "" << 3 << "" << BSONObj() << "" << true) );
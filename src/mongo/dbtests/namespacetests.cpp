@@ -28,6 +28,7 @@
 #include "mongo/db/json.h"
 #include "mongo/db/queryutil.h"
 #include "mongo/db/catalog/ondisk/namespace.h"
+#include "mongo/db/storage/free_space_index.h"
 #include "mongo/db/structure/collection.h"
 #include "mongo/dbtests/dbtests.h"
 
@@ -2105,6 +2106,47 @@ namespace NamespaceTests {
             virtual string spec() const { return ""; }
         };
         
+        /** alloc() takes the smallest deleted record that fits, whichever list it is on. */
+        class AllocBestFit : public Base {
+        public:
+            void run() {
+                create();
+                DiskLoc big = nsd()->alloc( ns(), 2000 );
+                DiskLoc small = nsd()->alloc( ns(), 300 );
+                DiskLoc spacer = nsd()->alloc( ns(), 300 );
+                ASSERT( !big.isNull() );
+                ASSERT( !small.isNull() );
+                ASSERT( !spacer.isNull() );
+                nsd()->addDeletedRec( (DeletedRecord*)big.rec(), big );
+                nsd()->addDeletedRec( (DeletedRecord*)small.rec(), small );
+
+                // the two freed records and what is left of the extent, mirrored since the
+                // first alloc()
+                FreeSpaceIndex::Stats stats;
+                ASSERT( FreeSpaceIndex::peekStats( nsd(), &stats ) );
+                ASSERT_EQUALS( 3, stats.records );
+
+                ASSERT_EQUALS( small, nsd()->allocWillBeAt( ns(), 250 ) );
+                ASSERT_EQUALS( small, nsd()->alloc( ns(), 250 ) );
+                ASSERT_EQUALS( big, nsd()->alloc( ns(), 1500 ) );
+            }
+            virtual string spec() const { return ""; }
+        };
+
+        /** Edits made to the deleted lists directly are picked up by later allocations. */
+        class AllocAfterDeletedListEdited : public Base {
+        public:
+            void run() {
+                create();
+                ASSERT( !nsd()->allocWillBeAt( ns(), 300 ).isNull() );
+                cookDeletedList( 299 );
+                ASSERT( nsd()->allocWillBeAt( ns(), 300 ).isNull() );
+                ASSERT( nsd()->alloc( ns(), 300 ).isNull() );
+                ASSERT( !nsd()->alloc( ns(), 200 ).isNull() );
+            }
+            virtual string spec() const { return ""; }
+        };
+
         /* test  NamespaceDetails::cappedTruncateAfter(const char *ns, DiskLoc loc)
         */
         class TruncateCapped : public Base {
@@ -2437,6 +2479,8 @@ namespace NamespaceTests {
             add< NamespaceDetailsTests::AllocQuantizedWithoutExtra >();
             add< NamespaceDetailsTests::AllocNotQuantizedNearDeletedSize >();
             add< NamespaceDetailsTests::AllocFailsWithTooSmallDeletedRecord >();
+            add< NamespaceDetailsTests::AllocBestFit >();
+            add< NamespaceDetailsTests::AllocAfterDeletedListEdited >();
             add< NamespaceDetailsTests::TwoExtent >();
             add< NamespaceDetailsTests::TruncateCapped >();
             add< NamespaceDetailsTests::Migrate >();
@@ -398,12 +398,56 @@ private:
     char _buf[ 1024 ];
 };
 
+/**
+ * Measures point lookups through an index on n, printing lookups per second.  Run it against
+ * builds before and after a change to btree key comparison to compare them.
+ */
+class LookupRunner {
+public:
+    LookupRunner( DBClientConnection &conn, long long docs ) :
+        _conn( conn ),
+        _docs( docs ),
+        _dist( 0, docs - 1 ),
+        _gen( randomNumberGenerator, _dist ) {
+    }
+    void load() {
+        for( long long i = 0; i < _docs; ++i ) {
+            _conn.insert( ns, BSON( "_id" << OID::gen() << "n" << i ) );
+        }
+        _conn.ensureIndex( ns, BSON( "n" << 1 ) );
+        _conn.getLastError();
+    }
+    void lookupOne() {
+        BSONObj doc = _conn.findOne( ns, QUERY( "n" << (long long)_gen() ) );
+        MONGO_verify( !doc.isEmpty() );
+    }
+private:
+    DBClientConnection &_conn;
+    long long _docs;
+    uniform_int< long long > _dist;
+    variate_generator< mt19937&, uniform_int< long long > > _gen;
+};
+
 int main( int argc, const char **argv ) {
 
     DBClientConnection conn;
     conn.connect( "127.0.0.1:27017" );
     conn.dropCollection( ns );
 
+    if ( argc > 1 && string( argv[ 1 ] ) == "lookup" ) {
+        LookupRunner lookups( conn, 1000000 );
+        lookups.load();
+        cout << "lookups,milliseconds,lookupsPerSecond" << endl;
+        Timer t;
+        for( long long i = 1; i <= 1000000; ++i ) {
+            lookups.lookupOne();
+            if ( i % 100000 == 0 ) {
+                cout << i << ',' << t.millis() << ',' << i * 1000 / max( 1, t.millis() ) << endl;
+            }
+        }
+        return 0;
+    }
+
 //    UniformInsertRangedUniformRemoveInteger strategy;
 //    UniformInsertUniformRemoveInteger strategy;
 //    UniformInsertRangedUniformRemoveString strategy;
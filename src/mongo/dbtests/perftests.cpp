@@ -28,12 +28,28 @@
 #include <boost/thread/thread.hpp>
 #include <fstream>
 
+#ifdef __linux__
+# include <sys/resource.h>
+#endif
+
 #include "mongo/db/db.h"
+#include "mongo/db/dbmessage.h"
 #include "mongo/db/dur_stats.h"
+#include "mongo/db/exec/collection_scan.h"
+#include "mongo/db/exec/fetch.h"
+#include "mongo/db/exec/index_scan.h"
+#include "mongo/db/exec/limit.h"
+#include "mongo/db/exec/skip.h"
+#include "mongo/db/exec/text.h"
+#include "mongo/db/exec/working_set.h"
 #include "mongo/db/instance.h"
 #include "mongo/db/json.h"
+#include "mongo/db/index/fts_access_method.h"
 #include "mongo/db/key.h"
 #include "mongo/db/lasterror.h"
+#include "mongo/db/matcher/expression_parser.h"
+#include "mongo/db/query/index_bounds_builder.h"
+#include "mongo/db/structure/collection.h"
 #include "mongo/db/taskqueue.h"
 #include "mongo/dbtests/dbtests.h"
 #include "mongo/dbtests/framework_options.h"
@@ -41,6 +57,9 @@
 #include "mongo/util/compress.h"
 #include "mongo/util/concurrency/qlock.h"
 #include "mongo/util/fail_point.h"
+#include "mongo/util/net/message_port.h"
+#include "mongo/util/net/message_server.h"
+#include "mongo/util/processinfo.h"
 #include "mongo/util/timer.h"
 #include "mongo/util/version.h"
 
@@ -50,6 +69,13 @@
 
 using namespace bson;
 
+namespace mongo {
+    extern bool internalQueryTextTopK;
+    namespace fts {
+        extern bool textSearchEnabled;
+    }
+}  // namespace mongo
+
 namespace PerfTests {
 
     const bool profiling = false;
@@ -490,6 +516,79 @@ namespace PerfTests {
         }
     };
 
+    /**
+     * A bucket's worth of keys binary searched as BtreeBucket::find does, comparing with
+     * KeyV1::woCompare (as before) or a KeyV1Search prepared once per lookup (as now).  Keys
+     * says what the keys hold, so that each kind of word the prepared compare decodes per probe
+     * (orderedNumber, orderedDate, loadBigEndian64) can be timed against woCompare on its own.
+     */
+    template< class Keys, bool Prepared >
+    class KeySearch : public B {
+    public:
+        string name() {
+            return string( "Key-search-" ) + Keys::name() + ( Prepared ? "-prepared" : "-woCompare" );
+        }
+        virtual int howLongMillis() { return 3000; }
+        virtual bool showDurStats() { return false; }
+        KeySearch() : _i(0), _ordering(Ordering::make(BSONObj())) {
+            for( int i = 0; i < 250; i++ ) {
+                _keys.push_back( new KeyV1Owned( Keys::key( i ) ) );
+                verify( _keys.back()->isCompactFormat() );
+            }
+        }
+        ~KeySearch() {
+            for( unsigned i = 0; i < _keys.size(); i++ )
+                delete _keys[i];
+        }
+        void timed() {
+            const KeyV1& key = *_keys[ _i++ % _keys.size() ];
+            KeyV1Search search( key, _ordering );
+            int l = 0;
+            int h = _keys.size() - 1;
+            while( l <= h ) {
+                int m = (l+h)/2;
+                int x = Prepared ? search.compare( *_keys[m] ) : key.woCompare( *_keys[m], _ordering );
+                if( x < 0 )
+                    h = m-1;
+                else if( x > 0 )
+                    l = m+1;
+                else
+                    return;
+            }
+            verify( false ); // Keys::key() increases with i
+        }
+    private:
+        unsigned _i;
+        Ordering _ordering;
+        vector<KeyV1Owned*> _keys;
+    };
+
+    /** oids as generated: the leading words are mostly equal, the counter decides */
+    struct OidSearchKeys {
+        static const char* name() { return "oid"; }
+        static BSONObj key( int i ) { return BSON( "" << OID::gen() ); }
+    };
+
+    /** doubles either side of zero, through the sign handling of orderedNumber */
+    struct NumberSearchKeys {
+        static const char* name() { return "number"; }
+        static BSONObj key( int i ) { return BSON( "" << ( i - 125 ) * 1.5 ); }
+    };
+
+    struct DateSearchKeys {
+        static const char* name() { return "date"; }
+        static BSONObj key( int i ) { return BSON( "" << Date_t( 1350000000000ULL + i * 1000 ) ); }
+    };
+
+    /** compound keys with equal leading fields, so each probe decodes every field */
+    struct CompoundSearchKeys {
+        static const char* name() { return "compound"; }
+        static BSONObj key( int i ) {
+            static const OID oid = OID::gen();
+            return BSON( "" << oid << "" << 42 << "" << Date_t( 1350000000000ULL ) << "" << i );
+        }
+    };
+
     unsigned long long aaa;
 
     class Timer : public B {
@@ -1135,6 +1234,361 @@ namespace PerfTests {
         }
     };
 
+    // Drains a plan, either a result at a time through work() or in blocks through
+    // workBatch().  The difference is the per-result dispatch overhead that batching removes.
+    template <bool batched>
+    class StageBench : public B {
+    public:
+        static const int N = 20000;
+        virtual int howLongMillis() { return 3000; }
+        virtual unsigned batchSize() { return 1; }
+        virtual bool showDurStats() { return false; }
+        void prep() {
+            for (int i = 0; i < N; i++) {
+                client().insert(ns(), BSON("_id" << i << "x" << i % 100));
+            }
+            client().ensureIndex(ns(), BSON("x" << 1));
+        }
+        void timed() {
+            Client::ReadContext ctx(ns());
+            WorkingSet ws;
+            scoped_ptr<PlanStage> root(makePlan(&ws));
+            int n = 0;
+            if (batched) {
+                vector<WorkingSetID> batch;
+                WorkingSetID fetchId;
+                PlanStage::StageState state = PlanStage::NEED_TIME;
+                while (PlanStage::NEED_TIME == state || PlanStage::NEED_FETCH == state) {
+                    batch.clear();
+                    state = root->workBatch(101, &batch, &fetchId);
+                    for (size_t i = 0; i < batch.size(); ++i) {
+                        ws.free(batch[i]);
+                    }
+                    n += batch.size();
+                }
+            }
+            else {
+                PlanStage::StageState state = PlanStage::NEED_TIME;
+                while (PlanStage::IS_EOF != state) {
+                    WorkingSetID id;
+                    state = root->work(&id);
+                    if (PlanStage::ADVANCED == state) {
+                        ws.free(id);
+                        n++;
+                    }
+                    verify(PlanStage::FAILURE != state && PlanStage::DEAD != state);
+                }
+            }
+            verify(n > 0);
+        }
+    protected:
+        virtual PlanStage* makePlan(WorkingSet* ws) = 0;
+    };
+
+    template <bool batched>
+    class CollScanStage : public StageBench<batched> {
+    public:
+        string name() { return batched ? "stage-collscan-limit-batched" : "stage-collscan-limit"; }
+    protected:
+        PlanStage* makePlan(WorkingSet* ws) {
+            CollectionScanParams params;
+            params.ns = this->ns();
+            return new LimitStage(StageBench<batched>::N / 2, ws,
+                                  new CollectionScan(params, ws, NULL));
+        }
+    };
+
+    template <bool batched>
+    class IndexScanFetchStage : public StageBench<batched> {
+    public:
+        string name() { return batched ? "stage-ixscan-fetch-skip-batched" : "stage-ixscan-fetch-skip"; }
+    protected:
+        PlanStage* makePlan(WorkingSet* ws) {
+            Collection* collection = cc().database()->getCollection(this->ns());
+            int idxNo = collection->details()->findIndexByKeyPattern(BSON("x" << 1));
+            IndexScanParams params;
+            params.descriptor = collection->getIndexCatalog()->getDescriptor(idxNo);
+            params.bounds.isSimpleRange = true;
+            params.bounds.startKey = BSON("" << 0);
+            params.bounds.endKey = BSON("" << 50);
+            params.bounds.endKeyInclusive = true;
+            params.direction = 1;
+            return new SkipStage(10, ws,
+                                 new FetchStage(ws, new IndexScan(params, ws, NULL), NULL));
+        }
+    };
+
+    // A large $in list, as sent by applications that look up thousands of ids at once.
+    BSONObj largeInOperand(int n) {
+        BSONArrayBuilder values;
+        for (int i = 0; i < n; i++) {
+            values.append(i * 3);
+        }
+        return values.arr();
+    }
+
+    // Matches values against a 20000 entry $in; a third of the candidates are present.
+    class InMatchLarge : public B {
+    public:
+        InMatchLarge() : _operand(largeInOperand(20000)) {
+            BSONObjIterator i(_operand);
+            while (i.more()) {
+                verify(_in.getArrayFilterEntries()->addEquality(i.next()).isOK());
+            }
+            BSONArrayBuilder candidates;
+            for (int i = 0; i < 1000; i++) {
+                candidates.append(i * 2);
+            }
+            _candidates = candidates.arr();
+        }
+        string name() { return "in-match-20000"; }
+        virtual int howLongMillis() { return 3000; }
+        virtual bool showDurStats() { return false; }
+        void timed() {
+            int n = 0;
+            BSONObjIterator i(_candidates);
+            while (i.more()) {
+                if (_in.matchesSingleElement(i.next())) {
+                    n++;
+                }
+            }
+            verify(n > 0);
+        }
+    private:
+        BSONObj _operand;
+        BSONObj _candidates;
+        InMatchExpression _in;
+    };
+
+    // Builds index bounds for a 2000 entry $in and seeks an index scan through them.
+    class InIndexSeek : public B {
+    public:
+        static const int N = 20000;
+        InIndexSeek() : _query(BSON("x" << BSON("$in" << largeInOperand(2000)))) { }
+        string name() { return "in-ixscan-2000"; }
+        virtual int howLongMillis() { return 3000; }
+        virtual unsigned batchSize() { return 1; }
+        virtual bool showDurStats() { return false; }
+        void prep() {
+            for (int i = 0; i < N; i++) {
+                client().insert(ns(), BSON("_id" << i << "x" << i));
+            }
+            client().ensureIndex(ns(), BSON("x" << 1));
+        }
+        void timed() {
+            StatusWithMatchExpression swme = MatchExpressionParser::parse(_query);
+            verify(swme.isOK());
+            scoped_ptr<MatchExpression> expr(swme.getValue());
+
+            BSONObj keyPattern = BSON("x" << 1);
+            OrderedIntervalList oil("x");
+            bool exact;
+            IndexBoundsBuilder::translate(expr.get(), keyPattern.firstElement(), &oil, &exact);
+
+            Client::ReadContext ctx(ns());
+            Collection* collection = cc().database()->getCollection(ns());
+            int idxNo = collection->details()->findIndexByKeyPattern(keyPattern);
+            IndexScanParams params;
+            params.descriptor = collection->getIndexCatalog()->getDescriptor(idxNo);
+            params.bounds.fields.push_back(oil);
+            params.direction = 1;
+
+            WorkingSet ws;
+            IndexScan scan(params, &ws, NULL);
+            int n = 0;
+            PlanStage::StageState state = PlanStage::NEED_TIME;
+            while (PlanStage::IS_EOF != state) {
+                WorkingSetID id;
+                state = scan.work(&id);
+                if (PlanStage::ADVANCED == state) {
+                    ws.free(id);
+                    n++;
+                }
+                verify(PlanStage::FAILURE != state && PlanStage::DEAD != state);
+            }
+            verify(2000 == n);
+        }
+    private:
+        BSONObj _query;
+    };
+
+    // The best 20 documents for a term that every document has, and for that term together
+    // with one that a few have: read through to the last key, or stopping once they are known.
+    template <bool topK>
+    class TextSearch : public B {
+    public:
+        static const int N = 20000;
+        string name() { return topK ? "text-limit20-topk" : "text-limit20-exhaustive"; }
+        virtual int howLongMillis() { return 3000; }
+        virtual unsigned batchSize() { return 1; }
+        virtual bool showDurStats() { return false; }
+        void prep() {
+            fts::textSearchEnabled = true;
+            _oldTopK = internalQueryTextTopK;
+            internalQueryTextTopK = topK;
+            for (int i = 0; i < N; i++) {
+                string text = "common";
+                for (int j = 0; j < i % 50; j++) {
+                    text += " filler";
+                }
+                if (i % 100 == 0) {
+                    text += " rare";
+                }
+                client().insert(ns(), BSON("_id" << i << "t" << text));
+            }
+            client().ensureIndex(ns(), BSON("t" << "text"));
+        }
+        void timed() {
+            verify(20 == search("common"));
+            verify(20 == search("common rare"));
+        }
+        void post() {
+            internalQueryTextTopK = _oldTopK;
+        }
+    private:
+        int search(const string& query) {
+            Client::ReadContext ctx(ns());
+            Collection* collection = cc().database()->getCollection(ns());
+            vector<int> idxMatches;
+            collection->details()->findIndexByType("text", idxMatches);
+            IndexDescriptor* index = collection->getIndexCatalog()->getDescriptor(idxMatches[0]);
+            FTSAccessMethod fam(index);
+
+            TextStageParams params(fam.getSpec());
+            params.ns = ns();
+            params.index = index;
+            params.limit = 20;
+            verify(fam.getSpec().getIndexPrefix(BSONObj(), &params.indexPrefix).isOK());
+            verify(params.query.parse(query, fam.getSpec().defaultLanguage().str()).isOK());
+
+            WorkingSet ws;
+            TextStage stage(params, &ws, NULL);
+            int n = 0;
+            while (!stage.isEOF()) {
+                WorkingSetID id;
+                PlanStage::StageState state = stage.work(&id);
+                if (PlanStage::ADVANCED == state) {
+                    ws.free(id);
+                    n++;
+                }
+                verify(PlanStage::FAILURE != state);
+            }
+            return n;
+        }
+        bool _oldTopK;
+    };
+
+    // The allocate/fill/free pattern of an index scan feeding a fetch: a handful of members are
+    // live at any time but a new one is needed for every key.
+    class WorkingSetChurn : public B {
+    public:
+        string name() { return "workingset-churn"; }
+        virtual int howLongMillis() { return 2000; }
+        virtual bool showDurStats() { return false; }
+        void timed() {
+            WorkingSet ws;
+            const BSONObj keyPattern = BSON("x" << 1);
+            WorkingSetID live[16];
+            for (int i = 0; i < 16; i++) {
+                live[i] = ws.allocate();
+            }
+            for (int i = 0; i < 10000; i++) {
+                ws.free(live[i % 16]);
+                live[i % 16] = ws.allocate();
+                WorkingSetMember* member = ws.get(live[i % 16]);
+                member->loc = DiskLoc(0, i);
+                member->keyData.push_back(IndexKeyDatum(keyPattern, keyPattern));
+                member->state = WorkingSetMember::LOC_AND_IDX;
+            }
+        }
+    };
+
+#ifdef __linux__
+    /** Answers every message with {ok: 1} and keeps no per-connection state. */
+    class PingHandler : public MessageHandler {
+    public:
+        virtual bool canShareThreads() const { return true; }
+        virtual void connected( AbstractMessagingPort* p ) { }
+        virtual void process( Message& m , AbstractMessagingPort* p , LastError * err ) {
+            replyToQuery( 0, p, m, BSON( "ok" << 1 ) );
+        }
+        virtual void disconnected( AbstractMessagingPort* p ) { }
+    };
+
+    void assembleRequest( const string &ns, BSONObj query, int nToReturn, int nToSkip,
+                          const BSONObj *fieldsToReturn, int queryOptions, Message &toSend );
+
+    /**
+     * Round trips over one of many mostly idle connections, served either by a thread per
+     * connection (workerThreads == 0) or by a pool of 'workerThreads' threads.  Also reports
+     * the process' memory once all connections are open.
+     */
+    template <int workerThreads>
+    class IdleConnections : public B {
+    public:
+        IdleConnections() : _next(0) { }
+        ~IdleConnections() {
+            for ( size_t i = 0; i < _ports.size(); i++ ) {
+                _ports[i]->shutdown();
+                delete _ports[i];
+            }
+        }
+        string name() {
+            return str::stream() << "idle-connections-" << (workerThreads ? "pooled" : "thread");
+        }
+        virtual int howLongMillis() { return 2000; }
+        virtual bool showDurStats() { return false; }
+        void prep() {
+            const int port = 27451 + ( workerThreads ? 1 : 0 );
+            MessageServer::Options options;
+            options.port = port;
+            options.ipList = "127.0.0.1";
+            options.workerThreads = workerThreads;
+            MessageServer* server = createServer( options, new PingHandler() );
+            server->setupSockets();
+            boost::thread listener( boost::bind( &MessageServer::run, server ) );
+
+            // both ends of each connection are in this process
+            struct rlimit limits;
+            verify( getrlimit( RLIMIT_NOFILE, &limits ) == 0 );
+            const size_t nConnections = std::min<rlim_t>( 10000, ( limits.rlim_cur - 200 ) / 2 );
+
+            SockAddr addr( "127.0.0.1", port );
+            for ( size_t i = 0; i < nConnections; i++ ) {
+                auto_ptr<MessagingPort> p( new MessagingPort( 30 ) );
+                for ( int tries = 0; ! p->connect( addr ); tries++ ) {
+                    verify( tries < 50 ); // the listener may not be up yet
+                    sleepmillis( 100 );
+                }
+                _ports.push_back( p.release() );
+            }
+
+            // make sure every connection is being served before we measure
+            for ( size_t i = 0; i < _ports.size(); i++ ) {
+                ping( _ports[i] );
+            }
+
+            ProcessInfo pi;
+            cout << "stats " << setw(42) << left << name() << ' ' << _ports.size()
+                 << " connections, resident " << pi.getResidentSize() << "MB, virtual "
+                 << pi.getVirtualMemorySize() << "MB" << endl;
+        }
+        void timed() {
+            ping( _ports[_next++ % _ports.size()] );
+        }
+    private:
+        static void ping( MessagingPort* p ) {
+            Message toSend;
+            Message response;
+            assembleRequest( "admin.$cmd", BSON( "ping" << 1 ), -1, 0, NULL, 0, toSend );
+            verify( p->call( toSend, response ) );
+        }
+
+        vector<MessagingPort*> _ports;
+        size_t _next;
+    };
+#endif
+
     // Tests what the worst case is for the overhead of enabling a fail point. If 'fpInjected'
     // is false, then the fail point will be compiled out. If 'fpInjected' is true, then the
     // fail point will be compiled in. Since the conditioned block is more or less trivial, any
@@ -1405,6 +1859,14 @@ namespace PerfTests {
                 add< CTM >();
                 add< CTMicros >();
                 add< KeyTest >();
+                add< KeySearch<OidSearchKeys, false> >();
+                add< KeySearch<OidSearchKeys, true> >();
+                add< KeySearch<NumberSearchKeys, false> >();
+                add< KeySearch<NumberSearchKeys, true> >();
+                add< KeySearch<DateSearchKeys, false> >();
+                add< KeySearch<DateSearchKeys, true> >();
+                add< KeySearch<CompoundSearchKeys, false> >();
+                add< KeySearch<CompoundSearchKeys, true> >();
                 add< Bldr >();
                 add< StkBldr >();
                 add< BSONIter >();
@@ -1418,6 +1880,19 @@ namespace PerfTests {
                 add< Update1 >();
                 add< MoreIndexes<Update1> >();
                 add< InsertBig >();
+                add< WorkingSetChurn >();
+                add< CollScanStage<false> >();
+                add< CollScanStage<true> >();
+                add< IndexScanFetchStage<false> >();
+                add< IndexScanFetchStage<true> >();
+                add< InMatchLarge >();
+                add< InIndexSeek >();
+                add< TextSearch<false> >();
+                add< TextSearch<true> >();
+#ifdef __linux__
+                add< IdleConnections<0> >();
+                add< IdleConnections<16> >();
+#endif
                 add< FailPointTest<false, false> >();
                 add< FailPointTest<true, false> >();
                 add< FailPointTest<true, true> >();
@@ -0,0 +1,218 @@
+/**
+ *    Copyright (C) 2013 10gen Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mongo/db/exec/plan_stats.h"
+#include "mongo/db/instance.h"
+#include "mongo/db/json.h"
+#include "mongo/db/query/cached_plan_runner.h"
+#include "mongo/db/query/canonical_query.h"
+#include "mongo/db/query/new_find.h"
+#include "mongo/db/query/plan_cache.h"
+#include "mongo/db/query/plan_ranker.h"
+#include "mongo/db/query/query_solution.h"
+#include "mongo/db/structure/collection.h"
+#include "mongo/dbtests/dbtests.h"
+
+namespace QueryPlanCache {
+
+    static const char* ns = "unittests.QueryPlanCache";
+
+    CanonicalQuery* canonicalize(const BSONObj& query, const BSONObj& sort = BSONObj()) {
+        CanonicalQuery* cq = NULL;
+        verify(CanonicalQuery::canonicalize(ns, query, sort, BSONObj(), &cq).isOK());
+        return cq;
+    }
+
+    // A collection scan, the simplest non-empty solution.
+    QuerySolution* collScanSolution() {
+        QuerySolution* solution = new QuerySolution();
+        solution->root.reset(new CollectionScanNode());
+        return solution;
+    }
+
+    // Why the plan won: it produced a result on 'advanced' of 'works' calls.
+    PlanRankingDecision* decision(uint64_t advanced, uint64_t works) {
+        CommonStats common;
+        common.advanced = advanced;
+        common.works = works;
+        PlanRankingDecision* why = new PlanRankingDecision();
+        why->statsOfWinner = new PlanStageStats(common, STAGE_COLLSCAN);
+        return why;
+    }
+
+    CachedSolutionFeedback* feedback(uint64_t advanced, uint64_t works) {
+        CommonStats common;
+        common.advanced = advanced;
+        common.works = works;
+        CachedSolutionFeedback* fb = new CachedSolutionFeedback();
+        fb->stats = new PlanStageStats(common, STAGE_COLLSCAN);
+        return fb;
+    }
+
+    // Queries that differ only in their values have the same shape.
+    class KeyIgnoresValues {
+    public:
+        void run() {
+            auto_ptr<CanonicalQuery> a(canonicalize(fromjson("{a: 1, b: {$gt: 5}}")));
+            auto_ptr<CanonicalQuery> b(canonicalize(fromjson("{a: 'foo', b: {$gt: 7}}")));
+            auto_ptr<CanonicalQuery> c(canonicalize(fromjson("{a: 1, b: {$lt: 5}}")));
+            auto_ptr<CanonicalQuery> d(canonicalize(fromjson("{a: 1, b: {$gt: 5}}"),
+                                                    fromjson("{a: -1}")));
+
+            ASSERT_EQUALS(PlanCache::getPlanCacheKey(*a), PlanCache::getPlanCacheKey(*b));
+            ASSERT_NOT_EQUALS(PlanCache::getPlanCacheKey(*a), PlanCache::getPlanCacheKey(*c));
+            ASSERT_NOT_EQUALS(PlanCache::getPlanCacheKey(*a), PlanCache::getPlanCacheKey(*d));
+        }
+    };
+
+    class AddGetRemove {
+    public:
+        void run() {
+            PlanCache cache;
+            auto_ptr<CanonicalQuery> cq(canonicalize(fromjson("{a: 1}")));
+            auto_ptr<CanonicalQuery> sameShape(canonicalize(fromjson("{a: 2}")));
+            auto_ptr<QuerySolution> solution(collScanSolution());
+
+            ASSERT(NULL == cache.get(*cq));
+            ASSERT(cache.add(*cq, *solution, decision(10, 10)));
+            ASSERT_EQUALS(cache.size(), 1U);
+
+            auto_ptr<CachedSolution> cs(cache.get(*sameShape));
+            ASSERT(NULL != cs.get());
+            ASSERT_EQUALS(cs->solutionKey, PlanCache::getSolutionKey(*solution));
+
+            ASSERT(cache.remove(*cq, *solution));
+            ASSERT(!cache.remove(*cq, *solution));
+            ASSERT(NULL == cache.get(*cq));
+        }
+    };
+
+    // Solutions that say nothing about the plan and uncacheable queries are not cached.
+    class DoesNotCacheUncacheable {
+    public:
+        void run() {
+            PlanCache cache;
+            auto_ptr<CanonicalQuery> cq(canonicalize(fromjson("{a: 1}")));
+            QuerySolution empty;
+            ASSERT(!cache.add(*cq, empty, decision(10, 10)));
+
+            CanonicalQuery* rawHinted = NULL;
+            ASSERT(CanonicalQuery::canonicalize(ns, fromjson("{$query: {a: 1}, $hint: {a: 1}}"),
+                                                &rawHinted).isOK());
+            auto_ptr<CanonicalQuery> hinted(rawHinted);
+            auto_ptr<QuerySolution> solution(collScanSolution());
+            ASSERT(!cache.add(*hinted, *solution, decision(10, 10)));
+            ASSERT_EQUALS(cache.size(), 0U);
+        }
+    };
+
+    // A plan whose productivity collapses after it was cached is evicted.
+    class FeedbackEvictsDegradedPlan {
+    public:
+        void run() {
+            PlanCache cache;
+            auto_ptr<CanonicalQuery> cq(canonicalize(fromjson("{a: 1}")));
+            auto_ptr<QuerySolution> solution(collScanSolution());
+            ASSERT(cache.add(*cq, *solution, decision(10, 10)));
+
+            // Performing as well as it did when it won: stays.
+            for (size_t i = 0; i < PlanCache::kMaxFeedback; ++i) {
+                ASSERT(cache.feedback(*cq, *solution, feedback(100, 100)));
+            }
+            ASSERT_EQUALS(cache.size(), 1U);
+
+            // One result per thousand calls to work(): goes.
+            for (size_t i = 0; i < PlanCache::kMaxFeedback; ++i) {
+                cache.feedback(*cq, *solution, feedback(1, 1000));
+            }
+            ASSERT_EQUALS(cache.size(), 0U);
+        }
+    };
+
+    // Enough writes flush the cache.
+    class WritesFlushCache {
+    public:
+        void run() {
+            PlanCache cache;
+            auto_ptr<CanonicalQuery> cq(canonicalize(fromjson("{a: 1}")));
+            auto_ptr<QuerySolution> solution(collScanSolution());
+            ASSERT(cache.add(*cq, *solution, decision(10, 10)));
+
+            for (int i = 0; i < 100000 && cache.size() > 0; ++i) {
+                cache.notifyOfWriteOp();
+            }
+            ASSERT_EQUALS(cache.size(), 0U);
+        }
+    };
+
+    // The second run of a query shape uses the plan picked by the first.  Adding an index throws
+    // the choice away.
+    class GetRunnerUsesCache {
+    public:
+        ~GetRunnerUsesCache() {
+            _client.dropCollection(ns);
+        }
+
+        void run() {
+            Client::WriteContext ctx(ns);
+
+            for (int i = 0; i < 1000; ++i) {
+                _client.insert(ns, BSON("a" << i << "b" << (i % 10)));
+            }
+            _client.ensureIndex(ns, BSON("a" << 1));
+            _client.ensureIndex(ns, BSON("b" << 1));
+
+            PlanCache* cache = ctx.ctx().db()->getCollection(ns)->infoCache()->getPlanCache();
+            ASSERT_EQUALS(cache->size(), 0U);
+
+            Runner* rawRunner = NULL;
+            ASSERT(getRunner(canonicalize(fromjson("{a: 5, b: 5}")), &rawRunner).isOK());
+            auto_ptr<Runner> runner(rawRunner);
+            ASSERT(NULL == dynamic_cast<CachedPlanRunner*>(runner.get()));
+            BSONObj obj;
+            while (Runner::RUNNER_ADVANCED == runner->getNext(&obj, NULL)) { }
+            ASSERT_EQUALS(cache->size(), 1U);
+
+            ASSERT(getRunner(canonicalize(fromjson("{a: 7, b: 7}")), &rawRunner).isOK());
+            runner.reset(rawRunner);
+            ASSERT(NULL != dynamic_cast<CachedPlanRunner*>(runner.get()));
+            runner.reset();
+
+            _client.ensureIndex(ns, BSON("a" << 1 << "b" << 1));
+            ASSERT_EQUALS(cache->size(), 0U);
+        }
+
+    private:
+        static DBDirectClient _client;
+    };
+
+    DBDirectClient GetRunnerUsesCache::_client;
+
+    class All : public Suite {
+    public:
+        All() : Suite( "query_plan_cache" ) { }
+
+        void setupTests() {
+            add<KeyIgnoresValues>();
+            add<AddGetRemove>();
+            add<DoesNotCacheUncacheable>();
+            add<FeedbackEvictsDegradedPlan>();
+            add<WritesFlushCache>();
+            add<GetRunnerUsesCache>();
+        }
+    }  queryPlanCacheAll;
+
+}  // namespace QueryPlanCache
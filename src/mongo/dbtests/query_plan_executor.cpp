@@ -0,0 +1,234 @@
+/**
+ *    Copyright (C) 2013 10gen Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * This file tests db/query/plan_executor.cpp, and in particular that reading results ahead with
+ * workBatch(...) hands out the same results as work(...) does.
+ */
+
+#include "mongo/client/dbclientcursor.h"
+#include "mongo/db/dbhelpers.h"
+#include "mongo/db/exec/collection_scan.h"
+#include "mongo/db/exec/plan_stage.h"
+#include "mongo/db/instance.h"
+#include "mongo/db/json.h"
+#include "mongo/db/matcher/expression_parser.h"
+#include "mongo/db/pdfile.h"
+#include "mongo/db/query/plan_executor.h"
+#include "mongo/dbtests/dbtests.h"
+
+namespace mongo {
+    extern int planExecutorBatchSize;
+}  // namespace mongo
+
+namespace QueryPlanExecutor {
+
+    // Sets the executor batch size for the lifetime of the object.
+    class BatchSize {
+    public:
+        BatchSize(int size) : _old(planExecutorBatchSize) { planExecutorBatchSize = size; }
+        ~BatchSize() { planExecutorBatchSize = _old; }
+    private:
+        int _old;
+    };
+
+    class PlanExecutorBase {
+    public:
+        PlanExecutorBase() {
+            Client::WriteContext ctx(ns());
+
+            for (int i = 0; i < numObj(); ++i) {
+                _client.insert(ns(), BSON("_id" << i << "foo" << i));
+            }
+        }
+
+        virtual ~PlanExecutorBase() {
+            Client::WriteContext ctx(ns());
+            _client.dropCollection(ns());
+        }
+
+        /**
+         * A forward collection scan over ns() filtered by 'filterObj'.  The caller owns it, and
+         * the filter it's given.
+         */
+        PlanExecutor* makeScan(const BSONObj& filterObj, auto_ptr<MatchExpression>* filterOut) {
+            CollectionScanParams params;
+            params.ns = ns();
+            params.direction = CollectionScanParams::FORWARD;
+            params.tailable = false;
+
+            StatusWithMatchExpression swme = MatchExpressionParser::parse(filterObj);
+            verify(swme.isOK());
+            filterOut->reset(swme.getValue());
+
+            WorkingSet* ws = new WorkingSet();
+            return new PlanExecutor(ws, new CollectionScan(params, ws, filterOut->get()));
+        }
+
+        /** The values of 'foo' in the order the executor hands them out. */
+        vector<int> getResults(int batchSize, const BSONObj& filterObj) {
+            BatchSize size(batchSize);
+            Client::ReadContext ctx(ns());
+
+            auto_ptr<MatchExpression> filter;
+            scoped_ptr<PlanExecutor> exec(makeScan(filterObj, &filter));
+
+            vector<int> out;
+            for (BSONObj obj; Runner::RUNNER_ADVANCED == exec->getNext(&obj, NULL); ) {
+                out.push_back(obj["foo"].numberInt());
+            }
+            return out;
+        }
+
+        DiskLoc locOf(int id) {
+            DiskLoc loc = Helpers::findOne(ns(), BSON("_id" << id), true);
+            verify(!loc.isNull());
+            return loc;
+        }
+
+        static int numObj() { return 200; }
+
+        static const char* ns() { return "unittests.QueryPlanExecutor"; }
+
+    protected:
+        static DBDirectClient _client;
+    };
+
+    DBDirectClient PlanExecutorBase::_client;
+
+    //
+    // Batches of any size hand out what work() does, in the same order.
+    //
+    class BatchMatchesWork : public PlanExecutorBase {
+    public:
+        void run() {
+            BSONObj filters[] = { BSONObj(),
+                                  fromjson("{foo: {$mod: [3, 0]}}"),
+                                  fromjson("{foo: {$gte: 190}}"),
+                                  fromjson("{foo: -1}") };
+
+            for (size_t i = 0; i < sizeof(filters) / sizeof(filters[0]); ++i) {
+                vector<int> expected = getResults(1, filters[i]);
+                ASSERT(expected == getResults(2, filters[i]));
+                ASSERT(expected == getResults(7, filters[i]));
+                ASSERT(expected == getResults(64, filters[i]));
+                ASSERT(expected == getResults(numObj() * 2, filters[i]));
+            }
+            ASSERT_EQUALS(static_cast<size_t>(numObj()), getResults(1, BSONObj()).size());
+        }
+    };
+
+    //
+    // Remove and move documents we've read ahead but not yet handed out.  We hand them out as
+    // they were when we read them, as work() would have had we returned them before the yield.
+    //
+    class InvalidateMidBatch : public PlanExecutorBase {
+    public:
+        void run() {
+            BatchSize size(64);
+            Client::WriteContext ctx(ns());
+
+            auto_ptr<MatchExpression> filter;
+            scoped_ptr<PlanExecutor> exec(makeScan(BSONObj(), &filter));
+
+            BSONObj obj;
+            for (int i = 0; i < 10; ++i) {
+                ASSERT_EQUALS(Runner::RUNNER_ADVANCED, exec->getNext(&obj, NULL));
+                ASSERT_EQUALS(i, obj["foo"].numberInt());
+            }
+
+            // 10 through 63 are buffered.  Remove one, grow one until it moves, and change one in
+            // place so it no longer matches what we read.
+            exec->saveState();
+            DiskLoc removed = locOf(20);
+            exec->invalidate(removed);
+            _client.remove(ns(), BSON("_id" << 20));
+
+            DiskLoc moved = locOf(30);
+            exec->invalidate(moved);
+            _client.update(ns(), BSON("_id" << 30),
+                           BSON("$set" << BSON("pad" << string(4096, 'x'))));
+            ASSERT(moved != locOf(30));
+
+            _client.update(ns(), BSON("_id" << 40), BSON("$set" << BSON("foo" << -40)));
+            ASSERT(exec->restoreState());
+
+            for (int i = 10; i < 64; ++i) {
+                ASSERT_EQUALS(Runner::RUNNER_ADVANCED, exec->getNext(&obj, NULL));
+                ASSERT_EQUALS(i, obj["_id"].numberInt());
+                ASSERT_EQUALS(i, obj["foo"].numberInt());
+                ASSERT(!obj.hasField("pad"));
+            }
+
+            // The scan itself carries on as it would have.  It may come across the moved
+            // document again in its new home.
+            int next = 64;
+            while (Runner::RUNNER_ADVANCED == exec->getNext(&obj, NULL)) {
+                if (obj.hasField("pad")) {
+                    ASSERT_EQUALS(30, obj["_id"].numberInt());
+                    continue;
+                }
+                ASSERT_EQUALS(next++, obj["_id"].numberInt());
+            }
+            ASSERT_EQUALS(numObj(), next);
+        }
+    };
+
+    //
+    // A caller that wants DiskLocs isn't handed a document that's no longer where we read it.
+    //
+    class InvalidateMidBatchWithLocs : public PlanExecutorBase {
+    public:
+        void run() {
+            BatchSize size(64);
+            Client::WriteContext ctx(ns());
+
+            auto_ptr<MatchExpression> filter;
+            scoped_ptr<PlanExecutor> exec(makeScan(BSONObj(), &filter));
+
+            // Read ahead, then switch to asking for DiskLocs.
+            BSONObj obj;
+            ASSERT_EQUALS(Runner::RUNNER_ADVANCED, exec->getNext(&obj, NULL));
+            ASSERT_EQUALS(0, obj["foo"].numberInt());
+
+            exec->saveState();
+            exec->invalidate(locOf(1));
+            _client.remove(ns(), BSON("_id" << 1));
+            ASSERT(exec->restoreState());
+
+            DiskLoc loc;
+            int count = 1;
+            while (Runner::RUNNER_ADVANCED == exec->getNext(&obj, &loc)) {
+                ASSERT_NOT_EQUALS(1, obj["_id"].numberInt());
+                ASSERT_EQUALS(obj["_id"].numberInt(), loc.obj()["_id"].numberInt());
+                ++count;
+            }
+            ASSERT_EQUALS(numObj() - 1, count);
+        }
+    };
+
+    class All : public Suite {
+    public:
+        All() : Suite( "query_plan_executor" ) {}
+
+        void setupTests() {
+            add<BatchMatchesWork>();
+            add<InvalidateMidBatch>();
+            add<InvalidateMidBatchWithLocs>();
+        }
+    } queryPlanExecutorAll;
+
+}  // namespace QueryPlanExecutor
@@ -29,8 +29,25 @@
  * This file tests db/exec/sort.cpp
  */
 
+namespace mongo {
+    extern int internalQueryExecMaxBlockingSortBytes;
+}  // namespace mongo
+
 namespace QueryStageSortTests {
 
+    // Lowers the memory budget of the sort stage for the lifetime of the object.
+    class SortMemoryBudget {
+    public:
+        explicit SortMemoryBudget(int bytes) : _old(internalQueryExecMaxBlockingSortBytes) {
+            internalQueryExecMaxBlockingSortBytes = bytes;
+        }
+        ~SortMemoryBudget() {
+            internalQueryExecMaxBlockingSortBytes = _old;
+        }
+    private:
+        int _old;
+    };
+
     class QueryStageSortTestBase {
     public:
         QueryStageSortTestBase() { }
@@ -90,7 +107,7 @@ namespace QueryStageSortTests {
          * If extAllowed is true, sorting will use use external sorting if available.
          * If limit is not zero, we limit the output of the sort stage to 'limit' results.
          */
-        void sortAndCheck(int direction) {
+        void sortAndCheck(int direction, size_t limit = 0) {
             WorkingSet* ws = new WorkingSet();
             MockStage* ms = new MockStage(ws);
 
@@ -99,6 +116,7 @@ namespace QueryStageSortTests {
 
             SortStageParams params;
             params.pattern = BSON("foo" << direction);
+            params.limit = limit;
 
             // Must fetch so we can look at the doc as a BSONObj.
             PlanExecutor runner(ws, new FetchStage(ws, new SortStage(params, ws, ms), NULL));
@@ -108,6 +126,9 @@ namespace QueryStageSortTests {
             BSONObj last;
             ASSERT_EQUALS(Runner::RUNNER_ADVANCED, runner.getNext(&last, NULL));
 
+            // The first result must be the overall first, limit or not.
+            ASSERT_EQUALS(direction > 0 ? 0 : numObj() - 1, last["foo"].numberInt());
+
             // Count 'last'.
             int count = 1;
 
@@ -121,8 +142,14 @@ namespace QueryStageSortTests {
                 last = current;
             }
 
-            // No limit, should get all objects back.
-            ASSERT_EQUALS(numObj(), count);
+            if (0 == limit) {
+                // No limit, should get all objects back.
+                ASSERT_EQUALS(numObj(), count);
+            }
+            else {
+                ASSERT_EQUALS(std::min(static_cast<size_t>(numObj()), limit),
+                              static_cast<size_t>(count));
+            }
         }
 
         virtual int numObj() = 0;
@@ -170,6 +197,46 @@ namespace QueryStageSortTests {
         }
     };
 
+    // Sort more data than fits in the memory budget so that the sort spills to disk.
+    class QueryStageSortSpill : public QueryStageSortTestBase {
+    public:
+        virtual int numObj() { return 10000; }
+
+        void run() {
+            Client::WriteContext ctx(ns());
+            fillData();
+            SortMemoryBudget budget(64 * 1024);
+            sortAndCheck(1);
+        }
+    };
+
+    // Only the best 'limit' results come back.
+    class QueryStageSortLimit : public QueryStageSortTestBase {
+    public:
+        virtual int numObj() { return 1000; }
+
+        void run() {
+            Client::WriteContext ctx(ns());
+            fillData();
+            sortAndCheck(1, 10);
+            sortAndCheck(-1, 10);
+            sortAndCheck(1, 5000);
+        }
+    };
+
+    // A limit that doesn't fit in the memory budget goes to the external top-k sorter.
+    class QueryStageSortSpillLimit : public QueryStageSortTestBase {
+    public:
+        virtual int numObj() { return 10000; }
+
+        void run() {
+            Client::WriteContext ctx(ns());
+            fillData();
+            SortMemoryBudget budget(1024);
+            sortAndCheck(-1, 500);
+        }
+    };
+
     // Invalidation of everything fed to sort.
     class QueryStageSortInvalidation : public QueryStageSortTestBase {
     public:
@@ -249,6 +316,9 @@ namespace QueryStageSortTests {
             add<QueryStageSortInc>();
             add<QueryStageSortDec>();
             add<QueryStageSortExt>();
+            add<QueryStageSortSpill>();
+            add<QueryStageSortLimit>();
+            add<QueryStageSortSpillLimit>();
             add<QueryStageSortInvalidation>();
         }
     }  queryStageSortTest;
@@ -0,0 +1,287 @@
+/**
+ *    Copyright (C) 2013 10gen Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * This file tests db/exec/text.cpp: that stopping once the top results are known returns what
+ * reading every key does.
+ */
+
+#include "mongo/client/dbclientcursor.h"
+#include "mongo/db/database.h"
+#include "mongo/db/exec/text.h"
+#include "mongo/db/exec/working_set_computed_data.h"
+#include "mongo/db/index/fts_access_method.h"
+#include "mongo/db/instance.h"
+#include "mongo/db/json.h"
+#include "mongo/db/matcher/expression_parser.h"
+#include "mongo/db/namespace_details.h"
+#include "mongo/db/query/explain_plan.h"
+#include "mongo/db/query/type_explain.h"
+#include "mongo/db/structure/collection.h"
+#include "mongo/dbtests/dbtests.h"
+#include "mongo/platform/random.h"
+
+namespace mongo {
+    extern bool internalQueryTextTopK;
+    namespace fts {
+        extern bool textSearchEnabled;
+    }
+}  // namespace mongo
+
+namespace QueryStageText {
+
+    // Sets whether text stages stop early for the lifetime of the object.
+    class TextTopK {
+    public:
+        explicit TextTopK(bool topK) : _old(internalQueryTextTopK) {
+            internalQueryTextTopK = topK;
+        }
+        ~TextTopK() {
+            internalQueryTextTopK = _old;
+        }
+    private:
+        bool _old;
+    };
+
+    class QueryStageTextBase {
+    public:
+        QueryStageTextBase() : _oldEnabled(fts::textSearchEnabled) {
+            fts::textSearchEnabled = true;
+        }
+
+        virtual ~QueryStageTextBase() {
+            _client.dropCollection(ns());
+            fts::textSearchEnabled = _oldEnabled;
+        }
+
+        /**
+         * Inserts documents whose text draws heavily on a few words and rarely on the rest, in
+         * texts of different lengths, so that the scores of a word vary.
+         */
+        void fillData() {
+            static const char* words[] = { "apple", "river", "mountain", "violet", "engine",
+                                           "harbor", "lantern", "meadow", "orchid", "pepper" };
+            const int numWords = sizeof(words) / sizeof(words[0]);
+
+            PseudoRandom r(17);
+            for (int i = 0; i < numDocs(); ++i) {
+                string text;
+                int len = 1 + static_cast<unsigned>(r.nextInt32()) % 12;
+                for (int j = 0; j < len; ++j) {
+                    // Word k is drawn about twice as often as word k + 1.
+                    int k = 0;
+                    while (k < numWords - 1 && r.nextInt32() % 2 == 0) {
+                        ++k;
+                    }
+                    text += words[k];
+                    text += ' ';
+                }
+                _client.insert(ns(), BSON("_id" << i << "t" << text << "n" << i % 3));
+            }
+            _client.ensureIndex(ns(), BSON("t" << "text"));
+        }
+
+        /**
+         * Runs a text stage for 'search', filtered by 'filter' if it's not empty, returning the
+         * scores and locations of the results in order, and the stage's stats if 'stats' isn't
+         * NULL.
+         */
+        void getResults(const string& search, const BSONObj& filter, size_t limit,
+                        vector<pair<double, DiskLoc> >* out,
+                        auto_ptr<PlanStageStats>* stats = NULL) {
+            Collection* collection = cc().database()->getCollection(ns());
+            verify(collection);
+            vector<int> idxMatches;
+            collection->details()->findIndexByType("text", idxMatches);
+            verify(1 == idxMatches.size());
+            IndexDescriptor* index = collection->getIndexCatalog()->getDescriptor(idxMatches[0]);
+            auto_ptr<FTSAccessMethod> fam(new FTSAccessMethod(index));
+
+            TextStageParams params(fam->getSpec());
+            params.ns = ns();
+            params.index = index;
+            params.limit = limit;
+            ASSERT(fam->getSpec().getIndexPrefix(BSONObj(), &params.indexPrefix).isOK());
+            ASSERT(params.query.parse(search, fam->getSpec().defaultLanguage().str()).isOK());
+
+            auto_ptr<MatchExpression> filterExpr;
+            if (!filter.isEmpty()) {
+                StatusWithMatchExpression swme = MatchExpressionParser::parse(filter);
+                verify(swme.isOK());
+                filterExpr.reset(swme.getValue());
+            }
+
+            WorkingSet ws;
+            TextStage stage(params, &ws, filterExpr.get());
+            while (!stage.isEOF()) {
+                WorkingSetID id;
+                PlanStage::StageState state = stage.work(&id);
+                if (PlanStage::ADVANCED == state) {
+                    WorkingSetMember* member = ws.get(id);
+                    const TextScoreComputedData* score =
+                        static_cast<const TextScoreComputedData*>(
+                            member->getComputed(WSM_COMPUTED_TEXT_SCORE));
+                    out->push_back(make_pair(score->getScore(), member->loc));
+                    ws.free(id);
+                }
+                else {
+                    ASSERT(PlanStage::IS_EOF == state || PlanStage::NEED_TIME == state);
+                }
+            }
+            if (stats) {
+                stats->reset(stage.getStats());
+            }
+        }
+
+        /**
+         * Asserts that a text stage returns the same results whether it stops early or reads
+         * every key.
+         */
+        void assertSameResults(const string& search, const BSONObj& filter, size_t limit) {
+            vector<pair<double, DiskLoc> > exhaustive;
+            {
+                TextTopK topK(false);
+                getResults(search, filter, limit, &exhaustive);
+            }
+            vector<pair<double, DiskLoc> > early;
+            {
+                TextTopK topK(true);
+                getResults(search, filter, limit, &early);
+            }
+
+            ASSERT_EQUALS(exhaustive.size(), early.size());
+            for (size_t i = 0; i < exhaustive.size(); ++i) {
+                ASSERT_EQUALS(exhaustive[i].first, early[i].first);
+                ASSERT_EQUALS(exhaustive[i].second, early[i].second);
+            }
+        }
+
+        /**
+         * Returns the index keys a text stage examines for 'search', checking that its explain
+         * reports the same.
+         */
+        uint64_t keysExamined(const string& search, size_t limit) {
+            vector<pair<double, DiskLoc> > results;
+            auto_ptr<PlanStageStats> stats;
+            getResults(search, BSONObj(), limit, &results, &stats);
+            ASSERT_EQUALS(STAGE_TEXT, stats->stageType);
+            const TextStats* textStats = static_cast<const TextStats*>(stats->specific.get());
+            ASSERT(textStats);
+
+            TypeExplain* rawExplain = NULL;
+            ASSERT_OK(explainPlan(*stats, &rawExplain, false));
+            scoped_ptr<TypeExplain> explain(rawExplain);
+            ASSERT_EQUALS("TextCursor", explain->getCursor());
+            ASSERT_EQUALS(static_cast<long long>(results.size()), explain->getN());
+            ASSERT_EQUALS(static_cast<long long>(textStats->keysExamined),
+                          explain->getNScanned());
+            ASSERT_EQUALS(static_cast<long long>(textStats->fetches),
+                          explain->getNScannedObjects());
+            return textStats->keysExamined;
+        }
+
+        static unsigned long long countMatching(const string& word) {
+            return _client.count(ns(), BSON("t" << BSONRegEx(word)));
+        }
+
+        static int numDocs() { return 2000; }
+        static const char* ns() { return "unittests.QueryStageText"; }
+
+    private:
+        bool _oldEnabled;
+        static DBDirectClient _client;
+    };
+
+    DBDirectClient QueryStageTextBase::_client;
+
+    // One term: keys come in score order, so the first 'limit' documents are the answer.
+    class QueryStageTextOneTerm : public QueryStageTextBase {
+    public:
+        void run() {
+            Client::WriteContext ctx(ns());
+            fillData();
+            assertSameResults("apple", BSONObj(), 10);
+            assertSameResults("meadow", BSONObj(), 10);
+            assertSameResults("pepper", BSONObj(), 100);
+            assertSameResults("apple", BSONObj(), numDocs() * 2);
+        }
+    };
+
+    // Several terms, of which some documents have only some.
+    class QueryStageTextManyTerms : public QueryStageTextBase {
+    public:
+        void run() {
+            Client::WriteContext ctx(ns());
+            fillData();
+            assertSameResults("apple river", BSONObj(), 10);
+            assertSameResults("river orchid", BSONObj(), 20);
+            assertSameResults("pepper apple", BSONObj(), 1);
+            assertSameResults("apple unknownword", BSONObj(), 10);
+        }
+    };
+
+    // Documents that are rejected mustn't hold a place in the top results.
+    class QueryStageTextFiltered : public QueryStageTextBase {
+    public:
+        void run() {
+            Client::WriteContext ctx(ns());
+            fillData();
+            assertSameResults("apple", BSON("n" << 1), 10);
+            assertSameResults("apple river", BSON("n" << 2), 10);
+            assertSameResults("river -apple", BSONObj(), 10);
+            assertSameResults("\"apple river\"", BSONObj(), 10);
+        }
+    };
+
+    // With a limit, a common term's keys are read only until its top results are known.
+    class QueryStageTextKeysExamined : public QueryStageTextBase {
+    public:
+        void run() {
+            Client::WriteContext ctx(ns());
+            fillData();
+
+            // Reading every key examines one per document with the term.
+            const size_t all = numDocs() * 2;
+            uint64_t exhaustive;
+            {
+                TextTopK topK(false);
+                exhaustive = keysExamined("apple", 10);
+                ASSERT_EQUALS(countMatching("apple"), exhaustive);
+                ASSERT_EQUALS(exhaustive, keysExamined("apple", all));
+            }
+
+            TextTopK topK(true);
+            ASSERT_LESS_THAN(keysExamined("apple", 10), exhaustive / 2);
+            ASSERT_LESS_THAN(keysExamined("river", 10), countMatching("river"));
+
+            // Nothing to stop early for without a limit short of the matches.
+            ASSERT_EQUALS(exhaustive, keysExamined("apple", all));
+        }
+    };
+
+    class All : public Suite {
+    public:
+        All() : Suite( "query_stage_text_test" ) { }
+
+        void setupTests() {
+            add<QueryStageTextOneTerm>();
+            add<QueryStageTextManyTerms>();
+            add<QueryStageTextFiltered>();
+            add<QueryStageTextKeysExamined>();
+        }
+    } queryStageTextTest;
+
+}  // namespace QueryStageText
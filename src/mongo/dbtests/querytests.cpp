@@ -21,6 +21,7 @@
 #include "mongo/client/dbclientcursor.h"
 #include "mongo/db/clientcursor.h"
 #include "mongo/db/dbhelpers.h"
+#include "mongo/db/dbmessage.h"
 #include "mongo/db/instance.h"
 #include "mongo/db/json.h"
 #include "mongo/db/kill_current_op.h"
@@ -1459,6 +1460,38 @@ namespace QueryTests {
         }
     };
 
+    /**
+     * A command reply too big to fit the small reply path, read back the ways clients read
+     * command replies: through runCommand, as the first batch of a command cursor
+     * (DBClientCursor::initCommand, as mongos does), and out of the Message directly.
+     */
+    class LargeCommandReply : public CollectionBase {
+    public:
+        LargeCommandReply() : CollectionBase( "largecommandreply" ) {
+        }
+        void run() {
+            const string big( 64 * 1024, 'x' );
+            client().insert( ns(), BSON( "_id" << 1 << "big" << big ) );
+            const BSONObj cmd = BSON( "aggregate" << "querytests.largecommandreply"
+                                      << "pipeline" << BSONArray() );
+
+            BSONObj res;
+            ASSERT( client().runCommand( "unittests", cmd, res ) );
+            ASSERT_EQUALS( big, res[ "result" ].Array()[ 0 ][ "big" ].String() );
+
+            DBClientCursor cursor( &client(), "unittests.$cmd", cmd, 1, 0, NULL, 0, 0 );
+            ASSERT( cursor.initCommand() );
+            ASSERT( cursor.more() );
+            ASSERT_EQUALS( res, cursor.next() );
+
+            Message m;
+            replyToQuery( 0, m, res.getOwned() );
+            QueryResult* qr = reinterpret_cast<QueryResult*>( m.singleData() );
+            ASSERT_EQUALS( 1, qr->nReturned );
+            ASSERT_EQUALS( res, BSONObj( qr->data() ) );
+        }
+    };
+
     namespace parsedtests {
         class basic1 {
         public:
@@ -1736,6 +1769,7 @@ namespace QueryTests {
             add< QueryCursorTimeout >();
             add< QueryReadsAll >();
             add< KillPinnedCursor >();
+            add< LargeCommandReply >();
 
             add< parsedtests::basic1 >();
 
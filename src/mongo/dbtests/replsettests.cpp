@@ -1130,6 +1130,87 @@ namespace ReplSetTests {
         }
     };
 
+    class TestInsertRun : public Base {
+        BSONObj insertOp(const BSONObj& o, const char* coll = NULL) {
+            BSONObjBuilder b;
+            b.appendTimestamp("ts", OpTime::_now().asLL());
+            b.append("op", "i");
+            b.append("o", o);
+            b.append("ns", coll ? coll : ns());
+            return b.obj();
+        }
+    public:
+        void run() {
+            drop();
+
+            vector<BSONObj> ops;
+            {
+                Lock::GlobalWrite lk;
+                for (int i = 0; i < 10; i++) {
+                    ops.push_back(insertOp(BSON("_id" << i << "x" << i)));
+                }
+                // replaces the document inserted above, as an upsert would
+                ops.push_back(insertOp(BSON("_id" << 3 << "x" << 33)));
+                ops.push_back(insertOp(BSON("x" << 100)));
+                ops.push_back(insertOp(BSON("_id" << 0), "unittests.other"));
+            }
+
+            // the inserts into ns() with an _id form one run
+            ASSERT(replset::SyncTail::findInsertRunEnd(ops.begin(), ops.end()) ==
+                   ops.begin() + 11);
+            ASSERT(replset::SyncTail::findInsertRunEnd(ops.begin() + 11, ops.end()) ==
+                   ops.begin() + 12);
+
+            replset::multiSyncApply(ops, _tailer);
+            ASSERT_EQUALS(11, static_cast<int>(client()->count(ns())));
+            ASSERT_EQUALS(33, findOne(BSON("_id" << 3))["x"].numberInt());
+
+            // replaying the same ops leaves the data unchanged
+            replset::multiSyncApply(ops, _tailer);
+            ASSERT_EQUALS(11, static_cast<int>(client()->count(ns())));
+            ASSERT_EQUALS(33, findOne(BSON("_id" << 3))["x"].numberInt());
+
+            client()->dropCollection("unittests.other");
+            drop();
+        }
+    };
+
+    class TestPrefetchPipelineClaim : public Base {
+        BSONObj op(const char* opType) {
+            BSONObjBuilder b;
+            b.appendTimestamp("ts", OpTime::_now().asLL());
+            b.append("op", opType);
+            b.append("o", BSON("_id" << 1));
+            b.append("ns", ns());
+            return b.obj();
+        }
+    public:
+        void run() {
+            vector<BSONObj> ops;
+            {
+                Lock::GlobalWrite lk;
+                ops.push_back(op("i"));
+                ops.push_back(op("n"));
+                ops.push_back(op("u"));
+                ops.push_back(op("d"));
+            }
+
+            replset::OplogPrefetchPipeline pipeline(1);
+            for (vector<BSONObj>::const_iterator it = ops.begin(); it != ops.end(); ++it) {
+                pipeline.add(*it);
+            }
+
+            ASSERT(pipeline.claim(ops[0]));
+            // no-ops aren't worth prefetching
+            ASSERT(!pipeline.claim(ops[1]));
+            // claiming a later op forgets the ones before it
+            ASSERT(pipeline.claim(ops[3]));
+            ASSERT(!pipeline.claim(ops[2]));
+            ASSERT_GREATER_THAN_OR_EQUALS(pipeline.getDepth(),
+                                          replset::OplogPrefetchPipeline::minDepth);
+        }
+    };
+
     class All : public Suite {
     public:
         All() : Suite( "replset" ) {
@@ -1143,6 +1224,8 @@ namespace ReplSetTests {
             add< CappedUpdate >();
             add< CappedInsert >();
             add< TestRSSync >();
+            add< TestInsertRun >();
+            add< TestPrefetchPipelineClaim >();
             add< TestDropDB >();
             add< TestDrop >();
             add< TestDropIndexes >();
@@ -23,9 +23,12 @@
 #include <boost/thread.hpp>
 
 #include "mongo/bson/util/atomic_int.h"
+#include "mongo/db/clientcursor.h"
 #include "mongo/db/d_concurrency.h"
+#include "mongo/db/lockstat.h"
 #include "mongo/dbtests/dbtests.h"
 #include "mongo/platform/atomic_word.h"
+#include "mongo/platform/random.h"
 #include "mongo/util/concurrency/mvar.h"
 #include "mongo/util/concurrency/thread_pool.h"
 #include "mongo/util/concurrency/list.h"
@@ -33,6 +36,7 @@
 #include "mongo/util/concurrency/synchronization.h"
 #include "mongo/util/concurrency/qlock.h"
 #include "mongo/util/concurrency/ticketholder.h"
+#include "mongo/util/histogram.h"
 #include "mongo/server.h"
 
 namespace mongo { 
@@ -327,6 +331,85 @@ namespace ThreadedTests {
         }
     };
 
+    class HistogramConcurrentInsert : public ThreadedTest<> {
+        static const int iterations = 100000;
+        Histogram _h;
+
+        static Histogram::Options options() {
+            Histogram::Options opts;
+            opts.numBuckets = 4;
+            opts.bucketSize = 10;
+            return opts;
+        }
+    public:
+        HistogramConcurrentInsert() : _h( options() ) {}
+
+        void subthread(int) {
+            for ( int i = 0; i < iterations; i++ ) {
+                _h.insert( i % 40 );
+            }
+        }
+        void validate() {
+            uint64_t total = 0;
+            for ( uint32_t i = 0; i < _h.getBucketsNum(); i++ )
+                total += _h.getCount( i );
+            ASSERT_EQUALS( total, static_cast<uint64_t>( nthreads * iterations ) );
+        }
+    };
+
+    class LockStatLatency {
+    public:
+        void run() {
+            LockStat withLatency( true );
+            withLatency.recordAcquireTimeMicros( 'w', 5 );
+            withLatency.recordAcquireTimeMicros( 'w', 6 );
+            withLatency.recordLockTimeMicros( 'W', 100 );
+            withLatency.recordLockTimeMicros( 'W', 1LL << 40 );
+
+            BSONObj r = withLatency.report();
+            ASSERT_EQUALS( 2, r["acquiringLatencyMicros"]["w"]["8"].numberLong() );
+            ASSERT( r["acquiringLatencyMicros"]["W"].eoo() );
+            ASSERT_EQUALS( 1, r["lockedLatencyMicros"]["W"]["128"].numberLong() );
+            ASSERT_EQUALS( 1, r["lockedLatencyMicros"]["W"]["more"].numberLong() );
+
+            // per operation stats stay as they were
+            LockStat plain;
+            plain.recordLockTimeMicros( 'W', 100 );
+            ASSERT( plain.report()["lockedLatencyMicros"].eoo() );
+            ASSERT_EQUALS( 100, plain.report()["timeLockedMicros"]["W"].numberLong() );
+        }
+    };
+
+    class LockContentionProfilerKeepsLongest : public ThreadedTest<> {
+        static const int iterations = 1000;
+        LockContentionProfiler _profiler;
+
+        void subthread(int remaining) {
+            for ( int i = 0; i < iterations; i++ ) {
+                long long micros = remaining * iterations + i;
+                if ( _profiler.wants( LockContentionProfiler::Waiting, micros ) )
+                    _profiler.record( LockContentionProfiler::Waiting, 'w', micros,
+                                      "insert", "test.foo", micros );
+            }
+        }
+        void validate() {
+            vector<LockContentionProfiler::Sample> kept =
+                _profiler.samples( LockContentionProfiler::Waiting );
+            ASSERT_EQUALS( static_cast<size_t>( LockContentionProfiler::MaxSamples ), kept.size() );
+            long long longest = nthreads * iterations + iterations - 1;
+            for ( unsigned i = 0; i < kept.size(); i++ ) {
+                ASSERT_EQUALS( longest - i, kept[i].micros );
+                ASSERT_EQUALS( "test.foo", kept[i].ns );
+            }
+            ASSERT( _profiler.samples( LockContentionProfiler::Holding ).empty() );
+            ASSERT( ! _profiler.wants( LockContentionProfiler::Waiting, longest - 10 ) );
+
+            _profiler.reset();
+            ASSERT( _profiler.samples( LockContentionProfiler::Waiting ).empty() );
+            ASSERT( _profiler.wants( LockContentionProfiler::Waiting, 1 ) );
+        }
+    };
+
     class MVarTest : public ThreadedTest<> {
         static const int iterations = 10000;
         MVar<int> target;
@@ -969,6 +1052,50 @@ namespace ThreadedTests {
 
     };
 
+    /**
+     * Many threads pinning and releasing open cursors, as concurrent getMores do.  Each thread
+     * has its own cursors, as a cursor can only be pinned by one at a time, so the time reported
+     * is what they cost each other through the cursor registry.
+     */
+    class ClientCursorRegistryContention : public ThreadedTest<16> {
+        enum { CursorsPerThread = 1000, N = 100000 };
+        vector<CursorId> _ids;
+        static const char* ns() { return "unittests.threadedtests_cursorregistry"; }
+    public:
+        void run() {
+            Timer t;
+            ThreadedTest<16>::run();
+            cout << "ClientCursorRegistryContention threads:" << nthreads << " pins:"
+                 << N * nthreads << ' ' << t.millis() << "ms" << endl;
+        }
+    private:
+        virtual void setup() {
+            Client::WriteContext ctx( ns() );
+            for( int i = 0; i < CursorsPerThread * nthreads; i++ ) {
+                // no timeout, so the cursors stay open until validate()
+                ClientCursor* cc = new ClientCursor( ns() );
+                _ids.push_back( cc->cursorid() );
+            }
+        }
+        virtual void subthread(int tnumber) {
+            Client::initThread("cursorregistry");
+            // thread 'tnumber' (1..nthreads) uses every nthreads'th cursor
+            PseudoRandom r( (int32_t) tnumber );
+            for( int i = 0; i < N; i++ ) {
+                unsigned k = (unsigned) r.nextInt32() % CursorsPerThread;
+                ClientCursorPin pin( _ids[ k * nthreads + tnumber - 1 ] );
+                ASSERT( pin.c() );
+            }
+            cc().shutdown();
+        }
+        virtual void validate() {
+            Client::WriteContext ctx( ns() );
+            for( vector<CursorId>::const_iterator i = _ids.begin(); i != _ids.end(); ++i ) {
+                ASSERT( ClientCursor::erase( *i ) );
+            }
+        }
+    };
+
     class All : public Suite {
     public:
         All() : Suite( "threading" ) { }
@@ -993,6 +1120,9 @@ namespace ThreadedTests {
             add< IsAtomicUIntAtomic >();
             add< IsAtomicWordAtomic<AtomicUInt32> >();
             add< IsAtomicWordAtomic<AtomicUInt64> >();
+            add< HistogramConcurrentInsert >();
+            add< LockStatLatency >();
+            add< LockContentionProfilerKeepsLongest >();
             add< MVarTest >();
             add< ThreadPoolTest >();
             add< LockTest >();
@@ -1005,6 +1135,7 @@ namespace ThreadedTests {
 
             add< MongoMutexTest >();
             add< TicketHolderWaits >();
+            add< ClientCursorRegistryContention >();
         }
     } myall;
 }
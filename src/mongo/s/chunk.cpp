@@ -690,6 +690,7 @@ namespace mongo {
                     const_cast<set<Shard>&>(_shards).swap(shards);
                     const_cast<ShardVersionMap&>(_shardVersions).swap(shardVersions);
                     const_cast<ChunkRangeManager&>(_chunkRanges).reloadAll(_chunkMap);
+                    _buildRoutingTable(_oldManager.get());
 
                     // Once we load data, clear reference to old manager
                     _oldManager.reset();
@@ -856,6 +857,43 @@ namespace mongo {
 
     }
 
+    void ChunkManager::_buildRoutingTable( const ChunkManager* oldManager ) {
+        // Const for thread-safety, like the rest of our state, but only set up while loading
+        vector<ChunkPtr>& chunks = const_cast<vector<ChunkPtr>&>(_chunkVector);
+        vector<unsigned>& runEnds = const_cast<vector<unsigned>&>(_shardRunEnds);
+
+        vector<BSONObj> mins;
+        chunks.clear();
+        chunks.reserve( _chunkMap.size() );
+        mins.reserve( _chunkMap.size() );
+        for ( ChunkMap::const_iterator it = _chunkMap.begin(); it != _chunkMap.end(); ++it ) {
+            chunks.push_back( it->second );
+            mins.push_back( it->second->getMin() );
+        }
+
+        runEnds.resize( chunks.size() );
+        for ( size_t i = chunks.size(); i-- > 0; ) {
+            const bool sameShardNext = i + 1 < chunks.size() &&
+                                       chunks[i + 1]->getShard() == chunks[i]->getShard();
+            runEnds[i] = sameShardNext ? runEnds[i + 1] : i + 1;
+        }
+
+        ChunkRoutingTable& table = const_cast<ChunkRoutingTable&>(_routingTable);
+        if ( !table.build( mins, oldManager ? &oldManager->_routingTable : NULL ) ) {
+            LOG(1) << "chunk bounds for " << _ns << " can't be put in a routing table,"
+                   << " routing through the chunk map instead" << endl;
+        }
+    }
+
+    int ChunkManager::_routeToChunk( const BSONObj& point ) const {
+        const int i = _routingTable.findContaining( point );
+
+        // The table is only a hint when numeric types are mixed, so check the answer
+        if ( i < 0 || !_chunkVector[i]->containsPoint( point ) )
+            return -1;
+        return i;
+    }
+
     ChunkManagerPtr ChunkManager::reload(bool force) const {
         return grid.getDBConfig(getns())->getChunkManager(getns(), force);
     }
@@ -1061,6 +1099,10 @@ namespace mongo {
     }
 
     ChunkPtr ChunkManager::findIntersectingChunk( const BSONObj& point ) const {
+        const int routed = _routeToChunk( point );
+        if ( routed >= 0 )
+            return _chunkVector[routed];
+
         {
             BSONObj foo;
             ChunkPtr c;
@@ -1167,6 +1209,24 @@ namespace mongo {
                                           const BSONObj& min,
                                           const BSONObj& max ) const {
 
+        const int first = _routeToChunk( min );
+        const int last = _routingTable.findContaining( max );
+
+        // Unlike min, max is inclusive and may be globalMax, which no chunk contains
+        if ( first >= 0 && last >= first &&
+             _chunkVector[last]->getMin().woCompare( max ) <= 0 &&
+             ( last + 1 == static_cast<int>( _chunkVector.size() ) ||
+               max.woCompare( _chunkVector[last]->getMax() ) < 0 ) ) {
+
+            for ( unsigned i = first; i <= static_cast<unsigned>( last ); i = _shardRunEnds[i] ) {
+                shards.insert( _chunkVector[i]->getShard() );
+
+                // once we know we need to visit all shards no need to keep looping
+                if ( shards.size() == _shards.size() ) break;
+            }
+            return;
+        }
+
         ChunkRangeMap::const_iterator it = _chunkRanges.upper_bound(min);
         ChunkRangeMap::const_iterator end = _chunkRanges.upper_bound(max);
 
@@ -33,6 +33,7 @@
 #include "mongo/base/string_data.h"
 #include "mongo/bson/util/atomic_int.h"
 #include "mongo/client/distlock.h"
+#include "mongo/s/chunk_routing_table.h"
 #include "mongo/s/chunk_version.h"
 #include "mongo/s/shard.h"
 #include "mongo/s/shardkey.h"
@@ -466,6 +467,13 @@ namespace mongo {
                                     ShardVersionMap& shardVersions, ChunkManagerPtr oldManager);
         static bool _isValid(const ChunkMap& chunks);
 
+        // Builds _chunkVector, _shardRunEnds and _routingTable from _chunkMap
+        void _buildRoutingTable( const ChunkManager* oldManager );
+
+        // Index in _chunkVector of the chunk containing 'point', or -1 if the routing table
+        // can't answer
+        int _routeToChunk( const BSONObj& point ) const;
+
         // end helpers
 
         // All members should be const for thread-safety
@@ -476,6 +484,12 @@ namespace mongo {
         const ChunkMap _chunkMap;
         const ChunkRangeManager _chunkRanges;
 
+        // _chunkMap flattened for lookups through _routingTable, which is keyed by chunk min.
+        // _shardRunEnds[i] is the index just past the run of chunks on the same shard as chunk i.
+        const vector<ChunkPtr> _chunkVector;
+        const vector<unsigned> _shardRunEnds;
+        const ChunkRoutingTable _routingTable;
+
         const set<Shard> _shards;
 
         const ShardVersionMap _shardVersions; // max version per shard
@@ -0,0 +1,264 @@
+/**
+ *    Copyright (C) 2013 10gen Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects
+ *    for all of the code used other than as permitted herein. If you modify
+ *    file(s) with this exception, you may extend this exception to your
+ *    version of the file(s), but you are not obligated to do so. If you do not
+ *    wish to do so, delete this exception statement from your version. If you
+ *    delete this exception statement from all source files in the program,
+ *    then also delete it in the license file.
+ */
+
+#include "mongo/s/chunk_routing_table.h"
+
+#include <cmath>
+#include <limits>
+
+namespace mongo {
+
+    namespace {
+
+        // Type bytes: MinKey and MaxKey go to the ends, the rest use their canonical type.
+        const unsigned char kMinKeyByte = 0x00;
+        const unsigned char kMaxKeyByte = 0xff;
+
+        // Kinds of numbers, in order
+        const unsigned char kNaN = 0;           // compares below all other numbers
+        const unsigned char kBelowInt64 = 1;    // doubles < -2^63, including -Inf
+        const unsigned char kInInt64 = 2;       // integer part followed by an optional fraction
+        const unsigned char kAboveInt64 = 3;    // doubles >= 2^63, including +Inf
+
+        const double kTwoTo63 = 9223372036854775808.0;
+
+        // These take any _BufBuilder so lookups can encode on the stack
+
+        template <typename Builder>
+        void appendBigEndian(unsigned long long v, Builder* out) {
+            char buf[8];
+            for (int i = 7; i >= 0; i--) {
+                buf[i] = static_cast<char>(v & 0xff);
+                v >>= 8;
+            }
+            out->appendBuf(buf, sizeof(buf));
+        }
+
+        template <typename Builder>
+        void appendDoubleBits(double d, bool negative, Builder* out) {
+            unsigned long long bits;
+            memcpy(&bits, &d, sizeof(bits));
+            // The bit patterns of negative doubles sort in reverse
+            appendBigEndian(negative ? ~bits : bits, out);
+        }
+
+        template <typename Builder>
+        void appendInt64(long long v, Builder* out) {
+            appendBigEndian(static_cast<unsigned long long>(v) ^ (1ULL << 63), out);
+        }
+
+        template <typename Builder>
+        void appendNumber(const BSONElement& e, Builder* out) {
+            if (e.type() != NumberDouble) {
+                out->appendChar(kInInt64);
+                appendInt64(e.numberLong(), out);
+                out->appendChar(0); // no fraction
+                return;
+            }
+
+            double d = e.numberDouble();
+            if (isNaN(d)) {
+                out->appendChar(kNaN);
+            }
+            else if (d < -kTwoTo63) {
+                out->appendChar(kBelowInt64);
+                appendDoubleBits(d, true, out);
+            }
+            else if (d >= kTwoTo63) {
+                out->appendChar(kAboveInt64);
+                appendDoubleBits(d, false, out);
+            }
+            else {
+                const double integral = std::floor(d);
+                const double fraction = d - integral; // exact, in [0, 1)
+                out->appendChar(kInInt64);
+                appendInt64(static_cast<long long>(integral), out);
+                if (fraction == 0) {
+                    out->appendChar(0); // also makes -0.0 equal to 0
+                }
+                else {
+                    out->appendChar(1);
+                    appendDoubleBits(fraction, false, out);
+                }
+            }
+        }
+
+        // Like memcmp, with a proper prefix ordered before the longer key
+        int compareKeys(const char* l, size_t lLen, const char* r, size_t rLen) {
+            const int res = memcmp(l, r, std::min(lLen, rLen));
+            if (res)
+                return res;
+            return lLen < rLen ? -1 : (lLen == rLen ? 0 : 1);
+        }
+
+        // Escapes NUL bytes so that the terminator sorts below any continuation
+        template <typename Builder>
+        void appendString(const char* data, int len, Builder* out) {
+            for (int i = 0; i < len; i++) {
+                out->appendChar(data[i]);
+                if (data[i] == '\0')
+                    out->appendChar(static_cast<char>(0xff));
+            }
+            out->appendChar(0);
+            out->appendChar(0);
+        }
+
+        template <typename Builder>
+        bool encodeKeyTo(const BSONObj& key, Builder* out) {
+            BSONObjIterator it(key);
+            while (it.more()) {
+                const BSONElement e = it.next();
+                switch (e.type()) {
+                case MinKey:
+                    out->appendChar(kMinKeyByte);
+                    break;
+                case MaxKey:
+                    out->appendChar(static_cast<char>(kMaxKeyByte));
+                    break;
+                case jstNULL:
+                    out->appendChar(e.canonicalType());
+                    break;
+                case NumberDouble:
+                case NumberInt:
+                case NumberLong:
+                    out->appendChar(e.canonicalType());
+                    appendNumber(e, out);
+                    break;
+                case String:
+                case Symbol:
+                    out->appendChar(e.canonicalType());
+                    appendString(e.valuestr(), e.valuestrsize() - 1, out);
+                    break;
+                case jstOID:
+                    out->appendChar(e.canonicalType());
+                    out->appendBuf(e.value(), OID::kOIDSize);
+                    break;
+                case Bool:
+                    out->appendChar(e.canonicalType());
+                    out->appendChar(e.boolean() ? 1 : 0);
+                    break;
+                case Date:
+                    out->appendChar(e.canonicalType());
+                    appendInt64(static_cast<long long>(e.date().millis), out);
+                    break;
+                default:
+                    return false;
+                }
+            }
+            return true;
+        }
+
+    } // namespace
+
+    bool ChunkRoutingTable::encodeKey(const BSONObj& key, BufBuilder* out) {
+        return encodeKeyTo(key, out);
+    }
+
+    bool ChunkRoutingTable::build(const std::vector<BSONObj>& mins,
+                                  const ChunkRoutingTable* previous) {
+        _usable = false;
+        _keys.clear();
+        _offsets.clear();
+        _mins = mins;
+
+        if (previous && !previous->isUsable())
+            previous = NULL;
+
+        BufBuilder keys(static_cast<int>(previous ? previous->_keys.size() : mins.size() * 16));
+        _offsets.reserve(mins.size() + 1);
+        _offsets.push_back(0);
+
+        size_t j = 0; // position in 'previous'
+        for (size_t i = 0; i < mins.size(); i++) {
+            const BSONObj& min = mins[i];
+            const int start = keys.len();
+
+            bool reused = false;
+            if (previous) {
+                // Most keys are unchanged between versions so this is usually the next one
+                while (j < previous->size() && !previous->_mins[j].binaryEqual(min)
+                       && previous->_mins[j].woCompare(min) < 0) {
+                    j++;
+                }
+                if (j < previous->size() && previous->_mins[j].binaryEqual(min)) {
+                    const unsigned from = previous->_offsets[j];
+                    keys.appendBuf(previous->_keys.data() + from, previous->_offsets[j + 1] - from);
+                    j++;
+                    reused = true;
+                }
+            }
+
+            if (!reused && !encodeKey(min, &keys))
+                return false;
+
+            if (i > 0 && compareKeys(keys.buf() + _offsets[i - 1], start - _offsets[i - 1],
+                                     keys.buf() + start, keys.len() - start) >= 0) {
+                // Can't happen for keys woCompare considers ascending, unless they mix numeric
+                // types beyond 2^53.
+                return false;
+            }
+
+            _offsets.push_back(keys.len());
+        }
+
+        _keys.assign(keys.buf(), keys.len());
+        _usable = true;
+        return true;
+    }
+
+    int ChunkRoutingTable::compareTo(size_t i, const char* key, size_t len) const {
+        return compareKeys(_keys.data() + _offsets[i], _offsets[i + 1] - _offsets[i], key, len);
+    }
+
+    int ChunkRoutingTable::findContaining(const BSONObj& point) const {
+        if (!_usable || _mins.empty())
+            return -1;
+
+        StackBufBuilder buf;
+        if (!encodeKeyTo(point, &buf))
+            return -1;
+
+        const char* key = buf.buf();
+        const size_t len = buf.len();
+
+        if (compareTo(0, key, len) > 0)
+            return -1;
+
+        // Find the last key <= point. The loop body has no data dependent branches, so the
+        // compiler can use a conditional move and the only mispredictions are within memcmp.
+        size_t base = 0;
+        size_t n = _mins.size();
+        while (n > 1) {
+            const size_t half = n / 2;
+            base = (compareTo(base + half, key, len) <= 0) ? base + half : base;
+            n -= half;
+        }
+        return static_cast<int>(base);
+    }
+
+}
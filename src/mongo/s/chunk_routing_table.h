@@ -0,0 +1,98 @@
+/**
+ *    Copyright (C) 2013 10gen Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects
+ *    for all of the code used other than as permitted herein. If you modify
+ *    file(s) with this exception, you may extend this exception to your
+ *    version of the file(s), but you are not obligated to do so. If you do not
+ *    wish to do so, delete this exception statement from your version. If you
+ *    delete this exception statement from all source files in the program,
+ *    then also delete it in the license file.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "mongo/db/jsobj.h"
+
+namespace mongo {
+
+    /**
+     * A flat, sorted table of chunk min keys used by mongos to route a shard key to its chunk.
+     *
+     * Keys are stored back to back in one buffer in an encoding whose memcmp order matches the
+     * BSONObj::woCompare order of shard keys, so a lookup is a binary search over contiguous
+     * memory rather than a walk down a map of BSONObjs.
+     *
+     * Only the value types that shard keys commonly hold can be encoded (see encodeKey). If any
+     * chunk boundary can't be, the table is left unusable and callers should fall back to their
+     * ordered maps. Callers must also check the chunk they get back: a lookup is exact for keys
+     * of one type, but mixing NumberLongs beyond 2^53 with doubles can disagree with woCompare,
+     * which compares those as doubles.
+     */
+    class ChunkRoutingTable {
+    public:
+        ChunkRoutingTable() : _usable(false) {}
+
+        /**
+         * Rebuilds the table from 'mins', the min keys of all chunks in ascending order.
+         *
+         * If 'previous' is given, encodings of keys that are also in it are copied rather than
+         * recomputed, so rebuilding after a config diff costs little more than a copy.
+         *
+         * Returns false, leaving the table unusable, if a key can't be encoded or the keys are
+         * not strictly ascending.
+         */
+        bool build(const std::vector<BSONObj>& mins, const ChunkRoutingTable* previous);
+
+        bool isUsable() const { return _usable; }
+
+        size_t size() const { return _mins.size(); }
+
+        const BSONObj& getMin(size_t i) const { return _mins[i]; }
+
+        /**
+         * Returns the index of the last min key <= 'point', or -1 if the table is unusable,
+         * 'point' can't be encoded or it is less than every min key.
+         */
+        int findContaining(const BSONObj& point) const;
+
+        /**
+         * Appends to 'out' an encoding of 'key' that compares with memcmp (shorter first when
+         * one is a prefix of the other) as the key compares with woCompare. Field names are
+         * ignored. Returns false if 'key' holds a type other than MinKey, MaxKey, null, numbers,
+         * strings, symbols, ObjectIds, booleans or dates.
+         */
+        static bool encodeKey(const BSONObj& key, BufBuilder* out);
+
+    private:
+        // Compares the i'th stored key with an encoded key, like memcmp
+        int compareTo(size_t i, const char* key, size_t len) const;
+
+        bool _usable;
+
+        // _keys[_offsets[i], _offsets[i+1]) is the encoding of _mins[i]
+        std::string _keys;
+        std::vector<unsigned> _offsets;
+        std::vector<BSONObj> _mins;
+    };
+
+}
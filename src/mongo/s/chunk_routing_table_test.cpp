@@ -0,0 +1,225 @@
+/**
+ *    Copyright (C) 2013 10gen Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects
+ *    for all of the code used other than as permitted herein. If you modify
+ *    file(s) with this exception, you may extend this exception to your
+ *    version of the file(s), but you are not obligated to do so. If you do not
+ *    wish to do so, delete this exception statement from your version. If you
+ *    delete this exception statement from all source files in the program,
+ *    then also delete it in the license file.
+ */
+
+#include <limits>
+#include <map>
+#include <vector>
+
+#include "mongo/db/jsobj.h"
+#include "mongo/s/chunk_routing_table.h"
+#include "mongo/unittest/unittest.h"
+#include "mongo/util/timer.h"
+
+namespace {
+
+    using mongo::BSONObj;
+    using mongo::BSONObjCmp;
+    using mongo::BufBuilder;
+    using mongo::ChunkRoutingTable;
+    using mongo::Date_t;
+    using mongo::MAXKEY;
+    using mongo::MINKEY;
+    using mongo::OID;
+    using mongo::Timer;
+    using std::map;
+    using std::numeric_limits;
+    using std::vector;
+
+    int encodedCompare(const BSONObj& l, const BSONObj& r) {
+        BufBuilder lb;
+        BufBuilder rb;
+        ASSERT(ChunkRoutingTable::encodeKey(l, &lb));
+        ASSERT(ChunkRoutingTable::encodeKey(r, &rb));
+        const int res = memcmp(lb.buf(), rb.buf(), std::min(lb.len(), rb.len()));
+        if (res)
+            return res < 0 ? -1 : 1;
+        return lb.len() < rb.len() ? -1 : (lb.len() == rb.len() ? 0 : 1);
+    }
+
+    int sign(int x) { return x < 0 ? -1 : (x == 0 ? 0 : 1); }
+
+    TEST(ChunkRoutingTable, EncodingMatchesWoCompare) {
+        vector<BSONObj> keys;
+        keys.push_back(BSON("a" << MINKEY));
+        keys.push_back(BSON("a" << MAXKEY));
+        keys.push_back(BSON("a" << mongo::BSONNULL));
+        keys.push_back(BSON("a" << numeric_limits<double>::quiet_NaN()));
+        keys.push_back(BSON("a" << -numeric_limits<double>::infinity()));
+        keys.push_back(BSON("a" << -1e300));
+        keys.push_back(BSON("a" << numeric_limits<long long>::min()));
+        keys.push_back(BSON("a" << -2.5));
+        keys.push_back(BSON("a" << -2));
+        keys.push_back(BSON("a" << -0.0));
+        keys.push_back(BSON("a" << 0));
+        keys.push_back(BSON("a" << 0.25));
+        keys.push_back(BSON("a" << 3));
+        keys.push_back(BSON("a" << 3LL));
+        keys.push_back(BSON("a" << 3.0));
+        keys.push_back(BSON("a" << 3.5));
+        keys.push_back(BSON("a" << numeric_limits<long long>::max()));
+        keys.push_back(BSON("a" << 1e300));
+        keys.push_back(BSON("a" << numeric_limits<double>::infinity()));
+        keys.push_back(BSON("a" << ""));
+        keys.push_back(BSON("a" << "a"));
+        keys.push_back(BSON("a" << std::string("a\0", 2)));
+        keys.push_back(BSON("a" << std::string("a\0b", 3)));
+        keys.push_back(BSON("a" << "a\x01"));
+        keys.push_back(BSON("a" << "ab"));
+        keys.push_back(BSON("a" << "b"));
+        keys.push_back(BSON("a" << OID("000000000000000000000000")));
+        keys.push_back(BSON("a" << OID("0123456789abcdef01234567")));
+        keys.push_back(BSON("a" << false));
+        keys.push_back(BSON("a" << true));
+        keys.push_back(BSON("a" << Date_t(-5)));
+        keys.push_back(BSON("a" << Date_t(5)));
+        keys.push_back(BSON("a" << 1 << "b" << "z"));
+        keys.push_back(BSON("a" << 1.5 << "b" << "a"));
+        keys.push_back(BSON("a" << "x" << "b" << MINKEY));
+        keys.push_back(BSON("a" << "x" << "b" << 1));
+
+        for (size_t i = 0; i < keys.size(); i++) {
+            for (size_t j = 0; j < keys.size(); j++) {
+                // Compound keys are only compared with each other
+                if (keys[i].nFields() != keys[j].nFields())
+                    continue;
+                ASSERT_EQUALS(sign(keys[i].woCompare(keys[j], BSONObj(), false)),
+                              encodedCompare(keys[i], keys[j]));
+            }
+        }
+    }
+
+    TEST(ChunkRoutingTable, UnsupportedTypes) {
+        BufBuilder b;
+        ASSERT_FALSE(ChunkRoutingTable::encodeKey(BSON("a" << BSON("b" << 1)), &b));
+        ASSERT_FALSE(ChunkRoutingTable::encodeKey(BSON("a" << BSON_ARRAY(1 << 2)), &b));
+
+        vector<BSONObj> mins;
+        mins.push_back(BSON("a" << MINKEY));
+        mins.push_back(BSON("a" << BSON("b" << 1)));
+        ChunkRoutingTable table;
+        ASSERT_FALSE(table.build(mins, NULL));
+        ASSERT_FALSE(table.isUsable());
+        ASSERT_EQUALS(-1, table.findContaining(BSON("a" << 1)));
+    }
+
+    TEST(ChunkRoutingTable, FindContaining) {
+        vector<BSONObj> mins;
+        mins.push_back(BSON("a" << MINKEY));
+        mins.push_back(BSON("a" << 0));
+        mins.push_back(BSON("a" << 10));
+        mins.push_back(BSON("a" << "str"));
+
+        ChunkRoutingTable table;
+        ASSERT(table.build(mins, NULL));
+        ASSERT_EQUALS(0, table.findContaining(BSON("a" << MINKEY)));
+        ASSERT_EQUALS(0, table.findContaining(BSON("a" << -1)));
+        ASSERT_EQUALS(1, table.findContaining(BSON("a" << 0)));
+        ASSERT_EQUALS(1, table.findContaining(BSON("a" << 9.99)));
+        ASSERT_EQUALS(2, table.findContaining(BSON("a" << 10LL)));
+        ASSERT_EQUALS(3, table.findContaining(BSON("a" << "str")));
+        ASSERT_EQUALS(3, table.findContaining(BSON("a" << MAXKEY)));
+        ASSERT_EQUALS(-1, table.findContaining(BSON("a" << BSON("b" << 1))));
+
+        vector<BSONObj> unordered;
+        unordered.push_back(BSON("a" << 10));
+        unordered.push_back(BSON("a" << 10.0));
+        ASSERT_FALSE(table.build(unordered, NULL));
+    }
+
+    TEST(ChunkRoutingTable, RebuildFromPrevious) {
+        vector<BSONObj> mins;
+        mins.push_back(BSON("a" << MINKEY));
+        for (int i = 0; i < 100; i++)
+            mins.push_back(BSON("a" << i * 10));
+        ChunkRoutingTable first;
+        ASSERT(first.build(mins, NULL));
+
+        // Split one chunk and merge two others
+        mins.insert(mins.begin() + 50, BSON("a" << 485));
+        mins.erase(mins.begin() + 10);
+
+        ChunkRoutingTable second;
+        ASSERT(second.build(mins, &first));
+        ChunkRoutingTable fresh;
+        ASSERT(fresh.build(mins, NULL));
+
+        ASSERT_EQUALS(fresh.size(), second.size());
+        for (int x = -5; x < 1005; x++) {
+            const BSONObj point = BSON("a" << x);
+            ASSERT_EQUALS(fresh.findContaining(point), second.findContaining(point));
+        }
+        ASSERT_EQUALS(49, second.findContaining(BSON("a" << 485)));
+    }
+
+    // Not a correctness test: compares lookups against the map of BSONObjs ChunkManager used.
+    TEST(ChunkRoutingTable, LookupMicrobenchmark) {
+        const int numChunks = 100000;
+        const int numLookups = 1000000;
+
+        vector<BSONObj> mins;
+        map<BSONObj, int, BSONObjCmp> byMax;
+        mins.push_back(BSON("a" << MINKEY));
+        for (int i = 1; i < numChunks; i++) {
+            mins.push_back(BSON("a" << (long long)i * 1000));
+            byMax[mins.back()] = i - 1;
+        }
+        byMax[BSON("a" << MAXKEY)] = numChunks - 1;
+
+        vector<BSONObj> points;
+        for (int i = 0; i < 1000; i++)
+            points.push_back(BSON("a" << (long long)(i * 7919 % numChunks) * 1000 + 17));
+
+        Timer buildTimer;
+        ChunkRoutingTable table;
+        ASSERT(table.build(mins, NULL));
+        const int buildMillis = buildTimer.millis();
+
+        Timer rebuildTimer;
+        ChunkRoutingTable rebuilt;
+        ASSERT(rebuilt.build(mins, &table));
+        const int rebuildMillis = rebuildTimer.millis();
+
+        long long check = 0;
+        Timer tableTimer;
+        for (int i = 0; i < numLookups; i++)
+            check += table.findContaining(points[i % points.size()]);
+        const int tableMillis = tableTimer.millis();
+
+        Timer mapTimer;
+        for (int i = 0; i < numLookups; i++)
+            check -= byMax.upper_bound(points[i % points.size()])->second;
+        const int mapMillis = mapTimer.millis();
+
+        ASSERT_EQUALS(0, check);
+        mongo::unittest::log() << "chunk routing with " << numChunks << " chunks: build "
+                               << buildMillis << "ms, rebuild " << rebuildMillis << "ms, "
+                               << numLookups << " lookups " << tableMillis << "ms vs "
+                               << mapMillis << "ms for map" << std::endl;
+    }
+
+} // namespace
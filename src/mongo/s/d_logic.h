@@ -291,6 +291,12 @@ namespace mongo {
 
         static ShardedConnectionInfo* get( bool create );
         static void reset();
+
+        /** detach this thread's info, if any, and return it.  The caller owns the result. */
+        static ShardedConnectionInfo* release();
+
+        /** make 'info' this thread's info.  Takes ownership. */
+        static void adopt( ShardedConnectionInfo* info );
         static void addHook();
 
         bool inForceVersionOkMode() const {
@@ -38,6 +38,7 @@
 
 #include <algorithm>
 #include <boost/thread/thread.hpp>
+#include <iterator>
 #include <map>
 #include <string>
 #include <vector>
@@ -145,6 +146,11 @@ namespace mongo {
         }
 
 
+        /** Records a figure, such as clone throughput, alongside the step timings. */
+        void addStat( const string& name , long long value ) {
+            _b.appendNumber( name , value );
+        }
+
         void note( const string& s ) {
             string field = "note";
             if ( _nextNote > 0 ) {
@@ -205,6 +211,9 @@ namespace mongo {
             _active = false;
             _inCriticalSection = false;
             _memoryUsed = 0;
+            _cloneLocsSorted = false;
+            _cloneLocsPos = 0;
+            _cloneLocsRemaining = 0;
         }
 
         /**
@@ -230,8 +239,10 @@ namespace mongo {
             _min = min;
             _max = max;
             _shardKeyPattern = shardKeyPattern;
+            _cloneLocsSorted = false;
 
             verify( _cloneLocs.size() == 0 );
+            verify( _deletedDuringScan.size() == 0 );
             verify( _deleted.size() == 0 );
             verify( _reload.size() == 0 );
             verify( _memoryUsed == 0 );
@@ -251,6 +262,11 @@ namespace mongo {
                 _deleted.clear();
                 _reload.clear();
                 _cloneLocs.clear();
+                _cloneLocsDeleted.clear();
+                _deletedDuringScan.clear();
+                _cloneLocsSorted = false;
+                _cloneLocsPos = 0;
+                _cloneLocsRemaining = 0;
             }
             _memoryUsed = 0;
 
@@ -434,11 +450,11 @@ namespace mongo {
             // we want the number of records to better report, in that case
             bool isLargeChunk = false;
             unsigned long long recCount = 0;;
+            vector<DiskLoc> locs;
             DiskLoc dl;
             while (Runner::RUNNER_ADVANCED == runner->getNext(NULL, &dl)) {
                 if ( ! isLargeChunk ) {
-                    scoped_spinlock lk( _trackerLocks );
-                    _cloneLocs.insert( dl );
+                    locs.push_back( dl );
                 }
 
                 if ( ++recCount > maxRecsWhenFull ) {
@@ -447,6 +463,27 @@ namespace mongo {
             }
             runner.reset();
 
+            {
+                // the scan yields, so a loc can show up twice and documents can be deleted behind
+                // it; aboutToDelete remembers those in _deletedDuringScan until we're sorted
+                scoped_spinlock lk( _trackerLocks );
+                std::sort( locs.begin(), locs.end() );
+                locs.erase( std::unique( locs.begin(), locs.end() ), locs.end() );
+                std::sort( _deletedDuringScan.begin(), _deletedDuringScan.end() );
+
+                _cloneLocs.clear();
+                _cloneLocs.reserve( locs.size() );
+                std::set_difference( locs.begin(), locs.end(),
+                                     _deletedDuringScan.begin(), _deletedDuringScan.end(),
+                                     std::back_inserter( _cloneLocs ) );
+                _deletedDuringScan.clear();
+
+                _cloneLocsDeleted.assign( _cloneLocs.size(), false );
+                _cloneLocsPos = 0;
+                _cloneLocsRemaining = _cloneLocs.size();
+                _cloneLocsSorted = true;
+            }
+
             if ( isLargeChunk ) {
                 warning() << "can't move chunk of size (approximately) " << recCount * avgRecSize
                           << " because maximum size allowed to move is " << maxChunkSize
@@ -481,7 +518,7 @@ namespace mongo {
                 scoped_spinlock lk( _trackerLocks );
                 allocSize =
                     std::min(BSONObjMaxUserSize,
-                             (int)((12 + collection->averageObjectSize()) * _cloneLocs.size()));
+                             (int)((12 + collection->averageObjectSize()) * _cloneLocsRemaining));
             }
             BSONArrayBuilder a (allocSize);
             
@@ -494,12 +531,15 @@ namespace mongo {
                 {
                     Client::ReadContext ctx( _ns );
                     scoped_spinlock lk( _trackerLocks );
-                    set<DiskLoc>::iterator i = _cloneLocs.begin();
-                    for ( ; i!=_cloneLocs.end(); ++i ) {
+                    size_t i = _cloneLocsPos;
+                    for ( ; i < _cloneLocs.size(); ++i ) {
+                        if ( _cloneLocsDeleted[i] )
+                            continue;
+
                         if (tracker.intervalHasElapsed()) // should I yield?
                             break;
                         
-                        DiskLoc dl = *i;
+                        DiskLoc dl = _cloneLocs[i];
                         
                         Record* r = dl.rec();
                         if ( ! r->likelyInPhysicalMemory() ) {
@@ -519,11 +559,12 @@ namespace mongo {
                         }
                         
                         a.append( o );
+                        _cloneLocsRemaining--;
                     }
                     
-                    _cloneLocs.erase( _cloneLocs.begin() , i );
+                    _cloneLocsPos = i;
                     
-                    if ( _cloneLocs.empty() || filledBuffer )
+                    if ( _cloneLocsPos == _cloneLocs.size() || filledBuffer )
                         break;
                 }
                 
@@ -556,12 +597,28 @@ namespace mongo {
             // but trying to prevent a future bug
             scoped_spinlock lk( _trackerLocks ); 
 
-            _cloneLocs.erase( dl );
+            if ( ! _cloneLocsSorted ) {
+                _deletedDuringScan.push_back( dl );
+                return;
+            }
+
+            // locs before _cloneLocsPos have already been sent
+            vector<DiskLoc>::iterator i = std::lower_bound( _cloneLocs.begin() + _cloneLocsPos,
+                                                            _cloneLocs.end(),
+                                                            dl );
+            if ( i == _cloneLocs.end() || *i != dl )
+                return;
+
+            size_t pos = i - _cloneLocs.begin();
+            if ( ! _cloneLocsDeleted[pos] ) {
+                _cloneLocsDeleted[pos] = true;
+                _cloneLocsRemaining--;
+            }
         }
 
         std::size_t cloneLocsRemaining() {
             scoped_spinlock lk( _trackerLocks );
-            return _cloneLocs.size();
+            return _cloneLocsRemaining;
         }
 
         long long mbUsed() const { return _memoryUsed / ( 1024 * 1024 ); }
@@ -614,11 +671,18 @@ namespace mongo {
         // even though it shouldn't be needed under normal operation
         SpinLock _trackerLocks;
 
-        // disk locs yet to be transferred from here to the other side
-        // no locking needed because built initially by 1 thread in a read lock
-        // emptied by 1 thread in a read lock
-        // updates applied by 1 thread in a write lock
-        set<DiskLoc> _cloneLocs;
+        // disk locs to be transferred from here to the other side, sorted so clone() reads them
+        // in disk order. built initially by 1 thread in a read lock, consumed from _cloneLocsPos
+        // by 1 thread in a read lock; deletes (applied in a write lock) only flag their entry in
+        // _cloneLocsDeleted so neither side has to shift or rebalance anything
+        vector<DiskLoc> _cloneLocs;
+        vector<bool> _cloneLocsDeleted;
+        size_t _cloneLocsPos; // everything before this has been sent
+        size_t _cloneLocsRemaining; // not yet sent and not deleted
+        bool _cloneLocsSorted; // false while storeCurrentLocs is still scanning
+
+        // deletes seen while storeCurrentLocs was scanning, subtracted once it sorts its locs
+        vector<DiskLoc> _deletedDuringScan;
 
         list<BSONObj> _reload; // objects that were modified that must be recloned
         list<BSONObj> _deleted; // objects deleted during clone that should be deleted later
@@ -1507,6 +1571,118 @@ namespace mongo {
     MONGO_FP_DECLARE(migrateThreadHangAtStep3);
     MONGO_FP_DECLARE(migrateThreadHangAtStep4);
     MONGO_FP_DECLARE(migrateThreadHangAtStep5);
+    // pauses the initial clone after each batch is inserted, with more batches fetched ahead
+    MONGO_FP_DECLARE(migrateThreadHangDuringClone);
+
+    // how long the receiving end may hold the write lock while inserting cloned documents
+    const long long kMaxCloneLockMicros = 10 * 1000;
+
+    /**
+     * Pulls the initial clone from the donor with _migrateClone on its own thread and connection,
+     * so the next batches are on the wire while the receiving end inserts the current one.
+     */
+    class CloneBatchFetcher : boost::noncopyable {
+    public:
+        // one being inserted plus up to two fetched ahead, each at most BSONObjMaxUserSize
+        static const int kMaxBatchesQueued = 3;
+
+        explicit CloneBatchFetcher( const string& from )
+            : _from( from ), _batches( kMaxBatchesQueued ), _stopping( false ), _sawLast( false ) {
+        }
+
+        ~CloneBatchFetcher() {
+            try {
+                stop();
+            }
+            catch ( const std::exception& e ) {
+                warning() << "error stopping migrate clone fetcher: " << e.what() << migrateLog;
+            }
+        }
+
+        void start() {
+            verify( ! _thread );
+            _thread.reset( new boost::thread( &CloneBatchFetcher::run, this ) );
+        }
+
+        /**
+         * Blocks for the next _migrateClone reply. Returns false once the donor has nothing
+         * left to send, or if the command failed, in which case errmsg is set.
+         */
+        bool next( BSONObj* arr, string* errmsg ) {
+            if ( _sawLast )
+                return false;
+
+            BSONObj res = _batches.blockingPop();
+            if ( isLast( res ) ) {
+                _sawLast = true;
+                if ( ! res["ok"].trueValue() )
+                    *errmsg = "_migrateClone failed: " + res.toString();
+                return false;
+            }
+
+            *arr = res["objects"].Obj();
+            return true;
+        }
+
+        /** Tells the fetching thread to wind down and waits for it. */
+        void stop() {
+            if ( ! _thread )
+                return;
+
+            _stopping = true;
+            // the thread always finishes with exactly one last reply; draining up to it also
+            // unblocks a push waiting on a full queue
+            while ( ! _sawLast ) {
+                if ( isLast( _batches.blockingPop() ) )
+                    _sawLast = true;
+            }
+            _thread->join();
+            _thread.reset();
+        }
+
+    private:
+        static bool isLast( const BSONObj& res ) {
+            return ! res["ok"].trueValue() || res["objects"].Obj().isEmpty();
+        }
+
+        void run() {
+            Client::initThread( "migrateCloneFetcher" );
+            if (getGlobalAuthorizationManager()->isAuthEnabled()) {
+                ShardedConnectionInfo::addHook();
+                cc().getAuthorizationSession()->grantInternalAuthorization();
+            }
+
+            try {
+                ScopedDbConnection conn( _from );
+                while ( true ) {
+                    if ( _stopping ) {
+                        _batches.push( BSON( "ok" << 0 << "errmsg" << "stopped" ) );
+                        break;
+                    }
+
+                    // gets array of objects to copy, in disk order
+                    BSONObj res;
+                    conn->runCommand( "admin" , BSON( "_migrateClone" << 1 ) , res );
+                    res = res.getOwned();
+                    _batches.push( res );
+                    if ( isLast( res ) )
+                        break;
+                }
+                conn.done();
+            }
+            catch ( const std::exception& e ) {
+                _batches.push( BSON( "ok" << 0 << "errmsg" << e.what() ) );
+            }
+
+            cc().shutdown();
+        }
+
+        const string _from;
+        BlockingQueue<BSONObj> _batches;
+        boost::scoped_ptr<boost::thread> _thread;
+        volatile bool _stopping;
+        bool _sawLast; // only touched by the consuming thread
+    };
 
     class MigrateStatus {
     public:
@@ -1522,6 +1698,7 @@ namespace mongo {
 
             numCloned = 0;
             clonedBytes = 0;
+            maxCloneLockMicros = 0;
             numCatchup = 0;
             numSteady = 0;
 
@@ -1689,28 +1866,30 @@ namespace mongo {
                 // 3. initial bulk clone
                 state = CLONE;
 
-                while ( true ) {
-                    BSONObj res;
-                    if ( ! conn->runCommand( "admin" , BSON( "_migrateClone" << 1 ) , res ) ) {  // gets array of objects to copy, in disk order
-                        state = FAIL;
-                        errmsg = "_migrateClone failed: ";
-                        errmsg += res.toString();
-                        error() << errmsg << migrateLog;
-                        conn.done();
-                        return;
-                    }
-
-                    BSONObj arr = res["objects"].Obj();
-                    int thisTime = 0;
+                Timer cloneTimer;
+                CloneBatchFetcher fetcher( from );
+                fetcher.start();
 
+                BSONObj arr;
+                while ( fetcher.next( &arr, &errmsg ) ) {
+                    vector<BSONObj> docs;
                     BSONObjIterator i( arr );
                     while( i.more() ) {
-                        BSONObj o = i.next().Obj();
-                        {
-                            PageFaultRetryableSection pgrs;
-                            while ( 1 ) {
-                                try {
-                                    Client::WriteContext cx( ns );
+                        docs.push_back( i.next().Obj() );
+                    }
+
+                    // insert several documents per write lock, but give the lock back often
+                    // enough that the migration doesn't stall other writers on this shard
+                    size_t next = 0;
+                    while ( next < docs.size() ) {
+                        PageFaultRetryableSection pgrs;
+                        while ( 1 ) {
+                            try {
+                                Client::WriteContext cx( ns );
+                                Timer lockTimer;
+
+                                do {
+                                    const BSONObj& o = docs[next];
 
                                     BSONObj localDoc;
                                     if ( willOverrideLocalId( o, &localDoc ) ) {
@@ -1727,28 +1906,46 @@ namespace mongo {
                                     }
 
                                     Helpers::upsert( ns, o, true );
-                                    break;
-                                }
-                                catch ( PageFaultException& e ) {
-                                    e.touch();
-                                }
+                                    numCloned++;
+                                    clonedBytes += o.objsize();
+                                    next++;
+                                } while ( next < docs.size() &&
+                                          ! secondaryThrottle &&
+                                          lockTimer.micros() < kMaxCloneLockMicros );
+
+                                maxCloneLockMicros = std::max( maxCloneLockMicros,
+                                                               (long long)lockTimer.micros() );
+                                break;
+                            }
+                            catch ( PageFaultException& e ) {
+                                e.touch();
                             }
                         }
-                        thisTime++;
-                        numCloned++;
-                        clonedBytes += o.objsize();
 
-                        if ( secondaryThrottle && thisTime > 0 ) {
+                        if ( secondaryThrottle ) {
                             if ( ! waitForReplication( cc().getLastOp(), 2, 60 /* seconds to wait */ ) ) {
                                 warning() << "secondaryThrottle on, but doc insert timed out after 60 seconds, continuing" << endl;
                             }
                         }
                     }
 
-                    if ( thisTime == 0 )
-                        break;
+                    MONGO_FP_PAUSE_WHILE(migrateThreadHangDuringClone);
                 }
 
+                if ( ! errmsg.empty() ) {
+                    state = FAIL;
+                    error() << errmsg << migrateLog;
+                    conn.done();
+                    return;
+                }
+
+                long long cloneMillis = cloneTimer.millis();
+                timing.addStat( "clonedDocs" , numCloned );
+                timing.addStat( "clonedBytes" , clonedBytes );
+                timing.addStat( "clonedBytesPerSec" ,
+                                cloneMillis ? clonedBytes * 1000 / cloneMillis : clonedBytes );
+                timing.addStat( "maxCloneLockMicros" , maxCloneLockMicros );
+
                 timing.done(3);
                 MONGO_FP_PAUSE_WHILE(migrateThreadHangAtStep3);
             }
@@ -1889,6 +2086,7 @@ namespace mongo {
                 BSONObjBuilder bb( b.subobjStart( "counts" ) );
                 bb.append( "cloned" , numCloned );
                 bb.append( "clonedBytes" , clonedBytes );
+                bb.append( "maxCloneLockMicros" , maxCloneLockMicros );
                 bb.append( "catchup" , numCatchup );
                 bb.append( "steady" , numSteady );
                 bb.done();
@@ -2074,6 +2272,7 @@ namespace mongo {
 
         long long numCloned;
         long long clonedBytes;
+        long long maxCloneLockMicros; // longest write lock held inserting one run of the clone
         long long numCatchup;
         long long numSteady;
         bool secondaryThrottle;
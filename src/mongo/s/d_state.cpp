@@ -728,6 +728,14 @@ namespace mongo {
         _tl.reset();
     }
 
+    ShardedConnectionInfo* ShardedConnectionInfo::release() {
+        return _tl.release();
+    }
+
+    void ShardedConnectionInfo::adopt( ShardedConnectionInfo* info ) {
+        _tl.reset( info );
+    }
+
     const ChunkVersion ShardedConnectionInfo::getVersion( const string& ns ) const {
         NSVersionMap::const_iterator it = _versions.find( ns );
         if ( it != _versions.end() ) {
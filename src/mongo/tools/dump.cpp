@@ -16,19 +16,25 @@
 
 #include "mongo/pch.h"
 
+#include <boost/bind.hpp>
 #include <boost/filesystem/operations.hpp>
 #include <boost/filesystem/convenience.hpp>
 #include <fcntl.h>
 #include <fstream>
+#include <iomanip>
+#include <limits>
 #include <map>
 
+#include "mongo/client/dbclient_rs.h"
 #include "mongo/client/dbclientcursor.h"
 #include "mongo/db/db.h"
 #include "mongo/db/namespace_string.h"
 #include "mongo/db/structure/collection.h"
 #include "mongo/tools/mongodump_options.h"
 #include "mongo/tools/tool.h"
+#include "mongo/util/compress.h"
 #include "mongo/util/options_parser/option_section.h"
+#include "mongo/util/timer.h"
 
 using namespace mongo;
 
@@ -48,20 +54,67 @@ public:
         printMongoDumpHelp(&out);
     }
 
-    // This is a functor that writes a BSONObj to a file
-    struct Writer {
-        Writer(FILE* out, ProgressMeter* m) :_out(out), _m(m) {}
+    // Documents gathered into blocks of about this much before they're compressed
+    static const size_t CompressedBlockBytes = 1024 * 1024;
 
-        void operator () (const BSONObj& obj) {
-            size_t toWrite = obj.objsize();
+    /**
+     * Writes documents to a file, as they are or, if compressing, in blocks that
+     * BSONTool::processFile() reads back.  flush() before closing the file.
+     */
+    class DumpFile : boost::noncopyable {
+    public:
+        DumpFile(FILE* out, bool compress) : _out(out), _compress(compress), _count(0) {}
+
+        void write(const BSONObj& obj) {
+            _count++;
+            if (!_compress) {
+                writeBytes(obj.objdata(), obj.objsize());
+                return;
+            }
+            if (!_block.empty() && _block.size() + obj.objsize() > CompressedBlockBytes) {
+                flush();
+            }
+            _block.append(obj.objdata(), obj.objsize());
+        }
+
+        void flush() {
+            if (_block.empty()) {
+                return;
+            }
+            string compressed;
+            mongo::compress(_block.data(), _block.size(), &compressed);
+            int len = compressed.size();
+            writeBytes(reinterpret_cast<const char*>(&len), sizeof(len));
+            writeBytes(compressed.data(), compressed.size());
+            _block.clear();
+        }
+
+        long long count() const { return _count; }
+
+    private:
+        void writeBytes(const char* data, size_t toWrite) {
             size_t written = 0;
 
             while (toWrite) {
-                size_t ret = fwrite( obj.objdata()+written, 1, toWrite, _out );
+                size_t ret = fwrite( data+written, 1, toWrite, _out );
                 uassert(14035, errnoWithPrefix("couldn't write to file"), ret);
                 toWrite -= ret;
                 written += ret;
             }
+        }
+
+        FILE* _out;
+        const bool _compress;
+        string _block; // documents not yet compressed
+        long long _count;
+    };
+
+    // This is a functor that writes a BSONObj to a file
+    struct Writer {
+        Writer(DumpFile* out, ProgressMeter* m) :_out(out), _m(m) {}
+
+        void operator () (const BSONObj& obj) {
+            _out->write(obj);
 
             // if there's a progress bar, hit it
             if (_m) {
@@ -69,21 +122,39 @@ public:
             }
         }
 
-        FILE* _out;
+        DumpFile* _out;
         ProgressMeter* _m;
     };
 
-    void doCollection( const string coll , FILE* out , ProgressMeter *m ) {
+    // A file to dump a collection, or one range of its _id values, to
+    struct DumpTarget {
+        string ns;
+        boost::filesystem::path file;
+        bool compress;
+        bool segment; // dump just the _id values from min up to max
+        BSONObj min; // empty for the first segment
+        BSONObj max; // empty for the last
+    };
+
+    void doCollection( DBClientBase& connBase , const string coll , DumpFile* out ,
+                       ProgressMeter *m , const DumpTarget* segment = NULL ) {
         Query q = _query;
 
         int queryOptions = QueryOption_SlaveOk | QueryOption_NoCursorTimeout;
         if (startsWith(coll.c_str(), "local.oplog."))
             queryOptions |= QueryOption_OplogReplay;
+        else if (segment) {
+            // walking the _id index sees each document once, as $snapshot does
+            q.hint(BSON("_id" << 1));
+            if (!segment->min.isEmpty())
+                q.minKey(segment->min);
+            if (!segment->max.isEmpty())
+                q.maxKey(segment->max);
+        }
         else if (mongoDumpGlobalParams.snapShotQuery) {
             q.snapshot();
         }
         
-        DBClientBase& connBase = conn(true);
         Writer writer(out, m);
 
         // use low-latency "exhaust" mode if going over the network
@@ -111,13 +182,122 @@ public:
         m.setName("Collection File Writing Progress");
         m.setUnits("objects");
 
-        doCollection(coll, f, &m);
+        DumpFile out(f, false);
+        doCollection(conn(true), coll, &out, &m);
 
         toolInfoLog() << "\t\t " << m.done() << " objects" << std::endl;
     }
 
+    void writeTarget( DBClientBase& c , size_t i ) {
+        const DumpTarget& target = _targets[i];
+        // as conn(true) does, read from a secondary of a replica set
+        DBClientBase& connBase = c.type() == ConnectionString::SET ?
+            static_cast<DBClientBase&>(static_cast<DBClientReplicaSet&>(c).slaveConn()) : c;
+
+        toolInfoLog() << "\t" << target.ns << " to " << target.file.string() << std::endl;
+
+        FilePtr f (fopen(target.file.string().c_str(), "wb"));
+        uassert(10262, errnoWithPrefix("couldn't open file"), f);
+
+        DumpFile out(f, target.compress);
+        Timer timer;
+        if (target.segment) {
+            // a range has no count short of counting it
+            doCollection(connBase, target.ns, &out, NULL, &target);
+        }
+        else {
+            ProgressMeter m(connBase.count(target.ns.c_str(), BSONObj(), QueryOption_SlaveOk));
+            m.setName("Collection File Writing Progress");
+            m.setUnits("objects");
+            doCollection(connBase, target.ns, &out, &m);
+            m.finished();
+        }
+        out.flush();
+
+        double secs = std::max(timer.millis(), 1) / 1000.0;
+        toolInfoLog() << "\t\t " << target.file.leaf().string() << ": " << out.count()
+                      << " objects in " << secs << "s" << std::endl;
+    }
+
+    /**
+     * @return _id values splitting 'ns' into ranges of about --segmentSizeMB, or none if it's
+     *         smaller than that or can't be split: through mongos, if it's capped (whose
+     *         insertion order is only kept by dumping it whole), or without an _id index
+     */
+    vector<BSONObj> findSplitPoints( const string& ns ) {
+        vector<BSONObj> points;
+        const long long segmentBytes = mongoDumpGlobalParams.segmentSizeMB * 1024LL * 1024;
+        if (segmentBytes == 0 || _usingMongos || nsToCollectionSubstring(ns).startsWith("system."))
+            return points;
+
+        BSONObj stats;
+        if (!conn().runCommand(nsToDatabase(ns), BSON("collStats" << nsToCollectionSubstring(ns)),
+                               stats) ||
+            stats["capped"].trueValue() ||
+            stats["size"].numberLong() <= segmentBytes) {
+            return points;
+        }
+
+        // Any _id values will do, as the ranges between them cover the collection whatever they
+        // are, so these can come from the primary.  splitVector splits where a range reaches
+        // half the size it's given.
+        BSONObj res;
+        BSONObj cmd = BSON("splitVector" << ns <<
+                           "keyPattern" << BSON("_id" << 1) <<
+                           "maxChunkSizeBytes" << 2 * segmentBytes <<
+                           "maxChunkObjects" << std::numeric_limits<int>::max());
+        if (!conn().runCommand("admin", cmd, res)) {
+            toolInfoLog() << "\tnot splitting " << ns << ": " << res["errmsg"] << std::endl;
+            return points;
+        }
+
+        BSONObjIterator i(res["splitKeys"].Obj());
+        while (i.more()) {
+            points.push_back(i.next().Obj().getOwned());
+        }
+        return points;
+    }
+
+    /**
+     * Queues 'ns' to be dumped to 'filename' in 'outdir', in segments if it's large enough.
+     * @return the names of the segments' files, or none if it's dumped whole
+     */
+    vector<string> addTargets( const string& ns , const boost::filesystem::path& outdir ,
+                               const string& filename ) {
+        vector<string> segments;
+        DumpTarget target;
+        target.ns = ns;
+        // restore relies on the names of system collections' files
+        target.compress = mongoDumpGlobalParams.compress &&
+                          !nsToCollectionSubstring(ns).startsWith("system.");
+        target.segment = false;
+        const string suffix = string(".bson") + (target.compress ? compressedBSONSuffix : "");
+
+        vector<BSONObj> points = findSplitPoints(ns);
+        if (points.empty()) {
+            target.file = outdir / (filename + suffix);
+            _targets.push_back(target);
+            return segments;
+        }
+
+        toolInfoLog() << "\t" << ns << " goes to " << points.size() + 1 << " segments"
+                      << std::endl;
+        target.segment = true;
+        for (size_t i = 0; i <= points.size(); i++) {
+            target.min = i == 0 ? BSONObj() : points[i - 1];
+            target.max = i == points.size() ? BSONObj() : points[i];
+            stringstream name;
+            name << filename << segmentBSONMarker << setw(4) << setfill('0') << i << suffix;
+            target.file = outdir / name.str();
+            _targets.push_back(target);
+            segments.push_back(name.str());
+        }
+        return segments;
+    }
+
     void writeMetadataFile( const string coll, boost::filesystem::path outputFile, 
-                            map<string, BSONObj> options, multimap<string, BSONObj> indexes ) {
+                            map<string, BSONObj> options, multimap<string, BSONObj> indexes,
+                            const vector<string>& segments ) {
         toolInfoLog() << "\tMetadata for " << coll << " to " << outputFile.string() << std::endl;
 
         bool hasOptions = options.count(coll) > 0;
@@ -143,6 +323,10 @@ public:
             indexesOutput.done();
         }
 
+        if (!segments.empty()) {
+            metadata.append("segments", segments);
+        }
+
         ofstream file (outputFile.string().c_str());
         uassert(15933, "Couldn't open file: " + outputFile.string(), file.is_open());
         file << metadata.done().jsonString();
@@ -151,7 +335,8 @@ public:
 
 
     void writeCollectionStdout( const string coll ) {
-        doCollection(coll, stdout, NULL);
+        DumpFile out(stdout, false);
+        doCollection(conn(true), coll, &out, NULL);
     }
 
     void go( const string db , const boost::filesystem::path outdir ) {
@@ -220,8 +405,9 @@ public:
         for (vector<string>::iterator it = collections.begin(); it != collections.end(); ++it) {
             string name = *it;
             const string filename = name.substr( db.size() + 1 );
-            writeCollectionFile( name , outdir / ( filename + ".bson" ) );
-            writeMetadataFile( name, outdir / (filename + ".metadata.json"), collectionOptions, indexes);
+            vector<string> segments = addTargets( name , outdir , filename );
+            writeMetadataFile( name, outdir / (filename + ".metadata.json"), collectionOptions,
+                               indexes, segments );
         }
 
     }
@@ -325,13 +511,14 @@ public:
         toolInfoLog() << "writing to: " << outfile.string() << std::endl;
 
         FilePtr f (fopen(outfile.string().c_str(), "wb"));
+        DumpFile out( f , false );
 
         // init with double the docs count because we make two passes 
         ProgressMeter m( nsd->numRecords() * 2 );
         m.setName("Repair Progress");
         m.setUnits("objects");
 
-        Writer w( f , &m );
+        Writer w( &out , &m );
 
         try {
             toolInfoLog() << "forward extent pass" << std::endl;
@@ -500,6 +687,10 @@ public:
             go(toolGlobalParams.db, root / toolGlobalParams.db);
         }
 
+        // the collections all go at once; the oplog after, to cover what they missed
+        forEachParallel(_targets.size(), mongoDumpGlobalParams.numParallelCollections,
+                        boost::bind(&Dump::writeTarget, this, _1, _2));
+
         if (!opLogName.empty()) {
             BSONObjBuilder b;
             b.appendTimestamp("$gt", opLogStart);
@@ -514,6 +705,7 @@ public:
 
     bool _usingMongos;
     BSONObj _query;
+    vector<DumpTarget> _targets;
 };
 
 REGISTER_MONGO_TOOL(Dump);
@@ -60,6 +60,18 @@ namespace mongo {
         options->addOptionChaining("forceTableScan", "forceTableScan", moe::Switch,
                 "force a table scan (do not use $snapshot)");
 
+        options->addOptionChaining("numParallelCollections", "numParallelCollections,j", moe::Int,
+                "number of collections to dump at once, each on its own connection")
+                                  .setDefault(moe::Value(4));
+
+        options->addOptionChaining("segmentSizeMB", "segmentSizeMB", moe::Int,
+                "dump collections larger than this many megabytes to several files of about this "
+                "size, by _id range (0 to never split)")
+                                  .setDefault(moe::Value(0));
+
+        options->addOptionChaining("compress", "compress", moe::Switch,
+                "compress collection files with snappy");
+
 
         return Status::OK();
     }
@@ -107,6 +119,18 @@ namespace mongo {
             }
         }
         mongoDumpGlobalParams.outputFile = getParam("out");
+        mongoDumpGlobalParams.numParallelCollections = getParam("numParallelCollections", 4);
+        if (mongoDumpGlobalParams.numParallelCollections < 1) {
+            return Status(ErrorCodes::BadValue, "numParallelCollections must be at least 1");
+        }
+        mongoDumpGlobalParams.segmentSizeMB = getParam("segmentSizeMB", 0);
+        if (mongoDumpGlobalParams.segmentSizeMB < 0) {
+            return Status(ErrorCodes::BadValue, "segmentSizeMB can't be negative");
+        }
+        mongoDumpGlobalParams.compress = hasParam("compress");
+        if (mongoDumpGlobalParams.compress && mongoDumpGlobalParams.outputFile == "-") {
+            return Status(ErrorCodes::BadValue, "compress only works when dumping to a directory");
+        }
         mongoDumpGlobalParams.snapShotQuery = false;
         if (!hasParam("query") && !hasParam("dbpath") && !hasParam("forceTableScan")) {
             mongoDumpGlobalParams.snapShotQuery = true;
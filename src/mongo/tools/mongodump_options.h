@@ -30,6 +30,9 @@ namespace mongo {
         std::string query;
         bool useOplog;
         bool repair;
+        int numParallelCollections;
+        int segmentSizeMB;
+        bool compress;
         bool snapShotQuery;
     };
 
@@ -400,6 +400,44 @@ namespace {
                 ASSERT_EQUALS(iterator->_positionalStart, -1);
                 ASSERT_EQUALS(iterator->_positionalEnd, -1);
             }
+            else if (iterator->_dottedName == "numParallelCollections") {
+                ASSERT_EQUALS(iterator->_singleName, "numParallelCollections,j");
+                ASSERT_EQUALS(iterator->_type, moe::Int);
+                ASSERT_EQUALS(iterator->_description, "number of collections to dump at once, each on its own connection");
+                ASSERT_EQUALS(iterator->_isVisible, true);
+                moe::Value defaultVal(4);
+                ASSERT_TRUE(iterator->_default.equal(defaultVal));
+                ASSERT_TRUE(iterator->_implicit.isEmpty());
+                ASSERT_EQUALS(iterator->_isComposing, false);
+                ASSERT_EQUALS(iterator->_sources, moe::SourceAll);
+                ASSERT_EQUALS(iterator->_positionalStart, -1);
+                ASSERT_EQUALS(iterator->_positionalEnd, -1);
+            }
+            else if (iterator->_dottedName == "segmentSizeMB") {
+                ASSERT_EQUALS(iterator->_singleName, "segmentSizeMB");
+                ASSERT_EQUALS(iterator->_type, moe::Int);
+                ASSERT_EQUALS(iterator->_description, "dump collections larger than this many megabytes to several files of about this size, by _id range (0 to never split)");
+                ASSERT_EQUALS(iterator->_isVisible, true);
+                moe::Value defaultVal(0);
+                ASSERT_TRUE(iterator->_default.equal(defaultVal));
+                ASSERT_TRUE(iterator->_implicit.isEmpty());
+                ASSERT_EQUALS(iterator->_isComposing, false);
+                ASSERT_EQUALS(iterator->_sources, moe::SourceAll);
+                ASSERT_EQUALS(iterator->_positionalStart, -1);
+                ASSERT_EQUALS(iterator->_positionalEnd, -1);
+            }
+            else if (iterator->_dottedName == "compress") {
+                ASSERT_EQUALS(iterator->_singleName, "compress");
+                ASSERT_EQUALS(iterator->_type, moe::Switch);
+                ASSERT_EQUALS(iterator->_description, "compress collection files with snappy");
+                ASSERT_EQUALS(iterator->_isVisible, true);
+                ASSERT_TRUE(iterator->_default.isEmpty());
+                ASSERT_TRUE(iterator->_implicit.isEmpty());
+                ASSERT_EQUALS(iterator->_isComposing, false);
+                ASSERT_EQUALS(iterator->_sources, moe::SourceAll);
+                ASSERT_EQUALS(iterator->_positionalStart, -1);
+                ASSERT_EQUALS(iterator->_positionalEnd, -1);
+            }
 #ifdef MONGO_SSL
             else if (iterator->_dottedName == "ssl") {
                 ASSERT_EQUALS(iterator->_singleName, "ssl");
@@ -72,6 +72,17 @@ namespace mongo {
         options->addOptionChaining("w", "w", moe::Int, "minimum number of replicas per write")
                                   .setDefault(moe::Value(0));
 
+        options->addOptionChaining("numParallelCollections", "numParallelCollections,j", moe::Int,
+                "number of collections to restore at once, each on its own connection")
+                                  .setDefault(moe::Value(4));
+
+        options->addOptionChaining("batchSizeMB", "batchSizeMB", moe::Int,
+                "most megabytes of documents to send in one insert (1 to 32)")
+                                  .setDefault(moe::Value(8));
+
+        options->addOptionChaining("deferIndexes", "deferIndexes", moe::Switch,
+                "build indexes once all the data is restored, several collections' at once");
+
         options->addOptionChaining("dir", "dir", moe::String, "directory to restore from")
                                   .hidden()
                                   .setDefault(moe::Value(std::string("dump")))
@@ -124,9 +135,19 @@ namespace mongo {
         mongoRestoreGlobalParams.restoreOptions = !hasParam("noOptionsRestore");
         mongoRestoreGlobalParams.restoreIndexes = !hasParam("noIndexRestore");
         mongoRestoreGlobalParams.w = getParam( "w" , 0 );
+        mongoRestoreGlobalParams.numParallelCollections = getParam("numParallelCollections", 4);
+        mongoRestoreGlobalParams.batchSizeMB = getParam("batchSizeMB", 8);
+        mongoRestoreGlobalParams.deferIndexes = hasParam("deferIndexes");
         mongoRestoreGlobalParams.oplogReplay = hasParam("oplogReplay");
         mongoRestoreGlobalParams.oplogLimit = getParam("oplogLimit", "");
 
+        if (mongoRestoreGlobalParams.numParallelCollections < 1) {
+            return Status(ErrorCodes::BadValue, "numParallelCollections must be at least 1");
+        }
+        if (mongoRestoreGlobalParams.batchSizeMB < 1 || mongoRestoreGlobalParams.batchSizeMB > 32) {
+            return Status(ErrorCodes::BadValue, "batchSizeMB must be between 1 and 32");
+        }
+
         // Make the default db "" if it was not explicitly set
         if (!params.count("db")) {
             toolGlobalParams.db = "";
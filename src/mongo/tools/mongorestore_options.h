@@ -33,6 +33,9 @@ namespace mongo {
         bool restoreOptions;
         bool restoreIndexes;
         int w;
+        int numParallelCollections;
+        int batchSizeMB;
+        bool deferIndexes;
         std::string restoreDirectory;
     };
 
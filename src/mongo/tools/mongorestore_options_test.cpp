@@ -460,6 +460,44 @@ namespace {
                 ASSERT_EQUALS(iterator->_positionalStart, -1);
                 ASSERT_EQUALS(iterator->_positionalEnd, -1);
             }
+            else if (iterator->_dottedName == "numParallelCollections") {
+                ASSERT_EQUALS(iterator->_singleName, "numParallelCollections,j");
+                ASSERT_EQUALS(iterator->_type, moe::Int);
+                ASSERT_EQUALS(iterator->_description, "number of collections to restore at once, each on its own connection");
+                ASSERT_EQUALS(iterator->_isVisible, true);
+                moe::Value defaultVal(4);
+                ASSERT_TRUE(iterator->_default.equal(defaultVal));
+                ASSERT_TRUE(iterator->_implicit.isEmpty());
+                ASSERT_EQUALS(iterator->_isComposing, false);
+                ASSERT_EQUALS(iterator->_sources, moe::SourceAll);
+                ASSERT_EQUALS(iterator->_positionalStart, -1);
+                ASSERT_EQUALS(iterator->_positionalEnd, -1);
+            }
+            else if (iterator->_dottedName == "batchSizeMB") {
+                ASSERT_EQUALS(iterator->_singleName, "batchSizeMB");
+                ASSERT_EQUALS(iterator->_type, moe::Int);
+                ASSERT_EQUALS(iterator->_description, "most megabytes of documents to send in one insert (1 to 32)");
+                ASSERT_EQUALS(iterator->_isVisible, true);
+                moe::Value defaultVal(8);
+                ASSERT_TRUE(iterator->_default.equal(defaultVal));
+                ASSERT_TRUE(iterator->_implicit.isEmpty());
+                ASSERT_EQUALS(iterator->_isComposing, false);
+                ASSERT_EQUALS(iterator->_sources, moe::SourceAll);
+                ASSERT_EQUALS(iterator->_positionalStart, -1);
+                ASSERT_EQUALS(iterator->_positionalEnd, -1);
+            }
+            else if (iterator->_dottedName == "deferIndexes") {
+                ASSERT_EQUALS(iterator->_singleName, "deferIndexes");
+                ASSERT_EQUALS(iterator->_type, moe::Switch);
+                ASSERT_EQUALS(iterator->_description, "build indexes once all the data is restored, several collections' at once");
+                ASSERT_EQUALS(iterator->_isVisible, true);
+                ASSERT_TRUE(iterator->_default.isEmpty());
+                ASSERT_TRUE(iterator->_implicit.isEmpty());
+                ASSERT_EQUALS(iterator->_isComposing, false);
+                ASSERT_EQUALS(iterator->_sources, moe::SourceAll);
+                ASSERT_EQUALS(iterator->_positionalStart, -1);
+                ASSERT_EQUALS(iterator->_positionalEnd, -1);
+            }
             else if (iterator->_dottedName == "dir") {
                 ASSERT_EQUALS(iterator->_singleName, "dir");
                 ASSERT_EQUALS(iterator->_type, moe::String);
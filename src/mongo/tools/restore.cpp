@@ -16,12 +16,16 @@
 
 #include "mongo/pch.h"
 
+#include <boost/bind.hpp>
 #include <boost/filesystem/convenience.hpp>
 #include <boost/filesystem/operations.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/scoped_ptr.hpp>
+#include <boost/thread/tss.hpp>
 #include <fcntl.h>
+#include <algorithm>
 #include <fstream>
+#include <map>
 #include <set>
 
 #include "mongo/client/dbclientcursor.h"
@@ -32,25 +36,71 @@
 #include "mongo/util/mmap.h"
 #include "mongo/util/options_parser/option_section.h"
 #include "mongo/util/stringutils.h"
+#include "mongo/util/timer.h"
 
 using namespace mongo;
 
 namespace {
     const char* OPLOG_SENTINEL = "$oplog";  // compare by ptr not strcmp
+
+    // A file found in the dump, and the namespace it is restored to
+    struct RestoreTarget {
+        boost::filesystem::path file;
+        string ns;
+        string oldCollName; // Name of the collection that was dumped from
+        bool segment; // one of several files the collection was dumped to
+        boost::uintmax_t fileSize;
+    };
+
+    /**
+     * @return the name of the file's stem, without ".bson" or ".bson.snappy"
+     */
+    string stemOfFileName(const string& fileName) {
+        string name = fileName;
+        if (endsWith(name.c_str(), compressedBSONSuffix)) {
+            name = name.substr(0, name.size() - strlen(compressedBSONSuffix));
+        }
+        return name.substr(0, name.find_last_of('.'));
+    }
+
+    bool largerFileFirst(const RestoreTarget& a, const RestoreTarget& b) {
+        return a.fileSize > b.fileSize;
+    }
 }
 
 class Restore : public BSONTool {
 public:
 
-    string _curns;
-    string _curdb;
-    string _curcoll;
-    set<string> _users; // For restoring users with --drop
+    // What a thread restoring a file is working on
+    struct CollectionRestore {
+        explicit CollectionRestore(DBClientBase& c) :
+            conn(c), batchBytes(0), docs(0), bytes(0) { }
+        DBClientBase& conn; // this thread's connection
+        string ns;
+        string db;
+        string coll;
+        set<string> users; // For restoring users with --drop
+        vector<BSONObj> batch; // documents not yet sent
+        int batchBytes;
+        long long docs; // documents inserted, for the throughput report
+        long long bytes;
+    };
+
+    boost::thread_specific_ptr<CollectionRestore> _cur;
+    vector<RestoreTarget> _targets; // restored in parallel
+    vector<RestoreTarget> _indexTargets; // system.indexes.bson, once the data is in
+    map<string, set<string> > _segments; // segment files listed by each .metadata.json read
+    mongo::mutex _deferredIndexesMutex;
+    map<string, vector<BSONObj> > _deferredIndexes; // by namespace, for --deferIndexes
     scoped_ptr<Matcher> _opmatcher; // For oplog replay
     scoped_ptr<OpTime> _oplogLimitTS; // for oplog replay (limit)
     int _oplogEntrySkips; // oplog entries skipped
     int _oplogEntryApplies; // oplog entries applied
-    Restore() : BSONTool() { }
+    Restore() : BSONTool(), _deferredIndexesMutex("deferredIndexes") { }
+
+    CollectionRestore& cur() {
+        return *_cur;
+    }
 
     virtual void printHelp(ostream& out) {
         printMongoRestoreHelp(&out);
@@ -170,15 +220,45 @@ public:
         drillDown(root, toolGlobalParams.db != "", toolGlobalParams.coll != "",
                   !(_oplogLimitTS.get() == NULL), true);
 
-        // should this happen for oplog replay as well?
-        string err = conn().getLastError(toolGlobalParams.db == "" ? "admin" : toolGlobalParams.db);
-        if (!err.empty()) {
-            toolError() << err << std::endl;
+        // A collection dumped in segments is set up once, then its segments are restored
+        // alongside everything else, then it gets its indexes.
+        map<string, BSONObj> segmented;
+        for (vector<RestoreTarget>::iterator it = _targets.begin(); it != _targets.end(); ++it) {
+            if (it->segment && !segmented.count(it->ns)) {
+                beginCollection(conn(), it->ns);
+                segmented[it->ns] = prepareCollection(*it);
+                _cur.reset();
+            }
+        }
+
+        // largest first, so that a big collection isn't left to finish on its own at the end
+        std::stable_sort(_targets.begin(), _targets.end(), largerFileFirst);
+        forEachParallel(_targets.size(), mongoRestoreGlobalParams.numParallelCollections,
+                        boost::bind(&Restore::restoreTarget, this, _1, boost::cref(_targets), _2));
+
+        for (map<string, BSONObj>::iterator it = segmented.begin(); it != segmented.end(); ++it) {
+            beginCollection(conn(), it->first);
+            finishCollection(it->second);
+            _cur.reset();
+        }
+
+        for (size_t i = 0; i < _indexTargets.size(); i++) {
+            restoreTarget(conn(), _indexTargets, i);
+        }
+
+        if (!_deferredIndexes.empty()) {
+            vector<pair<string, vector<BSONObj> > > builds(_deferredIndexes.begin(),
+                                                           _deferredIndexes.end());
+            toolInfoLog() << "building indexes on " << builds.size() << " collections"
+                          << std::endl;
+            forEachParallel(builds.size(), mongoRestoreGlobalParams.numParallelCollections,
+                            boost::bind(&Restore::buildIndexes, this, _1, boost::cref(builds), _2));
         }
 
         if (mongoRestoreGlobalParams.oplogReplay) {
             toolInfoLog() << "\t Replaying oplog" << std::endl;
-            _curns = OPLOG_SENTINEL;
+            _cur.reset(new CollectionRestore(conn()));
+            cur().ns = OPLOG_SENTINEL;
             processFile( root / "oplog.bson" );
             toolInfoLog() << "Applied " << _oplogEntryApplies << " oplog entries out of "
                           << _oplogEntryApplies + _oplogEntrySkips << " (" << _oplogEntrySkips
@@ -262,7 +342,9 @@ public:
         }
 
         if ( ! ( endsWith( root.string().c_str() , ".bson" ) ||
-                 endsWith( root.string().c_str() , ".bin" ) ) ) {
+                 endsWith( root.string().c_str() , ".bin" ) ||
+                 endsWith( root.string().c_str() ,
+                           ( string( ".bson" ) + compressedBSONSuffix ).c_str() ) ) ) {
             toolError() << "don't know what to do with file [" << root.string() << "]" << std::endl;
             return;
         }
@@ -286,8 +368,9 @@ public:
 
         verify( ns.size() );
 
-        string oldCollName = root.leaf().string(); // Name of the collection that was dumped from
-        oldCollName = oldCollName.substr( 0 , oldCollName.find_last_of( "." ) );
+        bool segment;
+        // Name of the collection that was dumped from
+        string oldCollName = collectionFromFile( root , &segment );
         if (use_coll) {
             ns += "." + toolGlobalParams.coll;
         }
@@ -302,26 +385,110 @@ public:
             exit(EXIT_FAILURE);
         }
 
+        RestoreTarget target;
+        target.file = root;
+        target.ns = ns;
+        target.oldCollName = oldCollName;
+        target.segment = segment;
+        target.fileSize = boost::filesystem::file_size(root);
+        if (root.leaf() == "system.indexes.bson") {
+            _indexTargets.push_back(target);
+        }
+        else {
+            _targets.push_back(target);
+        }
+    }
+
+    /**
+     * @return the name of the collection dumped to 'file'.  That is the file's name without
+     *         ".bson" or ".bson.snappy", unless the .metadata.json of the collection whose name
+     *         comes before segmentBSONMarker lists it as one of its segments.
+     */
+    string collectionFromFile(const boost::filesystem::path& file, bool* segment) {
+        const string leaf = file.leaf().string();
+        const string stem = stemOfFileName(leaf);
+        *segment = false;
+
+        size_t marker = stem.rfind(segmentBSONMarker);
+        if (marker == string::npos) {
+            return stem;
+        }
+
+        const string coll = stem.substr(0, marker);
+        const boost::filesystem::path metadataFile = file.branch_path() / (coll + ".metadata.json");
+        map<string, set<string> >::iterator segments = _segments.find(metadataFile.string());
+        if (segments == _segments.end()) {
+            set<string> names;
+            if (boost::filesystem::exists(metadataFile)) {
+                BSONObj metadata = parseMetadataFile(metadataFile.string());
+                if (metadata["segments"].type() == Array) {
+                    BSONForEach(name, metadata["segments"].Obj()) {
+                        names.insert(name.String());
+                    }
+                }
+            }
+            segments = _segments.insert(make_pair(metadataFile.string(), names)).first;
+        }
+
+        if (segments->second.count(leaf)) {
+            *segment = true;
+            return coll;
+        }
+        toolError() << "warning: " << leaf << " looks like a segment of " << coll << " but "
+                    << metadataFile.leaf().string() << " doesn't list it" << std::endl;
+        return stem;
+    }
+
+    void restoreTarget(DBClientBase& c, const vector<RestoreTarget>& targets, size_t i) {
+        const RestoreTarget& target = targets[i];
+        beginCollection(c, target.ns);
+        if (target.segment) {
+            restoreData(target);
+        }
+        else {
+            BSONObj metadataObject = prepareCollection(target);
+            restoreData(target);
+            finishCollection(metadataObject);
+        }
+        _cur.reset();
+    }
+
+    void beginCollection(DBClientBase& c, const string& ns) {
+        _cur.reset(new CollectionRestore(c));
+        cur().ns = ns;
+        cur().db = nsToDatabase(ns);
+        cur().coll = nsToCollectionSubstring(ns).toString();
+    }
+
+    /**
+     * Drops or warns about what's there, and creates the collection with its dumped options.
+     * @return the collection's metadata, if it was dumped with any
+     */
+    BSONObj prepareCollection(const RestoreTarget& target) {
+        const boost::filesystem::path& root = target.file;
+        const string& ns = target.ns;
+        DBClientBase& c = cur().conn;
+
         toolInfoLog() << "\tgoing into namespace [" << ns << "]" << std::endl;
 
         if (mongoRestoreGlobalParams.drop) {
             if (root.leaf() != "system.users.bson" ) {
                 toolInfoLog() << "\t dropping" << std::endl;
-                conn().dropCollection( ns );
+                c.dropCollection( ns );
             } else {
                 // Create map of the users currently in the DB
                 BSONObj fields = BSON("user" << 1);
-                scoped_ptr<DBClientCursor> cursor(conn().query(ns, Query(), 0, 0, &fields));
+                scoped_ptr<DBClientCursor> cursor(c.query(ns, Query(), 0, 0, &fields));
                 while (cursor->more()) {
                     BSONObj user = cursor->next();
-                    _users.insert(user["user"].String());
+                    cur().users.insert(user["user"].String());
                 }
             }
         }
 
         BSONObj metadataObject;
         if (mongoRestoreGlobalParams.restoreOptions || mongoRestoreGlobalParams.restoreIndexes) {
-            boost::filesystem::path metadataFile = (root.branch_path() / (oldCollName + ".metadata.json"));
+            boost::filesystem::path metadataFile = (root.branch_path() / (target.oldCollName + ".metadata.json"));
             if (!boost::filesystem::exists(metadataFile.string())) {
                 // This is fine because dumps from before 2.1 won't have a metadata file, just print a warning.
                 // System collections shouldn't have metadata so don't warn if that file is missing.
@@ -333,14 +500,10 @@ public:
             }
         }
 
-        _curns = ns.c_str();
-        _curdb = nsToDatabase(_curns);
-        _curcoll = nsToCollectionSubstring(_curns).toString();
-
         // If drop is not used, warn if the collection exists.
          if (!mongoRestoreGlobalParams.drop) {
-             scoped_ptr<DBClientCursor> cursor(conn().query(_curdb + ".system.namespaces",
-                                                             Query(BSON("name" << ns))));
+             scoped_ptr<DBClientCursor> cursor(c.query(cur().db + ".system.namespaces",
+                                                       Query(BSON("name" << ns))));
              if (cursor->more()) {
                  // collection already exists show warning
                  toolError() << "Restoring to " << ns << " without dropping. Restored data "
@@ -354,26 +517,62 @@ public:
             createCollectionWithOptions(metadataObject["options"].Obj());
         }
 
+        return metadataObject;
+    }
+
+    void restoreData(const RestoreTarget& target) {
+        const boost::filesystem::path& root = target.file;
+        const string& ns = target.ns;
+        DBClientBase& c = cur().conn;
+
+        Timer timer;
         processFile( root );
+        flushBatch();
+
+        string err = c.getLastError(cur().db);
+        if (!err.empty()) {
+            toolError() << err << std::endl;
+        }
+
         if (mongoRestoreGlobalParams.drop && root.leaf() == "system.users.bson") {
             // Delete any users that used to exist but weren't in the dump file
-            for (set<string>::iterator it = _users.begin(); it != _users.end(); ++it) {
+            for (set<string>::iterator it = cur().users.begin(); it != cur().users.end(); ++it) {
                 BSONObj userMatch = BSON("user" << *it);
-                conn().remove(ns, Query(userMatch));
+                c.remove(ns, Query(userMatch));
             }
-            _users.clear();
+            cur().users.clear();
+        }
+
+        if (cur().docs > 0) {
+            double secs = std::max(timer.millis(), 1) / 1000.0;
+            double mb = cur().bytes / (1024.0 * 1024.0);
+            toolInfoLog() << "\t" << root.leaf().string() << " to " << ns << ": " << cur().docs
+                          << " documents, " << mb << "MB in " << secs << "s ("
+                          << cur().docs / secs << " documents/s, " << mb / secs << "MB/s)"
+                          << std::endl;
         }
+    }
 
+    // Builds, or with --deferIndexes queues, the indexes in the collection's metadata
+    void finishCollection(const BSONObj& metadataObject) {
         if (mongoRestoreGlobalParams.restoreIndexes && metadataObject.hasField("indexes")) {
             vector<BSONElement> indexes = metadataObject["indexes"].Array();
             for (vector<BSONElement>::iterator it = indexes.begin(); it != indexes.end(); ++it) {
-                createIndex((*it).Obj(), false);
+                addIndex(indexSpec((*it).Obj(), false));
             }
         }
     }
 
+    void buildIndexes(DBClientBase& c, const vector<pair<string, vector<BSONObj> > >& builds,
+                      size_t i) {
+        const vector<BSONObj>& indexes = builds[i].second;
+        for (vector<BSONObj>::const_iterator it = indexes.begin(); it != indexes.end(); ++it) {
+            createIndex(c, *it);
+        }
+    }
+
     virtual void gotObject( const BSONObj& obj ) {
-        if (_curns == OPLOG_SENTINEL) { // intentional ptr compare
+        if (cur().ns == OPLOG_SENTINEL) { // intentional ptr compare
             if (obj["op"].valuestr()[0] == 'n') // skip no-ops
                 return;
             
@@ -399,33 +598,56 @@ public:
                 }
             }
         }
-        else if (nsToCollectionSubstring(_curns) == "system.indexes") {
-            createIndex(obj, true);
+        else if (nsToCollectionSubstring(cur().ns) == "system.indexes") {
+            addIndex(indexSpec(obj, true));
         }
         else if (mongoRestoreGlobalParams.drop &&
-                 nsToCollectionSubstring(_curns) == ".system.users" &&
-                 _users.count(obj["user"].String())) {
+                 nsToCollectionSubstring(cur().ns) == ".system.users" &&
+                 cur().users.count(obj["user"].String())) {
             // Since system collections can't be dropped, we have to manually
             // replace the contents of the system.users collection
             BSONObj userMatch = BSON("user" << obj["user"].String());
-            conn().update(_curns, Query(userMatch), obj);
-            _users.erase(obj["user"].String());
+            cur().conn.update(cur().ns, Query(userMatch), obj);
+            cur().users.erase(obj["user"].String());
         }
         else {
-            conn().insert( _curns , obj );
-
-            // wait for insert to propagate to "w" nodes (doesn't warn if w used without replset)
-            if (mongoRestoreGlobalParams.w > 0) {
-                string err = conn().getLastError(_curdb, false, false, mongoRestoreGlobalParams.w);
-                if (!err.empty()) {
-                    toolError() << err << std::endl;
-                }
+            CollectionRestore& c = cur();
+            if (c.batchBytes + obj.objsize() > mongoRestoreGlobalParams.batchSizeMB * 1024 * 1024) {
+                flushBatch();
             }
+            // processFile() reads the next document over this one
+            c.batch.push_back(obj.getOwned());
+            c.batchBytes += obj.objsize();
+            c.docs++;
+            c.bytes += obj.objsize();
         }
     }
 
 private:
 
+    /**
+     * Inserts the documents gathered for the current collection.  A document that can't be
+     * inserted doesn't stop the rest, as when they were inserted one at a time.
+     */
+    void flushBatch() {
+        CollectionRestore& c = cur();
+        if (c.batch.empty()) {
+            return;
+        }
+
+        c.conn.insert(c.ns, c.batch, InsertOption_ContinueOnError);
+        c.batch.clear();
+        c.batchBytes = 0;
+
+        // wait for inserts to propagate to "w" nodes (doesn't warn if w used without replset)
+        if (mongoRestoreGlobalParams.w > 0) {
+            string err = c.conn.getLastError(c.db, false, false, mongoRestoreGlobalParams.w);
+            if (!err.empty()) {
+                toolError() << err << std::endl;
+            }
+        }
+    }
+
     BSONObj parseMetadataFile(string filePath) {
         long long fileSize = boost::filesystem::file_size(filePath);
         ifstream file(filePath.c_str(), ios_base::in);
@@ -467,7 +689,7 @@ private:
 
         // Add a "create" field if it doesn't exist
         if (!cmdObj.hasField("create")) {
-            bo.append("create", _curcoll);
+            bo.append("create", cur().coll);
         }
 
         BSONObjIterator i(cmdObj);
@@ -476,11 +698,11 @@ private:
 
             // Replace the "create" field with the name of the collection we are actually creating
             if (strcmp(e.fieldName(), "create") == 0) {
-                bo.append("create", _curcoll);
+                bo.append("create", cur().coll);
             }
             else {
                 if (e.type() == Undefined) {
-                    toolInfoLog() << _curns << ": skipping undefined field: " << e.fieldName()
+                    toolInfoLog() << cur().ns << ": skipping undefined field: " << e.fieldName()
                                   << std::endl;
                 }
                 else {
@@ -491,14 +713,14 @@ private:
         cmdObj = bo.obj();
 
         BSONObj fields = BSON("options" << 1);
-        scoped_ptr<DBClientCursor> cursor(conn().query(_curdb + ".system.namespaces", Query(BSON("name" << _curns)), 0, 0, &fields));
+        scoped_ptr<DBClientCursor> cursor(cur().conn.query(cur().db + ".system.namespaces", Query(BSON("name" << cur().ns)), 0, 0, &fields));
 
         bool createColl = true;
         if (cursor->more()) {
             createColl = false;
             BSONObj obj = cursor->next();
             if (!obj.hasField("options") || !optionsSame(cmdObj, obj["options"].Obj())) {
-                toolError() << "WARNING: collection " << _curns
+                toolError() << "WARNING: collection " << cur().ns
                           << " exists with different options than are in the metadata.json file and"
                           << " not using --drop. Options in the metadata file will be ignored."
                           << std::endl;
@@ -510,10 +732,10 @@ private:
         }
 
         BSONObj info;
-        if (!conn().runCommand(_curdb, cmdObj, info)) {
-            uasserted(15936, "Creating collection " + _curns + " failed. Errmsg: " + info["errmsg"].String());
+        if (!cur().conn.runCommand(cur().db, cmdObj, info)) {
+            uasserted(15936, "Creating collection " + cur().ns + " failed. Errmsg: " + info["errmsg"].String());
         } else {
-            toolInfoLog() << "\tCreated collection " << _curns << " with options: "
+            toolInfoLog() << "\tCreated collection " << cur().ns << " with options: "
                           << cmdObj.jsonString() << std::endl;
         }
     }
@@ -521,14 +743,14 @@ private:
     /* We must handle if the dbname or collection name is different at restore time than what was dumped.
        If keepCollName is true, however, we keep the same collection name that's in the index object.
      */
-    void createIndex(BSONObj indexObj, bool keepCollName) {
+    BSONObj indexSpec(BSONObj indexObj, bool keepCollName) {
         BSONObjBuilder bo;
         BSONObjIterator i(indexObj);
         while ( i.more() ) {
             BSONElement e = i.next();
             if (strcmp(e.fieldName(), "ns") == 0) {
                 NamespaceString n(e.String());
-                string s = _curdb + "." + (keepCollName ? n.coll().toString() : _curcoll);
+                string s = cur().db + "." + (keepCollName ? n.coll().toString() : cur().coll);
                 bo.append("ns", s);
             }
             // Remove index version number
@@ -536,14 +758,28 @@ private:
                 bo.append(e);
             }
         }
-        BSONObj o = bo.obj();
+        return bo.obj();
+    }
+
+    // Builds the index now, or with --deferIndexes once all the data is restored
+    void addIndex(const BSONObj& spec) {
+        if (!mongoRestoreGlobalParams.deferIndexes) {
+            createIndex(cur().conn, spec);
+            return;
+        }
+        scoped_lock lk(_deferredIndexesMutex);
+        _deferredIndexes[spec["ns"].String()].push_back(spec);
+    }
+
+    void createIndex(DBClientBase& c, const BSONObj& o) {
+        const string db = nsToDatabase(o["ns"].String());
         if (logger::globalLogDomain()->shouldLog(logger::LogSeverity::Debug(0))) {
             toolInfoLog() << "\tCreating index: " << o << std::endl;
         }
-        conn().insert( _curdb + ".system.indexes" ,  o );
+        c.insert( db + ".system.indexes" ,  o );
 
         // We're stricter about errors for indexes than for regular data
-        BSONObj err = conn().getLastErrorDetailed(_curdb, false, false, mongoRestoreGlobalParams.w);
+        BSONObj err = c.getLastErrorDetailed(db, false, false, mongoRestoreGlobalParams.w);
 
         if (err.hasField("err") && !err["err"].isNull()) {
             if (err["err"].str() == "norepl" && mongoRestoreGlobalParams.w > 1) {
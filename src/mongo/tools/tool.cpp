@@ -18,7 +18,9 @@
 
 #include "mongo/tools/tool.h"
 
+#include <boost/bind.hpp>
 #include <boost/filesystem/operations.hpp>
+#include <boost/thread/thread.hpp>
 #include <fstream>
 #include <iostream>
 
@@ -32,6 +34,7 @@
 #include "mongo/db/namespace_details.h"
 #include "mongo/db/storage_options.h"
 #include "mongo/platform/posix_fadvise.h"
+#include "mongo/util/compress.h"
 #include "mongo/util/file_allocator.h"
 #include "mongo/util/options_parser/option_section.h"
 #include "mongo/util/password.h"
@@ -232,11 +235,86 @@ namespace mongo {
             return;
         }
 
-        _conn->auth(BSON(saslCommandUserDBFieldName << getAuthenticationDatabase() <<
-                         saslCommandUserFieldName << toolGlobalParams.username <<
-                         saslCommandPasswordFieldName << toolGlobalParams.password  <<
-                         saslCommandMechanismFieldName <<
-                         toolGlobalParams.authenticationMechanism));
+        authenticate(_conn);
+    }
+
+    void Tool::authenticate( DBClientBase* c ) {
+        c->auth(BSON(saslCommandUserDBFieldName << getAuthenticationDatabase() <<
+                     saslCommandUserFieldName << toolGlobalParams.username <<
+                     saslCommandPasswordFieldName << toolGlobalParams.password  <<
+                     saslCommandMechanismFieldName <<
+                     toolGlobalParams.authenticationMechanism));
+    }
+
+    DBClientBase* Tool::newConnection() {
+        verify(!toolGlobalParams.useDirectClient && !toolGlobalParams.noconnection);
+
+        string errmsg;
+        ConnectionString cs = ConnectionString::parse(toolGlobalParams.connectionString, errmsg);
+        uassert(17304, str::stream() << "invalid hostname [" << toolGlobalParams.connectionString
+                                     << "] " << errmsg,
+                cs.isValid());
+
+        auto_ptr<DBClientBase> c(cs.connect(errmsg));
+        uassert(17305, str::stream() << "couldn't connect to ["
+                                     << toolGlobalParams.connectionString << "] " << errmsg,
+                c.get());
+
+        if (!toolGlobalParams.username.empty())
+            authenticate(c.get());
+        return c.release();
+    }
+
+    // Calls to run on several threads, handed out in order
+    struct Tool::ParallelRun {
+        ParallelRun( size_t n, const boost::function<void (DBClientBase&, size_t)>& work ) :
+            mutex("ParallelRun"), n(n), next(0), failed(false), work(work) { }
+        mongo::mutex mutex;
+        const size_t n;
+        size_t next;
+        bool failed; // stops the other threads taking more
+        const boost::function<void (DBClientBase&, size_t)> work;
+    };
+
+    void Tool::forEachParallel( size_t n, int numThreads,
+                                const boost::function<void (DBClientBase&, size_t)>& work ) {
+        size_t threads = std::min(n, static_cast<size_t>(std::max(numThreads, 1)));
+        if (threads <= 1 || toolGlobalParams.useDirectClient) {
+            for (size_t i = 0; i < n; i++) {
+                work(conn(), i);
+            }
+            return;
+        }
+
+        ParallelRun run(n, work);
+        boost::thread_group group;
+        for (size_t i = 0; i < threads; i++) {
+            group.create_thread(boost::bind(&Tool::parallelWorker, this, &run));
+        }
+        group.join_all();
+        uassert(17306, "failed on another thread, see errors above", !run.failed);
+    }
+
+    void Tool::parallelWorker( ParallelRun* run ) {
+        try {
+            scoped_ptr<DBClientBase> c(newConnection());
+            while (true) {
+                size_t i;
+                {
+                    scoped_lock lk(run->mutex);
+                    if (run->failed || run->next == run->n) {
+                        return;
+                    }
+                    i = run->next++;
+                }
+                run->work(*c, i);
+            }
+        }
+        catch (const DBException& e) {
+            toolError() << "assertion: " << e.toString() << std::endl;
+            scoped_lock lk(run->mutex);
+            run->failed = true;
+        }
     }
 
     BSONTool::BSONTool() : Tool() { }
@@ -250,6 +328,32 @@ namespace mongo {
         return doRun();
     }
 
+    bool BSONTool::processObject( const BSONObj& o ) {
+        if (bsonToolGlobalParams.objcheck && !o.valid()) {
+            toolError() << "INVALID OBJECT - going to try and print out " << std::endl;
+            toolError() << "size: " << o.objsize() << std::endl;
+            BSONObjIterator i(o);
+            while ( i.more() ) {
+                BSONElement e = i.next();
+                try {
+                    e.validate();
+                }
+                catch ( ... ) {
+                    toolError() << "\t\t NEXT ONE IS INVALID" << std::endl;
+                }
+                toolError() << "\t name : " << e.fieldName() << " " << typeName(e.type())
+                            << std::endl;
+                toolError() << "\t " << e << std::endl;
+            }
+        }
+
+        if (!bsonToolGlobalParams.hasFilter || _matcher->matches(o)) {
+            gotObject( o );
+            return true;
+        }
+        return false;
+    }
+
     long long BSONTool::processFile( const boost::filesystem::path& root ) {
         std::string fileName = root.string();
 
@@ -289,45 +393,62 @@ namespace mongo {
             m.setUnits( "bytes" );
         }
 
-        while ( read < fileLength ) {
-            size_t amt = fread(buf, 1, 4, file);
-            verify( amt == 4 );
-
-            int size = ((int*)buf)[0];
-            uassert( 10264 , str::stream() << "invalid object size: " << size , size < BUF_SIZE );
-
-            amt = fread(buf+4, 1, size-4, file);
-            verify( amt == (size_t)( size - 4 ) );
-
-            BSONObj o( buf );
-            if (bsonToolGlobalParams.objcheck && !o.valid()) {
-                toolError() << "INVALID OBJECT - going to try and print out " << std::endl;
-                toolError() << "size: " << size << std::endl;
-                BSONObjIterator i(o);
-                while ( i.more() ) {
-                    BSONElement e = i.next();
-                    try {
-                        e.validate();
-                    }
-                    catch ( ... ) {
-                        toolError() << "\t\t NEXT ONE IS INVALID" << std::endl;
-                    }
-                    toolError() << "\t name : " << e.fieldName() << " " << typeName(e.type())
-                                << std::endl;
-                    toolError() << "\t " << e << std::endl;
+        if ( endsWith( fileName.c_str(), compressedBSONSuffix ) ) {
+            boost::scoped_array<char> compressed(new char[maxCompressedLength(BUF_SIZE)]);
+            std::string block;
+
+            while ( read < fileLength ) {
+                int len;
+                size_t amt = fread(&len, 1, 4, file);
+                verify( amt == 4 );
+                uassert( 17307, str::stream() << "invalid compressed block size: " << len,
+                         len > 0 && static_cast<size_t>(len) <= maxCompressedLength(BUF_SIZE) );
+
+                amt = fread(compressed.get(), 1, len, file);
+                verify( amt == (size_t)len );
+                uassert( 17308, str::stream() << "couldn't uncompress block at offset " << read,
+                         uncompress(compressed.get(), len, &block) );
+
+                const char* p = block.data();
+                const char* end = p + block.size();
+                while ( p < end ) {
+                    int size = *reinterpret_cast<const int*>(p);
+                    uassert( 17309, str::stream() << "invalid object size: " << size,
+                             size >= 5 && size <= end - p );
+                    BSONObj o( p );
+                    if ( processObject( o ) )
+                        processed++;
+                    num++;
+                    p += size;
                 }
-            }
 
-            if (!bsonToolGlobalParams.hasFilter || _matcher->matches(o)) {
-                gotObject( o );
-                processed++;
+                read += 4 + len;
+                if (!toolGlobalParams.quiet) {
+                    m.hit(4 + len);
+                }
             }
+        }
+        else {
+            while ( read < fileLength ) {
+                size_t amt = fread(buf, 1, 4, file);
+                verify( amt == 4 );
+
+                int size = ((int*)buf)[0];
+                uassert( 10264 , str::stream() << "invalid object size: " << size , size < BUF_SIZE );
+
+                amt = fread(buf+4, 1, size-4, file);
+                verify( amt == (size_t)( size - 4 ) );
 
-            read += o.objsize();
-            num++;
+                BSONObj o( buf );
+                if ( processObject( o ) )
+                    processed++;
 
-            if (!toolGlobalParams.quiet) {
-                m.hit(o.objsize());
+                read += o.objsize();
+                num++;
+
+                if (!toolGlobalParams.quiet) {
+                    m.hit(o.objsize());
+                }
             }
         }
 
@@ -20,6 +20,8 @@
 
 #include <string>
 
+#include <boost/function.hpp>
+
 #if defined(_WIN32)
 #include <io.h>
 #endif
@@ -34,6 +36,21 @@ using std::string;
 
 namespace mongo {
 
+    /**
+     * Ends the names of compressed BSON files.  They hold a run of blocks, each a little endian
+     * int32 length followed by that many bytes of snappy, uncompressing to whole documents one
+     * after another.
+     */
+    const char compressedBSONSuffix[] = ".snappy";
+
+    /**
+     * Names the files a large collection is dumped to in parts, with the part's number after it:
+     * "c.$segment0000.bson", "c.$segment0001.bson", ...  No user collection's name has a '$', so
+     * these can't be mistaken for a collection's file.  The collection's .metadata.json lists
+     * them under "segments", and that list is what mongorestore goes by.
+     */
+    const char segmentBSONMarker[] = ".$segment";
+
     class Tool {
     public:
         Tool();
@@ -64,6 +81,21 @@ namespace mongo {
 
         mongo::DBClientBase &conn( bool slaveIfPaired = false );
 
+        /**
+         * @return a new connection to the server conn() is connected to, authenticated the same
+         *         way, for a tool that works on several threads at once; the caller owns it.
+         *         Not for use with direct data file access, which has just the one client.
+         */
+        mongo::DBClientBase* newConnection();
+
+        /**
+         * Calls work(c, i) for each i below n, spread over up to 'numThreads' threads with a
+         * connection c each from newConnection().  Runs them in order on conn() if there would
+         * only be one thread, or the data files are being used directly.
+         */
+        void forEachParallel( size_t n, int numThreads,
+                              const boost::function<void (mongo::DBClientBase&, size_t)>& work );
+
         bool _autoreconnect;
 
     protected:
@@ -72,7 +104,11 @@ namespace mongo {
         mongo::DBClientBase * _slaveConn;
 
     private:
+        struct ParallelRun;
+
         void auth();
+        void authenticate( mongo::DBClientBase* c );
+        void parallelWorker( ParallelRun* run );
     };
 
     class BSONTool : public Tool {
@@ -86,8 +122,15 @@ namespace mongo {
 
         virtual int run();
 
+        /**
+         * Passes each document in 'file' to gotObject().  The file can be plain BSON, or
+         * compressed as mongodump --compress writes it if its name ends in compressedBSONSuffix.
+         */
         long long processFile( const boost::filesystem::path& file );
 
+    private:
+        /** @return true if 'o' passed the filter and went to gotObject() */
+        bool processObject( const BSONObj& o );
     };
 
 }
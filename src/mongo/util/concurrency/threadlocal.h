@@ -94,6 +94,7 @@ namespace mongo {
     public:
         T* get() const;
         void reset(T* v);
+        T* release(); // detaches without deleting
         T* getMake() { 
             T *t = get();
             if( t == 0 )
@@ -112,6 +113,10 @@ namespace mongo {
     void TSP<T>::reset(T* v) { \
         tsp.reset(v); \
         _ ## p = v; \
+    } \
+    template<> T* TSP<T>::release() { \
+        _ ## p = 0; \
+        return tsp.release(); \
     } 
 # else
 
@@ -126,6 +131,10 @@ namespace mongo {
         tsp.reset(v); \
         _ ## p = v; \
     } \
+    template<> T* TSP<T>::release() { \
+        _ ## p = 0; \
+        return tsp.release(); \
+    } \
     TSP<T> p;
 # endif
 
@@ -157,6 +166,12 @@ namespace mongo {
             verify( pthread_setspecific( _key, v ) == 0 ); 
         }
 
+        T* release() {
+            T* old = get();
+            verify( pthread_setspecific( _key, 0 ) == 0 );
+            return old;
+        }
+
         T* getMake() { 
             T *t = get();
             if( t == 0 ) {
@@ -179,6 +194,7 @@ namespace mongo {
     public:
         T* get() const { return tsp.get(); }
         void reset(T* v) { tsp.reset(v); }
+        T* release() { return tsp.release(); }
         T* getMake() { 
             T *t = get();
             if( t == 0 )
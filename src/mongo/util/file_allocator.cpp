@@ -36,6 +36,7 @@
 #   include <io.h>
 #endif
 
+#include "mongo/db/jsobj.h"
 #include "mongo/platform/posix_fadvise.h"
 #include "mongo/util/concurrency/thread_name.h"
 #include "mongo/util/mongoutils/str.h"
@@ -79,7 +80,9 @@ namespace mongo {
     }
 
     FileAllocator::FileAllocator()
-        : _pendingMutex("FileAllocator"), _failed() {
+        : _pendingMutex("FileAllocator"), _failed(),
+          _allocations(0), _reservedAllocations(0), _allocationMillis(0),
+          _waits(0), _waitMicros(0), _maxWaitMicros(0) {
     }
 
 
@@ -120,11 +123,20 @@ namespace mongo {
             _pending.insert( i, name );
         }
         _pendingUpdated.notify_all();
+        if ( !inProgress( name ) )
+            return;
+
+        // the caller needs the file now, so from here on it is stalled on the allocation
+        Timer t;
         while( inProgress( name ) ) {
             checkFailure();
             _pendingUpdated.wait( lk.boost() );
         }
-
+        long long micros = t.micros();
+        _waits++;
+        _waitMicros += micros;
+        if ( micros > _maxWaitMicros )
+            _maxWaitMicros = micros;
     }
 
     void FileAllocator::waitUntilFinished() const {
@@ -156,22 +168,42 @@ namespace mongo {
 #endif
     }
 
-    void FileAllocator::ensureLength(int fd , long size) {
+    bool FileAllocator::ensureLength(int fd , long size) {
 #if !defined(_WIN32)
         if (useSparseFiles(fd)) {
             LOG(1) << "using ftruncate to create a sparse file" << endl;
             int ret = ftruncate(fd, size);
             uassert(16063, "ftruncate failed: " + errnoWithDescription(), ret == 0);
-            return;
+            return true;
         }
 #endif
 
 #if defined(__linux__)
-        int ret = posix_fallocate(fd,0,size);
-        if ( ret == 0 )
-            return;
+        // fallocate proper, as glibc's posix_fallocate quietly falls back to writing every
+        // block when the filesystem can't reserve space; we'd rather know and zero fill
+        if ( fallocate(fd, 0, 0, size) == 0 )
+            return true;
+        if ( errno != EOPNOTSUPP && errno != ENOSYS ) {
+            int ret = posix_fallocate(fd,0,size);
+            if ( ret == 0 )
+                return true;
+
+            log() << "FileAllocator: posix_fallocate failed: " << errnoWithDescription( ret ) << " falling back" << endl;
+        }
+#elif defined(__APPLE__)
+        {
+            // try for contiguous space first; HFS+ reads unwritten space back as zeroes
+            fstore_t store = { F_ALLOCATECONTIG, F_PEOFPOSMODE, 0, size, 0 };
+            int ret = fcntl(fd, F_PREALLOCATE, &store);
+            if ( ret == -1 ) {
+                store.fst_flags = F_ALLOCATEALL;
+                ret = fcntl(fd, F_PREALLOCATE, &store);
+            }
+            if ( ret != -1 && ftruncate(fd, size) == 0 )
+                return true;
 
-        log() << "FileAllocator: posix_fallocate failed: " << errnoWithDescription( ret ) << " falling back" << endl;
+            log() << "FileAllocator: F_PREALLOCATE failed: " << errnoWithDescription() << " falling back" << endl;
+        }
 #endif
 
         off_t filelen = lseek( fd, 0, SEEK_END );
@@ -204,6 +236,20 @@ namespace mongo {
                 left -= written;
             }
         }
+        return false;
+    }
+
+    void FileAllocator::appendStats( BSONObjBuilder& b ) const {
+        scoped_lock lk( _pendingMutex );
+        b.appendNumber( "pending", (long long) _pending.size() );
+        b.appendNumber( "allocations", _allocations );
+        b.appendNumber( "reservedWithoutWriting", _reservedAllocations );
+        b.appendNumber( "allocationMillis", _allocationMillis );
+        BSONObjBuilder waits( b.subobjStart( "waits" ) );
+        waits.appendNumber( "count", _waits );
+        waits.appendNumber( "totalMicros", _waitMicros );
+        waits.appendNumber( "maxMicros", _maxWaitMicros );
+        waits.done();
     }
 
     bool FileAllocator::hasFailed() const {
@@ -307,7 +353,7 @@ namespace mongo {
                     Timer t;
 
                     /* make sure the file is the full desired length */
-                    ensureLength( fd , size );
+                    bool reserved = ensureLength( fd , size );
 
                     close( fd );
                     fd = 0;
@@ -321,11 +367,20 @@ namespace mongo {
                     }
                     flushMyDirectory(name);
 
+                    int millis = t.millis();
                     log() << "done allocating datafile " << name << ", "
                           << "size: " << size/1024/1024 << "MB, "
-                          << " took " << ((double)t.millis())/1000.0 << " secs"
+                          << " took " << ((double)millis)/1000.0 << " secs"
                           << endl;
 
+                    {
+                        scoped_lock lk( fa->_pendingMutex );
+                        fa->_allocations++;
+                        if ( reserved )
+                            fa->_reservedAllocations++;
+                        fa->_allocationMillis += millis;
+                    }
+
                     // no longer in a failed state. allow new writers.
                     fa->_failed = false;
                 }
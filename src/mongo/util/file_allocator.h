@@ -25,6 +25,8 @@
 
 namespace mongo {
 
+    class BSONObjBuilder;
+
     /*
      * Handles allocation of contiguous files on disk.  Allocation may be
      * requested asynchronously or synchronously.
@@ -56,7 +58,16 @@ namespace mongo {
         
         bool hasFailed() const;
 
-        static void ensureLength(int fd, long size);
+        /**
+         * Makes the file at least size bytes long, reading back as zeroes.  Where the filesystem
+         * can reserve the space without writing it (fallocate, F_PREALLOCATE) that is used,
+         * otherwise the file is filled with zeroes.
+         * @return true if the space was reserved without being written
+         */
+        static bool ensureLength(int fd, long size);
+
+        /** allocation counts and the time callers spent blocked waiting on allocations */
+        void appendStats( BSONObjBuilder& b ) const;
 
         /** @return the singleton */
         static FileAllocator * get();
@@ -91,6 +102,14 @@ namespace mongo {
 
         bool _failed;
 
+        // use _pendingMutex
+        long long _allocations;
+        long long _reservedAllocations; // ensureLength didn't have to write
+        long long _allocationMillis;
+        long long _waits; // allocateAsap calls that blocked
+        long long _waitMicros;
+        long long _maxWaitMicros;
+
         static FileAllocator* _instance;
 
     };
@@ -32,10 +32,13 @@
 #include <string>
 #include <stdint.h>
 
+#include "mongo/platform/atomic_word.h"
+
 namespace mongo {
 
     /**
-     * A histogram for a 32-bit integer range.
+     * A histogram for a 32-bit integer range. insert() may be called
+     * concurrently from several threads.
      */
     class Histogram {
     public:
@@ -124,7 +127,7 @@ namespace mongo {
 
         // all below owned here
         uint32_t* _boundaries;    // maximum element of each bucket
-        uint64_t* _buckets;       // current count of each bucket
+        AtomicUInt64* _buckets;   // current count of each bucket
 
         Histogram( const Histogram& );
         Histogram& operator=( const Histogram& );
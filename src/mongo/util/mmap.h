@@ -228,6 +228,14 @@ namespace mongo {
 
         /** close the current private view and open a new replacement */
         void* remapPrivateView(void *oldPrivateAddr);
+
+#ifndef _WIN32
+        /** replace [ofs, ofs+len) of the private view at oldPrivateAddr with a fresh mapping of
+            the file.  ofs must be page aligned.  there is no equivalent on Windows, where a view
+            can only be replaced as a whole.
+        */
+        void remapPrivateViewRange(void *oldPrivateAddr, unsigned long long ofs, size_t len);
+#endif
     };
 
     /** p is called from within a mutex that MongoFile uses.  so be careful not to deadlock. */
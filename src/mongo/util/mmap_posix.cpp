@@ -195,6 +195,29 @@ namespace mongo {
         return x;
     }
 
+    void MemoryMappedFile::remapPrivateViewRange(void *oldPrivateAddr,
+                                                 unsigned long long ofs,
+                                                 size_t rangeLen) {
+#if defined(__sunos__) // SERVER-8795
+        verify( Lock::isW() );
+        LockMongoFilesExclusive lockMongoFiles;
+#endif
+
+        verify( ofs % g_minOSPageSizeBytes == 0 );
+        verify( ofs + rangeLen <= len );
+
+        char *at = static_cast<char*>(oldPrivateAddr) + ofs;
+        void * x = mmap( at, rangeLen, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_NORESERVE|MAP_FIXED, fd, ofs );
+        if( x == MAP_FAILED ) {
+            int err = errno;
+            error()  << "13601 Couldn't remap private view: " << errnoWithDescription(err) << endl;
+            log() << "aborting" << endl;
+            printMemInfo();
+            abort();
+        }
+        verify( x == at );
+    }
+
     void MemoryMappedFile::flush(bool sync) {
         if ( views.empty() || fd == 0 )
             return;
@@ -23,12 +23,108 @@
 #include <errno.h>
 #include <time.h>
 
+#include "mongo/db/jsobj.h"
+#include "mongo/platform/atomic_word.h"
+#include "mongo/util/concurrency/threadlocal.h"
 #include "mongo/util/goodies.h"
 #include "mongo/util/net/listen.h"
 #include "mongo/util/net/message_port.h"
 
 namespace mongo {
 
+    namespace {
+        const int MinBufferClassBits = 10; // 1KB
+        const int NumBufferClasses = 7; // up to 64KB
+        const int MaxCachedPerClass = 4;
+
+        // Ahead of each buffer, its size class or -1 if it's too big to pool.  Keeps the
+        // message 16 byte aligned, as malloc() would.
+        const int BufferHeaderBytes = 16;
+
+        AtomicUInt64 messagesReceived;
+        AtomicUInt64 buffersAllocated;
+        AtomicUInt64 buffersReused;
+        AtomicUInt64 zeroCopyReplies;
+
+        int bufferClass( int size ) {
+            for ( int c = 0; c < NumBufferClasses; c++ ) {
+                if ( size <= ( 1 << ( MinBufferClassBits + c ) ) )
+                    return c;
+            }
+            return -1;
+        }
+    }
+
+    struct MessageBufferCache {
+        MessageBufferCache() {
+            for ( int c = 0; c < NumBufferClasses; c++ )
+                counts[c] = 0;
+        }
+        ~MessageBufferCache() {
+            for ( int c = 0; c < NumBufferClasses; c++ ) {
+                for ( int i = 0; i < counts[c]; i++ )
+                    free( buffers[c][i] );
+            }
+        }
+        char* buffers[NumBufferClasses][MaxCachedPerClass];
+        int counts[NumBufferClasses];
+    };
+
+    TSP_DECLARE(MessageBufferCache, messageBufferCache)
+    TSP_DEFINE(MessageBufferCache, messageBufferCache)
+
+    char* MessageBufferPool::allocate( int size ) {
+        const int c = bufferClass( size );
+        if ( c >= 0 ) {
+            MessageBufferCache* cache = messageBufferCache.getMake();
+            if ( cache->counts[c] > 0 ) {
+                buffersReused.fetchAndAdd( 1 );
+                return cache->buffers[c][--cache->counts[c]] + BufferHeaderBytes;
+            }
+            size = 1 << ( MinBufferClassBits + c );
+        }
+
+        char* raw = static_cast< char* >( malloc( BufferHeaderBytes + size ) );
+        if ( !raw )
+            return 0;
+        buffersAllocated.fetchAndAdd( 1 );
+        *reinterpret_cast< int* >( raw ) = c;
+        return raw + BufferHeaderBytes;
+    }
+
+    void MessageBufferPool::release( char* buf ) {
+        if ( !buf )
+            return;
+        char* raw = buf - BufferHeaderBytes;
+        const int c = *reinterpret_cast< int* >( raw );
+        if ( c >= 0 ) {
+            MessageBufferCache* cache = messageBufferCache.getMake();
+            if ( cache->counts[c] < MaxCachedPerClass ) {
+                cache->buffers[c][cache->counts[c]++] = raw;
+                return;
+            }
+        }
+        free( raw );
+    }
+
+    void MessageBufferPool::noteReceived() {
+        messagesReceived.fetchAndAdd( 1 );
+    }
+
+    void MessageBufferPool::noteZeroCopyReply() {
+        zeroCopyReplies.fetchAndAdd( 1 );
+    }
+
+    void MessageBufferPool::appendStats( BSONObjBuilder& b ) {
+        const unsigned long long received = messagesReceived.load();
+        const unsigned long long allocated = buffersAllocated.load();
+        b.appendNumber( "received", static_cast< long long >( received ) );
+        b.appendNumber( "allocated", static_cast< long long >( allocated ) );
+        b.appendNumber( "reused", static_cast< long long >( buffersReused.load() ) );
+        b.append( "allocatedPerMessage", received ? double( allocated ) / received : 0.0 );
+        b.appendNumber( "zeroCopyReplies", static_cast< long long >( zeroCopyReplies.load() ) );
+    }
+
     void Message::send( MessagingPort &p, const char *context ) {
         if ( empty() ) {
             return;
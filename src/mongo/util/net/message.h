@@ -17,8 +17,11 @@
 
 #pragma once
 
+#include <algorithm>
 #include <vector>
 
+#include <boost/shared_ptr.hpp>
+
 #include "mongo/bson/util/atomic_int.h"
 #include "mongo/util/goodies.h"
 #include "mongo/util/net/hostandport.h"
@@ -31,6 +34,7 @@ namespace mongo {
      */
     const int MaxMessageSizeBytes = 48 * 1000 * 1000;
 
+    class BSONObjBuilder;
     class Message;
     class MessagingPort;
     class PiggyBackData;
@@ -150,15 +154,37 @@ namespace mongo {
     }
 #pragma pack()
 
+    /**
+     * Buffers that received messages are read into, from free lists per power of two size class
+     * between 1KB and 64KB that each thread keeps for itself.  A connection's steady stream of
+     * requests then reuses a handful of buffers instead of malloc()ing one per message.  Larger
+     * messages are malloc()ed and freed as before.
+     */
+    class MessageBufferPool {
+    public:
+        /** @return a buffer of at least 'size' bytes, to be given back with release() */
+        static char* allocate( int size );
+
+        static void release( char* buf );
+
+        /** counts a message received; allocations per message are reported against these */
+        static void noteReceived();
+
+        /** counts a reply sent from the buffers it was built in */
+        static void noteZeroCopyReply();
+
+        static void appendStats( BSONObjBuilder& b );
+    };
+
     class Message {
     public:
         // we assume here that a vector with initial size 0 does no allocation (0 is the default, but wanted to make it explicit).
-        Message() : _buf( 0 ), _data( 0 ), _freeIt( false ) {}
+        Message() : _buf( 0 ), _data( 0 ), _freeIt( false ), _pooled( false ) {}
         Message( void * data , bool freeIt ) :
-            _buf( 0 ), _data( 0 ), _freeIt( false ) {
+            _buf( 0 ), _data( 0 ), _freeIt( false ), _pooled( false ) {
             _setData( reinterpret_cast< MsgData* >( data ), freeIt );
         };
-        Message(Message& r) : _buf( 0 ), _data( 0 ), _freeIt( false ) {
+        Message(Message& r) : _buf( 0 ), _data( 0 ), _freeIt( false ), _pooled( false ) {
             *this = r;
         }
         ~Message() {
@@ -228,6 +254,10 @@ namespace mongo {
             if ( r._data.size() > 0 ) {
                 _data.swap( r._data );
             }
+            _unowned.swap( r._unowned );
+            _owners.swap( r._owners );
+            _pooled = r._pooled;
+            r._pooled = false;
             r._freeIt = false;
             _freeIt = true;
             return *this;
@@ -235,17 +265,23 @@ namespace mongo {
 
         void reset() {
             if ( _freeIt ) {
+                // a pooled buffer is the message's first, wherever appendData() has put it
                 if ( _buf ) {
-                    free( _buf );
+                    _freeBuffer( reinterpret_cast< char* >( _buf ), _pooled );
                 }
                 for (std::vector< std::pair< char *, int > >::const_iterator i = _data.begin();
                      i != _data.end(); ++i) {
-                    free(i->first);
+                    if ( std::find( _unowned.begin(), _unowned.end(), i->first ) != _unowned.end() )
+                        continue;
+                    _freeBuffer( i->first, _pooled && i == _data.begin() );
                 }
             }
             _buf = 0;
             _data.clear();
+            _unowned.clear();
+            _owners.clear();
             _freeIt = false;
+            _pooled = false;
         }
 
         // use to add a buffer
@@ -269,11 +305,41 @@ namespace mongo {
             header()->len += size;
         }
 
+        /**
+         * Adds a buffer after the first without copying it or taking it over: 'owner' is kept
+         * until the message is reset, and must keep 'd' alive until then.  A null 'owner' means
+         * 'd' outlives the message anyway.  The buffers go out together in one gather write.
+         */
+        void appendUnownedData(const char *d, int size, const boost::shared_ptr<void>& owner) {
+            if ( size <= 0 ) {
+                return;
+            }
+            verify( !empty() );
+            verify( _freeIt );
+            if ( _buf ) {
+                _data.push_back(std::make_pair((char*)_buf, _buf->len));
+                _buf = 0;
+            }
+            char* p = const_cast< char* >( d );
+            _data.push_back(std::make_pair(p, size));
+            _unowned.push_back(p);
+            if ( owner ) {
+                _owners.push_back(owner);
+            }
+            header()->len += size;
+        }
+
         // use to set first buffer if empty
         void setData(MsgData *d, bool freeIt) {
             verify( empty() );
             _setData( d, freeIt );
         }
+        // use to set first buffer if empty, to a buffer from MessageBufferPool::allocate()
+        void setPooledData(MsgData *d) {
+            verify( empty() );
+            _setData( d, true );
+            _pooled = true;
+        }
         void setData(int operation, const char *msgtxt) {
             setData(operation, msgtxt, strlen(msgtxt)+1);
         }
@@ -298,14 +364,26 @@ namespace mongo {
     private:
         void _setData( MsgData *d, bool freeIt ) {
             _freeIt = freeIt;
+            _pooled = false;
             _buf = d;
         }
+        static void _freeBuffer( char* buf, bool pooled ) {
+            if ( pooled )
+                MessageBufferPool::release( buf );
+            else
+                free( buf );
+        }
         // if just one buffer, keep it in _buf, otherwise keep a sequence of buffers in _data
         MsgData * _buf;
         // byte buffer(s) - the first must contain at least a full MsgData unless using _buf for storage instead
         typedef std::vector< std::pair< char*, int > > MsgVec;
         MsgVec _data;
+        // buffers in _data that aren't ours to free, and what keeps them alive
+        std::vector< char* > _unowned;
+        std::vector< boost::shared_ptr<void> > _owners;
         bool _freeIt;
+        // whether the first buffer is from MessageBufferPool
+        bool _pooled;
     };
 
 
@@ -211,8 +211,8 @@ again:
             psock->setHandshakeReceived();
             int z = (len+1023)&0xfffffc00;
             verify(z>=len);
-            MsgData *md = (MsgData *) malloc(z);
-            ScopeGuard guard = MakeGuard(free, md);
+            MsgData *md = (MsgData *) MessageBufferPool::allocate(z);
+            ScopeGuard guard = MakeGuard(MessageBufferPool::release, (char*)md);
             verify(md);
 
             memcpy(md, &header, headerLen);
@@ -221,7 +221,8 @@ again:
             psock->recv( (char *)&md->_data, left );
 
             guard.Dismiss();
-            m.setData(md, true);
+            m.setPooledData(md);
+            MessageBufferPool::noteReceived();
             return true;
 
         }
@@ -30,7 +30,33 @@ namespace mongo {
 
     class MessageHandler {
     public:
+        /**
+         * Whatever per-connection state connected() and process() keep in thread locals.
+         */
+        class ThreadState {
+        public:
+            virtual ~ThreadState() {}
+        };
+
         virtual ~MessageHandler() {}
+
+        /**
+         * If true, the connection may be served by a different thread for each message.  The
+         * server then calls releaseThreadState() after connected() and after each process(), and
+         * adoptThreadState() before each process() and before disconnected().
+         */
+        virtual bool canShareThreads() const { return false; }
+
+        /**
+         * Detach this connection's state from the current thread.  The caller owns the result.
+         */
+        virtual ThreadState* releaseThreadState() { return NULL; }
+
+        /**
+         * Attach a connection's state, previously returned by releaseThreadState(), to the
+         * current thread.  Takes ownership of 'state'.
+         */
+        virtual void adoptThreadState( ThreadState* state ) {}
         
         /**
          * called once when a socket is connected
@@ -54,8 +80,12 @@ namespace mongo {
         struct Options {
             int port;                   // port to bind to
             string ipList;             // addresses to bind to
+            int workerThreads;          // if > 0, serve connections from a pool of this many
+                                        // threads instead of a thread per connection
+            double workerTimeoutSecs;   // if > 0, a pooled connection is closed if it takes
+                                        // longer than this to send a message or take a reply
 
-            Options() : port(0), ipList("") {}
+            Options() : port(0), ipList(""), workerThreads(0), workerTimeoutSecs(0) {}
         };
 
         virtual ~MessageServer() {}
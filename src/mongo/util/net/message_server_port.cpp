@@ -24,6 +24,7 @@
 
 #include "mongo/db/lasterror.h"
 #include "mongo/db/stats/counters.h"
+#include "mongo/platform/atomic_word.h"
 #include "mongo/util/concurrency/ticketholder.h"
 #include "mongo/util/concurrency/thread_name.h"
 #include "mongo/util/net/listen.h"
@@ -33,11 +34,247 @@
 #include "mongo/util/net/ssl_manager.h"
 
 #ifdef __linux__  // TODO: consider making this ifndef _WIN32
+# include <sys/epoll.h>
 # include <sys/resource.h>
+# include "mongo/util/concurrency/thread_pool.h"
 #endif
 
 namespace mongo {
 
+#ifdef __linux__
+    /**
+     * Serves connections from a pool of worker threads.  Idle sockets are parked in an epoll set
+     * with EPOLLONESHOT; when one becomes readable a worker adopts the connection's thread state,
+     * handles a single message and parks the socket again.  This trades a thread (and its stack)
+     * per connection for a thread per concurrently active request.
+     *
+     * A worker reads a whole message once its first bytes arrive, so pooled sockets time out
+     * rather than let a slow client hold the worker.  Operations themselves may block for a long
+     * time (fsyncLock, awaitData), so when every worker is busy a connection that becomes readable
+     * gets a thread of its own for the rest of its life instead of waiting for one.
+     */
+    class ConnectionDispatcher {
+        MONGO_DISALLOW_COPYING(ConnectionDispatcher);
+    public:
+        ConnectionDispatcher( MessageHandler* handler, int workerThreads, double timeoutSecs )
+            : _handler( handler ),
+              _epfd( epoll_create( 1024 ) ),
+              _workers( workerThreads ),
+              _timeoutSecs( timeoutSecs ),
+              _pool( workerThreads ) {
+            massert( 17301, str::stream() << "epoll_create failed: " << errnoWithDescription(),
+                     _epfd >= 0 );
+            boost::thread poller( boost::bind( &ConnectionDispatcher::pollLoop, this ) );
+        }
+
+        /** Takes ownership of 'p'.  The caller has already acquired a connection ticket. */
+        void add( MessagingPort* p ) {
+            _busy.fetchAndAdd( 1 );
+            _pool.schedule( &ConnectionDispatcher::setup, this, new Connection( p ) );
+        }
+
+    private:
+        struct Connection {
+            explicit Connection( MessagingPort* p ) : port( p ), le( NULL ), state( NULL ) {}
+            scoped_ptr<MessagingPort> port;
+            LastError* le; // owned; attached to lastError only while a worker serves us
+            MessageHandler::ThreadState* state; // owned while parked
+            string otherSide;
+        };
+
+        /** Decrements _busy when a pool task is done, however it ends. */
+        class BusyReleaser {
+        public:
+            explicit BusyReleaser( AtomicUInt32* busy ) : _busy( busy ) {}
+            ~BusyReleaser() { _busy->subtractAndFetch( 1 ); }
+        private:
+            AtomicUInt32* _busy;
+        };
+
+        void setup( Connection* conn ) {
+            BusyReleaser releaser( &_busy );
+            setThreadName( "connWorker" );
+            conn->port->psock->setLogLevel(logger::LogSeverity::Debug(1));
+            if ( _timeoutSecs > 0 ) {
+                conn->port->psock->setTimeout( _timeoutSecs );
+            }
+            conn->le = new LastError();
+            lastError.reset( conn->le );
+            try {
+                conn->otherSide = conn->port->psock->remoteString();
+                _handler->connected( conn->port.get() );
+            }
+            catch ( const DBException& e ) {
+                log() << "DBException handling new connection, closing client connection: "
+                      << e << endl;
+                close( conn, true );
+                return;
+            }
+            park( conn, EPOLL_CTL_ADD );
+        }
+
+        /** Detach 'conn' from this thread and wait for its next message. */
+        void park( Connection* conn, int op ) {
+            conn->state = _handler->releaseThreadState();
+            lastError.release();
+
+            epoll_event ev;
+            ev.events = EPOLLIN | EPOLLONESHOT;
+            ev.data.ptr = conn;
+            if ( epoll_ctl( _epfd, op, conn->port->psock->rawFD(), &ev ) != 0 ) {
+                log() << "epoll_ctl failed, closing client connection: "
+                      << errnoWithDescription() << endl;
+                close( conn, false );
+            }
+        }
+
+        /** Attach a parked connection's state to this thread. */
+        void adopt( Connection* conn ) {
+            _handler->adoptThreadState( conn->state );
+            conn->state = NULL;
+            lastError.reset( conn->le );
+        }
+
+        void serve( Connection* conn ) {
+            BusyReleaser releaser( &_busy );
+            adopt( conn );
+            if ( handleOne( conn ) ) {
+                park( conn, EPOLL_CTL_MOD );
+            }
+        }
+
+        /** Serves 'conn' until it closes, on a thread of its own. */
+        void dedicated( Connection* conn ) {
+            {
+                string threadName = "conn";
+                if ( conn->port->connectionId() > 0 )
+                    threadName = str::stream() << threadName << conn->port->connectionId();
+                setThreadName( threadName.c_str() );
+            }
+            adopt( conn );
+            conn->port->psock->setTimeout( 0 );
+            while ( handleOne( conn ) ) {
+            }
+        }
+
+        /**
+         * Handles one message on 'conn', whose state is attached to this thread.  Returns false if
+         * the connection was closed instead.
+         */
+        bool handleOne( Connection* conn ) {
+            MessagingPort* p = conn->port.get();
+            Message m;
+            try {
+                p->psock->clearCounters();
+                if ( inShutdown() || ! p->recv( m ) ) {
+                    close( conn, true );
+                    return false;
+                }
+                _handler->process( m , p , conn->le );
+                networkCounter.hit( p->psock->getBytesIn() , p->psock->getBytesOut() );
+            }
+            catch ( AssertionException& e ) {
+                log() << "AssertionException handling request, closing client connection: " << e << endl;
+                close( conn, false );
+                return false;
+            }
+            catch ( SocketException& e ) {
+                log() << "SocketException handling request, closing client connection: " << e << endl;
+                close( conn, false );
+                return false;
+            }
+            catch ( const DBException& e ) { // must be right above std::exception to avoid catching subclasses
+                log() << "DBException handling request, closing client connection: " << e << endl;
+                close( conn, false );
+                return false;
+            }
+            catch ( std::exception &e ) {
+                error() << "Uncaught std::exception: " << e.what() << ", terminating" << endl;
+                dbexit( EXIT_UNCAUGHT );
+            }
+            catch ( ... ) {
+                error() << "Uncaught exception, terminating" << endl;
+                dbexit( EXIT_UNCAUGHT );
+            }
+            return true;
+        }
+
+        /**
+         * The same teardown handleIncomingMsg does when its loop exits.  Expects the connection's
+         * state to be attached to this thread unless it is parked in conn->state.
+         */
+        void close( Connection* conn, bool logEnd ) {
+            TicketHolderReleaser connTicketReleaser( &Listener::globalTicketHolder );
+            scoped_ptr<Connection> owned( conn );
+
+            if ( logEnd && !serverGlobalParams.quiet ) {
+                int conns = Listener::globalTicketHolder.used()-1;
+                const char* word = (conns == 1 ? " connection" : " connections");
+                log() << "end connection " << conn->otherSide << " (" << conns << word << " now open)" << endl;
+            }
+            conn->port->shutdown();
+
+            if ( conn->state ) {
+                _handler->adoptThreadState( conn->state );
+                conn->state = NULL;
+            }
+            lastError.reset( conn->le ); // deleted when this thread's next connection resets it
+#ifdef MONGO_SSL
+            SSLManagerInterface* manager = getSSLManager();
+            if (manager)
+                manager->cleanupThreadLocals();
+#endif
+            _handler->disconnected( conn->port.get() );
+
+            // the thread is about to serve someone else
+            delete _handler->releaseThreadState();
+        }
+
+        /** Hands a readable connection to a worker, or to a thread of its own if all are busy. */
+        void dispatch( Connection* conn ) {
+            if ( _busy.loadRelaxed() >= static_cast<unsigned>( _workers ) ) {
+                try {
+                    boost::thread thr( boost::bind( &ConnectionDispatcher::dedicated, this, conn ) );
+                    LOG(1) << "connection workers busy, serving " << conn->otherSide
+                           << " on its own thread" << endl;
+                    return;
+                }
+                catch ( boost::thread_resource_error& ) {
+                    // Wait for a worker like everyone else.
+                }
+            }
+            _busy.fetchAndAdd( 1 );
+            _pool.schedule( &ConnectionDispatcher::serve, this, conn );
+        }
+
+        void pollLoop() {
+            setThreadName( "connPoller" );
+            const int maxEvents = 256;
+            epoll_event events[maxEvents];
+            while ( ! inShutdown() ) {
+                int n = epoll_wait( _epfd, events, maxEvents, 1000 );
+                if ( n < 0 ) {
+                    if ( errno != EINTR ) {
+                        error() << "epoll_wait failed: " << errnoWithDescription() << endl;
+                        sleepmillis( 10 );
+                    }
+                    continue;
+                }
+                for ( int i = 0; i < n; i++ ) {
+                    dispatch( static_cast<Connection*>( events[i].data.ptr ) );
+                }
+            }
+        }
+
+        MessageHandler* const _handler;
+        const int _epfd;
+        const int _workers;
+        const double _timeoutSecs; // for pooled sockets to send a message or take a reply
+        AtomicUInt32 _busy; // pool tasks scheduled and not yet finished
+        threadpool::ThreadPool _pool;
+    };
+#endif
+
     class PortMessageServer : public MessageServer , public Listener {
     public:
         /**
@@ -49,6 +286,23 @@ namespace mongo {
          */
         PortMessageServer(  const MessageServer::Options& opts, MessageHandler * handler ) :
             Listener( "" , opts.ipList, opts.port ), _handler(handler) {
+#ifdef __linux__
+            if ( opts.workerThreads > 0 ) {
+                bool ssl = false;
+#ifdef MONGO_SSL
+                ssl = getSSLManager() != NULL;
+#endif
+                // SSL may buffer decrypted bytes the kernel no longer reports as readable.
+                if ( ! handler->canShareThreads() || ssl ) {
+                    log() << "connection worker threads not supported here, "
+                          << "using a thread per connection" << endl;
+                }
+                else {
+                    _dispatcher.reset( new ConnectionDispatcher( handler, opts.workerThreads,
+                                                                 opts.workerTimeoutSecs ) );
+                }
+            }
+#endif
         }
 
         virtual void acceptedMP(MessagingPort * p) {
@@ -71,6 +325,11 @@ namespace mongo {
                     boost::thread thr(boost::bind(&handleIncomingMsg, himParam));
                 }
 #else
+                if ( _dispatcher ) {
+                    _dispatcher->add( p );
+                    return;
+                }
+
                 pthread_attr_t attrs;
                 pthread_attr_init(&attrs);
                 pthread_attr_setdetachstate(&attrs, PTHREAD_CREATE_DETACHED);
@@ -137,6 +396,9 @@ namespace mongo {
 
     private:
         MessageHandler* _handler;
+#ifdef __linux__
+        scoped_ptr<ConnectionDispatcher> _dispatcher;
+#endif
 
         /**
          * Simple holder for threadRun parameters. Should not destroy the objects it holds -
@@ -0,0 +1,111 @@
+/**
+ *    Copyright (C) 2013 10gen Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects
+ *    for all of the code used other than as permitted herein. If you modify
+ *    file(s) with this exception, you may extend this exception to your
+ *    version of the file(s), but you are not obligated to do so. If you do not
+ *    wish to do so, delete this exception statement from your version. If you
+ *    delete this exception statement from all source files in the program,
+ *    then also delete it in the license file.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/util/net/message.h"
+
+#include <cstring>
+
+#include "mongo/db/jsobj.h"
+#include "mongo/unittest/unittest.h"
+
+namespace {
+
+    using namespace mongo;
+
+    TEST(MessageBufferPool, ReusesBuffersOfASizeClass) {
+        char* a = MessageBufferPool::allocate(1500);
+        ASSERT(a);
+        MessageBufferPool::release(a);
+        // anything that rounds up to the same 2KB class comes back from this thread's free list
+        char* b = MessageBufferPool::allocate(2048);
+        ASSERT_EQUALS(a, b);
+        MessageBufferPool::release(b);
+    }
+
+    TEST(MessageBufferPool, LargeBuffersAreNotPooled) {
+        const int size = 1024 * 1024;
+        char* a = MessageBufferPool::allocate(size);
+        ASSERT(a);
+        memset(a, 'x', size);
+        MessageBufferPool::release(a);
+    }
+
+    TEST(MessageBufferPool, Stats) {
+        MessageBufferPool::noteReceived();
+        BSONObjBuilder b;
+        MessageBufferPool::appendStats(b);
+        BSONObj stats = b.obj();
+        ASSERT_GREATER_THAN(stats["received"].numberLong(), 0);
+        ASSERT(stats.hasField("allocated"));
+        ASSERT(stats.hasField("reused"));
+        ASSERT(stats.hasField("allocatedPerMessage"));
+        ASSERT(stats.hasField("zeroCopyReplies"));
+    }
+
+    TEST(Message, PooledDataIsReleased) {
+        MsgData* md = reinterpret_cast<MsgData*>(MessageBufferPool::allocate(sizeof(MsgData)));
+        md->len = sizeof(MsgData);
+        md->setOperation(opReply);
+        {
+            Message m;
+            m.setPooledData(md);
+            ASSERT_EQUALS(m.header(), md);
+        }
+        char* again = MessageBufferPool::allocate(sizeof(MsgData));
+        ASSERT_EQUALS(reinterpret_cast<char*>(md), again);
+        MessageBufferPool::release(again);
+    }
+
+    TEST(Message, UnownedDataIsSentNotCopied) {
+        BSONObj obj = BSON("a" << 1 << "b" << "hello");
+        boost::shared_ptr<void> owner(new BSONObj(obj));
+
+        Message m;
+        m.setData(opReply, "x");
+        const int headerLen = m.header()->len;
+        m.appendUnownedData(obj.objdata(), obj.objsize(), owner);
+        ASSERT_EQUALS(headerLen + obj.objsize(), m.header()->len);
+        ASSERT_EQUALS(headerLen + obj.objsize(), m.size());
+        ASSERT_GREATER_THAN(owner.use_count(), 1);
+
+        // a moved message keeps the owner alive
+        Message moved;
+        moved = m;
+        ASSERT(m.empty());
+        ASSERT_GREATER_THAN(owner.use_count(), 1);
+
+        moved.concat();
+        ASSERT_EQUALS(headerLen + obj.objsize(), moved.header()->len);
+        ASSERT_EQUALS(0, memcmp(moved.singleData()->_data + headerLen - sizeof(MSGHEADER),
+                                obj.objdata(), obj.objsize()));
+        ASSERT_EQUALS(1, owner.use_count());
+    }
+
+}  // namespace